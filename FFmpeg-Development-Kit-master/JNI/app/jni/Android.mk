@@ -5,7 +5,7 @@ LOCAL_LDLIBS := -llog -ljnigraphics -lz -landroid
 LOCAL_CFLAGS := -Wdeprecated-declarations
 ANDROID_LIB := -landroid
 LOCAL_CFLAGS := -I$(NDK)/sources/ffmpeg 
-LOCAL_SRC_FILES :=  videokit.c ffmpeg.c ffmpeg_filter.c ffmpeg_opt.c cmdutils.c
+LOCAL_SRC_FILES :=  videokit.c ffmpeg.c ffmpeg_filter.c ffmpeg_opt.c ffmpeg_job.c cmdutils.c
 LOCAL_SHARED_LIBRARIES := libavformat libavcodec libswscale libavutil libswresample libavfilter libavdevice
 
 include $(BUILD_SHARED_LIBRARY)
@@ -67,30 +67,20 @@
 
 static int init_report(const char *env);
 
-
-jmp_buf env_buf;
-
-
-AVDictionary *sws_dict;
-AVDictionary *swr_opts;
-AVDictionary *format_opts, *codec_opts, *resample_opts;
-
-static FILE *report_file;
-static int report_file_level = AV_LOG_DEBUG;
 int hide_banner = 0;
 
 void init_opts(void)
 {
-    av_dict_set(&sws_dict, "flags", "bicubic", 0);
+    av_dict_set(&cur_job->sws_dict, "flags", "bicubic", 0);
 }
 
 void uninit_opts(void)
 {
-    av_dict_free(&swr_opts);
-    av_dict_free(&sws_dict);
-    av_dict_free(&format_opts);
-    av_dict_free(&codec_opts);
-    av_dict_free(&resample_opts);
+    av_dict_free(&cur_job->swr_opts);
+    av_dict_free(&cur_job->sws_dict);
+    av_dict_free(&cur_job->format_opts);
+    av_dict_free(&cur_job->codec_opts);
+    av_dict_free(&cur_job->resample_opts);
 }
 
 void log_callback_help(void *ptr, int level, const char *fmt, va_list vl)
@@ -100,20 +90,35 @@ void log_callback_help(void *ptr, int level, const char *fmt, va_list vl)
 
 static void log_callback_report(void *ptr, int level, const char *fmt, va_list vl)
 {
+    FILE *report_file = cur_job->report_file;
     va_list vl2;
     char line[1024];
-    static int print_prefix = 1;
+    static __thread int print_prefix = 1;
 
     va_copy(vl2, vl);
-    av_log_default_callback(ptr, level, fmt, vl);
+    if ((level & 0xff) <= cur_job->log_level)
+        av_log_default_callback(ptr, level, fmt, vl);
     av_log_format_line(ptr, level, fmt, vl2, line, sizeof(line), &print_prefix);
     va_end(vl2);
-    if (report_file_level >= level) {
+    if (report_file && cur_job->report_file_level >= level) {
         fputs(line, report_file);
-        fflush(report_file);
+        /* the debug output is left to stdio buffering, warnings and errors
+         * must be in the report if the process dies right after */
+        if (level <= AV_LOG_WARNING)
+            fflush(report_file);
     }
 }
 
+void log_callback_job(void *ptr, int level, const char *fmt, va_list vl)
+{
+    FFTranscodeJob *job = cur_job;
+
+    if (job && job->log_callback)
+        job->log_callback(ptr, level, fmt, vl);
+    else if ((level & 0xff) <= (job ? job->log_level : AV_LOG_INFO))
+        av_log_default_callback(ptr, level, fmt, vl);
+}
+
 void init_dynload(void)
 {
 #ifdef _WIN32
@@ -134,7 +139,8 @@ void exit_program(int ret)
 {
     if (program_exit)
         program_exit(ret);
-		longjmp(env_buf, ret);
+    if (cur_job)
+        longjmp(cur_job->exit_buf, ret);
 
     exit(ret);
 }
@@ -296,10 +302,11 @@ static inline void prepare_app_arguments(int *argc_ptr, char ***argv_ptr)
 static int write_option(void *optctx, const OptionDef *po, const char *opt,
                         const char *arg)
 {
-    /* new-style options contain an offset into optctx, old-style address of
-     * a global var*/
+    /* new-style options contain an offset into optctx, job-wide ones an
+     * offset into the running job, old-style address of a global var*/
     void *dst = po->flags & (OPT_OFFSET | OPT_SPEC) ?
-                (uint8_t *)optctx + po->u.off : po->u.dst_ptr;
+                (uint8_t *)optctx + po->u.off :
+                po->flags & OPT_JOB ? (uint8_t *)cur_job + po->u.off : po->u.dst_ptr;
     int *dstcount;
 
     if (po->flags & OPT_SPEC) {
@@ -479,6 +486,7 @@ int locate_option(int argc, char **argv, const OptionDef *options,
 
 static void dump_argument(const char *a)
 {
+    FILE *report_file = cur_job->report_file;
     const unsigned char *p;
 
     for (p = a; *p; p++)
@@ -524,14 +532,14 @@ void parse_loglevel(int argc, char **argv, const OptionDef *options)
     idx = locate_option(argc, argv, options, "report");
     if ((env = getenv("FFREPORT")) || idx) {
         init_report(env);
-        if (report_file) {
+        if (cur_job->report_file) {
             int i;
-            fprintf(report_file, "Command line:\n");
+            fprintf(cur_job->report_file, "Command line:\n");
             for (i = 0; i < argc; i++) {
                 dump_argument(argv[i]);
-                fputc(i < argc - 1 ? ' ' : '\n', report_file);
+                fputc(i < argc - 1 ? ' ' : '\n', cur_job->report_file);
             }
-            fflush(report_file);
+            fflush(cur_job->report_file);
         }
     }
     idx = locate_option(argc, argv, options, "hide_banner");
@@ -567,7 +575,7 @@ int opt_default(void *optctx, const char *opt, const char *arg)
 #endif
 
     if (!strcmp(opt, "debug") || !strcmp(opt, "fdebug"))
-        av_log_set_level(AV_LOG_DEBUG);
+        cur_job->log_level = AV_LOG_DEBUG;
 
     if (!(p = strchr(opt, ':')))
         p = opt + strlen(opt);
@@ -577,12 +585,12 @@ int opt_default(void *optctx, const char *opt, const char *arg)
                          AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)) ||
         ((opt[0] == 'v' || opt[0] == 'a' || opt[0] == 's') &&
          (o = opt_find(&cc, opt + 1, NULL, 0, AV_OPT_SEARCH_FAKE_OBJ)))) {
-        av_dict_set(&codec_opts, opt, arg, FLAGS);
+        av_dict_set(&cur_job->codec_opts, opt, arg, FLAGS);
         consumed = 1;
     }
     if ((o = opt_find(&fc, opt, NULL, 0,
                          AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
-        av_dict_set(&format_opts, opt, arg, FLAGS);
+        av_dict_set(&cur_job->format_opts, opt, arg, FLAGS);
         if (consumed)
             if (loglevel == 2) 
             	LOGI("Routing option %s to both codec and muxer layer\n", opt);
@@ -607,7 +615,7 @@ int opt_default(void *optctx, const char *opt, const char *arg)
             return ret;
         }
 
-        av_dict_set(&sws_dict, opt, arg, FLAGS);
+        av_dict_set(&cur_job->sws_dict, opt, arg, FLAGS);
 
         consumed = 1;
     }
@@ -629,14 +637,14 @@ int opt_default(void *optctx, const char *opt, const char *arg)
             	LOGI("Error setting option %s.\n", opt);
             return ret;
         }
-        av_dict_set(&swr_opts, opt, arg, FLAGS);
+        av_dict_set(&cur_job->swr_opts, opt, arg, FLAGS);
         consumed = 1;
     }
 #endif
 #if CONFIG_AVRESAMPLE
     if ((o=opt_find(&rc, opt, NULL, 0,
                        AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
-        av_dict_set(&resample_opts, opt, arg, FLAGS);
+        av_dict_set(&cur_job->resample_opts, opt, arg, FLAGS);
         consumed = 1;
     }
 #endif
@@ -683,17 +691,17 @@ static void finish_group(OptionParseContext *octx, int group_idx,
     *g             = octx->cur_group;
     g->arg         = arg;
     g->group_def   = l->group_def;
-    g->sws_dict    = sws_dict;
-    g->swr_opts    = swr_opts;
-    g->codec_opts  = codec_opts;
-    g->format_opts = format_opts;
-    g->resample_opts = resample_opts;
-
-    codec_opts  = NULL;
-    format_opts = NULL;
-    resample_opts = NULL;
-    sws_dict    = NULL;
-    swr_opts    = NULL;
+    g->sws_dict    = cur_job->sws_dict;
+    g->swr_opts    = cur_job->swr_opts;
+    g->codec_opts  = cur_job->codec_opts;
+    g->format_opts = cur_job->format_opts;
+    g->resample_opts = cur_job->resample_opts;
+
+    cur_job->codec_opts  = NULL;
+    cur_job->format_opts = NULL;
+    cur_job->resample_opts = NULL;
+    cur_job->sws_dict    = NULL;
+    cur_job->swr_opts    = NULL;
     init_opts();
 
     memset(&octx->cur_group, 0, sizeof(octx->cur_group));
@@ -869,7 +877,7 @@ do {                                                                           \
         return AVERROR_OPTION_NOT_FOUND;
     }
 
-    if (octx->cur_group.nb_opts || codec_opts || format_opts || resample_opts)
+    if (octx->cur_group.nb_opts || cur_job->codec_opts || cur_job->format_opts || cur_job->resample_opts)
         if (loglevel == 2) 
         	LOGI("Trailing options were found on the "
                "commandline.\n");
@@ -907,17 +915,11 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
     };
     char *tail;
     int level;
-    int flags;
     int i;
 
-    flags = av_log_get_flags();
+    /* repeated lines are collapsed for the whole process, "repeat" is
+     * accepted but cannot be applied to a single job */
     tail = strstr(arg, "repeat");
-    if (tail)
-        flags &= ~AV_LOG_SKIP_REPEATED;
-    else
-        flags |= AV_LOG_SKIP_REPEATED;
-
-    av_log_set_flags(flags);
     if (tail == arg)
         arg += 6 + (arg[6]=='+');
     if(tail && !*arg)
@@ -925,7 +927,7 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
 
     for (i = 0; i < FF_ARRAY_ELEMS(log_levels); i++) {
         if (!strcmp(log_levels[i].name, arg)) {
-            av_log_set_level(log_levels[i].level);
+            cur_job->log_level = log_levels[i].level;
             return 0;
         }
     }
@@ -940,7 +942,7 @@ int opt_loglevel(void *optctx, const char *opt, const char *arg)
             	LOGI("\"%s\"\n", log_levels[i].name);
         exit_program(1006);
     }
-    av_log_set_level(level);
+    cur_job->log_level = level;
     return 0;
 }
 
@@ -981,7 +983,7 @@ static int init_report(const char *env)
     struct tm *tm;
     AVBPrint filename;
 
-    if (report_file) /* already opened */
+    if (cur_job->report_file) /* already opened */
         return 0;
     time(&now);
     tm = localtime(&now);
@@ -1003,7 +1005,7 @@ static int init_report(const char *env)
             val = NULL;
         } else if (!strcmp(key, "level")) {
             char *tail;
-            report_file_level = strtol(val, &tail, 10);
+            cur_job->report_file_level = strtol(val, &tail, 10);
             if (*tail) {
                 if (loglevel > 0) 
                 	LOGI("Invalid report file level\n");
@@ -1027,15 +1029,15 @@ static int init_report(const char *env)
         return AVERROR(ENOMEM);
     }
 
-    report_file = fopen(filename.str, "w");
-    if (!report_file) {
+    cur_job->report_file = fopen(filename.str, "w");
+    if (!cur_job->report_file) {
         int ret = AVERROR(errno);
         if (loglevel > 0) 
         	LOGI("Failed to open report \"%s\": %s\n",
                filename.str, strerror(errno));
         return ret;
     }
-    av_log_set_callback(log_callback_report);
+    cur_job->log_callback = log_callback_report;
     if (loglevel == 2) 
     	LOGI(           "%s started on %04d-%02d-%02d at %02d:%02d:%02d\n"
            "Report written to \"%s\"\n",
@@ -1204,7 +1206,7 @@ void show_banner(int argc, char **argv, const OptionDef *options)
 
 int show_version(void *optctx, const char *opt, const char *arg)
 {
-    av_log_set_callback(log_callback_help);
+    cur_job->log_callback = log_callback_help;
     print_program_info (SHOW_COPYRIGHT, AV_LOG_INFO);
     print_all_libs_info(SHOW_VERSION, AV_LOG_INFO);
 
@@ -1213,7 +1215,7 @@ int show_version(void *optctx, const char *opt, const char *arg)
 
 int show_buildconf(void *optctx, const char *opt, const char *arg)
 {
-    av_log_set_callback(log_callback_help);
+    cur_job->log_callback = log_callback_help;
     print_buildconf      (INDENT|0, AV_LOG_INFO);
 
     return 0;
@@ -1938,7 +1940,7 @@ static void show_help_filter(const char *name)
 int show_help(void *optctx, const char *opt, const char *arg)
 {
     char *topic, *par;
-    av_log_set_callback(log_callback_help);
+    cur_job->log_callback = log_callback_help;
 
     topic = av_strdup(arg ? arg : "");
     if (!topic)
@@ -2254,9 +2256,9 @@ int show_sources(void *optctx, const char *opt, const char *arg)
     char *dev = NULL;
     AVDictionary *opts = NULL;
     int ret = 0;
-    int error_level = av_log_get_level();
+    int error_level = cur_job->log_level;
 
-    av_log_set_level(AV_LOG_ERROR);
+    cur_job->log_level = AV_LOG_ERROR;
 
     if ((ret = show_sinks_sources_parse_arg(arg, &dev, &opts)) < 0)
         goto fail;
@@ -2282,7 +2284,7 @@ int show_sources(void *optctx, const char *opt, const char *arg)
   fail:
     av_dict_free(&opts);
     av_free(dev);
-    av_log_set_level(error_level);
+    cur_job->log_level = error_level;
     return ret;
 }
 
@@ -2292,9 +2294,9 @@ int show_sinks(void *optctx, const char *opt, const char *arg)
     char *dev = NULL;
     AVDictionary *opts = NULL;
     int ret = 0;
-    int error_level = av_log_get_level();
+    int error_level = cur_job->log_level;
 
-    av_log_set_level(AV_LOG_ERROR);
+    cur_job->log_level = AV_LOG_ERROR;
 
     if ((ret = show_sinks_sources_parse_arg(arg, &dev, &opts)) < 0)
         goto fail;
@@ -2318,7 +2320,7 @@ int show_sinks(void *optctx, const char *opt, const char *arg)
   fail:
     av_dict_free(&opts);
     av_free(dev);
-    av_log_set_level(error_level);
+    cur_job->log_level = error_level;
     return ret;
 }
 
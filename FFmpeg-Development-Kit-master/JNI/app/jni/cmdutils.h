@@ -38,6 +38,8 @@
 #include "libavformat/avformat.h"
 #include "libswscale/swscale.h"
 
+#include "ffmpeg_job.h"
+
 #ifdef _WIN32
 #undef main /* We don't want SDL to override our main() */
 #endif
@@ -48,8 +50,7 @@
 extern const char program_name[];
 
 
-extern int loglevel;
-extern jmp_buf env_buf;
+extern __thread int loglevel;
 
 
 /**
@@ -59,9 +60,6 @@ extern const int program_birth_year;
 
 extern AVCodecContext *avcodec_opts[AVMEDIA_TYPE_NB];
 extern AVFormatContext *avformat_opts;
-extern AVDictionary *sws_dict;
-extern AVDictionary *swr_opts;
-extern AVDictionary *format_opts, *codec_opts, *resample_opts;
 extern int hide_banner;
 
 /**
@@ -96,6 +94,13 @@ void uninit_opts(void);
  */
 void log_callback_help(void* ptr, int level, const char* fmt, va_list vl);
 
+/**
+ * Log callback of the process, installed once. It applies the log level and
+ * the callback of the job running on the calling thread, if any, so that
+ * concurrent jobs do not change each other's logging.
+ */
+void log_callback_job(void *ptr, int level, const char *fmt, va_list vl);
+
 /**
  * Override the cpuflags.
  */
@@ -198,6 +203,7 @@ typedef struct OptionDef {
 #define OPT_DOUBLE 0x20000
 #define OPT_INPUT  0x40000
 #define OPT_OUTPUT 0x80000
+#define OPT_JOB    0x100000     /* option is specified as an offset in cur_job */
      union {
         void *dst_ptr;
         int (*func_arg)(void *, const char *, const char *);
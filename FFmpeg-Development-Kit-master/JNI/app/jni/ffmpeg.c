@@ -104,18 +104,13 @@
 #include "ffmpeg.h"
 #include "cmdutils.h"
 
+#include "libavutil/atomic.h"
 #include "libavutil/avassert.h"
 
 const char program_name[] = "ffmpeg";
 const int program_birth_year = 2000;
 
-static FILE *vstats_file;
-
-
-int loglevel = 0;
-int return_code = -1;
-jmp_buf env_buf;
-
+__thread int loglevel = 0;
 
 const char *const forced_keyframes_const_names[] = {
     "n",
@@ -130,31 +125,6 @@ static void do_video_stats(OutputStream *ost, int frame_size);
 static int64_t getutime(void);
 static int64_t getmaxrss(void);
 
-static int run_as_daemon  = 0;
-static int nb_frames_dup = 0;
-static int nb_frames_drop = 0;
-static int64_t decode_error_stat[2];
-
-static int want_sdp = 1;
-
-static int current_time;
-AVIOContext *progress_avio = NULL;
-
-static uint8_t *subtitle_out;
-
-InputStream **input_streams = NULL;
-int        nb_input_streams = 0;
-InputFile   **input_files   = NULL;
-int        nb_input_files   = 0;
-
-OutputStream **output_streams = NULL;
-int         nb_output_streams = 0;
-OutputFile   **output_files   = NULL;
-int         nb_output_files   = 0;
-
-FilterGraph **filtergraphs;
-int        nb_filtergraphs;
-
 #if HAVE_TERMIOS_H
 
 /* init terminal so that we can grab keys */
@@ -268,7 +238,7 @@ static void sub2video_update(InputStream *ist, AVSubtitle *sub)
 
 static void sub2video_heartbeat(InputStream *ist, int64_t pts)
 {
-    InputFile *infile = input_files[ist->file_index];
+    InputFile *infile = cur_job->input_files[ist->file_index];
     int i, j, nb_reqs;
     int64_t pts2;
 
@@ -277,7 +247,7 @@ static void sub2video_heartbeat(InputStream *ist, int64_t pts)
        video frames could be accumulating in the filter graph while a filter
        (possibly overlay) is desperately waiting for a subtitle frame. */
     for (i = 0; i < infile->nb_streams; i++) {
-        InputStream *ist2 = input_streams[infile->ist_index + i];
+        InputStream *ist2 = cur_job->input_streams[infile->ist_index + i];
         if (!ist2->sub2video.frame)
             continue;
         /* subtitles seem to be usually muxed ahead of other streams;
@@ -322,11 +292,10 @@ void term_exit(void)
     term_exit_sigsafe();
 }
 
+/* signals are delivered to the process, they stop every job */
 static volatile int received_sigterm = 0;
 static volatile int received_nb_signals = 0;
-static volatile int transcode_init_done = 0;
-static volatile int ffmpeg_exited = 0;
-static int main_return_code = 0;
+static volatile int nb_running_jobs = 0;
 
 static void
 sigterm_handler(int sig)
@@ -338,7 +307,8 @@ sigterm_handler(int sig)
         write(2/*STDERR_FILENO*/, "Received > 3 system signals, hard exiting\n",
                            strlen("Received > 3 system signals, hard exiting\n"));
 
-        exit_program(2000);
+        /* any thread may get the signal: never clean up or unwind a job here */
+        _exit(2000);
     }
 }
 
@@ -363,7 +333,7 @@ static BOOL WINAPI CtrlHandler(DWORD fdwCtrlType)
            process is hard terminated, so stall as long as we need to
            to try and let the main thread(s) clean up and gracefully terminate
            (we have at most 5 seconds, but should be done far before that). */
-        while (!ffmpeg_exited) {
+        while (avpriv_atomic_int_get(&nb_running_jobs)) {
             Sleep(0);
         }
         return TRUE;
@@ -379,7 +349,7 @@ static BOOL WINAPI CtrlHandler(DWORD fdwCtrlType)
 void term_init(void)
 {
 #if HAVE_TERMIOS_H
-    if (!run_as_daemon && stdin_interaction) {
+    if (!cur_job->run_as_daemon && cur_job->stdin_interaction) {
         struct termios tty;
         if (tcgetattr (0, &tty) == 0) {
             oldtty = tty;
@@ -464,23 +434,25 @@ static int read_key(void)
 
 static int decode_interrupt_cb(void *ctx)
 {
-    return received_nb_signals > transcode_init_done;
+    FFTranscodeJob *job = ctx;
+    return received_nb_signals > job->transcode_init_done || job->cancelled;
 }
 
-const AVIOInterruptCB int_cb = { decode_interrupt_cb, NULL };
-
 static void ffmpeg_cleanup(int ret)
 {
     int i, j;
 
-    if (do_benchmark) {
+    if (!cur_job)
+        return;
+
+    if (cur_job->do_benchmark) {
         int maxrss = getmaxrss() / 1024;
         if (loglevel == 2) 
         	LOGI("bench: maxrss=%ikB\n", maxrss);
     }
 
-    for (i = 0; i < nb_filtergraphs; i++) {
-        FilterGraph *fg = filtergraphs[i];
+    for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+        FilterGraph *fg = cur_job->filtergraphs[i];
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             av_freep(&fg->inputs[j]->name);
@@ -494,15 +466,15 @@ static void ffmpeg_cleanup(int ret)
         av_freep(&fg->outputs);
         av_freep(&fg->graph_desc);
 
-        av_freep(&filtergraphs[i]);
+        av_freep(&cur_job->filtergraphs[i]);
     }
-    av_freep(&filtergraphs);
+    av_freep(&cur_job->filtergraphs);
 
-    av_freep(&subtitle_out);
+    av_freep(&cur_job->subtitle_out);
 
     /* close files */
-    for (i = 0; i < nb_output_files; i++) {
-        OutputFile *of = output_files[i];
+    for (i = 0; i < cur_job->nb_output_files; i++) {
+        OutputFile *of = cur_job->output_files[i];
         AVFormatContext *s;
         if (!of)
             continue;
@@ -512,10 +484,10 @@ static void ffmpeg_cleanup(int ret)
         avformat_free_context(s);
         av_dict_free(&of->opts);
 
-        av_freep(&output_files[i]);
+        av_freep(&cur_job->output_files[i]);
     }
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
 
         if (!ost)
             continue;
@@ -552,17 +524,17 @@ static void ffmpeg_cleanup(int ret)
         }
         av_fifo_freep(&ost->muxing_queue);
 
-        av_freep(&output_streams[i]);
+        av_freep(&cur_job->output_streams[i]);
     }
 #if HAVE_PTHREADS
     free_input_threads();
 #endif
-    for (i = 0; i < nb_input_files; i++) {
-        avformat_close_input(&input_files[i]->ctx);
-        av_freep(&input_files[i]);
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        avformat_close_input(&cur_job->input_files[i]->ctx);
+        av_freep(&cur_job->input_files[i]);
     }
-    for (i = 0; i < nb_input_streams; i++) {
-        InputStream *ist = input_streams[i];
+    for (i = 0; i < cur_job->nb_input_streams; i++) {
+        InputStream *ist = cur_job->input_streams[i];
 
         av_frame_free(&ist->decoded_frame);
         av_frame_free(&ist->filter_frame);
@@ -575,36 +547,38 @@ static void ffmpeg_cleanup(int ret)
 
         avcodec_free_context(&ist->dec_ctx);
 
-        av_freep(&input_streams[i]);
+        av_freep(&cur_job->input_streams[i]);
     }
 
-    if (vstats_file) {
-        if (fclose(vstats_file))
+    if (cur_job->vstats_file) {
+        if (fclose(cur_job->vstats_file))
             if (loglevel > 0) 
             	LOGI(                   "Error closing vstats file, loss of information possible: %s\n",
                    av_err2str(AVERROR(errno)));
     }
-    av_freep(&vstats_filename);
+    av_freep(&cur_job->vstats_filename);
+    av_freep(&cur_job->sdp_filename);
 
-    av_freep(&input_streams);
-    av_freep(&input_files);
-    av_freep(&output_streams);
-    av_freep(&output_files);
+    av_freep(&cur_job->input_streams);
+    av_freep(&cur_job->input_files);
+    av_freep(&cur_job->output_streams);
+    av_freep(&cur_job->output_files);
 
     uninit_opts();
 
-    avformat_network_deinit();
-
     if (received_sigterm) {
         if (loglevel == 2) 
         	LOGI("Exiting normally, received signal %d.\n",
                (int) received_sigterm);
-    } else if (ret && transcode_init_done) {
+    } else if (ret && cur_job->transcode_init_done) {
         if (loglevel == 2) 
         	LOGI("Conversion failed!\n");
     }
     term_exit();
-    ffmpeg_exited = 1;
+    if (cur_job->report_file) {
+        fclose(cur_job->report_file);
+        cur_job->report_file = NULL;
+    }
 }
 
 void remove_avoptions(AVDictionary **a, AVDictionary *b)
@@ -633,7 +607,7 @@ static void abort_codec_experimental(AVCodec *c, int encoder)
 
 static void update_benchmark(const char *fmt, ...)
 {
-    if (do_benchmark_all) {
+    if (cur_job->do_benchmark_all) {
         int64_t t = getutime();
         va_list va;
         char buf[1024];
@@ -643,17 +617,17 @@ static void update_benchmark(const char *fmt, ...)
             vsnprintf(buf, sizeof(buf), fmt, va);
             va_end(va);
             if (loglevel == 2) 
-            	LOGI("bench: %8"PRIu64" %s \n", t - current_time, buf);
+            	LOGI("bench: %8"PRIu64" %s \n", t - cur_job->current_time, buf);
         }
-        current_time = t;
+        cur_job->current_time = t;
     }
 }
 
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost2 = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost2 = cur_job->output_streams[i];
         ost2->finished |= ost == ost2 ? this_stream : others;
     }
 }
@@ -685,8 +659,8 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
         return;
     }
 
-    if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_sync_method == VSYNC_DROP) ||
-        (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && audio_sync_method < 0))
+    if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && cur_job->video_sync_method == VSYNC_DROP) ||
+        (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && cur_job->audio_sync_method < 0))
         pkt->pts = pkt->dts = AV_NOPTS_VALUE;
 
     /*
@@ -750,7 +724,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
                 	LOGI("Non-monotonous DTS in output stream "
                        "%d:%d; previous: %"PRId64", current: %"PRId64"; ",
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
-                if (exit_on_error) {
+                if (cur_job->exit_on_error) {
                     if (loglevel > 0) 
                     	LOGI("aborting.\n");
                     exit_program(2005);
@@ -772,7 +746,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
 
     pkt->stream_index = ost->index;
 
-    if (debug_ts) {
+    if (cur_job->debug_ts) {
         if (loglevel == 2) 
         	LOGI("muxer <- type:%s "
                 "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s size:%d\n",
@@ -787,7 +761,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
     if (ret < 0) {
         if (loglevel > 0) 
         	        LOGI("av_interleaved_write_frame()", ret);
-        main_return_code = 1;
+        cur_job->main_return_code = 1;
         close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
     av_packet_unref(pkt);
@@ -795,7 +769,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
 
 static void close_output_stream(OutputStream *ost)
 {
-    OutputFile *of = output_files[ost->file_index];
+    OutputFile *of = cur_job->output_files[ost->file_index];
 
     ost->finished |= ENCODER_FINISHED;
     if (of->shortest) {
@@ -863,14 +837,14 @@ finish:
         if (loglevel > 0) 
         	LOGI("Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
-        if(exit_on_error)
+        if(cur_job->exit_on_error)
             exit_program(2006);
     }
 }
 
 static int check_recording_time(OutputStream *ost)
 {
-    OutputFile *of = output_files[ost->file_index];
+    OutputFile *of = cur_job->output_files[ost->file_index];
 
     if (of->recording_time != INT64_MAX &&
         av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, of->recording_time,
@@ -895,7 +869,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     if (!check_recording_time(ost))
         return;
 
-    if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
+    if (frame->pts == AV_NOPTS_VALUE || cur_job->audio_sync_method < 0)
         frame->pts = ost->sync_opts;
     ost->sync_opts = frame->pts + frame->nb_samples;
     ost->samples_encoded += frame->nb_samples;
@@ -903,7 +877,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
 
     av_assert0(pkt.size || !pkt.data);
     update_benchmark(NULL);
-    if (debug_ts) {
+    if (cur_job->debug_ts) {
         if (loglevel == 2) 
         	LOGI("encoder <- type:audio "
                "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
@@ -926,7 +900,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
 
         av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
 
-        if (debug_ts) {
+        if (cur_job->debug_ts) {
             if (loglevel == 2) 
             	LOGI("encoder -> type:audio "
                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
@@ -957,16 +931,16 @@ static void do_subtitle_out(OutputFile *of,
     if (sub->pts == AV_NOPTS_VALUE) {
         if (loglevel > 0) 
         	LOGI("Subtitle packets must have a pts\n");
-        if (exit_on_error)
+        if (cur_job->exit_on_error)
             exit_program(2008);
         return;
     }
 
     enc = ost->enc_ctx;
 
-    if (!subtitle_out) {
-        subtitle_out = av_malloc(subtitle_out_max_size);
-        if (!subtitle_out) {
+    if (!cur_job->subtitle_out) {
+        cur_job->subtitle_out = av_malloc(subtitle_out_max_size);
+        if (!cur_job->subtitle_out) {
             if (loglevel > 0) 
             	LOGI("Failed to allocate subtitle_out\n");
             exit_program(2009);
@@ -983,8 +957,8 @@ static void do_subtitle_out(OutputFile *of,
 
     /* shift timestamp to honor -ss and make check_recording_time() work with -t */
     pts = sub->pts;
-    if (output_files[ost->file_index]->start_time != AV_NOPTS_VALUE)
-        pts -= output_files[ost->file_index]->start_time;
+    if (cur_job->output_files[ost->file_index]->start_time != AV_NOPTS_VALUE)
+        pts -= cur_job->output_files[ost->file_index]->start_time;
     for (i = 0; i < nb; i++) {
         unsigned save_num_rects = sub->num_rects;
 
@@ -1002,7 +976,7 @@ static void do_subtitle_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        subtitle_out_size = avcodec_encode_subtitle(enc, subtitle_out,
+        subtitle_out_size = avcodec_encode_subtitle(enc, cur_job->subtitle_out,
                                                     subtitle_out_max_size, sub);
         if (i == 1)
             sub->num_rects = save_num_rects;
@@ -1013,7 +987,7 @@ static void do_subtitle_out(OutputFile *of,
         }
 
         av_init_packet(&pkt);
-        pkt.data = subtitle_out;
+        pkt.data = cur_job->subtitle_out;
         pkt.size = subtitle_out_size;
         pkt.pts  = av_rescale_q(sub->pts, AV_TIME_BASE_Q, ost->st->time_base);
         pkt.duration = av_rescale_q(sub->end_display_time, (AVRational){ 1, 1000 }, ost->st->time_base);
@@ -1047,7 +1021,7 @@ static void do_video_out(OutputFile *of,
     AVFilterContext *filter = ost->filter->filter;
 
     if (ost->source_index >= 0)
-        ist = input_streams[ost->source_index];
+        ist = cur_job->input_streams[ost->source_index];
 
     if (filter->inputs[0]->frame_rate.num > 0 &&
         filter->inputs[0]->frame_rate.den > 0)
@@ -1077,7 +1051,7 @@ static void do_video_out(OutputFile *of,
         nb0_frames = 0; // tracks the number of times the PREVIOUS frame should be duplicated, mostly for variable framerate (VFR)
         nb_frames = 1;
 
-        format_video_sync = video_sync_method;
+        format_video_sync = cur_job->video_sync_method;
         if (format_video_sync == VSYNC_AUTO) {
             if(!strcmp(of->ctx->oformat->name, "avi")) {
                 format_video_sync = VSYNC_VFR;
@@ -1085,11 +1059,11 @@ static void do_video_out(OutputFile *of,
                 format_video_sync = (of->ctx->oformat->flags & AVFMT_VARIABLE_FPS) ? ((of->ctx->oformat->flags & AVFMT_NOTIMESTAMPS) ? VSYNC_PASSTHROUGH : VSYNC_VFR) : VSYNC_CFR;
             if (   ist
                 && format_video_sync == VSYNC_CFR
-                && input_files[ist->file_index]->ctx->nb_streams == 1
-                && input_files[ist->file_index]->input_ts_offset == 0) {
+                && cur_job->input_files[ist->file_index]->ctx->nb_streams == 1
+                && cur_job->input_files[ist->file_index]->input_ts_offset == 0) {
                 format_video_sync = VSYNC_VSCFR;
             }
-            if (format_video_sync == VSYNC_CFR && copy_ts) {
+            if (format_video_sync == VSYNC_CFR && cur_job->copy_ts) {
                 format_video_sync = VSYNC_VSCFR;
             }
         }
@@ -1121,7 +1095,7 @@ static void do_video_out(OutputFile *of,
             }
         case VSYNC_CFR:
             // FIXME set to 0.5 after we fix some dts/pts bugs like in avidec.c
-            if (frame_drop_threshold && delta < frame_drop_threshold && ost->frame_number) {
+            if (cur_job->frame_drop_threshold && delta < cur_job->frame_drop_threshold && ost->frame_number) {
                 nb_frames = 0;
             } else if (delta < -1.1)
                 nb_frames = 0;
@@ -1155,19 +1129,19 @@ static void do_video_out(OutputFile *of,
     ost->last_nb0_frames[0] = nb0_frames;
 
     if (nb0_frames == 0 && ost->last_dropped) {
-        nb_frames_drop++;
+        cur_job->nb_frames_drop++;
         if (loglevel == 2) 
         	LOGI(               "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
     }
     if (nb_frames > (nb0_frames && ost->last_dropped) + (nb_frames > nb0_frames)) {
-        if (nb_frames > dts_error_threshold * 30) {
+        if (nb_frames > cur_job->dts_error_threshold * 30) {
             if (loglevel > 0) 
             	LOGI("%d frame duplication too large, skipping\n", nb_frames - 1);
-            nb_frames_drop++;
+            cur_job->nb_frames_drop++;
             return;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        cur_job->nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
         if (loglevel == 2) 
         	LOGI("*** %d dup!\n", nb_frames - 1);
     }
@@ -1275,7 +1249,7 @@ static void do_video_out(OutputFile *of,
         }
 
         update_benchmark(NULL);
-        if (debug_ts) {
+        if (cur_job->debug_ts) {
             if (loglevel == 2) 
             	LOGI("encoder <- type:video "
                    "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
@@ -1297,7 +1271,7 @@ static void do_video_out(OutputFile *of,
             if (ret < 0)
                 goto error;
 
-            if (debug_ts) {
+            if (cur_job->debug_ts) {
                 if (loglevel == 2) 
                 	LOGI("encoder -> type:video "
                        "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
@@ -1310,7 +1284,7 @@ static void do_video_out(OutputFile *of,
 
             av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
 
-            if (debug_ts) {
+            if (cur_job->debug_ts) {
                 if (loglevel == 2) 
                 	LOGI("encoder -> type:video "
                     "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
@@ -1335,7 +1309,7 @@ static void do_video_out(OutputFile *of,
      */
     ost->frame_number++;
 
-    if (vstats_filename && frame_size)
+    if (cur_job->vstats_filename && frame_size)
         do_video_stats(ost, frame_size);
   }
 
@@ -1366,9 +1340,9 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     double ti1, bitrate, avg_bitrate;
 
     /* this is executed just the first time do_video_stats is called */
-    if (!vstats_file) {
-        vstats_file = fopen(vstats_filename, "w");
-        if (!vstats_file) {
+    if (!cur_job->vstats_file) {
+        cur_job->vstats_file = fopen(cur_job->vstats_filename, "w");
+        if (!cur_job->vstats_file) {
             perror("fopen");
             exit_program(2012);
         }
@@ -1377,13 +1351,13 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     enc = ost->enc_ctx;
     if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
         frame_number = ost->st->nb_frames;
-        fprintf(vstats_file, "frame= %5d q= %2.1f ", frame_number,
+        fprintf(cur_job->vstats_file, "frame= %5d q= %2.1f ", frame_number,
                 ost->quality / (float)FF_QP2LAMBDA);
 
         if (ost->error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
-            fprintf(vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
+            fprintf(cur_job->vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
 
-        fprintf(vstats_file,"f_size= %6d ", frame_size);
+        fprintf(cur_job->vstats_file,"f_size= %6d ", frame_size);
         /* compute pts value */
         ti1 = av_stream_get_end_pts(ost->st) * av_q2d(ost->st->time_base);
         if (ti1 < 0.01)
@@ -1391,22 +1365,22 @@ static void do_video_stats(OutputStream *ost, int frame_size)
 
         bitrate     = (frame_size * 8) / av_q2d(enc->time_base) / 1000.0;
         avg_bitrate = (double)(ost->data_size * 8) / ti1 / 1000.0;
-        fprintf(vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
+        fprintf(cur_job->vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
                (double)ost->data_size / 1024, ti1, bitrate, avg_bitrate);
-        fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
+        fprintf(cur_job->vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
     }
 }
 
 static void finish_output_stream(OutputStream *ost)
 {
-    OutputFile *of = output_files[ost->file_index];
+    OutputFile *of = cur_job->output_files[ost->file_index];
     int i;
 
     ost->finished = ENCODER_FINISHED | MUXER_FINISHED;
 
     if (of->shortest) {
         for (i = 0; i < of->ctx->nb_streams; i++)
-            output_streams[of->ost_index + i]->finished = ENCODER_FINISHED | MUXER_FINISHED;
+            cur_job->output_streams[of->ost_index + i]->finished = ENCODER_FINISHED | MUXER_FINISHED;
     }
 }
 
@@ -1422,9 +1396,9 @@ static int reap_filters(int flush)
     int i;
 
     /* Reap all buffers present in the buffer sinks */
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
-        OutputFile    *of = output_files[ost->file_index];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
+        OutputFile    *of = cur_job->output_files[ost->file_index];
         AVFilterContext *filter;
         AVCodecContext *enc = ost->enc_ctx;
         int ret = 0;
@@ -1481,7 +1455,7 @@ static int reap_filters(int flush)
                 if (!ost->frame_aspect_ratio.num)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
-                if (debug_ts) {
+                if (cur_job->debug_ts) {
                     if (loglevel == 2) 
                     	LOGI("filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
                             av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
@@ -1521,8 +1495,8 @@ static void print_final_stats(int64_t total_size)
     int i, j;
     int pass1_used = 1;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
         switch (ost->enc_ctx->codec_type) {
             case AVMEDIA_TYPE_VIDEO: video_size += ost->data_size; break;
             case AVMEDIA_TYPE_AUDIO: audio_size += ost->data_size; break;
@@ -1556,8 +1530,8 @@ static void print_final_stats(int64_t total_size)
     	LOGI("\n");
 
     /* print verbose per-stream stats */
-    for (i = 0; i < nb_input_files; i++) {
-        InputFile *f = input_files[i];
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        InputFile *f = cur_job->input_files[i];
         uint64_t total_packets = 0, total_size = 0;
 
         if (loglevel == 2) 
@@ -1565,7 +1539,7 @@ static void print_final_stats(int64_t total_size)
                i, f->ctx->filename);
 
         for (j = 0; j < f->nb_streams; j++) {
-            InputStream *ist = input_streams[f->ist_index + j];
+            InputStream *ist = cur_job->input_streams[f->ist_index + j];
             enum AVMediaType type = ist->dec_ctx->codec_type;
 
             total_size    += ist->data_size;
@@ -1598,8 +1572,8 @@ static void print_final_stats(int64_t total_size)
                total_packets, total_size);
     }
 
-    for (i = 0; i < nb_output_files; i++) {
-        OutputFile *of = output_files[i];
+    for (i = 0; i < cur_job->nb_output_files; i++) {
+        OutputFile *of = cur_job->output_files[i];
         uint64_t total_packets = 0, total_size = 0;
 
         if (loglevel == 2) 
@@ -1607,7 +1581,7 @@ static void print_final_stats(int64_t total_size)
                i, of->ctx->filename);
 
         for (j = 0; j < of->ctx->nb_streams; j++) {
-            OutputStream *ost = output_streams[of->ost_index + j];
+            OutputStream *ost = cur_job->output_streams[of->ost_index + j];
             enum AVMediaType type = ost->enc_ctx->codec_type;
 
             total_size    += ost->data_size;
@@ -1664,29 +1638,39 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     double bitrate;
     double speed;
     int64_t pts = INT64_MIN + 1;
-    static int64_t last_time = -1;
-    static int qp_histogram[52];
     int hours, mins, secs, us;
     int ret;
     float t;
+    int do_report = is_last_report, do_progress = is_last_report;
+    FFJobProgress progress = { 0 };
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!cur_job->print_stats && !is_last_report && !cur_job->progress_avio &&
+        !cur_job->progress_cb)
         return;
 
     if (!is_last_report) {
-        if (last_time == -1) {
-            last_time = cur_time;
+        if (cur_job->report_last_time == -1) {
+            cur_job->report_last_time   = cur_time;
+            cur_job->progress_last_time = cur_time;
             return;
         }
-        if ((cur_time - last_time) < 500000)
+        if ((cur_time - cur_job->report_last_time) >= 500000) {
+            cur_job->report_last_time = cur_time;
+            do_report = cur_job->print_stats || cur_job->progress_avio;
+        }
+        if (cur_job->progress_cb &&
+            (cur_time - cur_job->progress_last_time) >= cur_job->progress_interval) {
+            cur_job->progress_last_time = cur_time;
+            do_progress = 1;
+        }
+        if (!do_report && !do_progress)
             return;
-        last_time = cur_time;
     }
 
     t = (cur_time-timer_start) / 1000000.0;
 
 
-    oc = output_files[0]->ctx;
+    oc = cur_job->output_files[0]->ctx;
 
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
@@ -1695,9 +1679,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     buf[0] = '\0';
     vid = 0;
     av_bprint_init(&buf_script, 0, 1);
-    for (i = 0; i < nb_output_streams; i++) {
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
         float q = -1;
-        ost = output_streams[i];
+        ost = cur_job->output_streams[i];
         enc = ost->enc_ctx;
         if (!ost->stream_copy)
             q = ost->quality / (float) FF_QP2LAMBDA;
@@ -1712,6 +1696,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
             frame_number = ost->frame_number;
             fps = t > 1 ? frame_number / t : 0;
+            progress.frame = frame_number;
+            progress.fps   = fps;
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "frame=%5d fps=%3.*f q=%3.1f ",
                      frame_number, fps < 9.95, fps, q);
             av_bprintf(&buf_script, "frame=%d\n", frame_number);
@@ -1720,13 +1706,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                        ost->file_index, ost->index, q);
             if (is_last_report)
                 snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "L");
-            if (qp_hist) {
+            if (cur_job->qp_hist && do_report) {
                 int j;
                 int qp = lrintf(q);
-                if (qp >= 0 && qp < FF_ARRAY_ELEMS(qp_histogram))
-                    qp_histogram[qp]++;
+                if (qp >= 0 && qp < FF_ARRAY_ELEMS(cur_job->qp_histogram))
+                    cur_job->qp_histogram[qp]++;
                 for (j = 0; j < 32; j++)
-                    snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%X", av_log2(qp_histogram[j] + 1));
+                    snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%X", av_log2(cur_job->qp_histogram[j] + 1));
             }
 
             if ((enc->flags & AV_CODEC_FLAG_PSNR) && (ost->pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
@@ -1765,7 +1751,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
                                           ost->st->time_base, AV_TIME_BASE_Q));
         if (is_last_report)
-            nb_frames_drop += ost->last_dropped;
+            cur_job->nb_frames_drop += ost->last_dropped;
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1802,11 +1788,11 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprintf(&buf_script, "out_time=%02d:%02d:%02d.%06d\n",
                hours, mins, secs, us);
 
-    if (nb_frames_dup || nb_frames_drop)
+    if (cur_job->nb_frames_dup || cur_job->nb_frames_drop)
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " dup=%d drop=%d",
-                nb_frames_dup, nb_frames_drop);
-    av_bprintf(&buf_script, "dup_frames=%d\n", nb_frames_dup);
-    av_bprintf(&buf_script, "drop_frames=%d\n", nb_frames_drop);
+                cur_job->nb_frames_dup, cur_job->nb_frames_drop);
+    av_bprintf(&buf_script, "dup_frames=%d\n", cur_job->nb_frames_dup);
+    av_bprintf(&buf_script, "drop_frames=%d\n", cur_job->nb_frames_drop);
 
     if (speed < 0) {
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf)," speed=N/A");
@@ -1816,9 +1802,23 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf_script, "speed=%4.3gx\n", speed);
     }
 
-    if (print_stats || is_last_report) {
+    if (do_progress && cur_job->progress_cb) {
+        progress.total_size  = total_size;
+        progress.bitrate     = bitrate;
+        progress.out_time    = pts;
+        progress.speed       = speed;
+        progress.dup_frames  = cur_job->nb_frames_dup;
+        progress.drop_frames = cur_job->nb_frames_drop;
+        progress.is_last     = is_last_report;
+        cur_job->progress_cb(cur_job->progress_opaque, &progress);
+    }
+
+    if (!do_report)
+        return;
+
+    if (cur_job->print_stats || is_last_report) {
         const char end = is_last_report ? '\n' : '\r';
-        if (print_stats==1 && AV_LOG_INFO > av_log_get_level()) {
+        if (cur_job->print_stats==1 && AV_LOG_INFO > cur_job->log_level) {
             fprintf(stderr, "%s    %c", buf, end);
         } else
             if (loglevel == 2) 
@@ -1827,15 +1827,15 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     fflush(stderr);
     }
 
-    if (progress_avio) {
+    if (cur_job->progress_avio) {
         av_bprintf(&buf_script, "progress=%s\n",
                    is_last_report ? "end" : "continue");
-        avio_write(progress_avio, buf_script.str,
+        avio_write(cur_job->progress_avio, buf_script.str,
                    FFMIN(buf_script.len, buf_script.size - 1));
-        avio_flush(progress_avio);
+        avio_flush(cur_job->progress_avio);
         av_bprint_finalize(&buf_script, NULL);
         if (is_last_report) {
-            if ((ret = avio_closep(&progress_avio)) < 0)
+            if ((ret = avio_closep(&cur_job->progress_avio)) < 0)
                 if (loglevel > 0) 
                 	LOGI(                       "Error closing progress log, loss of information possible: %s\n", av_err2str(ret));
         }
@@ -1849,10 +1849,10 @@ static void flush_encoders(void)
 {
     int i, ret;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream   *ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream   *ost = cur_job->output_streams[i];
         AVCodecContext *enc = ost->enc_ctx;
-        OutputFile      *of = output_files[ost->file_index];
+        OutputFile      *of = cur_job->output_files[ost->file_index];
         int stop_encoding = 0;
 
         if (!ost->encoding_needed)
@@ -1915,7 +1915,7 @@ static void flush_encoders(void)
                 av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
                 pkt_size = pkt.size;
                 output_packet(of, &pkt, ost);
-                if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
+                if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && cur_job->vstats_filename) {
                     do_video_stats(ost, pkt_size);
                 }
             }
@@ -1931,8 +1931,8 @@ static void flush_encoders(void)
  */
 static int check_output_constraints(InputStream *ist, OutputStream *ost)
 {
-    OutputFile *of = output_files[ost->file_index];
-    int ist_index  = input_files[ist->file_index]->ist_index + ist->st->index;
+    OutputFile *of = cur_job->output_files[ost->file_index];
+    int ist_index  = cur_job->input_files[ist->file_index]->ist_index + ist->st->index;
 
     if (ost->source_index != ist_index)
         return 0;
@@ -1948,8 +1948,8 @@ static int check_output_constraints(InputStream *ist, OutputStream *ost)
 
 static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *pkt)
 {
-    OutputFile *of = output_files[ost->file_index];
-    InputFile   *f = input_files [ist->file_index];
+    OutputFile *of = cur_job->output_files[ost->file_index];
+    InputFile   *f = cur_job->input_files [ist->file_index];
     int64_t start_time = (of->start_time == AV_NOPTS_VALUE) ? 0 : of->start_time;
     int64_t ost_tb_start_time = av_rescale_q(start_time, AV_TIME_BASE_Q, ost->st->time_base);
     AVPicture pict;
@@ -1963,7 +1963,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
 
     if (!ost->frame_number && !ost->copy_prior_start) {
         int64_t comp_start = start_time;
-        if (copy_ts && f->start_time != AV_NOPTS_VALUE)
+        if (cur_job->copy_ts && f->start_time != AV_NOPTS_VALUE)
             comp_start = FFMAX(start_time, f->start_time + f->ts_offset);
         if (pkt->pts == AV_NOPTS_VALUE ?
             ist->pts < comp_start :
@@ -1979,7 +1979,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
 
     if (f->recording_time != INT64_MAX) {
         start_time = f->ctx->start_time;
-        if (f->start_time != AV_NOPTS_VALUE && copy_ts)
+        if (f->start_time != AV_NOPTS_VALUE && cur_job->copy_ts)
             start_time += f->start_time;
         if (ist->pts >= f->recording_time + start_time) {
             close_output_stream(ost);
@@ -2085,15 +2085,15 @@ int guess_input_channel_layout(InputStream *ist)
 static void check_decode_result(InputStream *ist, int *got_output, int ret)
 {
     if (*got_output || ret<0)
-        decode_error_stat[ret<0] ++;
+        cur_job->decode_error_stat[ret<0] ++;
 
-    if (ret < 0 && exit_on_error)
+    if (ret < 0 && cur_job->exit_on_error)
         exit_program(2017);
 
-    if (exit_on_error && *got_output && ist) {
+    if (cur_job->exit_on_error && *got_output && ist) {
         if (av_frame_get_decode_error_flags(ist->decoded_frame) || (ist->decoded_frame->flags & AV_FRAME_FLAG_CORRUPT)) {
             if (loglevel > 0) 
-            	LOGI("%s: corrupt decoded frame in stream %d\n", input_files[ist->file_index]->ctx->filename, ist->st->index);
+            	LOGI("%s: corrupt decoded frame in stream %d\n", cur_job->input_files[ist->file_index]->ctx->filename, ist->st->index);
             exit_program(2018);
         }
     }
@@ -2201,9 +2201,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
         ist->resample_channel_layout = decoded_frame->channel_layout;
         ist->resample_channels       = avctx->channels;
 
-        for (i = 0; i < nb_filtergraphs; i++)
-            if (ist_in_filtergraph(filtergraphs[i], ist)) {
-                FilterGraph *fg = filtergraphs[i];
+        for (i = 0; i < cur_job->nb_filtergraphs; i++)
+            if (ist_in_filtergraph(cur_job->filtergraphs[i], ist)) {
+                FilterGraph *fg = cur_job->filtergraphs[i];
                 if (configure_filtergraph(fg) < 0) {
                     if (loglevel > 0) 
                     	LOGI("Error reinitializing filters!\n");
@@ -2354,7 +2354,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eo
             ist->next_pts = ist->pts = ts;
     }
 
-    if (debug_ts) {
+    if (cur_job->debug_ts) {
         if (loglevel == 2) 
         	LOGI("decoder -> ist_index:%d type:video "
                "frame_pts:%s frame_pts_time:%s best_effort_ts:%"PRId64" best_effort_ts_time:%s keyframe:%d frame_type:%d time_base:%d/%d\n",
@@ -2383,9 +2383,9 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eo
         ist->resample_height  = decoded_frame->height;
         ist->resample_pix_fmt = decoded_frame->format;
 
-        for (i = 0; i < nb_filtergraphs; i++) {
-            if (ist_in_filtergraph(filtergraphs[i], ist) && ist->reinit_filters &&
-                configure_filtergraph(filtergraphs[i]) < 0) {
+        for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+            if (ist_in_filtergraph(cur_job->filtergraphs[i], ist) && ist->reinit_filters &&
+                configure_filtergraph(cur_job->filtergraphs[i]) < 0) {
                 if (loglevel > 0) 
                 	LOGI("Error reinitializing filters!\n");
                 exit_program(2021);
@@ -2465,14 +2465,14 @@ static int transcode_subtitles(InputStream *ist, AVPacket *pkt, int *got_output)
 
     ist->frames_decoded++;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
 
         if (!check_output_constraints(ist, ost) || !ost->encoding_needed
             || ost->enc->type != AVMEDIA_TYPE_SUBTITLE)
             continue;
 
-        do_subtitle_out(output_files[ost->file_index], ost, &subtitle);
+        do_subtitle_out(cur_job->output_files[ost->file_index], ost, &subtitle);
     }
 
 out:
@@ -2582,7 +2582,7 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             if (loglevel > 0) 
             	LOGI("Error while decoding stream #%d:%d: %s\n",
                    ist->file_index, ist->st->index, av_err2str(ret));
-            if (exit_on_error)
+            if (cur_job->exit_on_error)
                 exit_program(2023);
             // Decoding might not terminate if we're draining the decoder, and
             // the decoder keeps returning an error.
@@ -2648,8 +2648,8 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         ist->pts = ist->dts;
         ist->next_pts = ist->next_dts;
     }
-    for (i = 0; pkt && i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = 0; pkt && i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
 
         if (!check_output_constraints(ist, ost) || ost->encoding_needed)
             continue;
@@ -2668,17 +2668,17 @@ static void print_sdp(void)
     AVIOContext *sdp_pb;
     AVFormatContext **avc;
 
-    for (i = 0; i < nb_output_files; i++) {
-        if (!output_files[i]->header_written)
+    for (i = 0; i < cur_job->nb_output_files; i++) {
+        if (!cur_job->output_files[i]->header_written)
             return;
     }
 
-    avc = av_malloc_array(nb_output_files, sizeof(*avc));
+    avc = av_malloc_array(cur_job->nb_output_files, sizeof(*avc));
     if (!avc)
         exit_program(2025);
-    for (i = 0, j = 0; i < nb_output_files; i++) {
-        if (!strcmp(output_files[i]->ctx->oformat->name, "rtp")) {
-            avc[j] = output_files[i]->ctx;
+    for (i = 0, j = 0; i < cur_job->nb_output_files; i++) {
+        if (!strcmp(cur_job->output_files[i]->ctx->oformat->name, "rtp")) {
+            avc[j] = cur_job->output_files[i]->ctx;
             j++;
         }
     }
@@ -2688,17 +2688,17 @@ static void print_sdp(void)
 
     av_sdp_create(avc, j, sdp, sizeof(sdp));
 
-    if (!sdp_filename) {
+    if (!cur_job->sdp_filename) {
         printf("SDP:\n%s\n", sdp);
         fflush(stdout);
     } else {
-        if (avio_open2(&sdp_pb, sdp_filename, AVIO_FLAG_WRITE, &int_cb, NULL) < 0) {
+        if (avio_open2(&sdp_pb, cur_job->sdp_filename, AVIO_FLAG_WRITE, &cur_job->int_cb, NULL) < 0) {
             if (loglevel > 0) 
-            	LOGI("Failed to open sdp file '%s'\n", sdp_filename);
+            	LOGI("Failed to open sdp file '%s'\n", cur_job->sdp_filename);
         } else {
             avio_printf(sdp_pb, "SDP:\n%s", sdp);
             avio_closep(&sdp_pb);
-            av_freep(&sdp_filename);
+            av_freep(&cur_job->sdp_filename);
         }
     }
 
@@ -2773,7 +2773,7 @@ static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
 static int init_input_stream(int ist_index, char *error, int error_len)
 {
     int ret;
-    InputStream *ist = input_streams[ist_index];
+    InputStream *ist = cur_job->input_streams[ist_index];
 
     if (ist->decoding_needed) {
         AVCodec *codec = ist->dec;
@@ -2827,7 +2827,7 @@ static int init_input_stream(int ist_index, char *error, int error_len)
 static InputStream *get_input_stream(OutputStream *ost)
 {
     if (ost->source_index >= 0)
-        return input_streams[ost->source_index];
+        return cur_job->input_streams[ost->source_index];
     return NULL;
 }
 
@@ -2842,12 +2842,12 @@ static int check_init_output_file(OutputFile *of, int file_index)
     int ret, i;
 
     for (i = 0; i < of->ctx->nb_streams; i++) {
-        OutputStream *ost = output_streams[of->ost_index + i];
+        OutputStream *ost = cur_job->output_streams[of->ost_index + i];
         if (!ost->initialized)
             return 0;
     }
 
-    of->ctx->interrupt_callback = int_cb;
+    of->ctx->interrupt_callback = cur_job->int_cb;
 
     ret = avformat_write_header(of->ctx, &of->opts);
     if (ret < 0) {
@@ -2862,12 +2862,12 @@ static int check_init_output_file(OutputFile *of, int file_index)
 
     av_dump_format(of->ctx, file_index, of->ctx->filename, 1);
 
-    if (sdp_filename || want_sdp)
+    if (cur_job->sdp_filename || cur_job->want_sdp)
         print_sdp();
 
     /* flush the muxing queues */
     for (i = 0; i < of->ctx->nb_streams; i++) {
-        OutputStream *ost = output_streams[of->ost_index + i];
+        OutputStream *ost = cur_job->output_streams[of->ost_index + i];
 
         while (av_fifo_size(ost->muxing_queue)) {
             AVPacket pkt;
@@ -2918,7 +2918,7 @@ static int init_output_bsfs(OutputStream *ost)
 
 static int init_output_stream_streamcopy(OutputStream *ost)
 {
-    OutputFile *of = output_files[ost->file_index];
+    OutputFile *of = cur_job->output_files[ost->file_index];
     InputStream *ist = get_input_stream(ost);
     AVCodecParameters *par_dst = ost->st->codecpar;
     AVCodecParameters *par_src = ost->ref_par;
@@ -2974,7 +2974,7 @@ static int init_output_stream_streamcopy(OutputStream *ost)
         ost->frame_rate = ist->framerate;
     ost->st->avg_frame_rate = ost->frame_rate;
 
-    ret = avformat_transfer_internal_stream_timing_info(of->ctx->oformat, ost->st, ist->st, copy_tb);
+    ret = avformat_transfer_internal_stream_timing_info(of->ctx->oformat, ost->st, ist->st, cur_job->copy_tb);
     if (ret < 0)
         return ret;
 
@@ -3012,7 +3012,7 @@ static int init_output_stream_streamcopy(OutputStream *ost)
 
     switch (par_dst->codec_type) {
     case AVMEDIA_TYPE_AUDIO:
-        if (audio_volume != 256) {
+        if (cur_job->audio_volume != 256) {
             if (loglevel > 0) 
             	LOGI("-acodec copy and -vol are incompatible (frames are not decoded)\n");
             exit_program(2026);
@@ -3184,7 +3184,7 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
 
     ost->initialized = 1;
 
-    ret = check_init_output_file(output_files[ost->file_index], ost->file_index);
+    ret = check_init_output_file(cur_job->output_files[ost->file_index], ost->file_index);
     if (ret < 0)
         return ret;
 
@@ -3218,7 +3218,7 @@ static void parse_forced_key_frames(char *kf, OutputStream *ost,
 
         if (!memcmp(p, "chapters", 8)) {
 
-            AVFormatContext *avf = output_files[ost->file_index]->ctx;
+            AVFormatContext *avf = cur_job->output_files[ost->file_index]->ctx;
             int j;
 
             if (avf->nb_chapters > INT_MAX - size ||
@@ -3257,7 +3257,7 @@ static void parse_forced_key_frames(char *kf, OutputStream *ost,
 
 static void report_new_stream(int input_index, AVPacket *pkt)
 {
-    InputFile *file = input_files[input_index];
+    InputFile *file = cur_job->input_files[input_index];
     AVStream *st = file->ctx->streams[pkt->stream_index];
 
     if (pkt->stream_index < file->nb_streams_warn)
@@ -3319,33 +3319,33 @@ static int transcode_init(void)
     InputStream *ist;
     char error[1024] = {0};
 
-    for (i = 0; i < nb_filtergraphs; i++) {
-        FilterGraph *fg = filtergraphs[i];
+    for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+        FilterGraph *fg = cur_job->filtergraphs[i];
         for (j = 0; j < fg->nb_outputs; j++) {
             OutputFilter *ofilter = fg->outputs[j];
             if (!ofilter->ost || ofilter->ost->source_index >= 0)
                 continue;
             if (fg->nb_inputs != 1)
                 continue;
-            for (k = nb_input_streams-1; k >= 0 ; k--)
-                if (fg->inputs[0]->ist == input_streams[k])
+            for (k = cur_job->nb_input_streams-1; k >= 0 ; k--)
+                if (fg->inputs[0]->ist == cur_job->input_streams[k])
                     break;
             ofilter->ost->source_index = k;
         }
     }
 
     /* init framerate emulation */
-    for (i = 0; i < nb_input_files; i++) {
-        InputFile *ifile = input_files[i];
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        InputFile *ifile = cur_job->input_files[i];
         if (ifile->rate_emu)
             for (j = 0; j < ifile->nb_streams; j++)
-                input_streams[j + ifile->ist_index]->start = av_gettime_relative();
+                cur_job->input_streams[j + ifile->ist_index]->start = av_gettime_relative();
     }
 
     /* for each output stream, we compute the right encoding parameters */
-    for (i = 0; i < nb_output_streams; i++) {
-        ost = output_streams[i];
-        oc  = output_files[ost->file_index]->ctx;
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        ost = cur_job->output_streams[i];
+        oc  = cur_job->output_files[ost->file_index]->ctx;
         ist = get_input_stream(ost);
 
         if (ost->attachment_filename)
@@ -3369,7 +3369,7 @@ static int transcode_init(void)
             AVCodecContext *enc_ctx = ost->enc_ctx;
             AVCodecContext *dec_ctx = NULL;
 
-            set_encoder_id(output_files[ost->file_index], ost);
+            set_encoder_id(cur_job->output_files[ost->file_index], ost);
 
             if (ist) {
                 dec_ctx = ist->dec_ctx;
@@ -3441,8 +3441,8 @@ static int transcode_init(void)
                 enc_ctx->time_base = av_inv_q(ost->frame_rate);
                 if (!(enc_ctx->time_base.num && enc_ctx->time_base.den))
                     enc_ctx->time_base = ost->filter->filter->inputs[0]->time_base;
-                if (   av_q2d(enc_ctx->time_base) < 0.001 && video_sync_method != VSYNC_PASSTHROUGH
-                   && (video_sync_method == VSYNC_CFR || video_sync_method == VSYNC_VSCFR || (video_sync_method == VSYNC_AUTO && !(oc->oformat->flags & AVFMT_VARIABLE_FPS)))){
+                if (   av_q2d(enc_ctx->time_base) < 0.001 && cur_job->video_sync_method != VSYNC_PASSTHROUGH
+                   && (cur_job->video_sync_method == VSYNC_CFR || cur_job->video_sync_method == VSYNC_VSCFR || (cur_job->video_sync_method == VSYNC_AUTO && !(oc->oformat->flags & AVFMT_VARIABLE_FPS)))){
                     if (loglevel == 2) 
                     	LOGI("Frame rate very high for a muxer not efficiently supporting it.\n"
                                                "Please consider specifying a lower framerate, a different muxer or -vsync 2\n");
@@ -3483,7 +3483,7 @@ static int transcode_init(void)
                     enc_ctx->width   != dec_ctx->width  ||
                     enc_ctx->height  != dec_ctx->height ||
                     enc_ctx->pix_fmt != dec_ctx->pix_fmt) {
-                    enc_ctx->bits_per_raw_sample = frame_bits_per_raw_sample;
+                    enc_ctx->bits_per_raw_sample = cur_job->frame_bits_per_raw_sample;
                 }
 
                 if (ost->forced_keyframes) {
@@ -3510,8 +3510,8 @@ static int transcode_init(void)
             case AVMEDIA_TYPE_SUBTITLE:
                 enc_ctx->time_base = (AVRational){1, 1000};
                 if (!enc_ctx->width) {
-                    enc_ctx->width     = input_streams[ost->source_index]->st->codecpar->width;
-                    enc_ctx->height    = input_streams[ost->source_index]->st->codecpar->height;
+                    enc_ctx->width     = cur_job->input_streams[ost->source_index]->st->codecpar->width;
+                    enc_ctx->height    = cur_job->input_streams[ost->source_index]->st->codecpar->height;
                 }
                 break;
             case AVMEDIA_TYPE_DATA:
@@ -3555,31 +3555,31 @@ static int transcode_init(void)
     }
 
     /* init input streams */
-    for (i = 0; i < nb_input_streams; i++)
+    for (i = 0; i < cur_job->nb_input_streams; i++)
         if ((ret = init_input_stream(i, error, sizeof(error))) < 0) {
-            for (i = 0; i < nb_output_streams; i++) {
-                ost = output_streams[i];
+            for (i = 0; i < cur_job->nb_output_streams; i++) {
+                ost = cur_job->output_streams[i];
                 avcodec_close(ost->enc_ctx);
             }
             goto dump_format;
         }
 
     /* open each encoder */
-    for (i = 0; i < nb_output_streams; i++) {
-        ret = init_output_stream(output_streams[i], error, sizeof(error));
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        ret = init_output_stream(cur_job->output_streams[i], error, sizeof(error));
         if (ret < 0)
             goto dump_format;
     }
 
     /* discard unused programs */
-    for (i = 0; i < nb_input_files; i++) {
-        InputFile *ifile = input_files[i];
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        InputFile *ifile = cur_job->input_files[i];
         for (j = 0; j < ifile->ctx->nb_programs; j++) {
             AVProgram *p = ifile->ctx->programs[j];
             int discard  = AVDISCARD_ALL;
 
             for (k = 0; k < p->nb_stream_indexes; k++)
-                if (!input_streams[ifile->ist_index + p->stream_index[k]]->discard) {
+                if (!cur_job->input_streams[ifile->ist_index + p->stream_index[k]]->discard) {
                     discard = AVDISCARD_DEFAULT;
                     break;
                 }
@@ -3588,10 +3588,10 @@ static int transcode_init(void)
     }
 
     /* write headers for files with no streams */
-    for (i = 0; i < nb_output_files; i++) {
-        oc = output_files[i]->ctx;
+    for (i = 0; i < cur_job->nb_output_files; i++) {
+        oc = cur_job->output_files[i]->ctx;
         if (oc->oformat->flags & AVFMT_NOSTREAMS && oc->nb_streams == 0) {
-            ret = check_init_output_file(output_files[i], i);
+            ret = check_init_output_file(cur_job->output_files[i], i);
             if (ret < 0)
                 goto dump_format;
         }
@@ -3601,8 +3601,8 @@ static int transcode_init(void)
     /* dump the stream mapping */
     if (loglevel == 2) 
     	LOGI("Stream mapping:\n");
-    for (i = 0; i < nb_input_streams; i++) {
-        ist = input_streams[i];
+    for (i = 0; i < cur_job->nb_input_streams; i++) {
+        ist = cur_job->input_streams[i];
 
         for (j = 0; j < ist->nb_filters; j++) {
             if (!filtergraph_is_simple(ist->filters[j]->graph)) {
@@ -3610,7 +3610,7 @@ static int transcode_init(void)
                 	LOGI("  Stream #%d:%d (%s) -> %s",
                        ist->file_index, ist->st->index, ist->dec ? ist->dec->name : "?",
                        ist->filters[j]->name);
-                if (nb_filtergraphs > 1)
+                if (cur_job->nb_filtergraphs > 1)
                     if (loglevel == 2) 
                     	LOGI(" (graph %d)", ist->filters[j]->graph->index);
                 if (loglevel == 2) 
@@ -3619,8 +3619,8 @@ static int transcode_init(void)
         }
     }
 
-    for (i = 0; i < nb_output_streams; i++) {
-        ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        ost = cur_job->output_streams[i];
 
         if (ost->attachment_filename) {
             /* an attached file */
@@ -3634,7 +3634,7 @@ static int transcode_init(void)
             /* output from a complex graph */
             if (loglevel == 2) 
             	LOGI("  %s", ost->filter->name);
-            if (nb_filtergraphs > 1)
+            if (cur_job->nb_filtergraphs > 1)
                 if (loglevel == 2) 
                 	LOGI(" (graph %d)", ost->filter->graph->index);
 
@@ -3646,11 +3646,11 @@ static int transcode_init(void)
 
         if (loglevel == 2) 
         	LOGI("  Stream #%d:%d -> #%d:%d",
-               input_streams[ost->source_index]->file_index,
-               input_streams[ost->source_index]->st->index,
+               cur_job->input_streams[ost->source_index]->file_index,
+               cur_job->input_streams[ost->source_index]->st->index,
                ost->file_index,
                ost->index);
-        if (ost->sync_ist != input_streams[ost->source_index])
+        if (ost->sync_ist != cur_job->input_streams[ost->source_index])
             if (loglevel == 2) 
             	LOGI(" [sync #%d:%d]",
                    ost->sync_ist->file_index,
@@ -3659,7 +3659,7 @@ static int transcode_init(void)
             if (loglevel == 2) 
             	LOGI(" (copy)");
         else {
-            const AVCodec *in_codec    = input_streams[ost->source_index]->dec;
+            const AVCodec *in_codec    = cur_job->input_streams[ost->source_index]->dec;
             const AVCodec *out_codec   = ost->enc;
             const char *decoder_name   = "?";
             const char *in_codec_name  = "?";
@@ -3700,7 +3700,7 @@ static int transcode_init(void)
         return ret;
     }
 
-    transcode_init_done = 1;
+    cur_job->transcode_init_done = 1;
 
     return 0;
 }
@@ -3710,10 +3710,10 @@ static int need_output(void)
 {
     int i;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost    = output_streams[i];
-        OutputFile *of       = output_files[ost->file_index];
-        AVFormatContext *os  = output_files[ost->file_index]->ctx;
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost    = cur_job->output_streams[i];
+        OutputFile *of       = cur_job->output_files[ost->file_index];
+        AVFormatContext *os  = cur_job->output_files[ost->file_index]->ctx;
 
         if (ost->finished ||
             (os->pb && avio_tell(os->pb) >= of->limit_filesize))
@@ -3721,7 +3721,7 @@ static int need_output(void)
         if (ost->frame_number >= ost->max_frames) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
-                close_output_stream(output_streams[of->ost_index + j]);
+                close_output_stream(cur_job->output_streams[of->ost_index + j]);
             continue;
         }
 
@@ -3742,8 +3742,8 @@ static OutputStream *choose_output(void)
     int64_t opts_min = INT64_MAX;
     OutputStream *ost_min = NULL;
 
-    for (i = 0; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
         int64_t opts = ost->st->cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
                        av_rescale_q(ost->st->cur_dts, ost->st->time_base,
                                     AV_TIME_BASE_Q);
@@ -3774,28 +3774,27 @@ static void set_tty_echo(int on)
 static int check_keyboard_interaction(int64_t cur_time)
 {
     int i, ret, key;
-    static int64_t last_time;
     if (received_nb_signals)
         return AVERROR_EXIT;
     /* read_key() returns 0 on EOF */
-    if(cur_time - last_time >= 100000 && !run_as_daemon){
+    if(cur_time - cur_job->keyboard_last_time >= 100000 && !cur_job->run_as_daemon){
         key =  read_key();
-        last_time = cur_time;
+        cur_job->keyboard_last_time = cur_time;
     }else
         key = -1;
     if (key == 'q')
         return AVERROR_EXIT;
-    if (key == '+') av_log_set_level(av_log_get_level()+10);
-    if (key == '-') av_log_set_level(av_log_get_level()-10);
-    if (key == 's') qp_hist     ^= 1;
+    if (key == '+') cur_job->log_level += 10;
+    if (key == '-') cur_job->log_level -= 10;
+    if (key == 's') cur_job->qp_hist     ^= 1;
     if (key == 'h'){
-        if (do_hex_dump){
-            do_hex_dump = do_pkt_dump = 0;
-        } else if(do_pkt_dump){
-            do_hex_dump = 1;
+        if (cur_job->do_hex_dump){
+            cur_job->do_hex_dump = cur_job->do_pkt_dump = 0;
+        } else if(cur_job->do_pkt_dump){
+            cur_job->do_hex_dump = 1;
         } else
-            do_pkt_dump = 1;
-        av_log_set_level(AV_LOG_DEBUG);
+            cur_job->do_pkt_dump = 1;
+        cur_job->log_level = AV_LOG_DEBUG;
     }
     if (key == 'c' || key == 'C'){
         char buf[4096], target[64], command[256], arg[256] = {0};
@@ -3815,8 +3814,8 @@ static int check_keyboard_interaction(int64_t cur_time)
             if (loglevel == 2) 
             	LOGI("Processing command target:%s time:%f command:%s arg:%s",
                    target, time, command, arg);
-            for (i = 0; i < nb_filtergraphs; i++) {
-                FilterGraph *fg = filtergraphs[i];
+            for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+                FilterGraph *fg = cur_job->filtergraphs[i];
                 if (fg->graph) {
                     if (time < 0) {
                         ret = avfilter_graph_send_command(fg->graph, target, command, arg, buf, sizeof(buf),
@@ -3841,7 +3840,7 @@ static int check_keyboard_interaction(int64_t cur_time)
     if (key == 'd' || key == 'D'){
         int debug=0;
         if(key == 'D') {
-            debug = input_streams[0]->st->codec->debug<<1;
+            debug = cur_job->input_streams[0]->st->codec->debug<<1;
             if(!debug) debug = 1;
             while(debug & (FF_DEBUG_DCT_COEFF|FF_DEBUG_VIS_QP|FF_DEBUG_VIS_MB_TYPE)) //unsupported, would just crash
                 debug += debug;
@@ -3859,14 +3858,14 @@ static int check_keyboard_interaction(int64_t cur_time)
             if (k <= 0 || sscanf(buf, "%d", &debug)!=1)
                 fprintf(stderr,"error parsing debug value\n");
         }
-        for(i=0;i<nb_input_streams;i++) {
-            input_streams[i]->st->codec->debug = debug;
+        for(i=0;i<cur_job->nb_input_streams;i++) {
+            cur_job->input_streams[i]->st->codec->debug = debug;
         }
-        for(i=0;i<nb_output_streams;i++) {
-            OutputStream *ost = output_streams[i];
+        for(i=0;i<cur_job->nb_output_streams;i++) {
+            OutputStream *ost = cur_job->output_streams[i];
             ost->enc_ctx->debug = debug;
         }
-        if(debug) av_log_set_level(AV_LOG_DEBUG);
+        if(debug) cur_job->log_level = AV_LOG_DEBUG;
         fprintf(stderr,"debug=%d\n", debug);
     }
     if (key == '?'){
@@ -3931,8 +3930,8 @@ static void free_input_threads(void)
 {
     int i;
 
-    for (i = 0; i < nb_input_files; i++) {
-        InputFile *f = input_files[i];
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        InputFile *f = cur_job->input_files[i];
         AVPacket pkt;
 
         if (!f || !f->in_thread_queue)
@@ -3951,11 +3950,11 @@ static int init_input_threads(void)
 {
     int i, ret;
 
-    if (nb_input_files == 1)
+    if (cur_job->nb_input_files == 1)
         return 0;
 
-    for (i = 0; i < nb_input_files; i++) {
-        InputFile *f = input_files[i];
+    for (i = 0; i < cur_job->nb_input_files; i++) {
+        InputFile *f = cur_job->input_files[i];
 
         if (f->ctx->pb ? !f->ctx->pb->seekable :
             strcmp(f->ctx->iformat->name, "lavfi"))
@@ -3988,7 +3987,7 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
-            InputStream *ist = input_streams[f->ist_index + i];
+            InputStream *ist = cur_job->input_streams[f->ist_index + i];
             int64_t pts = av_rescale(ist->dts, 1000000, AV_TIME_BASE);
             int64_t now = av_gettime_relative() - ist->start;
             if (pts > now)
@@ -3997,7 +3996,7 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     }
 
 #if HAVE_PTHREADS
-    if (nb_input_files > 1)
+    if (cur_job->nb_input_files > 1)
         return get_input_packet_mt(f, pkt);
 #endif
     return av_read_frame(f->ctx, pkt);
@@ -4006,8 +4005,8 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
 static int got_eagain(void)
 {
     int i;
-    for (i = 0; i < nb_output_streams; i++)
-        if (output_streams[i]->unavailable)
+    for (i = 0; i < cur_job->nb_output_streams; i++)
+        if (cur_job->output_streams[i]->unavailable)
             return 1;
     return 0;
 }
@@ -4015,10 +4014,10 @@ static int got_eagain(void)
 static void reset_eagain(void)
 {
     int i;
-    for (i = 0; i < nb_input_files; i++)
-        input_files[i]->eagain = 0;
-    for (i = 0; i < nb_output_streams; i++)
-        output_streams[i]->unavailable = 0;
+    for (i = 0; i < cur_job->nb_input_files; i++)
+        cur_job->input_files[i]->eagain = 0;
+    for (i = 0; i < cur_job->nb_output_streams; i++)
+        cur_job->output_streams[i]->unavailable = 0;
 }
 
 // set duration to max(tmp, duration) in a proper time base and return duration's time_base
@@ -4053,7 +4052,7 @@ static int seek_to_start(InputFile *ifile, AVFormatContext *is)
         return ret;
 
     for (i = 0; i < ifile->nb_streams; i++) {
-        ist   = input_streams[ifile->ist_index + i];
+        ist   = cur_job->input_streams[ifile->ist_index + i];
         avctx = ist->dec_ctx;
 
         // flush decoders
@@ -4070,7 +4069,7 @@ static int seek_to_start(InputFile *ifile, AVFormatContext *is)
     }
 
     for (i = 0; i < ifile->nb_streams; i++) {
-        ist   = input_streams[ifile->ist_index + i];
+        ist   = cur_job->input_streams[ifile->ist_index + i];
         avctx = ist->dec_ctx;
 
         if (has_audio) {
@@ -4111,7 +4110,7 @@ static int seek_to_start(InputFile *ifile, AVFormatContext *is)
  */
 static int process_input(int file_index)
 {
-    InputFile *ifile = input_files[file_index];
+    InputFile *ifile = cur_job->input_files[file_index];
     AVFormatContext *is;
     InputStream *ist;
     AVPacket pkt;
@@ -4139,12 +4138,12 @@ static int process_input(int file_index)
         if (ret != AVERROR_EOF) {
             if (loglevel > 0) 
             	            LOGI(is->filename, ret);
-            if (exit_on_error)
+            if (cur_job->exit_on_error)
                 exit_program(2036);
         }
 
         for (i = 0; i < ifile->nb_streams; i++) {
-            ist = input_streams[ifile->ist_index + i];
+            ist = cur_job->input_streams[ifile->ist_index + i];
             if (ist->decoding_needed) {
                 ret = process_input_packet(ist, NULL, 0);
                 if (ret>0)
@@ -4152,8 +4151,8 @@ static int process_input(int file_index)
             }
 
             /* mark all outputs that don't go through lavfi as finished */
-            for (j = 0; j < nb_output_streams; j++) {
-                OutputStream *ost = output_streams[j];
+            for (j = 0; j < cur_job->nb_output_streams; j++) {
+                OutputStream *ost = cur_job->output_streams[j];
 
                 if (ost->source_index == ifile->ist_index + i &&
                     (ost->stream_copy || ost->enc->type == AVMEDIA_TYPE_SUBTITLE))
@@ -4167,8 +4166,8 @@ static int process_input(int file_index)
 
     reset_eagain();
 
-    if (do_pkt_dump) {
-        av_pkt_dump_log2(NULL, AV_LOG_INFO, &pkt, do_hex_dump,
+    if (cur_job->do_pkt_dump) {
+        av_pkt_dump_log2(NULL, AV_LOG_INFO, &pkt, cur_job->do_hex_dump,
                          is->streams[pkt.stream_index]);
     }
     /* the following test is needed in case new streams appear
@@ -4178,7 +4177,7 @@ static int process_input(int file_index)
         goto discard_packet;
     }
 
-    ist = input_streams[ifile->ist_index + pkt.stream_index];
+    ist = cur_job->input_streams[ifile->ist_index + pkt.stream_index];
 
     ist->data_size += pkt.size;
     ist->nb_packets++;
@@ -4186,13 +4185,13 @@ static int process_input(int file_index)
     if (ist->discard)
         goto discard_packet;
 
-    if (exit_on_error && (pkt.flags & AV_PKT_FLAG_CORRUPT)) {
+    if (cur_job->exit_on_error && (pkt.flags & AV_PKT_FLAG_CORRUPT)) {
         if (loglevel > 0) 
         	LOGI("%s: corrupt input packet in stream %d\n", is->filename, pkt.stream_index);
         exit_program(2037);
     }
 
-    if (debug_ts) {
+    if (cur_job->debug_ts) {
         if (loglevel == 2) 
         	LOGI("demuxer -> ist_index:%d type:%s "
                "next_dts:%s next_dts_time:%s next_pts:%s next_pts_time:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
@@ -4201,8 +4200,8 @@ static int process_input(int file_index)
                av_ts2str(ist->next_pts), av_ts2timestr(ist->next_pts, &AV_TIME_BASE_Q),
                av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ist->st->time_base),
                av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ist->st->time_base),
-               av_ts2str(input_files[ist->file_index]->ts_offset),
-               av_ts2timestr(input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
+               av_ts2str(cur_job->input_files[ist->file_index]->ts_offset),
+               av_ts2timestr(cur_job->input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
     }
 
     if(!ist->wrap_correction_done && is->start_time != AV_NOPTS_VALUE && ist->st->pts_wrap_bits < 64){
@@ -4275,11 +4274,11 @@ static int process_input(int file_index)
     pkt_dts = av_rescale_q_rnd(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q, AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
-        pkt_dts != AV_NOPTS_VALUE && ist->next_dts == AV_NOPTS_VALUE && !copy_ts
+        pkt_dts != AV_NOPTS_VALUE && ist->next_dts == AV_NOPTS_VALUE && !cur_job->copy_ts
         && (is->iformat->flags & AVFMT_TS_DISCONT) && ifile->last_ts != AV_NOPTS_VALUE) {
         int64_t delta   = pkt_dts - ifile->last_ts;
-        if (delta < -1LL*dts_delta_threshold*AV_TIME_BASE ||
-            delta >  1LL*dts_delta_threshold*AV_TIME_BASE){
+        if (delta < -1LL*cur_job->dts_delta_threshold*AV_TIME_BASE ||
+            delta >  1LL*cur_job->dts_delta_threshold*AV_TIME_BASE){
             ifile->ts_offset -= delta;
             if (loglevel == 2) 
             	LOGI(                   "Inter stream timestamp discontinuity %"PRId64", new offset= %"PRId64"\n",
@@ -4304,11 +4303,11 @@ static int process_input(int file_index)
     if ((ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ||
          ist->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) &&
          pkt_dts != AV_NOPTS_VALUE && ist->next_dts != AV_NOPTS_VALUE &&
-        !copy_ts) {
+        !cur_job->copy_ts) {
         int64_t delta   = pkt_dts - ist->next_dts;
         if (is->iformat->flags & AVFMT_TS_DISCONT) {
-            if (delta < -1LL*dts_delta_threshold*AV_TIME_BASE ||
-                delta >  1LL*dts_delta_threshold*AV_TIME_BASE ||
+            if (delta < -1LL*cur_job->dts_delta_threshold*AV_TIME_BASE ||
+                delta >  1LL*cur_job->dts_delta_threshold*AV_TIME_BASE ||
                 pkt_dts + AV_TIME_BASE/10 < FFMAX(ist->pts, ist->dts)) {
                 ifile->ts_offset -= delta;
                 if (loglevel == 2) 
@@ -4319,8 +4318,8 @@ static int process_input(int file_index)
                     pkt.pts -= av_rescale_q(delta, AV_TIME_BASE_Q, ist->st->time_base);
             }
         } else {
-            if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
-                 delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
+            if ( delta < -1LL*cur_job->dts_error_threshold*AV_TIME_BASE ||
+                 delta >  1LL*cur_job->dts_error_threshold*AV_TIME_BASE) {
                 if (loglevel == 2) 
                 	LOGI("DTS %"PRId64", next:%"PRId64" st:%d invalid dropping\n", pkt.dts, ist->next_dts, pkt.stream_index);
                 pkt.dts = AV_NOPTS_VALUE;
@@ -4328,8 +4327,8 @@ static int process_input(int file_index)
             if (pkt.pts != AV_NOPTS_VALUE){
                 int64_t pkt_pts = av_rescale_q(pkt.pts, ist->st->time_base, AV_TIME_BASE_Q);
                 delta   = pkt_pts - ist->next_dts;
-                if ( delta < -1LL*dts_error_threshold*AV_TIME_BASE ||
-                     delta >  1LL*dts_error_threshold*AV_TIME_BASE) {
+                if ( delta < -1LL*cur_job->dts_error_threshold*AV_TIME_BASE ||
+                     delta >  1LL*cur_job->dts_error_threshold*AV_TIME_BASE) {
                     if (loglevel == 2) 
                     	LOGI("PTS %"PRId64", next:%"PRId64" invalid dropping st:%d\n", pkt.pts, ist->next_dts, pkt.stream_index);
                     pkt.pts = AV_NOPTS_VALUE;
@@ -4341,14 +4340,14 @@ static int process_input(int file_index)
     if (pkt.dts != AV_NOPTS_VALUE)
         ifile->last_ts = av_rescale_q(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q);
 
-    if (debug_ts) {
+    if (cur_job->debug_ts) {
         if (loglevel == 2) 
         	LOGI("demuxer+ffmpeg -> ist_index:%d type:%s pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s off:%s off_time:%s\n",
                ifile->ist_index + pkt.stream_index, av_get_media_type_string(ist->dec_ctx->codec_type),
                av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ist->st->time_base),
                av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ist->st->time_base),
-               av_ts2str(input_files[ist->file_index]->ts_offset),
-               av_ts2timestr(input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
+               av_ts2str(cur_job->input_files[ist->file_index]->ts_offset),
+               av_ts2timestr(cur_job->input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
     }
 
     sub2video_heartbeat(ist, pkt.pts);
@@ -4392,8 +4391,8 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     for (i = 0; i < graph->nb_inputs; i++) {
         ifilter = graph->inputs[i];
         ist = ifilter->ist;
-        if (input_files[ist->file_index]->eagain ||
-            input_files[ist->file_index]->eof_reached)
+        if (cur_job->input_files[ist->file_index]->eagain ||
+            cur_job->input_files[ist->file_index]->eof_reached)
             continue;
         nb_requests = av_buffersrc_get_nb_failed_requests(ifilter->filter);
         if (nb_requests > nb_requests_max) {
@@ -4420,6 +4419,9 @@ static int transcode_step(void)
     InputStream  *ist;
     int ret;
 
+    if (cur_job->cancelled)
+        return AVERROR_EXIT;
+
     ost = choose_output();
     if (!ost) {
         if (got_eagain()) {
@@ -4439,12 +4441,12 @@ static int transcode_step(void)
             return 0;
     } else {
         av_assert0(ost->source_index >= 0);
-        ist = input_streams[ost->source_index];
+        ist = cur_job->input_streams[ost->source_index];
     }
 
     ret = process_input(ist->file_index);
     if (ret == AVERROR(EAGAIN)) {
-        if (input_files[ist->file_index]->eagain)
+        if (cur_job->input_files[ist->file_index]->eagain)
             ost->unavailable = 1;
         return 0;
     }
@@ -4471,7 +4473,7 @@ static int transcode(void)
     if (ret < 0)
         goto fail;
 
-    if (stdin_interaction) {
+    if (cur_job->stdin_interaction) {
         if (loglevel == 2) 
         	LOGI("Press [q] to stop, [?] for help\n");
     }
@@ -4487,7 +4489,7 @@ static int transcode(void)
         int64_t cur_time= av_gettime_relative();
 
         /* if 'q' pressed, exits */
-        if (stdin_interaction)
+        if (cur_job->stdin_interaction)
             if (check_keyboard_interaction(cur_time) < 0)
                 break;
 
@@ -4499,6 +4501,11 @@ static int transcode(void)
         }
 
         ret = transcode_step();
+        if (ret == AVERROR_EXIT && cur_job->cancelled) {
+            if (loglevel == 2)
+            	LOGI("Job cancelled, finishing.\n");
+            break;
+        }
         if (ret < 0 && ret != AVERROR_EOF) {
             char errbuf[128];
             av_strerror(ret, errbuf, sizeof(errbuf));
@@ -4516,9 +4523,9 @@ static int transcode(void)
 #endif
 
     /* at the end of stream, we must flush the decoder buffers */
-    for (i = 0; i < nb_input_streams; i++) {
-        ist = input_streams[i];
-        if (!input_files[ist->file_index]->eof_reached && ist->decoding_needed) {
+    for (i = 0; i < cur_job->nb_input_streams; i++) {
+        ist = cur_job->input_streams[i];
+        if (!cur_job->input_files[ist->file_index]->eof_reached && ist->decoding_needed) {
             process_input_packet(ist, NULL, 0);
         }
     }
@@ -4527,9 +4534,9 @@ static int transcode(void)
     term_exit();
 
     /* write the trailer if needed and close file */
-    for (i = 0; i < nb_output_files; i++) {
-        os = output_files[i]->ctx;
-        if (!output_files[i]->header_written) {
+    for (i = 0; i < cur_job->nb_output_files; i++) {
+        os = cur_job->output_files[i]->ctx;
+        if (!cur_job->output_files[i]->header_written) {
             if (loglevel > 0) 
             	LOGI(                   "Nothing was written into output file %d (%s), because "
                    "at least one of its streams received no packets.\n",
@@ -4539,7 +4546,7 @@ static int transcode(void)
         if ((ret = av_write_trailer(os)) < 0) {
             if (loglevel > 0) 
             	LOGI("Error writing trailer of %s: %s", os->filename, av_err2str(ret));
-            if (exit_on_error)
+            if (cur_job->exit_on_error)
                 exit_program(2039);
         }
     }
@@ -4548,23 +4555,23 @@ static int transcode(void)
     print_report(1, timer_start, av_gettime_relative());
 
     /* close each encoder */
-    for (i = 0; i < nb_output_streams; i++) {
-        ost = output_streams[i];
+    for (i = 0; i < cur_job->nb_output_streams; i++) {
+        ost = cur_job->output_streams[i];
         if (ost->encoding_needed) {
             av_freep(&ost->enc_ctx->stats_in);
         }
         total_packets_written += ost->packets_written;
     }
 
-    if (!total_packets_written && (abort_on_flags & ABORT_ON_FLAG_EMPTY_OUTPUT)) {
+    if (!total_packets_written && (cur_job->abort_on_flags & ABORT_ON_FLAG_EMPTY_OUTPUT)) {
         if (loglevel > 0) 
         	LOGI("Empty output\n");
         exit_program(2040);
     }
 
     /* close each decoder */
-    for (i = 0; i < nb_input_streams; i++) {
-        ist = input_streams[i];
+    for (i = 0; i < cur_job->nb_input_streams; i++) {
+        ist = cur_job->input_streams[i];
         if (ist->decoding_needed) {
             avcodec_close(ist->dec_ctx);
             if (ist->hwaccel_uninit)
@@ -4572,7 +4579,7 @@ static int transcode(void)
         }
     }
 
-    av_buffer_unref(&hw_device_ctx);
+    av_buffer_unref(&cur_job->hw_device_ctx);
 
     /* finished ! */
     ret = 0;
@@ -4582,9 +4589,9 @@ static int transcode(void)
     free_input_threads();
 #endif
 
-    if (output_streams) {
-        for (i = 0; i < nb_output_streams; i++) {
-            ost = output_streams[i];
+    if (cur_job->output_streams) {
+        for (i = 0; i < cur_job->nb_output_streams; i++) {
+            ost = cur_job->output_streams[i];
             if (ost) {
                 if (ost->logfile) {
                     if (fclose(ost->logfile))
@@ -4647,56 +4654,90 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 {
 }
 
-int main(int loglevel, int argc, char **argv)
+#if HAVE_PTHREADS
+static pthread_once_t register_once = PTHREAD_ONCE_INIT;
+#endif
+static int64_t global_init_time;
+
+/* lines per second and logging context written by the background logger */
+#define LOG_MAX_RATE 200
+
+/* process-wide state, shared by all jobs and never torn down */
+static void register_all(void)
 {
-	received_sigterm = 0;
-	received_nb_signals = 0;
-
-	transcode_init_done = 0;
-	ffmpeg_exited = 0;
-	main_return_code = 0;
-	run_as_daemon  = 0;
-
-	nb_frames_dup = 0;
-	nb_frames_drop = 0;
-	nb_input_streams = 0;
-	nb_input_files   = 0;
-	nb_output_streams = 0;
-	nb_output_files   = 0;
-	nb_filtergraphs = 0;
-
-	int jmpret = setjmp(env_buf);
-	if (jmpret != 0) {
-		return jmpret;
-	}
+    int64_t t = av_gettime_relative();
 
+    avcodec_register_all();
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avfilter_register_all();
+    av_register_all();
+    avformat_network_init();
+    /* the level, -d and -report of each job are applied by log_callback_job() */
+    av_log_set_level(AV_LOG_TRACE);
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    av_log_set_callback(log_callback_job);
+    /* codec threads must not serialize on the log output */
+    av_log_start_async(LOG_MAX_RATE);
+
+    global_init_time = av_gettime_relative() - t;
+}
+
+int64_t ffmpeg_job_global_init(void)
+{
+#if HAVE_PTHREADS
+    pthread_once(&register_once, register_all);
+#else
+    if (!global_init_time)
+        register_all();
+#endif
+    return global_init_time;
+}
+
+int ffmpeg_job_run(FFTranscodeJob *job)
+{
+    int argc = job->argc;
+    char **argv = job->argv;
     int i, ret;
     int64_t ti;
 
+    if (job->cancelled)
+        return job->ret = FF_JOB_CANCELLED_CODE;
+
+    cur_job  = job;
+    loglevel = job->loglevel;
+
+    job->int_cb.callback = decode_interrupt_cb;
+    job->int_cb.opaque   = job;
+    job->want_sdp         = 1;
+    job->report_last_time = -1;
+
+    avpriv_atomic_int_add_and_fetch(&nb_running_jobs, 1);
+    ret = setjmp(job->exit_buf);
+    if (ret != 0) {
+        /* a cancelled job fails wherever it was interrupted, report the cancel */
+        job->ret = job->cancelled ? FF_JOB_CANCELLED_CODE : ret;
+        goto end;
+    }
+
     init_dynload();
 
     register_exit(ffmpeg_cleanup);
 
     setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
 
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    ffmpeg_job_global_init();
+
     parse_loglevel(argc, argv, options);
 
     if(argc>1 && !strcmp(argv[1], "-d")){
-        run_as_daemon=1;
-        av_log_set_callback(log_callback_null);
+        job->run_as_daemon=1;
+        job->log_callback = log_callback_null;
         argc--;
         argv++;
     }
 
-    avcodec_register_all();
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avfilter_register_all();
-    av_register_all();
-    avformat_network_init();
-
     show_banner(argc, argv, options);
 
     /* parse options and open all input/output files */
@@ -4704,7 +4745,7 @@ int main(int loglevel, int argc, char **argv)
     if (ret < 0)
         exit_program(2041);
 
-    if (nb_output_files <= 0 && nb_input_files == 0) {
+    if (job->nb_output_files <= 0 && job->nb_input_files == 0) {
         show_usage();
         if (loglevel == 2) 
         	LOGI("Use -h to get full help or, even better, run 'man %s'\n", program_name);
@@ -4712,7 +4753,7 @@ int main(int loglevel, int argc, char **argv)
     }
 
     /* file converter / grab */
-    if (nb_output_files <= 0) {
+    if (job->nb_output_files <= 0) {
         if (loglevel > 0) 
         	LOGI("At least one output file must be specified\n");
         exit_program(2043);
@@ -4723,25 +4764,33 @@ int main(int loglevel, int argc, char **argv)
 //         exit_program(2044);
 //     }
 
-    for (i = 0; i < nb_output_files; i++) {
-        if (strcmp(output_files[i]->ctx->oformat->name, "rtp"))
-            want_sdp = 0;
+    for (i = 0; i < job->nb_output_files; i++) {
+        if (strcmp(job->output_files[i]->ctx->oformat->name, "rtp"))
+            job->want_sdp = 0;
     }
 
-    current_time = ti = getutime();
+    job->current_time = ti = getutime();
     if (transcode() < 0)
         exit_program(2045);
+    if (job->cancelled)
+        exit_program(FF_JOB_CANCELLED_CODE);
     ti = getutime() - ti;
-    if (do_benchmark) {
+    if (job->do_benchmark) {
         if (loglevel == 2) 
         	LOGI("bench: utime=%0.3fs\n", ti / 1000000.0);
     }
     if (loglevel == 2) 
     	LOGI("%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
-           decode_error_stat[0], decode_error_stat[1]);
-    if ((decode_error_stat[0] + decode_error_stat[1]) * max_error_rate < decode_error_stat[1])
+           job->decode_error_stat[0], job->decode_error_stat[1]);
+    if ((job->decode_error_stat[0] + job->decode_error_stat[1]) * job->max_error_rate < job->decode_error_stat[1])
         exit_program(2046);
 
-    ffmpeg_cleanup(received_nb_signals ? 255 : main_return_code);
-    return main_return_code;
+    ffmpeg_cleanup(received_nb_signals ? 255 : job->main_return_code);
+    job->ret = job->main_return_code;
+
+end:
+    avpriv_atomic_int_add_and_fetch(&nb_running_jobs, -1);
+    cur_job  = NULL;
+    loglevel = 0;
+    return job->ret;
 }
@@ -526,61 +526,17 @@ typedef struct OutputFile {
     int header_written;
 } OutputFile;
 
-extern InputStream **input_streams;
-extern int        nb_input_streams;
-extern InputFile   **input_files;
-extern int        nb_input_files;
-
-extern OutputStream **output_streams;
-extern int         nb_output_streams;
-extern OutputFile   **output_files;
-extern int         nb_output_files;
-
-extern FilterGraph **filtergraphs;
-extern int        nb_filtergraphs;
-
-extern char *vstats_filename;
-extern char *sdp_filename;
-
-extern float audio_drift_threshold;
-extern float dts_delta_threshold;
-extern float dts_error_threshold;
-
-extern int audio_volume;
-extern int audio_sync_method;
-extern int video_sync_method;
-extern float frame_drop_threshold;
-extern int do_benchmark;
-extern int do_benchmark_all;
-extern int do_deinterlace;
-extern int do_hex_dump;
-extern int do_pkt_dump;
-extern int copy_ts;
-extern int start_at_zero;
-extern int copy_tb;
-extern int debug_ts;
-extern int exit_on_error;
-extern int abort_on_flags;
-extern int print_stats;
-extern int qp_hist;
-extern int stdin_interaction;
-extern int frame_bits_per_raw_sample;
-extern AVIOContext *progress_avio;
-extern float max_error_rate;
 extern char *videotoolbox_pixfmt;
 
-extern const AVIOInterruptCB int_cb;
-
 extern const OptionDef options[];
 extern const HWAccel hwaccels[];
-extern int hwaccel_lax_profile_check;
-extern AVBufferRef *hw_device_ctx;
 
 
 void term_init(void);
 void term_exit(void);
 
 void reset_options(OptionsContext *o, int is_input);
+void init_job_options(FFTranscodeJob *job);
 void show_usage(void);
 
 void opt_output_file(void *optctx, const char *filename);
@@ -200,7 +200,7 @@ int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
 
     if (!fg)
         exit_program(4002);
-    fg->index = nb_filtergraphs;
+    fg->index = cur_job->nb_filtergraphs;
 
     GROW_ARRAY(fg->outputs, fg->nb_outputs);
     if (!(fg->outputs[0] = av_mallocz(sizeof(*fg->outputs[0]))))
@@ -219,8 +219,8 @@ int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     GROW_ARRAY(ist->filters, ist->nb_filters);
     ist->filters[ist->nb_filters - 1] = fg->inputs[0];
 
-    GROW_ARRAY(filtergraphs, nb_filtergraphs);
-    filtergraphs[nb_filtergraphs - 1] = fg;
+    GROW_ARRAY(cur_job->filtergraphs, cur_job->nb_filtergraphs);
+    cur_job->filtergraphs[cur_job->nb_filtergraphs - 1] = fg;
 
     return 0;
 }
@@ -245,13 +245,13 @@ static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
         char *p;
         int file_idx = strtol(in->name, &p, 0);
 
-        if (file_idx < 0 || file_idx >= nb_input_files) {
+        if (file_idx < 0 || file_idx >= cur_job->nb_input_files) {
             if (loglevel > 0) 
             	LOGI("Invalid file index %d in filtergraph description %s.\n",
                    file_idx, fg->graph_desc);
             exit_program(4006);
         }
-        s = input_files[file_idx]->ctx;
+        s = cur_job->input_files[file_idx]->ctx;
 
         for (i = 0; i < s->nb_streams; i++) {
             enum AVMediaType stream_type = s->streams[i]->codecpar->codec_type;
@@ -270,15 +270,15 @@ static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
                    "matches no streams.\n", p, fg->graph_desc);
             exit_program(4007);
         }
-        ist = input_streams[input_files[file_idx]->ist_index + st->index];
+        ist = cur_job->input_streams[cur_job->input_files[file_idx]->ist_index + st->index];
     } else {
         /* find the first unused stream of corresponding type */
-        for (i = 0; i < nb_input_streams; i++) {
-            ist = input_streams[i];
+        for (i = 0; i < cur_job->nb_input_streams; i++) {
+            ist = cur_job->input_streams[i];
             if (ist->dec_ctx->codec_type == type && ist->discard)
                 break;
         }
-        if (i == nb_input_streams) {
+        if (i == cur_job->nb_input_streams) {
             if (loglevel > 0) 
             	LOGI("Cannot find a matching stream for "
                    "unlabeled input pad %d on filter %s\n", in->pad_idx,
@@ -420,7 +420,7 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
 {
     char *pix_fmts;
     OutputStream *ost = ofilter->ost;
-    OutputFile    *of = output_files[ost->file_index];
+    OutputFile    *of = cur_job->output_files[ost->file_index];
     AVCodecContext *codec = ost->enc_ctx;
     AVFilterContext *last_filter = out->filter_ctx;
     int pad_idx = out->pad_idx;
@@ -435,7 +435,7 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     if (ret < 0)
         return ret;
 
-    if (!hw_device_ctx && (codec->width || codec->height)) {
+    if (!cur_job->hw_device_ctx && (codec->width || codec->height)) {
         char args[255];
         AVFilterContext *filter;
         AVDictionaryEntry *e = NULL;
@@ -515,7 +515,7 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
 static int configure_output_audio_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out)
 {
     OutputStream *ost = ofilter->ost;
-    OutputFile    *of = output_files[ost->file_index];
+    OutputFile    *of = cur_job->output_files[ost->file_index];
     AVCodecContext *codec  = ost->enc_ctx;
     AVFilterContext *last_filter = out->filter_ctx;
     int pad_idx = out->pad_idx;
@@ -607,10 +607,10 @@ static int configure_output_audio_filter(FilterGraph *fg, OutputFilter *ofilter,
         pad_idx = 0;
     }
 
-    if (audio_volume != 256 && 0) {
+    if (cur_job->audio_volume != 256 && 0) {
         char args[256];
 
-        snprintf(args, sizeof(args), "%f", audio_volume / 256.);
+        snprintf(args, sizeof(args), "%f", cur_job->audio_volume / 256.);
         AUTO_INSERT_FILTER("-vol", "volume", args);
     }
 
@@ -678,7 +678,7 @@ int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOu
 
 static int sub2video_prepare(InputStream *ist)
 {
-    AVFormatContext *avf = input_files[ist->file_index]->ctx;
+    AVFormatContext *avf = cur_job->input_files[ist->file_index]->ctx;
     int i, w, h;
 
     /* Compute the size of the canvas for the subtitles stream.
@@ -720,7 +720,7 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
     AVFilterContext *last_filter;
     const AVFilter *buffer_filt = avfilter_get_by_name("buffer");
     InputStream *ist = ifilter->ist;
-    InputFile     *f = input_files[ist->file_index];
+    InputFile     *f = cur_job->input_files[ist->file_index];
     AVRational tb = ist->framerate.num ? av_inv_q(ist->framerate) :
                                          ist->st->time_base;
     AVRational fr = ist->framerate;
@@ -744,7 +744,7 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
     }
 
     if (!fr.num)
-        fr = av_guess_frame_rate(input_files[ist->file_index]->ctx, ist->st, NULL);
+        fr = av_guess_frame_rate(cur_job->input_files[ist->file_index]->ctx, ist->st, NULL);
 
     if (ist->dec_ctx->codec_type == AVMEDIA_TYPE_SUBTITLE) {
         ret = sub2video_prepare(ist);
@@ -819,7 +819,7 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
         last_filter = setpts;
     }
 
-    if (do_deinterlace) {
+    if (cur_job->do_deinterlace) {
         AVFilterContext *yadif;
 
         snprintf(name, sizeof(name), "deinterlace input from stream %d:%d",
@@ -838,9 +838,9 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
 
     snprintf(name, sizeof(name), "trim for input stream %d:%d",
              ist->file_index, ist->st->index);
-    if (copy_ts) {
+    if (cur_job->copy_ts) {
         tsoffset = f->start_time == AV_NOPTS_VALUE ? 0 : f->start_time;
-        if (!start_at_zero && f->ctx->start_time != AV_NOPTS_VALUE)
+        if (!cur_job->start_at_zero && f->ctx->start_time != AV_NOPTS_VALUE)
             tsoffset += f->ctx->start_time;
     }
     ret = insert_trim(((f->start_time == AV_NOPTS_VALUE) || !f->accurate_seek) ?
@@ -864,7 +864,7 @@ static int configure_input_audio_filter(FilterGraph *fg, InputFilter *ifilter,
     AVFilterContext *last_filter;
     const AVFilter *abuffer_filt = avfilter_get_by_name("abuffer");
     InputStream *ist = ifilter->ist;
-    InputFile     *f = input_files[ist->file_index];
+    InputFile     *f = cur_job->input_files[ist->file_index];
     AVBPrint args;
     char name[255];
     int ret, pad_idx = 0;
@@ -917,12 +917,12 @@ static int configure_input_audio_filter(FilterGraph *fg, InputFilter *ifilter,
     last_filter = filt_ctx;                                                 \
 } while (0)
 
-    if (audio_sync_method > 0) {
+    if (cur_job->audio_sync_method > 0) {
         char args[256] = {0};
 
-        av_strlcatf(args, sizeof(args), "async=%d", audio_sync_method);
-        if (audio_drift_threshold != 0.1)
-            av_strlcatf(args, sizeof(args), ":min_hard_comp=%f", audio_drift_threshold);
+        av_strlcatf(args, sizeof(args), "async=%d", cur_job->audio_sync_method);
+        if (cur_job->audio_drift_threshold != 0.1)
+            av_strlcatf(args, sizeof(args), ":min_hard_comp=%f", cur_job->audio_drift_threshold);
         if (!fg->reconfiguration)
             av_strlcatf(args, sizeof(args), ":first_pts=0");
         AUTO_INSERT_FILTER_INPUT("-async", "aresample", args);
@@ -941,22 +941,22 @@ static int configure_input_audio_filter(FilterGraph *fg, InputFilter *ifilter,
 //         av_bprint_finalize(&pan_buf, NULL);
 //     }
 
-    if (audio_volume != 256) {
+    if (cur_job->audio_volume != 256) {
         char args[256];
 
         if (loglevel == 2) 
         	LOGI("-vol has been deprecated. Use the volume "
                "audio filter instead.\n");
 
-        snprintf(args, sizeof(args), "%f", audio_volume / 256.);
+        snprintf(args, sizeof(args), "%f", cur_job->audio_volume / 256.);
         AUTO_INSERT_FILTER_INPUT("-vol", "volume", args);
     }
 
     snprintf(name, sizeof(name), "trim for input stream %d:%d",
              ist->file_index, ist->st->index);
-    if (copy_ts) {
+    if (cur_job->copy_ts) {
         tsoffset = f->start_time == AV_NOPTS_VALUE ? 0 : f->start_time;
-        if (!start_at_zero && f->ctx->start_time != AV_NOPTS_VALUE)
+        if (!cur_job->start_at_zero && f->ctx->start_time != AV_NOPTS_VALUE)
             tsoffset += f->ctx->start_time;
     }
     ret = insert_trim(((f->start_time == AV_NOPTS_VALUE) || !f->accurate_seek) ?
@@ -1041,9 +1041,9 @@ int configure_filtergraph(FilterGraph *fg)
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         return ret;
 
-    if (hw_device_ctx) {
+    if (cur_job->hw_device_ctx) {
         for (i = 0; i < fg->graph->nb_filters; i++) {
-            fg->graph->filters[i]->hw_device_ctx = av_buffer_ref(hw_device_ctx);
+            fg->graph->filters[i]->hw_device_ctx = av_buffer_ref(cur_job->hw_device_ctx);
         }
     }
 
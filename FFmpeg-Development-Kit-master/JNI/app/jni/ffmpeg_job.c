@@ -0,0 +1,242 @@
+/*
+ * Concurrent execution of ffmpeg command lines
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffmpeg.h"
+#include "ffmpeg_job.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+__thread FFTranscodeJob *cur_job = NULL;
+
+struct FFJobPool {
+#if HAVE_PTHREADS
+    pthread_t *workers;
+    int nb_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+    FFTranscodeJob *head, *tail;    /* jobs waiting for a worker */
+    int quit;
+};
+
+FFTranscodeJob *ffmpeg_job_alloc(int loglevel, int argc, char **argv)
+{
+    FFTranscodeJob *job = av_mallocz(sizeof(*job));
+    int i;
+
+    if (!job)
+        return NULL;
+
+    job->loglevel = loglevel;
+    job->argv = av_mallocz_array(argc + 1, sizeof(*job->argv));
+    if (!job->argv)
+        goto fail;
+    for (job->argc = 0; job->argc < argc; job->argc++) {
+        job->argv[job->argc] = av_strdup(argv[job->argc]);
+        if (!job->argv[job->argc])
+            goto fail;
+    }
+
+    init_job_options(job);
+
+#if HAVE_PTHREADS
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+#endif
+    job->state = FF_JOB_PENDING;
+    return job;
+
+fail:
+    for (i = 0; i < job->argc; i++)
+        av_freep(&job->argv[i]);
+    av_freep(&job->argv);
+    av_freep(&job);
+    return NULL;
+}
+
+void ffmpeg_job_free(FFTranscodeJob **pjob)
+{
+    FFTranscodeJob *job = *pjob;
+    int i;
+
+    if (!job)
+        return;
+
+    for (i = 0; i < job->argc; i++)
+        av_freep(&job->argv[i]);
+    av_freep(&job->argv);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->cond);
+#endif
+    av_freep(pjob);
+}
+
+void ffmpeg_job_set_progress_cb(FFTranscodeJob *job,
+                                void (*cb)(void *opaque, const FFJobProgress *progress),
+                                void *opaque, int64_t interval)
+{
+    job->progress_cb       = cb;
+    job->progress_opaque   = opaque;
+    job->progress_interval = interval;
+}
+
+void ffmpeg_job_cancel(FFTranscodeJob *job)
+{
+    job->cancelled = 1;
+}
+
+#if HAVE_PTHREADS
+static void *job_worker(void *arg)
+{
+    FFJobPool *pool = arg;
+
+    while (1) {
+        FFTranscodeJob *job;
+
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->head && !pool->quit)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        job = pool->head;
+        if (!job) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pool->head = job->next;
+        if (!pool->head)
+            pool->tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        pthread_mutex_lock(&job->lock);
+        job->state = FF_JOB_RUNNING;
+        pthread_mutex_unlock(&job->lock);
+
+        ffmpeg_job_run(job);
+
+        pthread_mutex_lock(&job->lock);
+        job->state = FF_JOB_DONE;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    return NULL;
+}
+#endif
+
+FFJobPool *ffmpeg_job_pool_alloc(int nb_threads)
+{
+#if HAVE_PTHREADS
+    FFJobPool *pool = av_mallocz(sizeof(*pool));
+    int i;
+
+    if (!pool)
+        return NULL;
+
+    if (nb_threads <= 0)
+        nb_threads = av_cpu_count();
+
+    pool->workers = av_mallocz_array(nb_threads, sizeof(*pool->workers));
+    if (!pool->workers) {
+        av_freep(&pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_create(&pool->workers[i], NULL, job_worker, pool))
+            break;
+        pool->nb_workers++;
+    }
+    if (!pool->nb_workers) {
+        ffmpeg_job_pool_free(&pool);
+        return NULL;
+    }
+
+    return pool;
+#else
+    return NULL;
+#endif
+}
+
+int ffmpeg_job_pool_submit(FFJobPool *pool, FFTranscodeJob *job)
+{
+#if HAVE_PTHREADS
+    if (job->state != FF_JOB_PENDING)
+        return AVERROR(EINVAL);
+
+    job->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->quit) {
+        pthread_mutex_unlock(&pool->lock);
+        return AVERROR_EXIT;
+    }
+    if (pool->tail)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ffmpeg_job_wait(FFTranscodeJob *job)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+    while (job->state != FF_JOB_DONE)
+        pthread_cond_wait(&job->cond, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+#endif
+    return job->ret;
+}
+
+void ffmpeg_job_pool_free(FFJobPool **ppool)
+{
+    FFJobPool *pool = *ppool;
+
+    if (!pool)
+        return;
+
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    while (pool->nb_workers > 0)
+        pthread_join(pool->workers[--pool->nb_workers], NULL);
+    av_freep(&pool->workers);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+#endif
+    av_freep(ppool);
+}
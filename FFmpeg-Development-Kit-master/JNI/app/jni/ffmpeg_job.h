@@ -0,0 +1,260 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFMPEG_JOB_H
+#define FFMPEG_JOB_H
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "libavformat/avio.h"
+#include "libavutil/buffer.h"
+#include "libavutil/dict.h"
+
+enum FFJobState {
+    FF_JOB_PENDING,
+    FF_JOB_RUNNING,
+    FF_JOB_DONE,
+};
+
+/**
+ * Snapshot of a running job, handed to FFTranscodeJob.progress_cb.
+ */
+typedef struct FFJobProgress {
+    int frame;                  /* frames output on the first video stream */
+    float fps;
+    int64_t total_size;         /* bytes written to the first output, -1 if unknown */
+    double bitrate;             /* kbits/s, -1 if unknown */
+    int64_t out_time;           /* in AV_TIME_BASE units */
+    double speed;               /* out_time relative to wall clock time, -1 if unknown */
+    int dup_frames;
+    int drop_frames;
+    int is_last;                /* set on the final report of the job */
+} FFJobProgress;
+
+/**
+ * One ffmpeg command line invocation.
+ *
+ * Everything the transcoder used to keep in file-scope globals lives here,
+ * so that any number of jobs can run concurrently in one process. While a
+ * job is running, cur_job points to it on the thread executing it.
+ */
+typedef struct FFTranscodeJob {
+    int loglevel;
+    int argc;
+    char **argv;
+    int ret;                    /* exit code once state is FF_JOB_DONE */
+
+    jmp_buf exit_buf;           /* exit_program() unwinds to here */
+    AVIOInterruptCB int_cb;
+
+    /* set from any thread by ffmpeg_job_cancel() */
+    volatile int cancelled;
+
+    void (*progress_cb)(void *opaque, const FFJobProgress *progress);
+    void *progress_opaque;
+    int64_t progress_interval;  /* minimum time between progress_cb calls in us */
+    int64_t progress_last_time;
+
+    /* transcoding state */
+    struct InputStream **input_streams;
+    int        nb_input_streams;
+    struct InputFile   **input_files;
+    int        nb_input_files;
+
+    struct OutputStream **output_streams;
+    int         nb_output_streams;
+    struct OutputFile   **output_files;
+    int         nb_output_files;
+
+    struct FilterGraph **filtergraphs;
+    int        nb_filtergraphs;
+
+    FILE *vstats_file;
+    AVIOContext *progress_avio;
+    uint8_t *subtitle_out;
+
+    int run_as_daemon;
+    int nb_frames_dup;
+    int nb_frames_drop;
+    int64_t decode_error_stat[2];
+    int want_sdp;
+    int current_time;
+    int transcode_init_done;
+    int main_return_code;
+
+    int64_t report_last_time;
+    int qp_histogram[52];
+    int64_t keyboard_last_time;
+
+    /* options collected by opt_default() and friends */
+    AVDictionary *sws_dict;
+    AVDictionary *swr_opts;
+    AVDictionary *format_opts, *codec_opts, *resample_opts;
+
+    /* logging of the thread running the job, see log_callback_job() */
+    int log_level;              /* av_log() level, set by -loglevel */
+    void (*log_callback)(void *ptr, int level, const char *fmt, va_list vl);
+    FILE *report_file;          /* opened by -report */
+    int report_file_level;
+
+    /* global options, see init_job_options() for the defaults */
+    char *vstats_filename;
+    char *sdp_filename;
+
+    float audio_drift_threshold;
+    float dts_delta_threshold;
+    float dts_error_threshold;
+
+    int audio_volume;
+    int audio_sync_method;
+    int video_sync_method;
+    float frame_drop_threshold;
+    int do_deinterlace;
+    int do_benchmark;
+    int do_benchmark_all;
+    int do_hex_dump;
+    int do_pkt_dump;
+    int copy_ts;
+    int start_at_zero;
+    int copy_tb;
+    int debug_ts;
+    int exit_on_error;
+    int abort_on_flags;
+    int print_stats;
+    int qp_hist;
+    int stdin_interaction;
+    int frame_bits_per_raw_sample;
+    float max_error_rate;
+
+    int intra_only;
+    int file_overwrite;
+    int no_file_overwrite;
+    int do_psnr;
+    int input_sync;
+    int override_ffserver;
+    int input_stream_potentially_available;
+    int ignore_unknown_streams;
+    int copy_unknown_streams;
+
+    int hwaccel_lax_profile_check;
+    AVBufferRef *hw_device_ctx;
+
+    /* owned by the pool the job was submitted to */
+    enum FFJobState state;
+    struct FFTranscodeJob *next;
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+} FFTranscodeJob;
+
+typedef struct FFJobPool FFJobPool;
+
+/**
+ * The job being executed by the calling thread, NULL outside of
+ * ffmpeg_job_run().
+ */
+extern __thread FFTranscodeJob *cur_job;
+
+/**
+ * Register all codecs, formats and filters and initialize networking. This
+ * is done only once per process, on the first call; ffmpeg_job_run() calls
+ * it as well, so calling it up front only moves the cost out of the first
+ * job.
+ *
+ * @return time the one-time initialization took in microseconds
+ */
+int64_t ffmpeg_job_global_init(void);
+
+/**
+ * Allocate a job for the given command line. argv is copied, so the caller
+ * may release its strings as soon as this returns.
+ *
+ * @return the new job or NULL on allocation failure
+ */
+FFTranscodeJob *ffmpeg_job_alloc(int loglevel, int argc, char **argv);
+
+/**
+ * Free a job and everything it owns. The job must not be queued or running.
+ */
+void ffmpeg_job_free(FFTranscodeJob **job);
+
+/**
+ * Run a job to completion on the calling thread.
+ *
+ * @return the ffmpeg exit code, 0 on success
+ */
+int ffmpeg_job_run(FFTranscodeJob *job);
+
+/**
+ * Have the job report its progress. The callback is invoked on the thread
+ * running the job, at most once per interval and always once at the end.
+ * Must be called before the job is run or submitted.
+ *
+ * @param interval minimum time between two calls in microseconds
+ */
+void ffmpeg_job_set_progress_cb(FFTranscodeJob *job,
+                                void (*cb)(void *opaque, const FFJobProgress *progress),
+                                void *opaque, int64_t interval);
+
+/**
+ * Ask a job to stop as soon as possible. Safe to call from any thread while
+ * the job is queued or running; the job then finishes with
+ * FF_JOB_CANCELLED_CODE.
+ */
+void ffmpeg_job_cancel(FFTranscodeJob *job);
+
+/**
+ * Exit code of a job stopped by ffmpeg_job_cancel().
+ */
+#define FF_JOB_CANCELLED_CODE 2047
+
+/**
+ * Start a pool of worker threads executing submitted jobs.
+ *
+ * @param nb_threads number of workers, 0 for one per CPU
+ */
+FFJobPool *ffmpeg_job_pool_alloc(int nb_threads);
+
+/**
+ * Queue a job for execution by the next free worker of the pool.
+ */
+int ffmpeg_job_pool_submit(FFJobPool *pool, FFTranscodeJob *job);
+
+/**
+ * Block until a submitted job has finished.
+ *
+ * @return the ffmpeg exit code of the job
+ */
+int ffmpeg_job_wait(FFTranscodeJob *job);
+
+/**
+ * Finish all queued jobs, stop the workers and free the pool.
+ */
+void ffmpeg_job_pool_free(FFJobPool **pool);
+
+#endif /* FFMPEG_JOB_H */
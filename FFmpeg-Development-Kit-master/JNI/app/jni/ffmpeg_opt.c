@@ -89,47 +89,24 @@ const HWAccel hwaccels[] = {
 #endif
     { 0 },
 };
-int hwaccel_lax_profile_check = 0;
-AVBufferRef *hw_device_ctx;
-
-char *vstats_filename;
-char *sdp_filename;
-
-float audio_drift_threshold = 0.1;
-float dts_delta_threshold   = 10;
-float dts_error_threshold   = 3600*30;
-
-int audio_volume      = 256;
-int audio_sync_method = 0;
-int video_sync_method = VSYNC_AUTO;
-float frame_drop_threshold = 0;
-int do_deinterlace    = 0;
-int do_benchmark      = 0;
-int do_benchmark_all  = 0;
-int do_hex_dump       = 0;
-int do_pkt_dump       = 0;
-int copy_ts           = 0;
-int start_at_zero     = 0;
-int copy_tb           = -1;
-int debug_ts          = 0;
-int exit_on_error     = 0;
-int abort_on_flags    = 0;
-int print_stats       = -1;
-int qp_hist           = 0;
-int stdin_interaction = 1;
-int frame_bits_per_raw_sample = 0;
-float max_error_rate  = 2.0/3;
-
-
-static int intra_only         = 0;
-static int file_overwrite     = 0;
-static int no_file_overwrite  = 0;
-static int do_psnr            = 0;
-static int input_sync;
-static int override_ffserver  = 0;
-static int input_stream_potentially_available = 0;
-static int ignore_unknown_streams = 0;
-static int copy_unknown_streams = 0;
+
+void init_job_options(FFTranscodeJob *job)
+{
+    job->audio_drift_threshold = 0.1;
+    job->dts_delta_threshold   = 10;
+    job->dts_error_threshold   = 3600*30;
+
+    job->audio_volume      = 256;
+    job->audio_sync_method = 0;
+    job->video_sync_method = VSYNC_AUTO;
+    job->copy_tb           = -1;
+    job->print_stats       = -1;
+    job->stdin_interaction = 1;
+    job->max_error_rate    = 2.0/3;
+
+    job->log_level         = AV_LOG_INFO;
+    job->report_file_level = AV_LOG_DEBUG;
+}
 
 static void uninit_options(OptionsContext *o)
 {
@@ -222,7 +199,7 @@ static int opt_abort_on(void *optctx, const char *opt, const char *arg)
     };
     const AVClass *pclass = &class;
 
-    return av_opt_eval_flags(&pclass, &opts[0], arg, &abort_on_flags);
+    return av_opt_eval_flags(&pclass, &opts[0], arg, &cur_job->abort_on_flags);
 }
 
 static int opt_sameq(void *optctx, const char *opt, const char *arg)
@@ -295,20 +272,20 @@ static int opt_map(void *optctx, const char *opt, const char *arg)
     if (sync = strchr(map, ',')) {
         *sync = 0;
         sync_file_idx = strtol(sync + 1, &sync, 0);
-        if (sync_file_idx >= nb_input_files || sync_file_idx < 0) {
+        if (sync_file_idx >= cur_job->nb_input_files || sync_file_idx < 0) {
             if (loglevel > 0) 
             	LOGI("Invalid sync file index: %d.\n", sync_file_idx);
             exit_program(3001);
         }
         if (*sync)
             sync++;
-        for (i = 0; i < input_files[sync_file_idx]->nb_streams; i++)
-            if (check_stream_specifier(input_files[sync_file_idx]->ctx,
-                                       input_files[sync_file_idx]->ctx->streams[i], sync) == 1) {
+        for (i = 0; i < cur_job->input_files[sync_file_idx]->nb_streams; i++)
+            if (check_stream_specifier(cur_job->input_files[sync_file_idx]->ctx,
+                                       cur_job->input_files[sync_file_idx]->ctx->streams[i], sync) == 1) {
                 sync_stream_idx = i;
                 break;
             }
-        if (i == input_files[sync_file_idx]->nb_streams) {
+        if (i == cur_job->input_files[sync_file_idx]->nb_streams) {
             if (loglevel > 0) 
             	LOGI("Sync stream specification in map %s does not "
                                        "match any streams.\n", arg);
@@ -332,7 +309,7 @@ static int opt_map(void *optctx, const char *opt, const char *arg)
         if (allow_unused = strchr(map, '?'))
             *allow_unused = 0;
         file_idx = strtol(map, &p, 0);
-        if (file_idx >= nb_input_files || file_idx < 0) {
+        if (file_idx >= cur_job->nb_input_files || file_idx < 0) {
             if (loglevel > 0) 
             	LOGI("Invalid input file index: %d.\n", file_idx);
             exit_program(3004);
@@ -342,14 +319,14 @@ static int opt_map(void *optctx, const char *opt, const char *arg)
             for (i = 0; i < o->nb_stream_maps; i++) {
                 m = &o->stream_maps[i];
                 if (file_idx == m->file_index &&
-                    check_stream_specifier(input_files[m->file_index]->ctx,
-                                           input_files[m->file_index]->ctx->streams[m->stream_index],
+                    check_stream_specifier(cur_job->input_files[m->file_index]->ctx,
+                                           cur_job->input_files[m->file_index]->ctx->streams[m->stream_index],
                                            *p == ':' ? p + 1 : p) > 0)
                     m->disabled = 1;
             }
         else
-            for (i = 0; i < input_files[file_idx]->nb_streams; i++) {
-                if (check_stream_specifier(input_files[file_idx]->ctx, input_files[file_idx]->ctx->streams[i],
+            for (i = 0; i < cur_job->input_files[file_idx]->nb_streams; i++) {
+                if (check_stream_specifier(cur_job->input_files[file_idx]->ctx, cur_job->input_files[file_idx]->ctx->streams[i],
                             *p == ':' ? p + 1 : p) <= 0)
                     continue;
                 GROW_ARRAY(o->stream_maps, o->nb_stream_maps);
@@ -427,20 +404,20 @@ static int opt_map_channel(void *optctx, const char *opt, const char *arg)
         m->ofile_idx = m->ostream_idx = -1;
 
     /* check input */
-    if (m->file_idx < 0 || m->file_idx >= nb_input_files) {
+    if (m->file_idx < 0 || m->file_idx >= cur_job->nb_input_files) {
         if (loglevel > 0) 
         	LOGI("mapchan: invalid input file index: %d\n",
                m->file_idx);
         exit_program(3007);
     }
     if (m->stream_idx < 0 ||
-        m->stream_idx >= input_files[m->file_idx]->nb_streams) {
+        m->stream_idx >= cur_job->input_files[m->file_idx]->nb_streams) {
         if (loglevel > 0) 
         	LOGI("mapchan: invalid input file stream index #%d.%d\n",
                m->file_idx, m->stream_idx);
         exit_program(3008);
     }
-    st = input_files[m->file_idx]->ctx->streams[m->stream_idx];
+    st = cur_job->input_files[m->file_idx]->ctx->streams[m->stream_idx];
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
         if (loglevel > 0) 
         	LOGI("mapchan: stream #%d.%d is not an audio stream.\n",
@@ -458,8 +435,8 @@ static int opt_map_channel(void *optctx, const char *opt, const char *arg)
 
 static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
 {
-    av_free(sdp_filename);
-    sdp_filename = av_strdup(arg);
+    av_free(cur_job->sdp_filename);
+    cur_job->sdp_filename = av_strdup(arg);
     return 0;
 }
 
@@ -684,11 +661,11 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
         if (!ist)
             exit_program(3020);
 
-        GROW_ARRAY(input_streams, nb_input_streams);
-        input_streams[nb_input_streams - 1] = ist;
+        GROW_ARRAY(cur_job->input_streams, cur_job->nb_input_streams);
+        cur_job->input_streams[cur_job->nb_input_streams - 1] = ist;
 
         ist->st = st;
-        ist->file_index = nb_input_files;
+        ist->file_index = cur_job->nb_input_files;
         ist->discard = 1;
         st->discard  = AVDISCARD_ALL;
         ist->nb_samples = 0;
@@ -872,15 +849,15 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
 
 static void assert_file_overwrite(const char *filename)
 {
-    if (file_overwrite && no_file_overwrite) {
+    if (cur_job->file_overwrite && cur_job->no_file_overwrite) {
         fprintf(stderr, "Error, both -y and -n supplied. Exiting.\n");
         exit_program(3030);
     }
 
-    if (!file_overwrite) {
+    if (!cur_job->file_overwrite) {
         const char *proto_name = avio_find_protocol_name(filename);
         if (proto_name && !strcmp(proto_name, "file") && avio_check(filename, 0) == 0) {
-            if (stdin_interaction && !no_file_overwrite) {
+            if (cur_job->stdin_interaction && !cur_job->no_file_overwrite) {
                 fprintf(stderr,"File '%s' already exists. Overwrite ? [y/N] ", filename);
                 fflush(stderr);
                 term_exit();
@@ -910,7 +887,7 @@ static void dump_attachment(AVStream *st, const char *filename)
     if (!st->codecpar->extradata_size) {
         if (loglevel == 2) 
         	LOGI("No extradata to dump in stream #%d:%d.\n",
-               nb_input_files - 1, st->index);
+               cur_job->nb_input_files - 1, st->index);
         return;
     }
     if (!*filename && (e = av_dict_get(st->metadata, "filename", NULL, 0)))
@@ -918,13 +895,13 @@ static void dump_attachment(AVStream *st, const char *filename)
     if (!*filename) {
         if (loglevel > 0) 
         	LOGI("No filename specified and no 'filename' tag"
-               "in stream #%d:%d.\n", nb_input_files - 1, st->index);
+               "in stream #%d:%d.\n", cur_job->nb_input_files - 1, st->index);
         exit_program(3033);
     }
 
     assert_file_overwrite(filename);
 
-    if ((ret = avio_open2(&out, filename, AVIO_FLAG_WRITE, &int_cb, NULL)) < 0) {
+    if ((ret = avio_open2(&out, filename, AVIO_FLAG_WRITE, &cur_job->int_cb, NULL)) < 0) {
         if (loglevel > 0) 
         	LOGI("Could not open file %s for writing.\n",
                filename);
@@ -964,7 +941,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
     if (!strcmp(filename, "-"))
         filename = "pipe:";
 
-    stdin_interaction &= strncmp(filename, "pipe:", 5) &&
+    cur_job->stdin_interaction &= strncmp(filename, "pipe:", 5) &&
                          strcmp(filename, "/dev/stdin");
 
     /* get default parameters from command line */
@@ -1027,7 +1004,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
         av_format_set_data_codec(ic, find_codec_or_die(data_codec_name, AVMEDIA_TYPE_DATA, 0));
 
     ic->flags |= AVFMT_FLAG_NONBLOCK;
-    ic->interrupt_callback = int_cb;
+    ic->interrupt_callback = cur_job->int_cb;
 
     if (!av_dict_get(o->g->format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
         av_dict_set(&o->g->format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
@@ -1107,20 +1084,20 @@ static int open_input_file(OptionsContext *o, const char *filename)
     add_input_streams(o, ic);
 
     /* dump the file content */
-    av_dump_format(ic, nb_input_files, filename, 0);
+    av_dump_format(ic, cur_job->nb_input_files, filename, 0);
 
-    GROW_ARRAY(input_files, nb_input_files);
+    GROW_ARRAY(cur_job->input_files, cur_job->nb_input_files);
     f = av_mallocz(sizeof(*f));
     if (!f)
         exit_program(3039);
-    input_files[nb_input_files - 1] = f;
+    cur_job->input_files[cur_job->nb_input_files - 1] = f;
 
     f->ctx        = ic;
-    f->ist_index  = nb_input_streams - ic->nb_streams;
+    f->ist_index  = cur_job->nb_input_streams - ic->nb_streams;
     f->start_time = o->start_time;
     f->recording_time = o->recording_time;
     f->input_ts_offset = o->input_ts_offset;
-    f->ts_offset  = o->input_ts_offset - (copy_ts ? (start_at_zero && ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) : timestamp);
+    f->ts_offset  = o->input_ts_offset - (cur_job->copy_ts ? (cur_job->start_at_zero && ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) : timestamp);
     f->nb_streams = ic->nb_streams;
     f->rate_emu   = o->rate_emu;
     f->accurate_seek = o->accurate_seek;
@@ -1133,9 +1110,9 @@ static int open_input_file(OptionsContext *o, const char *filename)
 
     /* check if all codec options have been used */
     unused_opts = strip_specifiers(o->g->codec_opts);
-    for (i = f->ist_index; i < nb_input_streams; i++) {
+    for (i = f->ist_index; i < cur_job->nb_input_streams; i++) {
         e = NULL;
-        while ((e = av_dict_get(input_streams[i]->decoder_opts, "", e,
+        while ((e = av_dict_get(cur_job->input_streams[i]->decoder_opts, "", e,
                                 AV_DICT_IGNORE_SUFFIX)))
             av_dict_set(&unused_opts, e->key, NULL, 0);
     }
@@ -1156,7 +1133,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
             if (loglevel > 0) 
             	LOGI("Codec AVOption %s (%s) specified for "
                    "input file #%d (%s) is not a decoding option.\n", e->key,
-                   option->help ? option->help : "", nb_input_files - 1,
+                   option->help ? option->help : "", cur_job->nb_input_files - 1,
                    filename);
             exit_program(3040);
         }
@@ -1167,7 +1144,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
                "likely reason is either wrong type (e.g. a video option with "
                "no video streams) or that it is a private option of some decoder "
                "which was not actually used for any stream.\n", e->key,
-               option->help ? option->help : "", nb_input_files - 1, filename);
+               option->help ? option->help : "", cur_job->nb_input_files - 1, filename);
     }
     av_dict_free(&unused_opts);
 
@@ -1186,7 +1163,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
         av_dict_free(&opts[i]);
     av_freep(&opts);
 
-    input_stream_potentially_available = 1;
+    cur_job->input_stream_potentially_available = 1;
 
     return 0;
 }
@@ -1226,12 +1203,12 @@ static int get_preset_file_2(const char *preset_name, const char *codec_name, AV
         if (codec_name) {
             snprintf(filename, sizeof(filename), "%s%s/%s-%s.avpreset", base[i],
                      i != 1 ? "" : "/.avconv", codec_name, preset_name);
-            ret = avio_open2(s, filename, AVIO_FLAG_READ, &int_cb, NULL);
+            ret = avio_open2(s, filename, AVIO_FLAG_READ, &cur_job->int_cb, NULL);
         }
         if (ret < 0) {
             snprintf(filename, sizeof(filename), "%s%s/%s.avpreset", base[i],
                      i != 1 ? "" : "/.avconv", preset_name);
-            ret = avio_open2(s, filename, AVIO_FLAG_READ, &int_cb, NULL);
+            ret = avio_open2(s, filename, AVIO_FLAG_READ, &cur_job->int_cb, NULL);
         }
     }
     return ret;
@@ -1292,12 +1269,12 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
     if (oc->nb_streams - 1 < o->nb_streamid_map)
         st->id = o->streamid_map[oc->nb_streams - 1];
 
-    GROW_ARRAY(output_streams, nb_output_streams);
+    GROW_ARRAY(cur_job->output_streams, cur_job->nb_output_streams);
     if (!(ost = av_mallocz(sizeof(*ost))))
         exit_program(3043);
-    output_streams[nb_output_streams - 1] = ost;
+    cur_job->output_streams[cur_job->nb_output_streams - 1] = ost;
 
-    ost->file_index = nb_output_files - 1;
+    ost->file_index = cur_job->nb_output_files - 1;
     ost->index      = idx;
     ost->st         = st;
     st->codecpar->codec_type = type;
@@ -1471,9 +1448,9 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
 
     ost->source_index = source_index;
     if (source_index >= 0) {
-        ost->sync_ist = input_streams[source_index];
-        input_streams[source_index]->discard = 0;
-        input_streams[source_index]->st->discard = input_streams[source_index]->user_set_discard;
+        ost->sync_ist = cur_job->input_streams[source_index];
+        cur_job->input_streams[source_index]->discard = 0;
+        cur_job->input_streams[source_index]->st->discard = cur_job->input_streams[source_index]->user_set_discard;
     }
     ost->last_mux_dts = AV_NOPTS_VALUE;
 
@@ -1540,7 +1517,7 @@ static char *get_ost_filters(OptionsContext *o, AVFormatContext *oc,
     if (ost->filters_script && ost->filters) {
         if (loglevel > 0) 
         	LOGI("Both -filter and -filter_script set for "
-               "output stream #%d:%d.\n", nb_output_files, st->index);
+               "output stream #%d:%d.\n", cur_job->nb_output_files, st->index);
         exit_program(3058);
     }
 
@@ -1584,7 +1561,7 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
         	LOGI("Invalid framerate value: %s\n", frame_rate);
         exit_program(3060);
     }
-    if (frame_rate && video_sync_method == VSYNC_PASSTHROUGH)
+    if (frame_rate && cur_job->video_sync_method == VSYNC_PASSTHROUGH)
         if (loglevel > 0) 
         	LOGI("Using -vsync 0 and -r can produce invalid output files\n");
 
@@ -1619,7 +1596,7 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
             exit_program(3062);
         }
 
-        video_enc->bits_per_raw_sample = frame_bits_per_raw_sample;
+        video_enc->bits_per_raw_sample = cur_job->frame_bits_per_raw_sample;
         MATCH_PER_STREAM_OPT(frame_pix_fmts, str, frame_pix_fmt, oc, st);
         if (frame_pix_fmt && *frame_pix_fmt == '+') {
             ost->keep_pix_fmt = 1;
@@ -1633,7 +1610,7 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
         }
         st->sample_aspect_ratio = video_enc->sample_aspect_ratio;
 
-        if (intra_only)
+        if (cur_job->intra_only)
             video_enc->gop_size = 0;
         MATCH_PER_STREAM_OPT(intra_matrices, str, intra_matrix, oc, st);
         if (intra_matrix) {
@@ -1697,7 +1674,7 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
         }
         video_enc->rc_override_count = i;
 
-        if (do_psnr)
+        if (cur_job->do_psnr)
             video_enc->flags|= AV_CODEC_FLAG_PSNR;
 
         /* two pass mode */
@@ -1829,7 +1806,7 @@ static OutputStream *new_audio_stream(OptionsContext *o, AVFormatContext *oc, in
                            ost->file_index, ost->st->index);
                     continue;
                 } else {
-                    ist = input_streams[ost->source_index];
+                    ist = cur_job->input_streams[ost->source_index];
                 }
 
                 if (!ist || (ist->file_index == map->file_idx && ist->st->index == map->stream_idx)) {
@@ -1986,7 +1963,7 @@ static int read_ffserver_streams(OptionsContext *o, AVFormatContext *s, const ch
     int i, err;
     AVFormatContext *ic = avformat_alloc_context();
 
-    ic->interrupt_callback = int_cb;
+    ic->interrupt_callback = cur_job->int_cb;
     err = avformat_open_input(&ic, filename, NULL, NULL);
     if (err < 0)
         return err;
@@ -2079,8 +2056,8 @@ static int init_complex_filters(void)
 {
     int i, ret = 0;
 
-    for (i = 0; i < nb_filtergraphs; i++) {
-        ret = init_complex_filtergraph(filtergraphs[i]);
+    for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+        ret = init_complex_filtergraph(cur_job->filtergraphs[i]);
         if (ret < 0)
             return ret;
     }
@@ -2091,9 +2068,9 @@ static int configure_complex_filters(void)
 {
     int i, ret = 0;
 
-    for (i = 0; i < nb_filtergraphs; i++)
-        if (!filtergraph_is_simple(filtergraphs[i]) &&
-            (ret = configure_filtergraph(filtergraphs[i])) < 0)
+    for (i = 0; i < cur_job->nb_filtergraphs; i++)
+        if (!filtergraph_is_simple(cur_job->filtergraphs[i]) &&
+            (ret = configure_filtergraph(cur_job->filtergraphs[i])) < 0)
             return ret;
     return 0;
 }
@@ -2127,13 +2104,13 @@ static int open_output_file(OptionsContext *o, const char *filename)
         }
     }
 
-    GROW_ARRAY(output_files, nb_output_files);
+    GROW_ARRAY(cur_job->output_files, cur_job->nb_output_files);
     of = av_mallocz(sizeof(*of));
     if (!of)
         exit_program(3084);
-    output_files[nb_output_files - 1] = of;
+    cur_job->output_files[cur_job->nb_output_files - 1] = of;
 
-    of->ost_index      = nb_output_streams;
+    of->ost_index      = cur_job->nb_output_streams;
     of->recording_time = o->recording_time;
     of->start_time     = o->start_time;
     of->limit_filesize = o->limit_filesize;
@@ -2155,11 +2132,11 @@ static int open_output_file(OptionsContext *o, const char *filename)
         oc->duration = o->recording_time;
 
     file_oformat= oc->oformat;
-    oc->interrupt_callback = int_cb;
+    oc->interrupt_callback = cur_job->int_cb;
 
     /* create streams for all unlabeled output pads */
-    for (i = 0; i < nb_filtergraphs; i++) {
-        FilterGraph *fg = filtergraphs[i];
+    for (i = 0; i < cur_job->nb_filtergraphs; i++) {
+        FilterGraph *fg = cur_job->filtergraphs[i];
         for (j = 0; j < fg->nb_outputs; j++) {
             OutputFilter *ofilter = fg->outputs[j];
 
@@ -2186,7 +2163,7 @@ static int open_output_file(OptionsContext *o, const char *filename)
         }
     }
 
-    if (!strcmp(file_oformat->name, "ffm") && !override_ffserver &&
+    if (!strcmp(file_oformat->name, "ffm") && !cur_job->override_ffserver &&
         av_strstart(filename, "http:", NULL)) {
         int j;
         /* special case for files sent to ffserver: we get the stream
@@ -2197,10 +2174,10 @@ static int open_output_file(OptionsContext *o, const char *filename)
             	            LOGI(filename, err);
             exit_program(3087);
         }
-        for(j = nb_output_streams - oc->nb_streams; j < nb_output_streams; j++) {
-            ost = output_streams[j];
-            for (i = 0; i < nb_input_streams; i++) {
-                ist = input_streams[i];
+        for(j = cur_job->nb_output_streams - oc->nb_streams; j < cur_job->nb_output_streams; j++) {
+            ost = cur_job->output_streams[j];
+            for (i = 0; i < cur_job->nb_input_streams; i++) {
+                ist = cur_job->input_streams[i];
                 if(ist->st->codecpar->codec_type == ost->st->codecpar->codec_type){
                     ost->sync_ist= ist;
                     ost->source_index= i;
@@ -2225,9 +2202,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
         if (!o->video_disable && av_guess_codec(oc->oformat, NULL, filename, NULL, AVMEDIA_TYPE_VIDEO) != AV_CODEC_ID_NONE) {
             int area = 0, idx = -1;
             int qcr = avformat_query_codec(oc->oformat, oc->oformat->video_codec, 0);
-            for (i = 0; i < nb_input_streams; i++) {
+            for (i = 0; i < cur_job->nb_input_streams; i++) {
                 int new_area;
-                ist = input_streams[i];
+                ist = cur_job->input_streams[i];
                 new_area = ist->st->codecpar->width * ist->st->codecpar->height + 100000000*!!ist->st->codec_info_nb_frames;
                 if((qcr!=MKTAG('A', 'P', 'I', 'C')) && (ist->st->disposition & AV_DISPOSITION_ATTACHED_PIC))
                     new_area = 1;
@@ -2246,9 +2223,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
         /* audio: most channels */
         if (!o->audio_disable && av_guess_codec(oc->oformat, NULL, filename, NULL, AVMEDIA_TYPE_AUDIO) != AV_CODEC_ID_NONE) {
             int best_score = 0, idx = -1;
-            for (i = 0; i < nb_input_streams; i++) {
+            for (i = 0; i < cur_job->nb_input_streams; i++) {
                 int score;
-                ist = input_streams[i];
+                ist = cur_job->input_streams[i];
                 score = ist->st->codecpar->channels + 100000000*!!ist->st->codec_info_nb_frames;
                 if (ist->st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
                     score > best_score) {
@@ -2263,10 +2240,10 @@ static int open_output_file(OptionsContext *o, const char *filename)
         /* subtitles: pick first */
         MATCH_PER_TYPE_OPT(codec_names, str, subtitle_codec_name, oc, "s");
         if (!o->subtitle_disable && (avcodec_find_encoder(oc->oformat->subtitle_codec) || subtitle_codec_name)) {
-            for (i = 0; i < nb_input_streams; i++)
-                if (input_streams[i]->st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
+            for (i = 0; i < cur_job->nb_input_streams; i++)
+                if (cur_job->input_streams[i]->st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
                     AVCodecDescriptor const *input_descriptor =
-                        avcodec_descriptor_get(input_streams[i]->st->codecpar->codec_id);
+                        avcodec_descriptor_get(cur_job->input_streams[i]->st->codecpar->codec_id);
                     AVCodecDescriptor const *output_descriptor = NULL;
                     AVCodec const *output_codec =
                         avcodec_find_encoder(oc->oformat->subtitle_codec);
@@ -2291,9 +2268,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
         /* Data only if codec id match */
         if (!o->data_disable ) {
             enum AVCodecID codec_id = av_guess_codec(oc->oformat, NULL, filename, NULL, AVMEDIA_TYPE_DATA);
-            for (i = 0; codec_id != AV_CODEC_ID_NONE && i < nb_input_streams; i++) {
-                if (input_streams[i]->st->codecpar->codec_type == AVMEDIA_TYPE_DATA
-                    && input_streams[i]->st->codecpar->codec_id == codec_id )
+            for (i = 0; codec_id != AV_CODEC_ID_NONE && i < cur_job->nb_input_streams; i++) {
+                if (cur_job->input_streams[i]->st->codecpar->codec_type == AVMEDIA_TYPE_DATA
+                    && cur_job->input_streams[i]->st->codecpar->codec_id == codec_id )
                     new_data_stream(o, oc, i);
             }
         }
@@ -2309,8 +2286,8 @@ static int open_output_file(OptionsContext *o, const char *filename)
                 OutputFilter *ofilter = NULL;
                 int j, k;
 
-                for (j = 0; j < nb_filtergraphs; j++) {
-                    fg = filtergraphs[j];
+                for (j = 0; j < cur_job->nb_filtergraphs; j++) {
+                    fg = cur_job->filtergraphs[j];
                     for (k = 0; k < fg->nb_outputs; k++) {
                         AVFilterInOut *out = fg->outputs[k]->out_tmp;
                         if (out && !strcmp(out->name, map->linklabel)) {
@@ -2328,9 +2305,9 @@ loop_end:
                 }
                 init_output_filter(ofilter, o, oc);
             } else {
-                int src_idx = input_files[map->file_index]->ist_index + map->stream_index;
+                int src_idx = cur_job->input_files[map->file_index]->ist_index + map->stream_index;
 
-                ist = input_streams[input_files[map->file_index]->ist_index + map->stream_index];
+                ist = cur_job->input_streams[cur_job->input_files[map->file_index]->ist_index + map->stream_index];
                 if(o->subtitle_disable && ist->st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE)
                     continue;
                 if(o->   audio_disable && ist->st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
@@ -2348,7 +2325,7 @@ loop_end:
                 case AVMEDIA_TYPE_DATA:       ost = new_data_stream      (o, oc, src_idx); break;
                 case AVMEDIA_TYPE_ATTACHMENT: ost = new_attachment_stream(o, oc, src_idx); break;
                 case AVMEDIA_TYPE_UNKNOWN:
-                    if (copy_unknown_streams) {
+                    if (cur_job->copy_unknown_streams) {
                         ost = new_unknown_stream   (o, oc, src_idx);
                         break;
                     }
@@ -2356,7 +2333,7 @@ loop_end:
                     if (loglevel > 0) 
                     	LOGI(                           "Cannot map stream #%d:%d - unsupported type.\n",
                            map->file_index, map->stream_index);
-                    if (!ignore_unknown_streams) {
+                    if (!cur_job->ignore_unknown_streams) {
                         if (loglevel > 0) 
                         	LOGI(                               "If you want unsupported types ignored instead "
                                "of failing, please use the -ignore_unknown option\n"
@@ -2365,7 +2342,7 @@ loop_end:
                     }
                 }
                 if (ost)
-                    ost->sync_ist = input_streams[  input_files[map->sync_file_index]->ist_index
+                    ost->sync_ist = cur_job->input_streams[  cur_job->input_files[map->sync_file_index]->ist_index
                                                   + map->sync_stream_index];
             }
         }
@@ -2378,7 +2355,7 @@ loop_end:
         const char *p;
         int64_t len;
 
-        if ((err = avio_open2(&pb, o->attachments[i], AVIO_FLAG_READ, &int_cb, NULL)) < 0) {
+        if ((err = avio_open2(&pb, o->attachments[i], AVIO_FLAG_READ, &cur_job->int_cb, NULL)) < 0) {
             if (loglevel > 0) 
             	LOGI("Could not open attachment file %s.\n",
                    o->attachments[i]);
@@ -2410,9 +2387,9 @@ loop_end:
     }
 
 #if FF_API_LAVF_AVCTX
-    for (i = nb_output_streams - oc->nb_streams; i < nb_output_streams; i++) { //for all streams of this output file
+    for (i = cur_job->nb_output_streams - oc->nb_streams; i < cur_job->nb_output_streams; i++) { //for all streams of this output file
         AVDictionaryEntry *e;
-        ost = output_streams[i];
+        ost = cur_job->output_streams[i];
 
         if ((ost->stream_copy || ost->attachment_filename)
             && (e = av_dict_get(o->g->codec_opts, "flags", NULL, AV_DICT_IGNORE_SUFFIX))
@@ -2423,17 +2400,17 @@ loop_end:
 #endif
 
     if (!oc->nb_streams && !(oc->oformat->flags & AVFMT_NOSTREAMS)) {
-        av_dump_format(oc, nb_output_files - 1, oc->filename, 1);
+        av_dump_format(oc, cur_job->nb_output_files - 1, oc->filename, 1);
         if (loglevel > 0) 
-        	LOGI("Output file #%d does not contain any stream\n", nb_output_files - 1);
+        	LOGI("Output file #%d does not contain any stream\n", cur_job->nb_output_files - 1);
         exit_program(3095);
     }
 
     /* check if all codec options have been used */
     unused_opts = strip_specifiers(o->g->codec_opts);
-    for (i = of->ost_index; i < nb_output_streams; i++) {
+    for (i = of->ost_index; i < cur_job->nb_output_streams; i++) {
         e = NULL;
-        while ((e = av_dict_get(output_streams[i]->encoder_opts, "", e,
+        while ((e = av_dict_get(cur_job->output_streams[i]->encoder_opts, "", e,
                                 AV_DICT_IGNORE_SUFFIX)))
             av_dict_set(&unused_opts, e->key, NULL, 0);
     }
@@ -2454,7 +2431,7 @@ loop_end:
             if (loglevel > 0) 
             	LOGI("Codec AVOption %s (%s) specified for "
                    "output file #%d (%s) is not an encoding option.\n", e->key,
-                   option->help ? option->help : "", nb_output_files - 1,
+                   option->help ? option->help : "", cur_job->nb_output_files - 1,
                    filename);
             exit_program(3096);
         }
@@ -2469,16 +2446,16 @@ loop_end:
                "likely reason is either wrong type (e.g. a video option with "
                "no video streams) or that it is a private option of some encoder "
                "which was not actually used for any stream.\n", e->key,
-               option->help ? option->help : "", nb_output_files - 1, filename);
+               option->help ? option->help : "", cur_job->nb_output_files - 1, filename);
     }
     av_dict_free(&unused_opts);
 
     /* set the decoding_needed flags and create simple filtergraphs */
-    for (i = of->ost_index; i < nb_output_streams; i++) {
-        OutputStream *ost = output_streams[i];
+    for (i = of->ost_index; i < cur_job->nb_output_streams; i++) {
+        OutputStream *ost = cur_job->output_streams[i];
 
         if (ost->encoding_needed && ost->source_index >= 0) {
-            InputStream *ist = input_streams[ost->source_index];
+            InputStream *ist = cur_job->input_streams[ost->source_index];
             ist->decoding_needed |= DECODING_FOR_OST;
 
             if (ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
@@ -2488,7 +2465,7 @@ loop_end:
                     if (loglevel > 0) 
                     	LOGI(                           "Error initializing a simple filtergraph between streams "
                            "%d:%d->%d:%d\n", ist->file_index, ost->source_index,
-                           nb_output_files - 1, ost->st->index);
+                           cur_job->nb_output_files - 1, ost->st->index);
                     exit_program(3097);
                 }
             }
@@ -2504,7 +2481,7 @@ loop_end:
         }
     }
 
-    if (!(oc->oformat->flags & AVFMT_NOSTREAMS) && !input_stream_potentially_available) {
+    if (!(oc->oformat->flags & AVFMT_NOSTREAMS) && !cur_job->input_stream_potentially_available) {
         if (loglevel > 0) 
         	LOGI(               "No input streams but output needs an input stream\n");
         exit_program(3099);
@@ -2535,23 +2512,23 @@ loop_end:
         char *p;
         int in_file_index = strtol(o->metadata_map[i].u.str, &p, 0);
 
-        if (in_file_index >= nb_input_files) {
+        if (in_file_index >= cur_job->nb_input_files) {
             if (loglevel > 0) 
             	LOGI("Invalid input file index %d while processing metadata maps\n", in_file_index);
             exit_program(3101);
         }
         copy_metadata(o->metadata_map[i].specifier, *p ? p + 1 : p, oc,
                       in_file_index >= 0 ?
-                      input_files[in_file_index]->ctx : NULL, o);
+                      cur_job->input_files[in_file_index]->ctx : NULL, o);
     }
 
     /* copy chapters */
-    if (o->chapters_input_file >= nb_input_files) {
+    if (o->chapters_input_file >= cur_job->nb_input_files) {
         if (o->chapters_input_file == INT_MAX) {
             /* copy chapters from the first input file that has them*/
             o->chapters_input_file = -1;
-            for (i = 0; i < nb_input_files; i++)
-                if (input_files[i]->ctx->nb_chapters) {
+            for (i = 0; i < cur_job->nb_input_files; i++)
+                if (cur_job->input_files[i]->ctx->nb_chapters) {
                     o->chapters_input_file = i;
                     break;
                 }
@@ -2563,28 +2540,28 @@ loop_end:
         }
     }
     if (o->chapters_input_file >= 0)
-        copy_chapters(input_files[o->chapters_input_file], of,
+        copy_chapters(cur_job->input_files[o->chapters_input_file], of,
                       !o->metadata_chapters_manual);
 
     /* copy global metadata by default */
-    if (!o->metadata_global_manual && nb_input_files){
-        av_dict_copy(&oc->metadata, input_files[0]->ctx->metadata,
+    if (!o->metadata_global_manual && cur_job->nb_input_files){
+        av_dict_copy(&oc->metadata, cur_job->input_files[0]->ctx->metadata,
                      AV_DICT_DONT_OVERWRITE);
         if(o->recording_time != INT64_MAX)
             av_dict_set(&oc->metadata, "duration", NULL, 0);
         av_dict_set(&oc->metadata, "creation_time", NULL, 0);
     }
     if (!o->metadata_streams_manual)
-        for (i = of->ost_index; i < nb_output_streams; i++) {
+        for (i = of->ost_index; i < cur_job->nb_output_streams; i++) {
             InputStream *ist;
-            if (output_streams[i]->source_index < 0)         /* this is true e.g. for attached files */
+            if (cur_job->output_streams[i]->source_index < 0)         /* this is true e.g. for attached files */
                 continue;
-            ist = input_streams[output_streams[i]->source_index];
-            av_dict_copy(&output_streams[i]->st->metadata, ist->st->metadata, AV_DICT_DONT_OVERWRITE);
-            if (!output_streams[i]->stream_copy) {
-                av_dict_set(&output_streams[i]->st->metadata, "encoder", NULL, 0);
+            ist = cur_job->input_streams[cur_job->output_streams[i]->source_index];
+            av_dict_copy(&cur_job->output_streams[i]->st->metadata, ist->st->metadata, AV_DICT_DONT_OVERWRITE);
+            if (!cur_job->output_streams[i]->stream_copy) {
+                av_dict_set(&cur_job->output_streams[i]->st->metadata, "encoder", NULL, 0);
                 if (ist->autorotate)
-                    av_dict_set(&output_streams[i]->st->metadata, "rotate", NULL, 0);
+                    av_dict_set(&cur_job->output_streams[i]->st->metadata, "rotate", NULL, 0);
             }
         }
 
@@ -2674,7 +2651,7 @@ loop_end:
         parse_meta_type(o->metadata[i].specifier, &type, &index, &stream_spec);
         if (type == 's') {
             for (j = 0; j < oc->nb_streams; j++) {
-                ost = output_streams[nb_output_streams - oc->nb_streams + j];
+                ost = cur_job->output_streams[cur_job->nb_output_streams - oc->nb_streams + j];
                 if ((ret = check_stream_specifier(oc, oc->streams[j], stream_spec)) > 0) {
                     av_dict_set(&oc->streams[j]->metadata, o->metadata[i].u.str, *val ? val : NULL, 0);
                     if (!strcmp(o->metadata[i].u.str, "rotate")) {
@@ -2734,11 +2711,11 @@ static int opt_target(void *optctx, const char *opt, const char *arg)
         arg += 5;
     } else {
         /* Try to determine PAL/NTSC by peeking in the input files */
-        if (nb_input_files) {
+        if (cur_job->nb_input_files) {
             int i, j, fr;
-            for (j = 0; j < nb_input_files; j++) {
-                for (i = 0; i < input_files[j]->nb_streams; i++) {
-                    AVStream *st = input_files[j]->ctx->streams[i];
+            for (j = 0; j < cur_job->nb_input_files; j++) {
+                for (i = 0; i < cur_job->input_files[j]->nb_streams; i++) {
+                    AVStream *st = cur_job->input_files[j]->ctx->streams[i];
                     if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
                         continue;
                     fr = st->time_base.den * 1000 / st->time_base.num;
@@ -2858,16 +2835,16 @@ static int opt_target(void *optctx, const char *opt, const char *arg)
         return AVERROR(EINVAL);
     }
 
-    av_dict_copy(&o->g->codec_opts,  codec_opts, AV_DICT_DONT_OVERWRITE);
-    av_dict_copy(&o->g->format_opts, format_opts, AV_DICT_DONT_OVERWRITE);
+    av_dict_copy(&o->g->codec_opts,  cur_job->codec_opts, AV_DICT_DONT_OVERWRITE);
+    av_dict_copy(&o->g->format_opts, cur_job->format_opts, AV_DICT_DONT_OVERWRITE);
 
     return 0;
 }
 
 static int opt_vstats_file(void *optctx, const char *opt, const char *arg)
 {
-    av_free (vstats_filename);
-    vstats_filename = av_strdup (arg);
+    av_free (cur_job->vstats_filename);
+    cur_job->vstats_filename = av_strdup (arg);
     return 0;
 }
 
@@ -2909,19 +2886,19 @@ static int opt_data_frames(void *optctx, const char *opt, const char *arg)
 static int opt_default_new(OptionsContext *o, const char *opt, const char *arg)
 {
     int ret;
-    AVDictionary *cbak = codec_opts;
-    AVDictionary *fbak = format_opts;
-    codec_opts = NULL;
-    format_opts = NULL;
+    AVDictionary *cbak = cur_job->codec_opts;
+    AVDictionary *fbak = cur_job->format_opts;
+    cur_job->codec_opts = NULL;
+    cur_job->format_opts = NULL;
 
     ret = opt_default(NULL, opt, arg);
 
-    av_dict_copy(&o->g->codec_opts , codec_opts, 0);
-    av_dict_copy(&o->g->format_opts, format_opts, 0);
-    av_dict_free(&codec_opts);
-    av_dict_free(&format_opts);
-    codec_opts = cbak;
-    format_opts = fbak;
+    av_dict_copy(&o->g->codec_opts , cur_job->codec_opts, 0);
+    av_dict_copy(&o->g->format_opts, cur_job->format_opts, 0);
+    av_dict_free(&cur_job->codec_opts);
+    av_dict_free(&cur_job->format_opts);
+    cur_job->codec_opts = cbak;
+    cur_job->format_opts = fbak;
 
     return ret;
 }
@@ -3048,13 +3025,13 @@ static int opt_audio_filters(void *optctx, const char *opt, const char *arg)
 
 static int opt_vsync(void *optctx, const char *opt, const char *arg)
 {
-    if      (!av_strcasecmp(arg, "cfr"))         video_sync_method = VSYNC_CFR;
-    else if (!av_strcasecmp(arg, "vfr"))         video_sync_method = VSYNC_VFR;
-    else if (!av_strcasecmp(arg, "passthrough")) video_sync_method = VSYNC_PASSTHROUGH;
-    else if (!av_strcasecmp(arg, "drop"))        video_sync_method = VSYNC_DROP;
+    if      (!av_strcasecmp(arg, "cfr"))         cur_job->video_sync_method = VSYNC_CFR;
+    else if (!av_strcasecmp(arg, "vfr"))         cur_job->video_sync_method = VSYNC_VFR;
+    else if (!av_strcasecmp(arg, "passthrough")) cur_job->video_sync_method = VSYNC_PASSTHROUGH;
+    else if (!av_strcasecmp(arg, "drop"))        cur_job->video_sync_method = VSYNC_DROP;
 
-    if (video_sync_method == VSYNC_AUTO)
-        video_sync_method = parse_number_or_die("vsync", arg, OPT_INT, VSYNC_AUTO, VSYNC_VFR);
+    if (cur_job->video_sync_method == VSYNC_AUTO)
+        cur_job->video_sync_method = parse_number_or_die("vsync", arg, OPT_INT, VSYNC_AUTO, VSYNC_VFR);
     return 0;
 }
 
@@ -3114,15 +3091,15 @@ static int opt_audio_qscale(void *optctx, const char *opt, const char *arg)
 
 static int opt_filter_complex(void *optctx, const char *opt, const char *arg)
 {
-    GROW_ARRAY(filtergraphs, nb_filtergraphs);
-    if (!(filtergraphs[nb_filtergraphs - 1] = av_mallocz(sizeof(*filtergraphs[0]))))
+    GROW_ARRAY(cur_job->filtergraphs, cur_job->nb_filtergraphs);
+    if (!(cur_job->filtergraphs[cur_job->nb_filtergraphs - 1] = av_mallocz(sizeof(*cur_job->filtergraphs[0]))))
         return AVERROR(ENOMEM);
-    filtergraphs[nb_filtergraphs - 1]->index      = nb_filtergraphs - 1;
-    filtergraphs[nb_filtergraphs - 1]->graph_desc = av_strdup(arg);
-    if (!filtergraphs[nb_filtergraphs - 1]->graph_desc)
+    cur_job->filtergraphs[cur_job->nb_filtergraphs - 1]->index      = cur_job->nb_filtergraphs - 1;
+    cur_job->filtergraphs[cur_job->nb_filtergraphs - 1]->graph_desc = av_strdup(arg);
+    if (!cur_job->filtergraphs[cur_job->nb_filtergraphs - 1]->graph_desc)
         return AVERROR(ENOMEM);
 
-    input_stream_potentially_available = 1;
+    cur_job->input_stream_potentially_available = 1;
 
     return 0;
 }
@@ -3133,13 +3110,13 @@ static int opt_filter_complex_script(void *optctx, const char *opt, const char *
     if (!graph_desc)
         return AVERROR(EINVAL);
 
-    GROW_ARRAY(filtergraphs, nb_filtergraphs);
-    if (!(filtergraphs[nb_filtergraphs - 1] = av_mallocz(sizeof(*filtergraphs[0]))))
+    GROW_ARRAY(cur_job->filtergraphs, cur_job->nb_filtergraphs);
+    if (!(cur_job->filtergraphs[cur_job->nb_filtergraphs - 1] = av_mallocz(sizeof(*cur_job->filtergraphs[0]))))
         return AVERROR(ENOMEM);
-    filtergraphs[nb_filtergraphs - 1]->index      = nb_filtergraphs - 1;
-    filtergraphs[nb_filtergraphs - 1]->graph_desc = graph_desc;
+    cur_job->filtergraphs[cur_job->nb_filtergraphs - 1]->index      = cur_job->nb_filtergraphs - 1;
+    cur_job->filtergraphs[cur_job->nb_filtergraphs - 1]->graph_desc = graph_desc;
 
-    input_stream_potentially_available = 1;
+    cur_job->input_stream_potentially_available = 1;
 
     return 0;
 }
@@ -3348,31 +3325,32 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
 
     if (!strcmp(arg, "-"))
         arg = "pipe:";
-    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &cur_job->int_cb, NULL);
     if (ret < 0) {
         if (loglevel > 0) 
         	LOGI("Failed to open progress URL \"%s\": %s\n",
                arg, av_err2str(ret));
         return ret;
     }
-    progress_avio = avio;
+    cur_job->progress_avio = avio;
     return 0;
 }
 
 #define OFFSET(x) offsetof(OptionsContext, x)
+#define JOB_OFFSET(x) offsetof(FFTranscodeJob, x)
 const OptionDef options[] = {
     /* main options */
 #include "cmdutils_common_opts.h"
     { "f",              HAS_ARG | OPT_STRING | OPT_OFFSET |
                         OPT_INPUT | OPT_OUTPUT,                      { .off       = OFFSET(format) },
         "force format", "fmt" },
-    { "y",              OPT_BOOL,                                    {              &file_overwrite },
+    { "y",              OPT_BOOL | OPT_JOB,                          { .off = JOB_OFFSET(file_overwrite) },
         "overwrite output files" },
-    { "n",              OPT_BOOL,                                    {              &no_file_overwrite },
+    { "n",              OPT_BOOL | OPT_JOB,                          { .off = JOB_OFFSET(no_file_overwrite) },
         "never overwrite output files" },
-    { "ignore_unknown", OPT_BOOL,                                    {              &ignore_unknown_streams },
+    { "ignore_unknown", OPT_BOOL | OPT_JOB,                          { .off = JOB_OFFSET(ignore_unknown_streams) },
         "Ignore unknown stream types" },
-    { "copy_unknown",   OPT_BOOL | OPT_EXPERT,                       {              &copy_unknown_streams },
+    { "copy_unknown",   OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(copy_unknown_streams) },
         "Copy unknown stream types" },
     { "c",              HAS_ARG | OPT_STRING | OPT_SPEC |
                         OPT_INPUT | OPT_OUTPUT,                      { .off       = OFFSET(codec_names) },
@@ -3431,19 +3409,19 @@ const OptionDef options[] = {
     { "dframes",        HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_data_frames },
         "set the number of data frames to output", "number" },
-    { "benchmark",      OPT_BOOL | OPT_EXPERT,                       { &do_benchmark },
+    { "benchmark",      OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(do_benchmark) },
         "add timings for benchmarking" },
-    { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
+    { "benchmark_all",  OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(do_benchmark_all) },
       "add timings for each task" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
-    { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
+    { "stdin",          OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(stdin_interaction) },
       "enable or disable interaction on standard input" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
         "set max runtime in seconds", "limit" },
-    { "dump",           OPT_BOOL | OPT_EXPERT,                       { &do_pkt_dump },
+    { "dump",           OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(do_pkt_dump) },
         "dump each input packet" },
-    { "hex",            OPT_BOOL | OPT_EXPERT,                       { &do_hex_dump },
+    { "hex",            OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(do_hex_dump) },
         "when dumping packets, also dump the payload" },
     { "re",             OPT_BOOL | OPT_EXPERT | OPT_OFFSET |
                         OPT_INPUT,                                   { .off = OFFSET(rate_emu) },
@@ -3453,17 +3431,17 @@ const OptionDef options[] = {
         "with optional prefixes \"pal-\", \"ntsc-\" or \"film-\")", "type" },
     { "vsync",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_vsync },
         "video sync method", "" },
-    { "frame_drop_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,      { &frame_drop_threshold },
+    { "frame_drop_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT | OPT_JOB, { .off = JOB_OFFSET(frame_drop_threshold) },
         "frame drop threshold", "" },
-    { "async",          HAS_ARG | OPT_INT | OPT_EXPERT,              { &audio_sync_method },
+    { "async",          HAS_ARG | OPT_INT | OPT_EXPERT | OPT_JOB,    { .off = JOB_OFFSET(audio_sync_method) },
         "audio sync method", "" },
-    { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,          { &audio_drift_threshold },
+    { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT | OPT_JOB, { .off = JOB_OFFSET(audio_drift_threshold) },
         "audio drift threshold", "threshold" },
-    { "copyts",         OPT_BOOL | OPT_EXPERT,                       { &copy_ts },
+    { "copyts",         OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(copy_ts) },
         "copy timestamps" },
-    { "start_at_zero",  OPT_BOOL | OPT_EXPERT,                       { &start_at_zero },
+    { "start_at_zero",  OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(start_at_zero) },
         "shift input timestamps to start at 0 when using copyts" },
-    { "copytb",         HAS_ARG | OPT_INT | OPT_EXPERT,              { &copy_tb },
+    { "copytb",         HAS_ARG | OPT_INT | OPT_EXPERT | OPT_JOB,    { .off = JOB_OFFSET(copy_tb) },
         "copy input stream time base when stream copying", "mode" },
     { "shortest",       OPT_BOOL | OPT_EXPERT | OPT_OFFSET |
                         OPT_OUTPUT,                                  { .off = OFFSET(shortest) },
@@ -3471,11 +3449,11 @@ const OptionDef options[] = {
     { "apad",           OPT_STRING | HAS_ARG | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(apad) },
         "audio pad", "" },
-    { "dts_delta_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,       { &dts_delta_threshold },
+    { "dts_delta_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT | OPT_JOB, { .off = JOB_OFFSET(dts_delta_threshold) },
         "timestamp discontinuity delta threshold", "threshold" },
-    { "dts_error_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,       { &dts_error_threshold },
+    { "dts_error_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT | OPT_JOB, { .off = JOB_OFFSET(dts_error_threshold) },
         "timestamp error delta threshold", "threshold" },
-    { "xerror",         OPT_BOOL | OPT_EXPERT,                       { &exit_on_error },
+    { "xerror",         OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(exit_on_error) },
         "exit on error", "error" },
     { "abort_on",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_abort_on },
         "abort on the specified condition flags", "flags" },
@@ -3509,7 +3487,7 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
-    { "stats",          OPT_BOOL,                                    { &print_stats },
+    { "stats",          OPT_BOOL | OPT_JOB,                          { .off = JOB_OFFSET(print_stats) },
         "print progress report during encoding", },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_attach },
@@ -3519,9 +3497,9 @@ const OptionDef options[] = {
         "extract an attachment into a file", "filename" },
     { "stream_loop", OPT_INT | HAS_ARG | OPT_EXPERT | OPT_INPUT |
                         OPT_OFFSET,                                  { .off = OFFSET(loop) }, "set number of times input stream shall be looped", "loop count" },
-    { "debug_ts",       OPT_BOOL | OPT_EXPERT,                       { &debug_ts },
+    { "debug_ts",       OPT_BOOL | OPT_EXPERT | OPT_JOB,             { .off = JOB_OFFSET(debug_ts) },
         "print timestamp debugging info" },
-    { "max_error_rate",  HAS_ARG | OPT_FLOAT,                        { &max_error_rate },
+    { "max_error_rate",  HAS_ARG | OPT_FLOAT | OPT_JOB,              { .off = JOB_OFFSET(max_error_rate) },
         "maximum error rate", "ratio of errors (0.0: no errors, 1.0: 100% errors) above which ffmpeg returns an error instead of success." },
     { "discard",        OPT_STRING | HAS_ARG | OPT_SPEC |
                         OPT_INPUT,                                   { .off = OFFSET(discard) },
@@ -3548,9 +3526,9 @@ const OptionDef options[] = {
     { "pix_fmt",      OPT_VIDEO | HAS_ARG | OPT_EXPERT  | OPT_STRING | OPT_SPEC |
                       OPT_INPUT | OPT_OUTPUT,                                    { .off = OFFSET(frame_pix_fmts) },
         "set pixel format", "format" },
-    { "bits_per_raw_sample", OPT_VIDEO | OPT_INT | HAS_ARG,                      { &frame_bits_per_raw_sample },
+    { "bits_per_raw_sample", OPT_VIDEO | OPT_INT | HAS_ARG | OPT_JOB,            { .off = JOB_OFFSET(frame_bits_per_raw_sample) },
         "set the number of bits per raw sample", "number" },
-    { "intra",        OPT_VIDEO | OPT_BOOL | OPT_EXPERT,                         { &intra_only },
+    { "intra",        OPT_VIDEO | OPT_BOOL | OPT_EXPERT | OPT_JOB,               { .off = JOB_OFFSET(intra_only) },
         "deprecated use -g 1" },
     { "vn",           OPT_VIDEO | OPT_BOOL  | OPT_OFFSET | OPT_INPUT | OPT_OUTPUT,{ .off = OFFSET(video_disable) },
         "disable video" },
@@ -3571,9 +3549,9 @@ const OptionDef options[] = {
     { "passlogfile",  OPT_VIDEO | HAS_ARG | OPT_STRING | OPT_EXPERT | OPT_SPEC |
                       OPT_OUTPUT,                                                { .off = OFFSET(passlogfiles) },
         "select two pass log file name prefix", "prefix" },
-    { "deinterlace",  OPT_VIDEO | OPT_BOOL | OPT_EXPERT,                         { &do_deinterlace },
+    { "deinterlace",  OPT_VIDEO | OPT_BOOL | OPT_EXPERT | OPT_JOB,               { .off = JOB_OFFSET(do_deinterlace) },
         "this option is deprecated, use the yadif filter instead" },
-    { "psnr",         OPT_VIDEO | OPT_BOOL | OPT_EXPERT,                         { &do_psnr },
+    { "psnr",         OPT_VIDEO | OPT_BOOL | OPT_EXPERT | OPT_JOB,               { .off = JOB_OFFSET(do_psnr) },
         "calculate PSNR of compressed frames" },
     { "vstats",       OPT_VIDEO | OPT_EXPERT ,                                   { .func_arg = opt_vstats },
         "dump video coding statistics to file" },
@@ -3596,7 +3574,7 @@ const OptionDef options[] = {
     { "vtag",         OPT_VIDEO | HAS_ARG | OPT_EXPERT  | OPT_PERFILE |
                       OPT_INPUT | OPT_OUTPUT,                                    { .func_arg = opt_old2new },
         "force video tag/fourcc", "fourcc/tag" },
-    { "qphist",       OPT_VIDEO | OPT_BOOL | OPT_EXPERT ,                        { &qp_hist },
+    { "qphist",       OPT_VIDEO | OPT_BOOL | OPT_EXPERT | OPT_JOB,               { .off = JOB_OFFSET(qp_hist) },
         "show QP histogram" },
     { "force_fps",    OPT_VIDEO | OPT_BOOL | OPT_EXPERT  | OPT_SPEC |
                       OPT_OUTPUT,                                                { .off = OFFSET(force_fps) },
@@ -3628,7 +3606,7 @@ const OptionDef options[] = {
     { "autorotate",       HAS_ARG | OPT_BOOL | OPT_SPEC |
                           OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(autorotate) },
         "automatically insert correct rotate filters" },
-    { "hwaccel_lax_profile_check", OPT_BOOL | OPT_EXPERT,                        { &hwaccel_lax_profile_check},
+    { "hwaccel_lax_profile_check", OPT_BOOL | OPT_EXPERT | OPT_JOB,              { .off = JOB_OFFSET(hwaccel_lax_profile_check) },
         "attempt to decode anyway if HW accelerated decoder's supported profiles do not exactly match the stream" },
 
     /* audio options */
@@ -3650,7 +3628,7 @@ const OptionDef options[] = {
     { "atag",           OPT_AUDIO | HAS_ARG  | OPT_EXPERT | OPT_PERFILE |
                         OPT_OUTPUT,                                                { .func_arg = opt_old2new },
         "force audio tag/fourcc", "fourcc/tag" },
-    { "vol",            OPT_AUDIO | HAS_ARG  | OPT_INT,                            { &audio_volume },
+    { "vol",            OPT_AUDIO | HAS_ARG  | OPT_INT | OPT_JOB,                  { .off = JOB_OFFSET(audio_volume) },
         "change audio volume (256=normal)" , "volume" },
     { "sample_fmt",     OPT_AUDIO | HAS_ARG  | OPT_EXPERT | OPT_SPEC |
                         OPT_STRING | OPT_INPUT | OPT_OUTPUT,                       { .off = OFFSET(sample_fmts) },
@@ -3680,14 +3658,14 @@ const OptionDef options[] = {
         "deprecated, use -channel", "channel" },
     { "tvstd", HAS_ARG | OPT_EXPERT | OPT_VIDEO, { .func_arg = opt_video_standard },
         "deprecated, use -standard", "standard" },
-    { "isync", OPT_BOOL | OPT_EXPERT, { &input_sync }, "this option is deprecated and does nothing", "" },
+    { "isync", OPT_BOOL | OPT_EXPERT | OPT_JOB, { .off = JOB_OFFSET(input_sync) }, "this option is deprecated and does nothing", "" },
 
     /* muxer options */
     { "muxdelay",   OPT_FLOAT | HAS_ARG | OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT, { .off = OFFSET(mux_max_delay) },
         "set the maximum demux-decode delay", "seconds" },
     { "muxpreload", OPT_FLOAT | HAS_ARG | OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT, { .off = OFFSET(mux_preload) },
         "set the initial demux-decode delay", "seconds" },
-    { "override_ffserver", OPT_BOOL | OPT_EXPERT | OPT_OUTPUT, { &override_ffserver },
+    { "override_ffserver", OPT_BOOL | OPT_EXPERT | OPT_OUTPUT | OPT_JOB, { .off = JOB_OFFSET(override_ffserver) },
         "override the options from ffserver", "" },
     { "sdp_file", HAS_ARG | OPT_EXPERT | OPT_OUTPUT, { .func_arg = opt_sdp_file },
         "specify a file in which to print sdp information", "file" },
@@ -2,26 +2,110 @@
 // Created by Ilja Kosynkin on 25.03.2016.
 //
 #include "logjam.h"
+#include "ffmpeg_job.h"
+#include "libavutil/time.h"
 
 #include <jni.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
 JavaVM *sVm = NULL;
 
-int main(int level, int argc, char **argv);
+static FFJobPool *sPool = NULL;
+static pthread_once_t sPoolOnce = PTHREAD_ONCE_INIT;
+
+// Threads attached to the VM for progress callbacks, detached when they exit
+static pthread_key_t sEnvKey;
+
+typedef struct ProgressListener {
+    jobject listener;
+    jmethodID onProgress;
+} ProgressListener;
+
+static void createPool(void) {
+    // One worker per core, every job is single threaded apart from its codecs
+    sPool = ffmpeg_job_pool_alloc(0);
+}
+
+static void detachThread(void *env) {
+    (*sVm)->DetachCurrentThread(sVm);
+}
 
 jint JNI_OnLoad(JavaVM* vm, void* reserved) {
     sVm = vm;
+    pthread_key_create(&sEnvKey, detachThread);
+
+    // Everything shared between jobs is set up once here and kept for the
+    // lifetime of the process, jobs only pay for their own command line
+    ffmpeg_job_global_init();
+    pthread_once(&sPoolOnce, createPool);
+
     return JNI_VERSION_1_6;
 }
 
-JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_run(JNIEnv *env, jobject obj, jint loglevel, jobjectArray args) {
+// Job threads of the pool are attached on their first callback and stay
+// attached, so later callbacks only cost a GetEnv
+static JNIEnv *getEnv(void) {
+    JNIEnv *env = NULL;
+    if ((*sVm)->GetEnv(sVm, (void **) &env, JNI_VERSION_1_6) == JNI_EDETACHED) {
+        if ((*sVm)->AttachCurrentThread(sVm, &env, NULL) != JNI_OK) {
+            return NULL;
+        }
+        pthread_setspecific(sEnvKey, env);
+    }
+    return env;
+}
+
+static void onProgress(void *opaque, const FFJobProgress *progress) {
+    ProgressListener *pl = opaque;
+    JNIEnv *env = getEnv();
+    if (env == NULL) {
+        return;
+    }
+
+    (*env)->CallVoidMethod(env, pl->listener, pl->onProgress,
+                           (jint) progress->frame, (jfloat) progress->fps,
+                           (jlong) progress->total_size, (jdouble) progress->bitrate,
+                           (jlong) (progress->out_time / 1000), (jdouble) progress->speed,
+                           (jboolean) progress->is_last);
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+    }
+}
+
+static ProgressListener *createListener(JNIEnv *env, jobject listener) {
+    ProgressListener *pl = (ProgressListener *) malloc(sizeof(ProgressListener));
+    if (pl == NULL) {
+        return NULL;
+    }
+
+    jclass cls = (*env)->GetObjectClass(env, listener);
+    pl->onProgress = (*env)->GetMethodID(env, cls, "onProgress", "(IFJDJDZ)V");
+    (*env)->DeleteLocalRef(env, cls);
+    if (pl->onProgress == NULL) {
+        free(pl);
+        return NULL;
+    }
+    pl->listener = (*env)->NewGlobalRef(env, listener);
+    return pl;
+}
+
+static void freeListener(JNIEnv *env, ProgressListener *pl) {
+    if (pl != NULL) {
+        (*env)->DeleteGlobalRef(env, pl->listener);
+        free(pl);
+    }
+}
+
+static FFTranscodeJob *createJob(JNIEnv *env, jint loglevel, jobjectArray args) {
     int i = 0;
     int argc = 0;
     char **argv = NULL;
     jstring *strr = NULL;
+    FFTranscodeJob *job = NULL;
 
     if (args != NULL) {
         argc = (*env)->GetArrayLength(env, args);
@@ -37,11 +121,8 @@ JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_run(JNIEnv *env,
         }
     }
 
-    jint retcode = 0;
-    retcode = main(loglevel, argc, argv);
-    if (loglevel == 2) {
-       LOGI("Main ended with status %d", retcode);
-    }
+    // The job keeps its own copy of the arguments
+    job = ffmpeg_job_alloc(loglevel, argc, argv);
 
     for (i = 0; i < argc; ++i) {
         (*env)->ReleaseStringUTFChars(env, strr[i], argv[i]);
@@ -49,5 +130,160 @@ JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_run(JNIEnv *env,
     free(argv);
     free(strr);
 
+    return job;
+}
+
+JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_run(JNIEnv *env, jobject obj, jint loglevel, jobjectArray args) {
+    FFTranscodeJob *job = createJob(env, loglevel, args);
+    if (job == NULL) {
+        return -1;
+    }
+
+    jint retcode = 0;
+    retcode = ffmpeg_job_run(job);
+    if (loglevel == 2) {
+       LOGI("Main ended with status %d", retcode);
+    }
+
+    ffmpeg_job_free(&job);
+
+    return retcode;
+}
+
+// Trim, central square crop and bitrate limit in a single decode/encode pass.
+// The crop size is left to the filter expression, so rotated inputs are
+// handled the same way as straight ones and no probing is needed up front.
+JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_processVideo(JNIEnv *env, jobject obj, jint loglevel,
+        jstring input, jstring output, jint start, jint duration, jstring bitrate) {
+    char startStr[16];
+    char durationStr[16];
+    const char *inputPath = (*env)->GetStringUTFChars(env, input, 0);
+    const char *outputPath = (*env)->GetStringUTFChars(env, output, 0);
+    const char *bitrateStr = (*env)->GetStringUTFChars(env, bitrate, 0);
+
+    snprintf(startStr, sizeof(startStr), "%d", start);
+    snprintf(durationStr, sizeof(durationStr), "%d", duration);
+
+    // -ss/-t as input options so demuxing stops at the end of the trimmed part
+    char *argv[] = {
+        "ffmpeg", "-y",
+        "-ss", startStr, "-t", durationStr,
+        "-i", (char *) inputPath,
+        "-vf", "crop=min(iw\\,ih):min(iw\\,ih)",
+        "-b:v", (char *) bitrateStr,
+        "-c:a", "copy",
+        "-strict", "-2",
+        (char *) outputPath,
+    };
+    FFTranscodeJob *job = ffmpeg_job_alloc(loglevel, sizeof(argv) / sizeof(argv[0]), argv);
+
+    (*env)->ReleaseStringUTFChars(env, input, inputPath);
+    (*env)->ReleaseStringUTFChars(env, output, outputPath);
+    (*env)->ReleaseStringUTFChars(env, bitrate, bitrateStr);
+
+    if (job == NULL) {
+        return -1;
+    }
+
+    jint retcode = ffmpeg_job_run(job);
+    if (loglevel == 2) {
+       LOGI("Pipeline ended with status %d", retcode);
+    }
+
+    ffmpeg_job_free(&job);
+
     return retcode;
 }
+
+JNIEXPORT jlong JNICALL Java_processing_ffmpeg_videokit_VideoKit_submit(JNIEnv *env, jobject obj, jint loglevel, jobjectArray args,
+        jobject listener, jint intervalMs) {
+    pthread_once(&sPoolOnce, createPool);
+    if (sPool == NULL) {
+        return 0;
+    }
+
+    FFTranscodeJob *job = createJob(env, loglevel, args);
+    if (job == NULL) {
+        return 0;
+    }
+
+    if (listener != NULL) {
+        ProgressListener *pl = createListener(env, listener);
+        if (pl == NULL) {
+            ffmpeg_job_free(&job);
+            return 0;
+        }
+        ffmpeg_job_set_progress_cb(job, onProgress, pl, (int64_t) intervalMs * 1000);
+    }
+
+    if (ffmpeg_job_pool_submit(sPool, job) < 0) {
+        freeListener(env, job->progress_opaque);
+        ffmpeg_job_free(&job);
+        return 0;
+    }
+
+    return (jlong) (intptr_t) job;
+}
+
+JNIEXPORT jint JNICALL Java_processing_ffmpeg_videokit_VideoKit_await(JNIEnv *env, jobject obj, jlong handle) {
+    FFTranscodeJob *job = (FFTranscodeJob *) (intptr_t) handle;
+    if (job == NULL) {
+        return -1;
+    }
+
+    jint retcode = ffmpeg_job_wait(job);
+    if (job->loglevel == 2) {
+       LOGI("Job ended with status %d", retcode);
+    }
+
+    return retcode;
+}
+
+JNIEXPORT void JNICALL Java_processing_ffmpeg_videokit_VideoKit_release(JNIEnv *env, jobject obj, jlong handle) {
+    FFTranscodeJob *job = (FFTranscodeJob *) (intptr_t) handle;
+    if (job == NULL) {
+        return;
+    }
+
+    ffmpeg_job_wait(job);
+    freeListener(env, job->progress_opaque);
+    ffmpeg_job_free(&job);
+}
+
+JNIEXPORT void JNICALL Java_processing_ffmpeg_videokit_VideoKit_cancel(JNIEnv *env, jobject obj, jlong handle) {
+    FFTranscodeJob *job = (FFTranscodeJob *) (intptr_t) handle;
+    if (job != NULL) {
+        ffmpeg_job_cancel(job);
+    }
+}
+
+// Returns {one time initialization, average run of a job with no inputs and outputs} in microseconds
+JNIEXPORT jlongArray JNICALL Java_processing_ffmpeg_videokit_VideoKit_benchmarkStartup(JNIEnv *env, jobject obj, jint iterations) {
+    char *argv[] = { "ffmpeg", "-hide_banner" };
+    jlong result[2] = { 0, 0 };
+    int i;
+
+    result[0] = ffmpeg_job_global_init();
+
+    for (i = 0; i < iterations; ++i) {
+        FFTranscodeJob *job = ffmpeg_job_alloc(0, sizeof(argv) / sizeof(argv[0]), argv);
+        if (job == NULL) {
+            return NULL;
+        }
+
+        int64_t t = av_gettime_relative();
+        ffmpeg_job_run(job);
+        result[1] += av_gettime_relative() - t;
+
+        ffmpeg_job_free(&job);
+    }
+    if (iterations > 0) {
+        result[1] /= iterations;
+    }
+
+    jlongArray array = (*env)->NewLongArray(env, 2);
+    if (array != NULL) {
+        (*env)->SetLongArrayRegion(env, array, 0, 2, result);
+    }
+    return array;
+}
@@ -22,6 +22,9 @@ import rx.schedulers.Schedulers;
 public class VideoKit {
     private static final int TRIM_DURATION = 30;
 
+    // Return code of a job stopped with Job.cancel()
+    public static final int CANCELLED = 2047;
+
     static {
         System.loadLibrary("avutil-54");
         System.loadLibrary("swresample-1");
@@ -56,6 +59,91 @@ public class VideoKit {
     // that however could be very useful in case return code didn't help a lot
     private native int run(int loglevel, String[] args);
 
+    // Trims, crops central square and limits bitrate of input in one pass, returns ret_code as run does
+    private native int processVideo(int loglevel, String input, String output,
+            int start, int duration, String bitrate);
+
+    // Queues FFmpeg call on native worker pool, so several calls could run at the same time.
+    // Returns handle that has to be passed to release exactly once, 0 if job couldn't be queued.
+    // Listener may be null, otherwise it's called from worker thread at most every intervalMs
+    private native long submit(int loglevel, String[] args, ProgressListener listener, int intervalMs);
+
+    // Blocks until job from submit is finished and returns its ret_code
+    private native int await(long handle);
+
+    // Makes job from submit stop as soon as possible, must not be called after release
+    private native void cancel(long handle);
+
+    // Waits for job from submit and frees it
+    private native void release(long handle);
+
+    // Returns {one time native initialization, average startup and teardown of a job} in microseconds
+    private native long[] benchmarkStartup(int iterations);
+
+    /**
+     * Measure what a job costs before it touches any file. Codecs, formats and filters
+     * are registered once when the library is loaded, so only the first value is paid once
+     * per process and the second one on every call
+     * @param iterations number of empty jobs to average over
+     * @return String describing cold and warm startup time
+     */
+    public String describeStartupCost(int iterations) {
+        final long[] result = benchmarkStartup(iterations);
+        if (result == null) {
+            return "Startup benchmark failed";
+        }
+        return "cold init: " + result[0] + "us, warm job: " + result[1] + "us";
+    }
+
+    /**
+     * Start FFmpeg with specified arguments on native worker pool
+     * @param args FFmpeg arguments
+     * @param listener gets progress of the job, could be null
+     * @param progressIntervalMs minimal time between two listener calls
+     * @return running job or null if it couldn't be started
+     */
+    public Job start(String[] args, ProgressListener listener, int progressIntervalMs) {
+        final String[] params = new String[args.length + 1];
+        params[0] = "ffmpeg";
+        System.arraycopy(args, 0, params, 1, args.length);
+
+        final long handle = submit(0, params, listener, progressIntervalMs);
+        return handle != 0 ? new Job(handle) : null;
+    }
+
+    public final class Job {
+        private long handle;
+
+        private Job(long handle) {
+            this.handle = handle;
+        }
+
+        public synchronized void cancel() {
+            if (handle != 0) {
+                VideoKit.this.cancel(handle);
+            }
+        }
+
+        // Blocks until job is finished, ret_code is same as for process, CANCELLED if job was cancelled
+        public int await() {
+            final long toAwait;
+            synchronized (this) {
+                toAwait = handle;
+            }
+            if (toAwait == 0) {
+                throw new IllegalStateException("Job was already awaited");
+            }
+            final int returnCode = VideoKit.this.await(toAwait);
+            synchronized (this) {
+                if (handle != 0) {
+                    release(handle);
+                    handle = 0;
+                }
+            }
+            return returnCode;
+        }
+    }
+
     // CHECKSTYLE:OFF
     public String trimVideo(String path,
                                 int startPosition,
@@ -101,31 +189,34 @@ public class VideoKit {
                 .processVideo();
     }
 
+    // Trim, auto crop and bitrate limit are done in one native pass,
+    // so there are no intermediate files and video is encoded only once
     public String processVideoBlocking(String path) {
-        final String trimmed = autoTrimVideo(path, false);
-        final String cropped = autoCropVideo(trimmed, true);
-        return limitBitrate(cropped, true);
-    }
-
-    private String limitBitrate(String path, boolean deleteInput) {
-        return limitBitrate(path, deleteInput, null);
-    }
-
-    private String autoCropVideo(String path, boolean deleteInput) {
-        return autoCropVideo(path, deleteInput, null);
+        return processVideoBlocking(path, null);
     }
 
-    private String autoTrimVideo(String path, boolean deleteInput) {
-        return autoTrimVideo(path, deleteInput, null);
+    private String processVideoBlocking(String path, VideoProcessingListener listener) {
+        final String outputPath = FileUtils.createNewVideoFile(context).getAbsolutePath();
+        final int returnCode = processVideo(0, path, outputPath, 0, TRIM_DURATION,
+                CommandBuilder.VIDEO_BITRATE);
+        if (returnCode == 0) {
+            if (listener != null) {
+                listener.onSuccess(outputPath);
+            }
+            return outputPath;
+        } else {
+            if (listener != null) {
+                listener.onError(returnCode);
+            }
+            return path;
+        }
     }
 
     public Observable<String> processVideoAsync(final String path) {
         return Observable.create(new Observable.OnSubscribe<String>() {
             @Override
             public void call(final Subscriber<? super String> subscriber) {
-                final String trimmed = autoTrimVideo(path, false);
-                final String cropped = autoCropVideo(trimmed, true);
-                limitBitrate(cropped, true, new VideoProcessingListener() {
+                processVideoBlocking(path, new VideoProcessingListener() {
                     @Override
                     public void onSuccess(String path) {
                         subscriber.onNext(path);
@@ -163,6 +254,12 @@ public class VideoKit {
         }).subscribeOn(Schedulers.computation());
     }
 
+    public interface ProgressListener {
+        // Bitrate is in kbits/s, bitrate and speed are negative while unknown
+        void onProgress(int frames, float fps, long totalSize, double bitrate,
+                long outTimeMs, double speed, boolean finished);
+    }
+
     public interface VideoProcessingListener {
         void onSuccess(String path);
         void onError(int errorCode);
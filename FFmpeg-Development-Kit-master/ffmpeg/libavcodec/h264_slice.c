@@ -29,6 +29,7 @@
 #include "libavutil/display.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/stereo3d.h"
+#include "libavutil/thread.h"
 #include "libavutil/timer.h"
 #include "internal.h"
 #include "cabac.h"
@@ -2324,6 +2325,40 @@ static void predict_field_decoding_flag(const H264Context *h, H264SliceContext *
     sl->mb_mbaff    = sl->mb_field_decoding_flag = IS_INTERLACED(mb_type) ? 1 : 0;
 }
 
+#if HAVE_THREADS
+/**
+ * Deblocking filter running in a separate thread while a slice is decoded.
+ *
+ * The slice is decoded as with a postponed filter, so intra prediction reads
+ * unfiltered pixels. An MB row is filtered once the row below it has been
+ * decoded, from a copy of the slice context, and the filter thread then
+ * reports the progress of the picture in place of the decoding thread.
+ */
+typedef struct H264DeblockContext {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        ///< new decoded row, end of the slice or quit
+    pthread_cond_t done_cond;   ///< all rows of the slice were filtered
+
+    H264SliceContext sl;
+    int running;
+    int decoded_row;            ///< last MB row completely decoded
+    int slice_done;             ///< the slice decoding ended at end_x, end_y
+    int end_x, end_y;
+    int quit;
+} H264DeblockContext;
+
+static void deblock_row_decoded(const H264Context *h, int mb_y)
+{
+    H264DeblockContext *d = h->deblock;
+
+    pthread_mutex_lock(&d->mutex);
+    d->decoded_row = mb_y;
+    pthread_cond_signal(&d->cond);
+    pthread_mutex_unlock(&d->mutex);
+}
+#endif
+
 /**
  * Draw edges and report progress for the last MB row.
  */
@@ -2334,6 +2369,13 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
     int height         =  16      << FRAME_MBAFF(h);
     int deblock_border = (16 + 4) << FRAME_MBAFF(h);
 
+#if HAVE_THREADS
+    if (sl->deblock_lagged) {
+        deblock_row_decoded(h, sl->mb_y);
+        return;
+    }
+#endif
+
     if (sl->deblocking_filter) {
         if ((top + height) >= pic_height)
             height += deblock_border;
@@ -2358,6 +2400,139 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
                               h->picture_structure == PICT_BOTTOM_FIELD);
 }
 
+#if HAVE_THREADS
+static void *attribute_align_arg deblock_thread(void *arg)
+{
+    H264Context *h        = arg;
+    H264DeblockContext *d = h->deblock;
+    H264SliceContext *sl  = &d->sl;
+
+    pthread_mutex_lock(&d->mutex);
+    for (;;) {
+        int mb_x, mb_y;
+
+        while (!d->running && !d->quit)
+            pthread_cond_wait(&d->cond, &d->mutex);
+        if (d->quit)
+            break;
+
+        for (mb_x = sl->mb_x, mb_y = sl->mb_y;; mb_x = 0, mb_y++) {
+            int end_x = h->mb_width;
+
+            /* the row below predicts from the unfiltered pixels of this one */
+            while (d->decoded_row <= mb_y && !d->slice_done)
+                pthread_cond_wait(&d->cond, &d->mutex);
+            if (d->decoded_row <= mb_y) {
+                if (mb_y > d->end_y || (mb_y == d->end_y && mb_x >= d->end_x))
+                    break;
+                if (mb_y == d->end_y)
+                    end_x = d->end_x;
+            }
+            pthread_mutex_unlock(&d->mutex);
+
+            sl->mb_y = mb_y;
+            loop_filter(h, sl, mb_x, end_x);
+            if (end_x == h->mb_width)
+                decode_finish_row(h, sl);
+
+            pthread_mutex_lock(&d->mutex);
+        }
+
+        d->running = 0;
+        pthread_cond_signal(&d->done_cond);
+    }
+    pthread_mutex_unlock(&d->mutex);
+
+    return NULL;
+}
+
+static int deblock_thread_init(H264Context *h)
+{
+    H264DeblockContext *d = av_mallocz(sizeof(*d));
+    int ret;
+
+    if (!d)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_init(&d->mutex, NULL);
+    pthread_cond_init(&d->cond, NULL);
+    pthread_cond_init(&d->done_cond, NULL);
+
+    h->deblock = d;
+    if ((ret = pthread_create(&d->thread, NULL, deblock_thread, h))) {
+        h->deblock = NULL;
+        pthread_cond_destroy(&d->done_cond);
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->mutex);
+        av_free(d);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+/**
+ * Hand the filtering of the slice to the deblocking thread, once the slice
+ * context is set up for decoding.
+ */
+static void deblock_slice_start(const H264Context *h, H264SliceContext *sl)
+{
+    H264DeblockContext *d = h->deblock;
+
+    pthread_mutex_lock(&d->mutex);
+    memcpy(&d->sl, sl, sizeof(*sl));
+    d->sl.deblock_lagged = 0;
+    d->decoded_row = sl->mb_y - 1;
+    d->slice_done  = 0;
+    d->running     = 1;
+    pthread_cond_signal(&d->cond);
+    pthread_mutex_unlock(&d->mutex);
+}
+
+/**
+ * Wait for the deblocking thread to filter what was decoded of the slice.
+ */
+static void deblock_slice_end(const H264Context *h, H264SliceContext *sl)
+{
+    H264DeblockContext *d = h->deblock;
+
+    if (!sl->deblock_lagged)
+        return;
+
+    pthread_mutex_lock(&d->mutex);
+    d->end_y      = FFMIN(sl->mb_y, h->mb_height - 1);
+    d->end_x      = sl->mb_y >= h->mb_height ? h->mb_width : sl->mb_x;
+    d->slice_done = 1;
+    pthread_cond_signal(&d->cond);
+    while (d->running)
+        pthread_cond_wait(&d->done_cond, &d->mutex);
+    pthread_mutex_unlock(&d->mutex);
+
+    sl->deblock_lagged = 0;
+}
+#endif
+
+void ff_h264_deblock_thread_free(H264Context *h)
+{
+#if HAVE_THREADS
+    H264DeblockContext *d = h->deblock;
+
+    if (!d)
+        return;
+
+    pthread_mutex_lock(&d->mutex);
+    d->quit = 1;
+    pthread_cond_signal(&d->cond);
+    pthread_mutex_unlock(&d->mutex);
+    pthread_join(d->thread, NULL);
+
+    pthread_cond_destroy(&d->done_cond);
+    pthread_cond_destroy(&d->cond);
+    pthread_mutex_destroy(&d->mutex);
+    av_freep(&h->deblock);
+#endif
+}
+
 static void er_add_slice(H264SliceContext *sl,
                          int startx, int starty,
                          int endx, int endy, int status)
@@ -2391,7 +2566,11 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
 
     av_assert0(h->block_offset[15] == (4 * ((scan8[15] - scan8[0]) & 7) << h->pixel_shift) + 4 * sl->linesize * ((scan8[15] - scan8[0]) >> 3));
 
-    if (h->postpone_filter)
+#if HAVE_THREADS
+    if (sl->deblock_lagged)
+        deblock_slice_start(h, sl);
+#endif
+    if (h->postpone_filter || sl->deblock_lagged)
         sl->deblocking_filter = 0;
 
     sl->is_complex = FRAME_MBAFF(h) || h->picture_structure != PICT_FRAME ||
@@ -2609,7 +2788,23 @@ int ff_h264_execute_decode_slices(H264Context *h, unsigned context_count)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
+#if HAVE_THREADS
+        if (h->deblock_thread && !h->deblock && avctx->active_thread_type &&
+            (ret = deblock_thread_init(h)) < 0) {
+            av_log(avctx, AV_LOG_WARNING,
+                   "Could not start the deblocking thread, filtering inline.\n");
+            h->deblock_thread = 0;
+        }
+        sl = &h->slice_ctx[0];
+        sl->deblock_lagged = h->deblock && sl->deblocking_filter &&
+                             h->picture_structure == PICT_FRAME && !FRAME_MBAFF(h) &&
+                             !avctx->draw_horiz_band;
+#endif
+
         ret = decode_slice(avctx, &h->slice_ctx[0]);
+#if HAVE_THREADS
+        deblock_slice_end(h, &h->slice_ctx[0]);
+#endif
         h->mb_y = h->slice_ctx[0].mb_y;
         return ret;
     } else {
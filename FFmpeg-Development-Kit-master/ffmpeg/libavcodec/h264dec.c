@@ -362,6 +362,7 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
     H264Context *h = avctx->priv_data;
     int i;
 
+    ff_h264_deblock_thread_free(h);
     ff_h264_remove_all_refs(h);
     ff_h264_free_tables(h);
 
@@ -449,12 +450,14 @@ av_cold int ff_h264_decode_init(AVCodecContext *avctx)
 static int decode_init_thread_copy(AVCodecContext *avctx)
 {
     H264Context *h = avctx->priv_data;
+    int deblock_thread = h->deblock_thread;
     int ret;
 
     if (!avctx->internal->is_copy)
         return 0;
 
     memset(h, 0, sizeof(*h));
+    h->deblock_thread = deblock_thread;
 
     ret = h264_init_context(avctx, h);
     if (ret < 0)
@@ -1199,6 +1202,7 @@ static const AVOption h264_options[] = {
     {"is_avc", "is avc", offsetof(H264Context, is_avc), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, 0},
     {"nal_length_size", "nal_length_size", offsetof(H264Context, nal_length_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 4, 0},
     { "enable_er", "Enable error resilience on damaged frames (unsafe)", OFFSET(enable_er), AV_OPT_TYPE_BOOL, { .i64 = -1 }, -1, 1, VD },
+    { "deblock_thread", "Deblock in a separate thread, one MB row behind the decoding (with threading)", OFFSET(deblock_thread), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
     { NULL },
 };
 
@@ -197,6 +197,7 @@ typedef struct H264SliceContext {
     int deblocking_filter;          ///< disable_deblocking_filter_idc with 1 <-> 0
     int slice_alpha_c0_offset;
     int slice_beta_offset;
+    int deblock_lagged;             ///< filtered by H264Context.deblock while being decoded
 
     H264PredWeightTable pwt;
 
@@ -555,6 +556,14 @@ typedef struct H264Context {
 
     int enable_er;
 
+    /* Set by the user to run the deblocking filter of single slice contexts
+     * in a separate thread, one MB row behind the decoding. This is mostly
+     * useful with a small number of frame threads, trading some of their
+     * parallelism for less delay.
+     */
+    int deblock_thread;
+    struct H264DeblockContext *deblock;
+
     H264SEIContext sei;
 
     AVBufferPool *qscale_table_pool;
@@ -850,6 +859,7 @@ int ff_h264_decode_slice_header(H264Context *h, H264SliceContext *sl,
 #define SLICE_SKIPED 2
 
 int ff_h264_execute_decode_slices(H264Context *h, unsigned context_count);
+void ff_h264_deblock_thread_free(H264Context *h);
 int ff_h264_update_thread_context(AVCodecContext *dst,
                                   const AVCodecContext *src);
 
@@ -772,15 +772,18 @@ static int hls_slice_header(HEVCContext *s)
                 unsigned val = get_bits_long(gb, offset_len);
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
-            if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
-            } else
-                s->enable_parallel_tiles = 0;
-        } else
-            s->enable_parallel_tiles = 0;
+            if (s->threads_number > 1 && s->ps.pps->entropy_coding_sync_enabled_flag &&
+                (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1))
+                s->threads_number = 1; // tiles combined with WPP are decoded serially
+        }
     }
 
+    /* tiles are decoded in parallel and the loop filters deferred for the
+     * whole picture, so this must not change between its slices */
+    s->enable_parallel_tiles = s->threads_number > 1 &&
+                               !s->ps.pps->entropy_coding_sync_enabled_flag &&
+                               (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1);
+
     if (s->ps.pps->slice_header_extension_present_flag) {
         unsigned int length = get_ue_golomb_long(gb);
         if (length*8LL > get_bits_left(gb)) {
@@ -2286,13 +2289,20 @@ static void hls_decode_neighbour(HEVCContext *s, int x_ctb, int y_ctb,
 
     lc->boundary_flags = 0;
     if (s->ps.pps->tiles_enabled_flag) {
+        /* with parallel tiles, a CTB of another tile may be in the middle of
+         * being decoded; the flags are only needed for the deblocking of
+         * tile edges, which is then done after the tiles */
+        int parallel_tiles = s->enable_parallel_tiles;
+
         if (x_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - 1]])
             lc->boundary_flags |= BOUNDARY_LEFT_TILE;
-        if (x_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - 1])
+        if (x_ctb > 0 && !(parallel_tiles && lc->boundary_flags & BOUNDARY_LEFT_TILE) &&
+            s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - 1])
             lc->boundary_flags |= BOUNDARY_LEFT_SLICE;
         if (y_ctb > 0 && s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[ctb_addr_rs - s->ps.sps->ctb_width]])
             lc->boundary_flags |= BOUNDARY_UPPER_TILE;
-        if (y_ctb > 0 && s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - s->ps.sps->ctb_width])
+        if (y_ctb > 0 && !(parallel_tiles && lc->boundary_flags & BOUNDARY_UPPER_TILE) &&
+            s->tab_slice_address[ctb_addr_rs] != s->tab_slice_address[ctb_addr_rs - s->ps.sps->ctb_width])
             lc->boundary_flags |= BOUNDARY_UPPER_SLICE;
     } else {
         if (ctb_addr_in_slice <= 0)
@@ -2342,6 +2352,7 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *isFilterThread)
 
         s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
         s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->deblock[ctb_addr_rs].disable_dbf = s->sh.disable_deblocking_filter_flag;
         s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
 
         more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
@@ -2353,11 +2364,12 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *isFilterThread)
 
         ctb_addr_ts++;
         ff_hevc_save_states(s, ctb_addr_ts);
-        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+        if (!s->enable_parallel_tiles)
+            ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
     }
 
     if (x_ctb + ctb_size >= s->ps.sps->width &&
-        y_ctb + ctb_size >= s->ps.sps->height)
+        y_ctb + ctb_size >= s->ps.sps->height && !s->enable_parallel_tiles)
         ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
 
     return ctb_addr_ts;
@@ -2451,7 +2463,127 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
     return 0;
 }
 
-static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_threads, int job, int self_id)
+{
+    HEVCContext *s1     = avctxt->priv_data, *s;
+    const HEVCPPS *pps  = s1->ps.pps;
+    HEVCLocalContext *lc;
+    int *threads        = input_threads;
+    int more_data       = 1;
+    int ctb_addr_ts     = pps->ctb_addr_rs_to_ts[s1->sh.slice_ctb_addr_rs];
+    int tile            = pps->tile_id[ctb_addr_ts] + job;
+    int ret;
+
+    s  = s1->sList[self_id];
+    lc = s->HEVClc;
+    threads[job] = self_id;
+
+    if (job) {
+        int tile_x = tile % pps->num_tile_columns;
+        int tile_y = tile / pps->num_tile_columns;
+
+        if (tile_y >= pps->num_tile_rows) {
+            avpriv_atomic_int_set(&s1->wpp_err, 1);
+            return AVERROR_INVALIDDATA;
+        }
+        ctb_addr_ts = pps->ctb_addr_rs_to_ts[pps->row_bd[tile_y] * s->ps.sps->ctb_width +
+                                             pps->col_bd[tile_x]];
+
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+        if (ret < 0) {
+            avpriv_atomic_int_set(&s1->wpp_err, 1);
+            return ret;
+        }
+    }
+
+    while (more_data && ctb_addr_ts < s->ps.sps->ctb_size &&
+           pps->tile_id[ctb_addr_ts] == tile) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        int x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        int y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+
+        if (avpriv_atomic_int_get(&s1->wpp_err))
+            return 0;
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ff_hevc_cabac_init(s, ctb_addr_ts);
+
+        hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->deblock[ctb_addr_rs].disable_dbf = s->sh.disable_deblocking_filter_flag;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            s->tab_slice_address[ctb_addr_rs] = -1;
+            avpriv_atomic_int_set(&s1->wpp_err, 1);
+            return more_data;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    if (job != s->sh.num_entry_point_offsets) {
+        // only the last tile of the slice may end it
+        if (!more_data)
+            avpriv_atomic_int_set(&s1->wpp_err, 1);
+        return 0;
+    }
+
+    return ctb_addr_ts;
+}
+
+static int alloc_thread_contexts(HEVCContext *s)
+{
+    int i;
+
+    for (i = 1; i < s->threads_number; i++) {
+        if (s->sList[i])
+            continue;
+        s->HEVClcList[i] = av_mallocz(sizeof(HEVCLocalContext));
+        if (!s->HEVClcList[i])
+            return AVERROR(ENOMEM);
+        s->sList[i] = av_malloc(sizeof(HEVCContext));
+        if (!s->sList[i])
+            return AVERROR(ENOMEM);
+        memcpy(s->sList[i], s, sizeof(HEVCContext));
+        s->sList[i]->HEVClc = s->HEVClcList[i];
+    }
+
+    return 0;
+}
+
+/**
+ * Run the loop filters of a picture whose tiles were decoded in parallel.
+ * The CTBs are filtered in tile scan order as by the serial decoder, so that
+ * the output does not depend on the number of threads.
+ */
+static void hls_filter_frame(HEVCContext *s)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int ctb_addr_ts, x_ctb = 0, y_ctb = 0;
+
+    ff_hevc_deblocking_boundary_strengths_tiles(s);
+
+    for (ctb_addr_ts = 0; ctb_addr_ts < s->ps.sps->ctb_size; ctb_addr_ts++) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        if (s->tab_slice_address[ctb_addr_rs] < 0)
+            continue;
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= s->ps.sps->width &&
+        y_ctb + ctb_size >= s->ps.sps->height)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+}
+
+static int hls_slice_data_parallel(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
     int length          = nal->size;
@@ -2468,7 +2600,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2477,17 +2610,22 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         goto error;
     }
 
-    ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
-
-    if (!s->sList[1]) {
-        for (i = 1; i < s->threads_number; i++) {
-            s->sList[i] = av_malloc(sizeof(HEVCContext));
-            memcpy(s->sList[i], s, sizeof(HEVCContext));
-            s->HEVClcList[i] = av_mallocz(sizeof(HEVCLocalContext));
-            s->sList[i]->HEVClc = s->HEVClcList[i];
+    if (s->sh.dependent_slice_segment_flag && s->ps.pps->tiles_enabled_flag) {
+        int ctb_addr_ts = s->ps.pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+        if (!ctb_addr_ts ||
+            s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts - 1]] != s->sh.slice_addr) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            res = AVERROR_INVALIDDATA;
+            goto error;
         }
     }
 
+    ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+
+    res = alloc_thread_contexts(s);
+    if (res < 0)
+        goto error;
+
     offset = (lc->gb.index >> 3);
 
     for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < nal->skipped_bytes; j++) {
@@ -2528,6 +2666,10 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         s->sList[i]->HEVClc->qp_y = s->sList[0]->HEVClc->qp_y;
         memcpy(s->sList[i], s, sizeof(HEVCContext));
         s->sList[i]->HEVClc = s->HEVClcList[i];
+        /* the first tile may be decoded by any thread, starting from the
+         * state left by the slice header */
+        if (s->enable_parallel_tiles)
+            memcpy(s->HEVClcList[i], s->HEVClc, sizeof(HEVCLocalContext));
     }
 
     avpriv_atomic_int_set(&s->wpp_err, 0);
@@ -2538,8 +2680,16 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    } else if (s->enable_parallel_tiles) {
+        /* arg[] returns the thread that decoded each tile; a dependent
+         * slice segment continues from the state of the last one */
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+        i = arg[s->sh.num_entry_point_offsets];
+        if (i)
+            memcpy(s->HEVClc, s->HEVClcList[i], sizeof(HEVCLocalContext));
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -2826,7 +2976,7 @@ static int decode_nal_unit(HEVCContext *s, const H2645NAL *nal)
                 goto fail;
         } else {
             if (s->threads_number > 1 && s->sh.num_entry_point_offsets > 0)
-                ctb_addr_ts = hls_slice_data_wpp(s, nal);
+                ctb_addr_ts = hls_slice_data_parallel(s, nal);
             else
                 ctb_addr_ts = hls_slice_data(s);
             if (ctb_addr_ts >= (s->ps.sps->ctb_width * s->ps.sps->ctb_height)) {
@@ -2894,6 +3044,8 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     }
 
 fail:
+    if (s->ref && s->enable_parallel_tiles && !s->avctx->hwaccel)
+        hls_filter_frame(s);
     if (s->ref && s->threads_type == FF_THREAD_FRAME)
         ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
 
@@ -718,6 +718,7 @@ typedef struct TransformUnit {
 typedef struct DBParams {
     int beta_offset;
     int tc_offset;
+    int disable_dbf;
 } DBParams;
 
 #define HEVC_FRAME_FLAG_OUTPUT    (1 << 0)
@@ -1047,6 +1048,11 @@ void ff_hevc_set_qPy(HEVCContext *s, int xBase, int yBase,
                      int log2_cb_size);
 void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                                            int log2_trafo_size);
+/**
+ * Compute the boundary strengths of the CTB edges lying on tile boundaries,
+ * which are skipped while the tiles of a picture are decoded in parallel.
+ */
+void ff_hevc_deblocking_boundary_strengths_tiles(HEVCContext *s);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
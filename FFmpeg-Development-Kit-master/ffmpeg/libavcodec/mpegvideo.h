@@ -61,6 +61,7 @@
 #define MAX_THREADS 32
 
 #define MAX_B_FRAMES 16
+#define MAX_RC_LOOKAHEAD (MAX_PICTURE_COUNT - 6)
 
 /* Start codes. */
 #define SEQ_END_CODE            0x000001b7
@@ -537,6 +538,7 @@ typedef struct MpegEncContext {
     float border_masking;
     int lmin, lmax;
     int vbv_ignore_qmax;
+    int rc_lookahead;   ///< number of pictures analysed ahead for rate control, 0 for none
 
     char *rc_eq;
 
@@ -553,9 +555,22 @@ typedef struct MpegEncContext {
 
     /* temporary frames used by b_frame_strategy = 2 */
     AVFrame *tmp_frames[MAX_B_FRAMES + 2];
+    /* lookahead used by b_frame_strategy = 3 */
+    struct MpvLookaheadContext *lookahead;
     int b_frame_strategy;
     int b_sensitivity;
 
+    /* motion estimation of the next B-frame, run while coding the current picture */
+    int pipeline_me;
+    struct MpegEncContext *me_ahead_context[MAX_THREADS];
+    Picture *me_ahead_picture;          ///< queued picture whose ME results are in the me_ahead tables, or NULL
+    AVFrame *me_ahead_input;            ///< source planes of that picture, borrowed from it
+    int16_t (*me_ahead_mv_table_base[5])[2];
+    uint16_t *me_ahead_mb_type;
+    uint16_t *me_ahead_mc_mb_var;
+    int me_ahead_report;                ///< draw edges and report progress of each coded MB row
+    int me_ahead_wait;                  ///< reference MB rows around each row to await before its ME, 0 for none
+
     /* frame skip options for encoding */
     int frame_skip_threshold;
     int frame_skip_factor;
@@ -628,6 +643,7 @@ FF_MPV_OPT_CMP_FUNC, \
                                                                     FF_MPV_OFFSET(rc_eq), AV_OPT_TYPE_STRING,                           .flags = FF_MPV_OPT_FLAGS },            \
 {"rc_init_cplx", "initial complexity for 1-pass encoding",          FF_MPV_OFFSET(rc_initial_cplx), AV_OPT_TYPE_FLOAT, {.dbl = 0 }, -FLT_MAX, FLT_MAX, FF_MPV_OPT_FLAGS},       \
 {"rc_buf_aggressivity", "currently useless",                        FF_MPV_OFFSET(rc_buffer_aggressivity), AV_OPT_TYPE_FLOAT, {.dbl = 1.0 }, -FLT_MAX, FLT_MAX, FF_MPV_OPT_FLAGS}, \
+{"rc_lookahead", "Number of pictures to analyse ahead for VBV rate control and adaptive quantization", FF_MPV_OFFSET(rc_lookahead), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, MAX_RC_LOOKAHEAD, FF_MPV_OPT_FLAGS }, \
 {"border_mask", "increase the quantizer for macroblocks close to borders", FF_MPV_OFFSET(border_masking), AV_OPT_TYPE_FLOAT, {.dbl = 0 }, -FLT_MAX, FLT_MAX, FF_MPV_OPT_FLAGS},    \
 {"lmin", "minimum Lagrange factor (VBR)",                           FF_MPV_OFFSET(lmin), AV_OPT_TYPE_INT, {.i64 =  2*FF_QP2LAMBDA }, 0, INT_MAX, FF_MPV_OPT_FLAGS },            \
 {"lmax", "maximum Lagrange factor (VBR)",                           FF_MPV_OFFSET(lmax), AV_OPT_TYPE_INT, {.i64 = 31*FF_QP2LAMBDA }, 0, INT_MAX, FF_MPV_OPT_FLAGS },            \
@@ -641,9 +657,10 @@ FF_MPV_OPT_CMP_FUNC, \
 { "epzs", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = FF_ME_EPZS }, 0, 0, FF_MPV_OPT_FLAGS, "motion_est" }, \
 { "xone", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = FF_ME_XONE }, 0, 0, FF_MPV_OPT_FLAGS, "motion_est" }, \
 { "force_duplicated_matrix", "Always write luma and chroma matrix for mjpeg, useful for rtp streaming.", FF_MPV_OFFSET(force_duplicated_matrix), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, FF_MPV_OPT_FLAGS },   \
-{"b_strategy", "Strategy to choose between I/P/B-frames",           FF_MPV_OFFSET(b_frame_strategy), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 2, FF_MPV_OPT_FLAGS }, \
+{"b_strategy", "Strategy to choose between I/P/B-frames",           FF_MPV_OFFSET(b_frame_strategy), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 3, FF_MPV_OPT_FLAGS }, \
 {"b_sensitivity", "Adjust sensitivity of b_frame_strategy 1",       FF_MPV_OFFSET(b_sensitivity), AV_OPT_TYPE_INT, {.i64 = 40 }, 1, INT_MAX, FF_MPV_OPT_FLAGS }, \
 {"brd_scale", "Downscale frames for dynamic B-frame decision",      FF_MPV_OFFSET(brd_scale), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 3, FF_MPV_OPT_FLAGS }, \
+{"pipeline_me", "Estimate the motion of the next B-frame while coding the current picture", FF_MPV_OFFSET(pipeline_me), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, FF_MPV_OPT_FLAGS }, \
 {"skip_threshold", "Frame skip threshold",                          FF_MPV_OFFSET(frame_skip_threshold), AV_OPT_TYPE_INT, {.i64 = 0 }, INT_MIN, INT_MAX, FF_MPV_OPT_FLAGS }, \
 {"skip_factor", "Frame skip factor",                                FF_MPV_OFFSET(frame_skip_factor), AV_OPT_TYPE_INT, {.i64 = 0 }, INT_MIN, INT_MAX, FF_MPV_OPT_FLAGS }, \
 {"skip_exp", "Frame skip exponent",                                 FF_MPV_OFFSET(frame_skip_exp), AV_OPT_TYPE_INT, {.i64 = 0 }, INT_MIN, INT_MAX, FF_MPV_OPT_FLAGS }, \
@@ -691,6 +708,34 @@ void ff_mpv_encode_init_x86(MpegEncContext *s);
 int ff_mpv_encode_end(AVCodecContext *avctx);
 int ff_mpv_encode_picture(AVCodecContext *avctx, AVPacket *pkt,
                           const AVFrame *frame, int *got_packet);
+int ff_mpv_lookahead_init(MpegEncContext *s);
+void ff_mpv_lookahead_end(MpegEncContext *s);
+/**
+ * Choose the number of B-frames before the next reference picture from
+ * the estimated costs of the queued input pictures. Scene cuts found on
+ * the way are marked as I-frames.
+ */
+int ff_mpv_lookahead_b_count(MpegEncContext *s);
+/**
+ * Estimate the cost of a picture entering the input queue, predicted from
+ * the previous input picture, for rc_lookahead.
+ */
+void ff_mpv_lookahead_add(MpegEncContext *s, Picture *pic);
+/**
+ * Get the estimated costs of the picture being coded and of the queued
+ * pictures following it in coding order, with their expected types.
+ * @return the number of pictures written to cost and pict_type, at most max
+ */
+int ff_mpv_lookahead_plan(MpegEncContext *s, int64_t *cost, int *pict_type,
+                          int max);
+/**
+ * Get how much the MBs of the picture being coded are referenced by the
+ * analysed pictures following it, as qscale divisors indexed by mb_xy.
+ * The divisors are normalised to a geometric mean of 1 over the picture.
+ * @param strength exponent applied to the ratio of the propagated cost
+ * @return the divisors, or NULL if they are all 1
+ */
+const float *ff_mpv_lookahead_mb_factors(MpegEncContext *s, float strength);
 int ff_mpv_reallocate_putbitbuffer(MpegEncContext *s, size_t threshold, size_t size_increase);
 
 void ff_clean_intra_table_entries(MpegEncContext *s);
@@ -707,6 +752,8 @@ int ff_mpv_export_qp_table(MpegEncContext *s, AVFrame *f, Picture *p, int qp_typ
 
 void ff_write_quant_matrix(PutBitContext *pb, uint16_t *matrix);
 
+int ff_mpv_init_duplicate_context(MpegEncContext *s);
+void ff_mpv_free_duplicate_context(MpegEncContext *s);
 int ff_update_duplicate_context(MpegEncContext *dst, MpegEncContext *src);
 int ff_mpeg_update_thread_context(AVCodecContext *dst, const AVCodecContext *src);
 void ff_set_qscale(MpegEncContext * s, int qscale);
@@ -282,6 +282,55 @@ av_cold int ff_dct_encode_init(MpegEncContext *s) {
     return 0;
 }
 
+static av_cold int me_ahead_init(MpegEncContext *s)
+{
+    int mv_table_size = (s->mb_height + 2) * s->mb_stride + 1;
+    int mb_array_size = s->mb_height * s->mb_stride;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->me_ahead_mv_table_base); i++) {
+        s->me_ahead_mv_table_base[i] = av_mallocz_array(mv_table_size, 2 * sizeof(int16_t));
+        if (!s->me_ahead_mv_table_base[i])
+            return AVERROR(ENOMEM);
+    }
+    s->me_ahead_mb_type   = av_mallocz_array(mb_array_size, sizeof(uint16_t));
+    s->me_ahead_mc_mb_var = av_mallocz_array(mb_array_size, sizeof(uint16_t));
+    s->me_ahead_input     = av_frame_alloc();
+    if (!s->me_ahead_mb_type || !s->me_ahead_mc_mb_var || !s->me_ahead_input)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->slice_context_count; i++) {
+        MpegEncContext *t = av_memdup(s, sizeof(MpegEncContext));
+        if (!t)
+            return AVERROR(ENOMEM);
+        s->me_ahead_context[i] = t;
+        if (ff_mpv_init_duplicate_context(t) < 0)
+            return AVERROR(ENOMEM);
+        t->start_mb_y = s->thread_context[i]->start_mb_y;
+        t->end_mb_y   = s->thread_context[i]->end_mb_y;
+    }
+
+    /* one counter per MB row of the reference picture being coded, see
+     * me_ahead_report_row() */
+    return ff_alloc_entries(s->avctx, 2 * s->mb_height);
+}
+
+static av_cold void me_ahead_end(MpegEncContext *s)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->me_ahead_context); i++) {
+        if (s->me_ahead_context[i])
+            ff_mpv_free_duplicate_context(s->me_ahead_context[i]);
+        av_freep(&s->me_ahead_context[i]);
+    }
+    for (i = 0; i < FF_ARRAY_ELEMS(s->me_ahead_mv_table_base); i++)
+        av_freep(&s->me_ahead_mv_table_base[i]);
+    av_freep(&s->me_ahead_mb_type);
+    av_freep(&s->me_ahead_mc_mb_var);
+    av_frame_free(&s->me_ahead_input);
+}
+
 /* init video encoder */
 av_cold int ff_mpv_encode_init(AVCodecContext *avctx)
 {
@@ -432,6 +481,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
                          s->avctx->spatial_cplx_masking  ||
                          s->avctx->p_masking      ||
                          s->border_masking ||
+                         s->rc_lookahead ||
                          (s->mpv_flags & FF_MPV_FLAG_QP_RD)) &&
                         !s->fixed_qscale;
 
@@ -546,6 +596,20 @@ FF_ENABLE_DEPRECATION_WARNINGS
                "max b frames must be 0 or positive for mpegvideo based encoders\n");
         return -1;
     }
+    if (s->rc_lookahead                    &&
+        s->codec_id != AV_CODEC_ID_MPEG4      &&
+        s->codec_id != AV_CODEC_ID_MPEG1VIDEO &&
+        s->codec_id != AV_CODEC_ID_MPEG2VIDEO) {
+        av_log(avctx, AV_LOG_ERROR, "rc_lookahead not supported by codec\n");
+        return -1;
+    }
+    /* the queued pictures and the ones being reordered come from s->picture */
+    if (2 * s->max_b_frames + s->rc_lookahead + 6 > MAX_PICTURE_COUNT) {
+        av_log(avctx, AV_LOG_ERROR,
+               "rc_lookahead %d is too large with %d B-frames\n",
+               s->rc_lookahead, s->max_b_frames);
+        return -1;
+    }
 
     if ((s->codec_id == AV_CODEC_ID_MPEG4 ||
          s->codec_id == AV_CODEC_ID_H263  ||
@@ -909,6 +973,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
+    avctx->delay       += s->rc_lookahead;
     avctx->has_b_frames = !s->low_delay;
 
     s->encoding = 1;
@@ -1103,6 +1168,18 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
+    if (s->b_frame_strategy == 3 || s->rc_lookahead) {
+        ret = ff_mpv_lookahead_init(s);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (s->pipeline_me && s->max_b_frames) {
+        ret = me_ahead_init(s);
+        if (ret < 0)
+            return ret;
+    }
+
     cpb_props = ff_add_cpb_side_data(avctx);
     if (!cpb_props)
         return AVERROR(ENOMEM);
@@ -1133,6 +1210,8 @@ av_cold int ff_mpv_encode_end(AVCodecContext *avctx)
 
     for (i = 0; i < FF_ARRAY_ELEMS(s->tmp_frames); i++)
         av_frame_free(&s->tmp_frames[i]);
+    ff_mpv_lookahead_end(s);
+    me_ahead_end(s);
 
     ff_free_picture_tables(&s->new_picture);
     ff_mpeg_unref_picture(s->avctx, &s->new_picture);
@@ -1205,8 +1284,9 @@ static int load_input_picture(MpegEncContext *s, const AVFrame *pic_arg)
     Picture *pic = NULL;
     int64_t pts;
     int i, display_picture_number = 0, ret;
-    int encoding_delay = s->max_b_frames ? s->max_b_frames
-                                         : (s->low_delay ? 0 : 1);
+    int encoding_delay = (s->max_b_frames ? s->max_b_frames
+                                          : (s->low_delay ? 0 : 1)) +
+                         s->rc_lookahead;
     int flush_offset = 1;
     int direct = 1;
 
@@ -1348,6 +1428,9 @@ static int load_input_picture(MpegEncContext *s, const AVFrame *pic_arg)
 
     s->input_picture[encoding_delay] = (Picture*) pic;
 
+    if (pic && s->rc_lookahead)
+        ff_mpv_lookahead_add(s, pic);
+
     return 0;
 }
 
@@ -1602,6 +1685,8 @@ static int select_input_picture(MpegEncContext *s)
                 }
             } else if (s->b_frame_strategy == 2) {
                 b_frames = estimate_best_b_count(s);
+            } else if (s->b_frame_strategy == 3) {
+                b_frames = ff_mpv_lookahead_b_count(s);
             }
 
             emms_c();
@@ -1706,11 +1791,13 @@ static void frame_end(MpegEncContext *s)
         const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(s->avctx->pix_fmt);
         int hshift = desc->log2_chroma_w;
         int vshift = desc->log2_chroma_h;
-        s->mpvencdsp.draw_edges(s->current_picture.f->data[0],
-                                s->current_picture.f->linesize[0],
-                                s->h_edge_pos, s->v_edge_pos,
-                                EDGE_WIDTH, EDGE_WIDTH,
-                                EDGE_TOP | EDGE_BOTTOM);
+        /* with me_ahead_report the luma edges are drawn row by row */
+        if (!s->me_ahead_report)
+            s->mpvencdsp.draw_edges(s->current_picture.f->data[0],
+                                    s->current_picture.f->linesize[0],
+                                    s->h_edge_pos, s->v_edge_pos,
+                                    EDGE_WIDTH, EDGE_WIDTH,
+                                    EDGE_TOP | EDGE_BOTTOM);
         s->mpvencdsp.draw_edges(s->current_picture.f->data[1],
                                 s->current_picture.f->linesize[1],
                                 s->h_edge_pos >> hshift,
@@ -2784,14 +2871,53 @@ static int pre_estimate_motion_thread(AVCodecContext *c, void *arg){
     return 0;
 }
 
+/*
+ * While a reference picture is coded with a B-frame's motion estimation
+ * running alongside, entries[2 * y] counts the completions of MB row y and
+ * entries[2 * y + 1] stays 0, so ff_thread_await_progress2() on the odd
+ * entry waits for the row. Row y uses the progress mutex y % thread_count.
+ */
+static void me_ahead_report_row(MpegEncContext *s, int mb_y)
+{
+    if (s->unrestricted_mv && !s->intra_only) {
+        int y     = 16 * mb_y;
+        int sides = (mb_y ? 0 : EDGE_TOP) |
+                    (mb_y == s->mb_height - 1 ? EDGE_BOTTOM : 0);
+
+        s->mpvencdsp.draw_edges(s->current_picture.f->data[0] + y * s->linesize,
+                                s->linesize, s->h_edge_pos,
+                                FFMIN(16, s->v_edge_pos - y),
+                                EDGE_WIDTH, EDGE_WIDTH, sides);
+    }
+    if (s->avctx->active_thread_type & FF_THREAD_SLICE)
+        ff_thread_report_progress2(s->avctx, 2 * mb_y,
+                                   mb_y % s->avctx->thread_count, 1);
+}
+
+/* wait for the reference rows needed by the ME of row s->mb_y, starting at
+ * row first; returns the first row not waited for */
+static int me_ahead_await_rows(MpegEncContext *s, int first)
+{
+    int last = FFMIN(s->mb_y + s->me_ahead_wait, s->mb_height - 1);
+    int y;
+
+    for (y = FFMAX(first, s->mb_y - s->me_ahead_wait); y <= last; y++)
+        ff_thread_await_progress2(s->avctx, 2 * y + 1,
+                                  (y + 1) % s->avctx->thread_count, 1);
+    return last + 1;
+}
+
 static int estimate_motion_thread(AVCodecContext *c, void *arg){
     MpegEncContext *s= *(void**)arg;
+    int awaited = 0;
 
     ff_check_alignment();
 
     s->me.dia_size= s->avctx->dia_size;
     s->first_slice_line=1;
     for(s->mb_y= s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
+        if (s->me_ahead_wait)
+            awaited = me_ahead_await_rows(s, awaited);
         s->mb_x=0; //for block init below
         ff_init_block_index(s);
         for(s->mb_x=0; s->mb_x < s->mb_width; s->mb_x++) {
@@ -3560,6 +3686,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             ff_dlog(s->avctx, "MB %d %d bits\n",
                     s->mb_x + s->mb_y * s->mb_stride, put_bits_count(&s->pb));
         }
+        if (s->me_ahead_report)
+            me_ahead_report_row(s, mb_y);
     }
 
     //not beautiful here but we must write it before flushing so it has to be here
@@ -3674,9 +3802,163 @@ static void set_frame_distances(MpegEncContext * s){
     }
 }
 
+/**
+ * Check whether the motion of the next picture in coding order can be
+ * estimated while the current one is coded. The next picture must be a
+ * B-frame, so its references are the ones of the current B-frame or are the
+ * current reference picture itself. In the latter case the ME reads the rows
+ * of the reference as they are coded, which needs a bounded search range.
+ */
+static int me_ahead_possible(MpegEncContext *s)
+{
+    Picture *next = s->reordered_input_picture[1];
+    int cmp = s->avctx->me_cmp | s->avctx->me_sub_cmp | s->avctx->mb_cmp;
+
+    if (!s->me_ahead_context[0] || !next ||
+        next->f->pict_type != AV_PICTURE_TYPE_B ||
+        (s->avctx->flags & (AV_CODEC_FLAG_PASS2 | AV_CODEC_FLAG_INTERLACED_ME)) ||
+        ((s->avctx->flags & AV_CODEC_FLAG_QSCALE) && s->adaptive_quant))
+        return 0;
+    if (s->pict_type == AV_PICTURE_TYPE_B)
+        return 1;
+    /* only the luma edges are drawn before frame_end() */
+    return s->avctx->me_range && !s->loop_filter &&
+           !(s->unrestricted_mv && (cmp & FF_CMP_CHROMA));
+}
+
+/**
+ * Set up the ME contexts of the next picture in coding order with the state
+ * encode_picture() will have when it gets to that picture.
+ */
+static int me_ahead_start(MpegEncContext *s)
+{
+    Picture *next = s->reordered_input_picture[1];
+    int16_t (*tables[5])[2] = { s->b_forw_mv_table_base,
+                                s->b_back_mv_table_base,
+                                s->b_bidir_forw_mv_table_base,
+                                s->b_bidir_back_mv_table_base,
+                                s->b_direct_mv_table_base };
+    int mv_table_size = (s->mb_height + 2) * s->mb_stride + 1;
+    int i, ret;
+
+    /* the ME reads neighbouring vectors it has not written yet */
+    for (i = 0; i < 5; i++)
+        memcpy(s->me_ahead_mv_table_base[i], tables[i],
+               mv_table_size * 2 * sizeof(int16_t));
+
+    for (i = 0; i < 3; i++) {
+        s->me_ahead_input->data[i]     = next->f->data[i];
+        s->me_ahead_input->linesize[i] = next->f->linesize[i];
+        if (!next->shared && !s->avctx->rc_buffer_size)
+            s->me_ahead_input->data[i] += INPLACE_OFFSET;
+    }
+
+    for (i = 0; i < s->slice_context_count; i++) {
+        MpegEncContext *t = s->me_ahead_context[i];
+
+        ret = ff_update_duplicate_context(t, s);
+        if (ret < 0)
+            return ret;
+
+        t->pict_type             = AV_PICTURE_TYPE_B;
+        t->current_picture_ptr   = next;
+        t->new_picture.f         = s->me_ahead_input;
+        t->current_picture.mc_mb_var = s->me_ahead_mc_mb_var;
+        t->mb_type               = s->me_ahead_mb_type;
+        t->b_forw_mv_table       = s->me_ahead_mv_table_base[0] + s->mb_stride + 1;
+        t->b_back_mv_table       = s->me_ahead_mv_table_base[1] + s->mb_stride + 1;
+        t->b_bidir_forw_mv_table = s->me_ahead_mv_table_base[2] + s->mb_stride + 1;
+        t->b_bidir_back_mv_table = s->me_ahead_mv_table_base[3] + s->mb_stride + 1;
+        t->b_direct_mv_table     = s->me_ahead_mv_table_base[4] + s->mb_stride + 1;
+        t->me_ahead_report       = 0;
+        t->me_ahead_wait         = 0;
+        if (s->me_ahead_report && (s->avctx->active_thread_type & FF_THREAD_SLICE))
+            t->me_ahead_wait = (s->avctx->me_range + 63) >> 4;
+        t->me.scene_change_score = 0;
+        t->me.mb_var_sum_temp    =
+        t->me.mc_mb_var_sum_temp = 0;
+        t->vbv_ignore_qmax       = 0;
+
+        /* with a fixed qscale the lambda is kept from the current picture */
+        if (!(s->avctx->flags & AV_CODEC_FLAG_QSCALE)) {
+            t->lambda = s->pict_type == AV_PICTURE_TYPE_B ?
+                        s->current_picture_ptr->f->quality :
+                        s->last_lambda_for[AV_PICTURE_TYPE_B];
+            update_qscale(t);
+        }
+        t->lambda  = (t->lambda  * s->me_penalty_compensation + 128) >> 8;
+        t->lambda2 = (t->lambda2 * (int64_t) s->me_penalty_compensation + 128) >> 8;
+
+        if (s->codec_id == AV_CODEC_ID_MPEG1VIDEO || s->codec_id == AV_CODEC_ID_MPEG2VIDEO ||
+            (s->h263_pred && !s->msmpeg4_version))
+            set_frame_distances(t);
+        if (ff_init_me(t) < 0)
+            return -1;
+    }
+
+    if (s->me_ahead_report && (s->avctx->active_thread_type & FF_THREAD_SLICE))
+        ff_reset_entries(s->avctx);
+    s->me_ahead_picture = next;
+    return 0;
+}
+
+/* use the ME results of the current picture computed by me_ahead_start() */
+static void me_ahead_finish(MpegEncContext *s)
+{
+    int16_t (**bases[5])[2] = { &s->b_forw_mv_table_base,
+                                &s->b_back_mv_table_base,
+                                &s->b_bidir_forw_mv_table_base,
+                                &s->b_bidir_back_mv_table_base,
+                                &s->b_direct_mv_table_base };
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        int16_t (*tmp)[2]            = *bases[i];
+        *bases[i]                    = s->me_ahead_mv_table_base[i];
+        s->me_ahead_mv_table_base[i] = tmp;
+    }
+    s->b_forw_mv_table       = s->b_forw_mv_table_base       + s->mb_stride + 1;
+    s->b_back_mv_table       = s->b_back_mv_table_base       + s->mb_stride + 1;
+    s->b_bidir_forw_mv_table = s->b_bidir_forw_mv_table_base + s->mb_stride + 1;
+    s->b_bidir_back_mv_table = s->b_bidir_back_mv_table_base + s->mb_stride + 1;
+    s->b_direct_mv_table     = s->b_direct_mv_table_base     + s->mb_stride + 1;
+    FFSWAP(uint16_t *, s->mb_type, s->me_ahead_mb_type);
+
+    /* the B-frame ME starts each slice with the penalty factors left over
+     * from the previous picture, keep them as if the ME had run here */
+    s->me.penalty_factor     = s->me_ahead_context[0]->me.penalty_factor;
+    s->me.sub_penalty_factor = s->me_ahead_context[0]->me.sub_penalty_factor;
+    s->me.mb_penalty_factor  = s->me_ahead_context[0]->me.mb_penalty_factor;
+
+    memcpy(s->current_picture.mc_mb_var, s->me_ahead_mc_mb_var,
+           s->mb_height * s->mb_stride * sizeof(uint16_t));
+}
+
+static int encode_ahead_thread(AVCodecContext *c, void *arg, int jobnr, int threadnr)
+{
+    MpegEncContext *s = arg;
+    MpegEncContext *t;
+    int ret, y;
+
+    /* the slices are handed out first, so no ME job can hold a thread
+     * a slice is waiting for */
+    if (jobnr >= s->slice_context_count)
+        return estimate_motion_thread(c, &s->me_ahead_context[jobnr - s->slice_context_count]);
+
+    t   = s->thread_context[jobnr];
+    ret = encode_thread(c, &t);
+    if (ret < 0 && t->me_ahead_report && (c->active_thread_type & FF_THREAD_SLICE)) {
+        /* do not leave the ME jobs waiting */
+        for (y = t->start_mb_y; y < t->end_mb_y; y++)
+            ff_thread_report_progress2(c, 2 * y, y % c->thread_count, 1);
+    }
+    return ret;
+}
+
 static int encode_picture(MpegEncContext *s, int picture_number)
 {
     int i, ret;
+    int ahead, start_ahead;
     int bits;
     int context_count = s->slice_context_count;
 
@@ -3724,6 +4006,14 @@ static int encode_picture(MpegEncContext *s, int picture_number)
         s->q_chroma_intra_matrix16 = s->q_intra_matrix16;
     }
 
+    ahead = s->me_ahead_picture &&
+            s->me_ahead_picture == s->reordered_input_picture[0];
+    if (ahead)
+        me_ahead_finish(s);
+    s->me_ahead_picture = NULL;
+    start_ahead     = me_ahead_possible(s);
+    s->me_ahead_report = start_ahead && s->pict_type != AV_PICTURE_TYPE_B;
+
     s->mb_intra=0; //for the rate distortion & bit compare functions
     for(i=1; i<context_count; i++){
         ret = ff_update_duplicate_context(s->thread_context[i], s);
@@ -3745,7 +4035,11 @@ static int encode_picture(MpegEncContext *s, int picture_number)
             }
         }
 
-        s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+        if (ahead) {
+            for (i = 0; i < context_count; i++)
+                merge_context_after_me(s, s->me_ahead_context[i]);
+        } else
+            s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     }else /* if(s->pict_type == AV_PICTURE_TYPE_I) */{
         /* I-Frame */
         for(i=0; i<s->mb_stride*s->mb_height; i++)
@@ -3939,7 +4233,10 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     for(i=1; i<context_count; i++){
         update_duplicate_context_after_me(s->thread_context[i], s);
     }
-    s->avctx->execute(s->avctx, encode_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+    if (start_ahead && me_ahead_start(s) >= 0)
+        s->avctx->execute2(s->avctx, encode_ahead_thread, s, NULL, 2 * context_count);
+    else
+        s->avctx->execute(s->avctx, encode_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     for(i=1; i<context_count; i++){
         if (s->pb.buf_end == s->thread_context[i]->pb.buf)
             set_put_bits_buffer_size(&s->pb, FFMIN(s->thread_context[i]->pb.buf_end - s->pb.buf, INT_MAX/8-32));
@@ -0,0 +1,632 @@
+/*
+ * MPEG video encoder lookahead
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Lookahead B-frame and scene cut decision (b_strategy 3).
+ *
+ * The luma planes of the queued input pictures are downscaled once, then the
+ * cost of coding each picture as P or B is estimated as the sum of the SATD
+ * of its 8x8 blocks after a small integer motion search, with an intra
+ * estimate as the upper bound. The block rows of a picture are independent
+ * and are estimated with avctx->execute, so slice threads share the work.
+ *
+ * With rc_lookahead, each input picture is also estimated as P from the
+ * previous one when it is queued. The rate control uses the frame costs to
+ * plan the VBV buffer over the queued pictures. The block costs are chained
+ * backwards in display order to find out how much of each block is
+ * referenced by the following pictures (the "MB-tree" of x264), which is
+ * turned into per-MB qscale factors for adaptive quantization.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+#include "avcodec.h"
+#include "me_cmp.h"
+#include "mpegutils.h"
+#include "mpegvideo.h"
+
+#define LOOKAHEAD_SIZE (MAX_B_FRAMES + 2)
+#define SEARCH_RANGE   16
+
+/* A picture whose inter cost exceeds this share of its intra cost, in
+ * percent, starts a new scene. */
+#define SCENECUT_RATIO 60
+
+typedef struct LookaheadPicture {
+    AVFrame *f;                 ///< downscaled luma
+    int display_picture_number;
+
+    /* estimate as P from the previous picture, for rc_lookahead */
+    int analysed;
+    int64_t cost, intra_cost;
+    int *block_cost;            ///< per block, at most the intra cost
+    int *block_intra_cost;
+    int16_t (*block_mv)[2];
+} LookaheadPicture;
+
+typedef struct LookaheadRow {
+    struct MpvLookaheadContext *la;
+    uint8_t *cur, *ref0, *ref1;
+    int y;
+    int64_t cost, intra_cost;
+    /* block costs and P vectors of the row, if not NULL */
+    int *block_cost, *block_intra_cost;
+    int16_t (*block_mv)[2];
+} LookaheadRow;
+
+typedef struct MpvLookaheadContext {
+    MECmpContext *mecc;
+    int scale;
+    int width, height;          ///< downscaled size
+    int mb_width, mb_height;    ///< in 8x8 blocks of the downscaled planes
+    int stride;
+
+    LookaheadPicture *pic;
+    int nb_pics;
+    /* pictures of the current decision, the last reference first */
+    LookaheadPicture *gop[LOOKAHEAD_SIZE];
+
+    LookaheadRow *rows;
+    /* cost of picture b predicted from p0 and p1, p1 == b for P */
+    int64_t cost[LOOKAHEAD_SIZE][LOOKAHEAD_SIZE][LOOKAHEAD_SIZE];
+    int64_t intra_cost[LOOKAHEAD_SIZE];
+
+    /* cost propagated into the blocks of a picture, and of its reference */
+    float *propagate[2];
+    float *mb_factor;
+} MpvLookaheadContext;
+
+av_cold int ff_mpv_lookahead_init(MpegEncContext *s)
+{
+    MpvLookaheadContext *la;
+    int i, ret;
+
+    la = av_mallocz(sizeof(*la));
+    if (!la)
+        return AVERROR(ENOMEM);
+    s->lookahead = la;
+
+    la->mecc      = &s->mecc;
+    la->scale     = FFMAX(s->brd_scale, 1);
+    la->width     = s->width  >> la->scale;
+    la->height    = s->height >> la->scale;
+    la->mb_width  = la->width  >> 3;
+    la->mb_height = la->height >> 3;
+
+    la->rows = av_mallocz_array(FFMAX(la->mb_height, 1), sizeof(*la->rows));
+    if (!la->rows)
+        return AVERROR(ENOMEM);
+
+    /* with rc_lookahead, the pictures from the oldest one not yet coded to
+     * the newest input must stay analysed */
+    la->nb_pics = LOOKAHEAD_SIZE;
+    if (s->rc_lookahead)
+        la->nb_pics = FFMAX(la->nb_pics,
+                            2 * s->max_b_frames + s->rc_lookahead + 4);
+    la->pic = av_mallocz_array(la->nb_pics, sizeof(*la->pic));
+    if (!la->pic)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < la->nb_pics; i++) {
+        LookaheadPicture *lp = &la->pic[i];
+        AVFrame *f = av_frame_alloc();
+        if (!f)
+            return AVERROR(ENOMEM);
+        lp->f = f;
+        lp->display_picture_number = -1;
+
+        f->format = AV_PIX_FMT_GRAY8;
+        f->width  = la->width;
+        f->height = la->height;
+        if ((ret = av_frame_get_buffer(f, 32)) < 0)
+            return ret;
+
+        if (s->rc_lookahead) {
+            int nb_blocks = la->mb_width * la->mb_height;
+
+            lp->block_cost       = av_malloc_array(nb_blocks, sizeof(*lp->block_cost));
+            lp->block_intra_cost = av_malloc_array(nb_blocks, sizeof(*lp->block_intra_cost));
+            lp->block_mv         = av_malloc_array(nb_blocks, sizeof(*lp->block_mv));
+            if (!lp->block_cost || !lp->block_intra_cost || !lp->block_mv)
+                return AVERROR(ENOMEM);
+        }
+    }
+    la->stride = la->pic[0].f->linesize[0];
+
+    if (s->rc_lookahead) {
+        int nb_blocks = la->mb_width * la->mb_height;
+
+        la->propagate[0] = av_malloc_array(nb_blocks, sizeof(*la->propagate[0]));
+        la->propagate[1] = av_malloc_array(nb_blocks, sizeof(*la->propagate[1]));
+        la->mb_factor    = av_malloc_array(s->mb_stride * s->mb_height,
+                                           sizeof(*la->mb_factor));
+        if (!la->propagate[0] || !la->propagate[1] || !la->mb_factor)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+av_cold void ff_mpv_lookahead_end(MpegEncContext *s)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    int i;
+
+    if (!la)
+        return;
+
+    for (i = 0; i < la->nb_pics && la->pic; i++) {
+        av_frame_free(&la->pic[i].f);
+        av_freep(&la->pic[i].block_cost);
+        av_freep(&la->pic[i].block_intra_cost);
+        av_freep(&la->pic[i].block_mv);
+    }
+    av_freep(&la->pic);
+    av_freep(&la->rows);
+    av_freep(&la->propagate[0]);
+    av_freep(&la->propagate[1]);
+    av_freep(&la->mb_factor);
+    av_freep(&s->lookahead);
+}
+
+static LookaheadPicture *find_lowres(MpvLookaheadContext *la, int num)
+{
+    int i;
+
+    for (i = 0; i < la->nb_pics; i++)
+        if (la->pic[i].display_picture_number == num)
+            return &la->pic[i];
+    return NULL;
+}
+
+/**
+ * Get the downscaled luma of a picture, reusing the one made for an earlier
+ * decision if the picture was already in the lookahead.
+ *
+ * @param shifted  the picture is a queued input, stored at INPLACE_OFFSET
+ *                 unless there is a VBV, see load_input_picture()
+ * @param nb_used  number of pictures already picked for this decision
+ */
+static LookaheadPicture *get_lowres(MpegEncContext *s, Picture *p,
+                                    int shifted, int nb_used)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    int num = p->f->display_picture_number;
+    LookaheadPicture *lp = find_lowres(la, num);
+    uint8_t *data;
+    int i, j;
+
+    if (lp)
+        return lp;
+
+    /* replace the oldest picture not used by this decision */
+    for (i = 0; i < la->nb_pics; i++) {
+        for (j = 0; j < nb_used; j++)
+            if (la->gop[j] == &la->pic[i])
+                break;
+        if (j == nb_used && (!lp || la->pic[i].display_picture_number <
+                                    lp->display_picture_number))
+            lp = &la->pic[i];
+    }
+
+    data = p->f->data[0];
+    if (shifted && !p->shared && !s->avctx->rc_buffer_size)
+        data += INPLACE_OFFSET;
+    s->mpvencdsp.shrink[la->scale](lp->f->data[0], la->stride,
+                                   data, p->f->linesize[0],
+                                   la->width, la->height);
+    lp->display_picture_number = num;
+    lp->analysed               = 0;
+
+    return lp;
+}
+
+/**
+ * Integer diamond search of the 8x8 block at (x, y), starting from the
+ * better of the zero vector and mv, the vector of the block on the left.
+ * @return the SATD of the best match, whose vector is stored in mv
+ */
+static int search_block(MpvLookaheadContext *la, uint8_t *cur, uint8_t *ref,
+                        int x, int y, int mv[2])
+{
+    static const int8_t dia[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    const ptrdiff_t stride = la->stride;
+    const me_cmp_func sad  = la->mecc->sad[1];
+    const int min_x = -FFMIN(x, SEARCH_RANGE);
+    const int min_y = -FFMIN(y, SEARCH_RANGE);
+    const int max_x =  FFMIN(la->width  - 8 - x, SEARCH_RANGE);
+    const int max_y =  FFMIN(la->height - 8 - y, SEARCH_RANGE);
+    uint8_t *src = cur + x + y * stride;
+    int bx = 0, by = 0, best, d, i;
+
+    ref += x + y * stride;
+    best = sad(NULL, src, ref, stride, 8);
+
+    mv[0] = av_clip(mv[0], min_x, max_x);
+    mv[1] = av_clip(mv[1], min_y, max_y);
+    if (mv[0] || mv[1]) {
+        d = sad(NULL, src, ref + mv[0] + mv[1] * stride, stride, 8);
+        if (d < best) {
+            best = d;
+            bx   = mv[0];
+            by   = mv[1];
+        }
+    }
+
+    for (;;) {
+        int cx = bx, cy = by;
+
+        for (i = 0; i < 4; i++) {
+            int mx = cx + dia[i][0];
+            int my = cy + dia[i][1];
+
+            if (mx < min_x || mx > max_x || my < min_y || my > max_y)
+                continue;
+            d = sad(NULL, src, ref + mx + my * stride, stride, 8);
+            if (d < best) {
+                best = d;
+                bx   = mx;
+                by   = my;
+            }
+        }
+        if (bx == cx && by == cy)
+            break;
+    }
+
+    mv[0] = bx;
+    mv[1] = by;
+    return la->mecc->hadamard8_diff[1](NULL, src, ref + bx + by * stride,
+                                       stride, 8);
+}
+
+static int estimate_row(AVCodecContext *avctx, void *arg)
+{
+    LookaheadRow *row       = arg;
+    MpvLookaheadContext *la = row->la;
+    const ptrdiff_t stride  = la->stride;
+    LOCAL_ALIGNED_16(uint8_t, blk,  [64]);
+    LOCAL_ALIGNED_16(uint8_t, pred, [64]);
+    int mv0[2] = { 0 }, mv1[2] = { 0 };
+    int x, i, j;
+
+    row->cost = row->intra_cost = 0;
+
+    for (x = 0; x < la->mb_width * 8; x += 8) {
+        uint8_t *src = row->cur + x + row->y * stride;
+        int sum = 0, intra, cost;
+
+        for (j = 0; j < 8; j++) {
+            memcpy(blk + 8 * j, src + j * stride, 8);
+            for (i = 0; i < 8; i++)
+                sum += src[i + j * stride];
+        }
+        memset(pred, (sum + 32) >> 6, 64);
+        cost = intra = la->mecc->hadamard8_diff[1](NULL, blk, pred, 8, 8);
+
+        if (row->ref0)
+            cost = FFMIN(cost, search_block(la, row->cur, row->ref0, x, row->y, mv0));
+        if (row->ref1) {
+            const uint8_t *p0, *p1;
+
+            cost = FFMIN(cost, search_block(la, row->cur, row->ref1, x, row->y, mv1));
+            p0 = row->ref0 + x + mv0[0] + (row->y + mv0[1]) * stride;
+            p1 = row->ref1 + x + mv1[0] + (row->y + mv1[1]) * stride;
+            for (j = 0; j < 8; j++)
+                for (i = 0; i < 8; i++)
+                    pred[i + 8 * j] = (p0[i + j * stride] + p1[i + j * stride] + 1) >> 1;
+            cost = FFMIN(cost, la->mecc->hadamard8_diff[1](NULL, blk, pred, 8, 8));
+        }
+
+        if (row->block_cost) {
+            row->block_cost[x >> 3]       = cost;
+            row->block_intra_cost[x >> 3] = intra;
+            row->block_mv[x >> 3][0]      = mv0[0];
+            row->block_mv[x >> 3][1]      = mv0[1];
+        }
+
+        row->intra_cost += intra;
+        row->cost       += cost;
+    }
+
+    return 0;
+}
+
+/**
+ * Estimate the cost of coding picture b of the decision as P from p0 if
+ * p1 == b, as B from p0 and p1 otherwise.
+ */
+static int64_t frame_cost(MpegEncContext *s, int p0, int p1, int b)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    int64_t cost = 0, intra_cost = 0;
+    int y;
+
+    if (la->cost[p0][p1][b] >= 0)
+        return la->cost[p0][p1][b];
+
+    for (y = 0; y < la->mb_height; y++) {
+        LookaheadRow *row = &la->rows[y];
+
+        row->la   = la;
+        row->cur  = la->gop[b]->f->data[0];
+        row->ref0 = la->gop[p0]->f->data[0];
+        row->ref1 = p1 != b ? la->gop[p1]->f->data[0] : NULL;
+        row->y    = 8 * y;
+        row->block_cost = NULL;
+    }
+    s->avctx->execute(s->avctx, estimate_row, la->rows, NULL,
+                      la->mb_height, sizeof(*la->rows));
+
+    for (y = 0; y < la->mb_height; y++) {
+        cost       += la->rows[y].cost;
+        intra_cost += la->rows[y].intra_cost;
+    }
+    la->intra_cost[b] = intra_cost;
+
+    return la->cost[p0][p1][b] = cost;
+}
+
+int ff_mpv_lookahead_b_count(MpegEncContext *s)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    int64_t best_cost = INT64_MAX;
+    int i, j, b, n, best_b_count = 0;
+
+    if (!la->mb_width || !la->mb_height) {
+        for (b = s->max_b_frames; b && !s->input_picture[b]; b--);
+        return b;
+    }
+
+    la->gop[0] = get_lowres(s, s->next_picture_ptr, 0, 0);
+    for (n = 1; n < s->max_b_frames + 2 && s->input_picture[n - 1]; n++)
+        la->gop[n] = get_lowres(s, s->input_picture[n - 1], 1, n);
+    memset(la->cost, -1, sizeof(la->cost));
+
+    /* A scene cut, or an I-frame requested by the user, ends the pictures
+     * to decide for. */
+    for (i = 1; i < n; i++) {
+        AVFrame *f = s->input_picture[i - 1]->f;
+
+        if (!f->pict_type && s->scenechange_threshold < 1000000000 &&
+            frame_cost(s, i - 1, i, i) * 100 > la->intra_cost[i] * SCENECUT_RATIO)
+            f->pict_type = AV_PICTURE_TYPE_I;
+        if (f->pict_type == AV_PICTURE_TYPE_I) {
+            n = i + 1;
+            break;
+        }
+    }
+
+    /* Try each number of B-frames between the references, as
+     * b_frame_strategy 2 does, over all the pictures. */
+    for (j = 0; j < n - 1 && j <= s->max_b_frames; j++) {
+        int64_t cost = 0;
+        int p0 = 0;
+
+        for (i = 1; i < n; i++) {
+            if (i % (j + 1) && i != n - 1)
+                continue;
+            cost += frame_cost(s, p0, i, i);
+            for (b = p0 + 1; b < i; b++)
+                cost += frame_cost(s, p0, i, b);
+            p0 = i;
+        }
+
+        if (cost < best_cost) {
+            best_cost    = cost;
+            best_b_count = j;
+        }
+    }
+
+    return best_b_count;
+}
+
+void ff_mpv_lookahead_add(MpegEncContext *s, Picture *pic)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    LookaheadPicture *lp, *ref;
+    int y;
+
+    if (!la->mb_width || !la->mb_height)
+        return;
+
+    lp  = get_lowres(s, pic, 1, 0);
+    ref = find_lowres(la, lp->display_picture_number - 1);
+
+    for (y = 0; y < la->mb_height; y++) {
+        LookaheadRow *row = &la->rows[y];
+
+        row->la               = la;
+        row->cur              = lp->f->data[0];
+        row->ref0             = ref ? ref->f->data[0] : NULL;
+        row->ref1             = NULL;
+        row->y                = 8 * y;
+        row->block_cost       = lp->block_cost       + y * la->mb_width;
+        row->block_intra_cost = lp->block_intra_cost + y * la->mb_width;
+        row->block_mv         = lp->block_mv         + y * la->mb_width;
+    }
+    s->avctx->execute(s->avctx, estimate_row, la->rows, NULL,
+                      la->mb_height, sizeof(*la->rows));
+
+    lp->cost = lp->intra_cost = 0;
+    for (y = 0; y < la->mb_height; y++) {
+        lp->cost       += la->rows[y].cost;
+        lp->intra_cost += la->rows[y].intra_cost;
+    }
+    lp->analysed = 1;
+}
+
+static int add_plan_entry(MpvLookaheadContext *la, int num, int pict_type,
+                          int64_t *cost, int *types)
+{
+    LookaheadPicture *lp = find_lowres(la, num);
+
+    if (!lp || !lp->analysed)
+        return 0;
+    *cost  = pict_type == AV_PICTURE_TYPE_I ? lp->intra_cost : lp->cost;
+    *types = pict_type;
+    return 1;
+}
+
+int ff_mpv_lookahead_plan(MpegEncContext *s, int64_t *cost, int *pict_type,
+                          int max)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    int i, n = 0, undecided = 0;
+    int last = s->picture_number;
+
+    if (!la->mb_width || !la->mb_height || !max)
+        return 0;
+
+    if (!add_plan_entry(la, s->picture_number, s->pict_type, cost, pict_type))
+        return 0;
+    n++;
+
+    for (i = 1; n < max && s->reordered_input_picture[i]; i++) {
+        AVFrame *f = s->reordered_input_picture[i]->f;
+
+        if (!add_plan_entry(la, f->display_picture_number, f->pict_type,
+                            &cost[n], &pict_type[n]))
+            return n;
+        last = FFMAX(last, f->display_picture_number);
+        n++;
+    }
+
+    /* The input queue still starts with the pictures reordered above. The
+     * types of the others are not decided yet, assume max_b_frames B-frames
+     * before each P-frame. */
+    for (i = 0; n < max && s->input_picture[i]; i++) {
+        AVFrame *f = s->input_picture[i]->f;
+        int type   = f->pict_type;
+
+        if (f->display_picture_number <= last)
+            continue;
+
+        if (!type)
+            type = ++undecided % (s->max_b_frames + 1) ? AV_PICTURE_TYPE_B
+                                                       : AV_PICTURE_TYPE_P;
+        if (!add_plan_entry(la, f->display_picture_number, type,
+                            &cost[n], &pict_type[n]))
+            break;
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Add the share of amount propagated from the block at (bx, by) with the
+ * vector mv to the blocks of the reference it overlaps.
+ */
+static void propagate_block(MpvLookaheadContext *la, float *dst,
+                            int bx, int by, const int16_t *mv, float amount)
+{
+    int x  = 8 * bx + mv[0];
+    int y  = 8 * by + mv[1];
+    int fx = x & 7, fy = y & 7;
+    int i, j;
+
+    x >>= 3;
+    y >>= 3;
+    for (j = 0; j < 2; j++) {
+        int wy = j ? fy : 8 - fy;
+
+        if (!wy || y + j >= la->mb_height)
+            continue;
+        for (i = 0; i < 2; i++) {
+            int wx = i ? fx : 8 - fx;
+
+            if (wx && x + i < la->mb_width)
+                dst[x + i + (y + j) * la->mb_width] += amount * (wx * wy) / 64;
+        }
+    }
+}
+
+const float *ff_mpv_lookahead_mb_factors(MpegEncContext *s, float strength)
+{
+    MpvLookaheadContext *la = s->lookahead;
+    LookaheadPicture *cur, *chain[MAX_RC_LOOKAHEAD];
+    int nb_blocks = la->mb_width * la->mb_height;
+    float *in  = la->propagate[0];
+    float *out = la->propagate[1];
+    double log_sum = 0;
+    float norm;
+    int b, i, n, mb_x, mb_y;
+
+    if (!nb_blocks || s->pict_type == AV_PICTURE_TYPE_B)
+        return NULL;
+    cur = find_lowres(la, s->picture_number);
+    if (!cur || !cur->analysed)
+        return NULL;
+
+    /* each picture is assumed to be predicted from the previous one */
+    for (n = 0; n < s->rc_lookahead; n++) {
+        chain[n] = find_lowres(la, s->picture_number + n + 1);
+        if (!chain[n] || !chain[n]->analysed)
+            break;
+    }
+    if (!n)
+        return NULL;
+
+    memset(in, 0, nb_blocks * sizeof(*in));
+    for (i = n - 1; i >= 0; i--) {
+        LookaheadPicture *lp = chain[i];
+
+        memset(out, 0, nb_blocks * sizeof(*out));
+        for (b = 0; b < nb_blocks; b++) {
+            int intra = lp->block_intra_cost[b];
+            int inter = lp->block_cost[b];
+
+            if (inter < intra)
+                propagate_block(la, out, b % la->mb_width, b / la->mb_width,
+                                lp->block_mv[b],
+                                (intra + in[b]) * (intra - inter) / intra);
+        }
+        FFSWAP(float *, in, out);
+    }
+
+    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
+        int by = FFMIN((16 * mb_y >> la->scale) >> 3, la->mb_height - 1);
+
+        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
+            int bx    = FFMIN((16 * mb_x >> la->scale) >> 3, la->mb_width - 1);
+            int intra = cur->block_intra_cost[bx + by * la->mb_width];
+            float f   = 1.0;
+
+            if (intra)
+                f = powf((intra + in[bx + by * la->mb_width]) / intra, strength);
+            la->mb_factor[mb_x + mb_y * s->mb_stride] = f;
+            log_sum += logf(f);
+        }
+    }
+
+    /* only redistribute the bits within the picture, the frame level rate
+     * control already accounts for the picture as a whole */
+    norm = expf(-log_sum / (s->mb_width * s->mb_height));
+    for (mb_y = 0; mb_y < s->mb_height; mb_y++)
+        for (mb_x = 0; mb_x < s->mb_width; mb_x++)
+            la->mb_factor[mb_x + mb_y * s->mb_stride] *= norm;
+
+    return la->mb_factor;
+}
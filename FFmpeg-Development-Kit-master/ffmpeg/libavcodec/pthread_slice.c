@@ -32,6 +32,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
+#include "libavutil/executor_internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -39,21 +40,13 @@ typedef int (action_func)(AVCodecContext *c, void *arg);
 typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
 
 typedef struct SliceThreadContext {
-    pthread_t *workers;
+    AVExecutorClient *client;
     action_func *func;
     action_func2 *func2;
     void *args;
     int *rets;
-    int job_count;
     int job_size;
 
-    pthread_cond_t last_job_cond;
-    pthread_cond_t current_job_cond;
-    pthread_mutex_t current_job_lock;
-    unsigned current_execute;
-    int current_job;
-    int done;
-
     int *entries;
     int entries_count;
     int thread_count;
@@ -61,43 +54,16 @@ typedef struct SliceThreadContext {
     pthread_mutex_t *progress_mutex;
 } SliceThreadContext;
 
-static void* attribute_align_arg worker(void *v)
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
-    AVCodecContext *avctx = v;
+    AVCodecContext *avctx = priv;
     SliceThreadContext *c = avctx->internal->thread_ctx;
-    unsigned last_execute = 0;
-    int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
-    int self_id;
-
-    pthread_mutex_lock(&c->current_job_lock);
-    self_id = c->current_job++;
-    for (;;){
-        int ret;
-        while (our_job >= c->job_count) {
-            if (c->current_job == thread_count + c->job_count)
-                pthread_cond_signal(&c->last_job_cond);
-
-            while (last_execute == c->current_execute && !c->done)
-                pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
-            last_execute = c->current_execute;
-            our_job = self_id;
-
-            if (c->done) {
-                pthread_mutex_unlock(&c->current_job_lock);
-                return NULL;
-            }
-        }
-        pthread_mutex_unlock(&c->current_job_lock);
-
-        ret = c->func ? c->func(avctx, (char*)c->args + our_job*c->job_size):
-                                c->func2(avctx, c->args, our_job, self_id);
-        if (c->rets)
-            c->rets[our_job%c->job_count] = ret;
+    int ret;
 
-        pthread_mutex_lock(&c->current_job_lock);
-        our_job = c->current_job++;
-    }
+    ret = c->func ? c->func(avctx, (char*)c->args + jobnr*c->job_size):
+                    c->func2(avctx, c->args, jobnr, threadnr);
+    if (c->rets)
+        c->rets[jobnr] = ret;
 }
 
 void ff_slice_thread_free(AVCodecContext *avctx)
@@ -105,40 +71,20 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     SliceThreadContext *c = avctx->internal->thread_ctx;
     int i;
 
-    pthread_mutex_lock(&c->current_job_lock);
-    c->done = 1;
-    pthread_cond_broadcast(&c->current_job_cond);
-    for (i = 0; i < c->thread_count; i++)
-        pthread_cond_broadcast(&c->progress_cond[i]);
-    pthread_mutex_unlock(&c->current_job_lock);
-
-    for (i=0; i<avctx->thread_count; i++)
-         pthread_join(c->workers[i], NULL);
+    avpriv_executor_client_free(&c->client);
 
     for (i = 0; i < c->thread_count; i++) {
         pthread_mutex_destroy(&c->progress_mutex[i]);
         pthread_cond_destroy(&c->progress_cond[i]);
     }
 
-    pthread_mutex_destroy(&c->current_job_lock);
-    pthread_cond_destroy(&c->current_job_cond);
-    pthread_cond_destroy(&c->last_job_cond);
-
     av_freep(&c->entries);
     av_freep(&c->progress_mutex);
     av_freep(&c->progress_cond);
 
-    av_freep(&c->workers);
     av_freep(&avctx->internal->thread_ctx);
 }
 
-static av_always_inline void thread_park_workers(SliceThreadContext *c, int thread_count)
-{
-    while (c->current_job != thread_count + c->job_count)
-        pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
-    pthread_mutex_unlock(&c->current_job_lock);
-}
-
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
     SliceThreadContext *c = avctx->internal->thread_ctx;
@@ -149,10 +95,6 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     if (job_count <= 0)
         return 0;
 
-    pthread_mutex_lock(&c->current_job_lock);
-
-    c->current_job = avctx->thread_count;
-    c->job_count = job_count;
     c->job_size = job_size;
     c->args = arg;
     c->func = func;
@@ -161,10 +103,8 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     } else {
         c->rets = NULL;
     }
-    c->current_execute++;
-    pthread_cond_broadcast(&c->current_job_cond);
 
-    thread_park_workers(c, avctx->thread_count);
+    avpriv_executor_execute(c->client, job_count);
 
     return 0;
 }
@@ -178,7 +118,6 @@ static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg
 
 int ff_slice_thread_init(AVCodecContext *avctx)
 {
-    int i;
     SliceThreadContext *c;
     int thread_count = avctx->thread_count;
 
@@ -212,31 +151,16 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     if (!c)
         return -1;
 
-    c->workers = av_mallocz_array(thread_count, sizeof(pthread_t));
-    if (!c->workers) {
+    // the jobs run on the process-wide executor, no threads are started here
+    if (avpriv_executor_client_create(&c->client, avctx, worker_func, thread_count,
+                                      av_codec_is_encoder(avctx->codec) ?
+                                          AV_EXECUTOR_PRIORITY_ENCODER :
+                                          AV_EXECUTOR_PRIORITY_DECODER) < 0) {
         av_free(c);
         return -1;
     }
 
     avctx->internal->thread_ctx = c;
-    c->current_job = 0;
-    c->job_count = 0;
-    c->job_size = 0;
-    c->done = 0;
-    pthread_cond_init(&c->current_job_cond, NULL);
-    pthread_cond_init(&c->last_job_cond, NULL);
-    pthread_mutex_init(&c->current_job_lock, NULL);
-    pthread_mutex_lock(&c->current_job_lock);
-    for (i=0; i<thread_count; i++) {
-        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
-           pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
-           return -1;
-        }
-    }
-
-    thread_park_workers(c, thread_count);
 
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
@@ -250,7 +174,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
     entries[field] +=n;
-    pthread_cond_signal(&p->progress_cond[thread]);
+    pthread_cond_broadcast(&p->progress_cond[thread]);
     pthread_mutex_unlock(&p->progress_mutex[thread]);
 }
 
@@ -35,6 +35,11 @@
 #include "mpegvideo.h"
 #include "libavutil/eval.h"
 
+/* initial guess of the bits of a picture at qscale 1 per unit of its
+ * rc_lookahead cost, by picture type; B-frames cost much less than their
+ * estimate as P-frames */
+static const double lookahead_coeff[5] = { 1.0, 0.6, 1.0, 0.1, 1.0 };
+
 static int init_pass2(MpegEncContext *s);
 static double get_qscale(MpegEncContext *s, RateControlEntry *rce,
                          double rate_factor, int frame_num);
@@ -154,6 +159,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         rcc->pred[i].count = 1.0;
         rcc->pred[i].decay = 0.4;
 
+        rcc->lookahead_pred[i].coeff = FF_QP2LAMBDA * lookahead_coeff[i];
+        rcc->lookahead_pred[i].count = 1.0;
+        rcc->lookahead_pred[i].decay = 0.4;
+
         rcc->i_cplx_sum [i] =
         rcc->p_cplx_sum [i] =
         rcc->mv_bits_sum[i] =
@@ -165,6 +174,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     rcc->buffer_index = s->avctx->rc_initial_buffer_occupancy;
     if (!rcc->buffer_index)
         rcc->buffer_index = s->avctx->rc_buffer_size * 3 / 4;
+    rcc->lookahead_buffer_index = s->bit_rate * 3 / 4;
 
     if (s->avctx->flags & AV_CODEC_FLAG_PASS2) {
         int i;
@@ -361,6 +371,12 @@ int ff_vbv_update(MpegEncContext *s, int frame_size)
 
             return stuffing;
         }
+    } else if (s->rc_lookahead && s->bit_rate) {
+        /* the virtual buffer of lookahead_vbv_qscale(), one second at the
+         * target bitrate, where unused bits are lost */
+        rcc->lookahead_buffer_index = FFMAX(rcc->lookahead_buffer_index - frame_size, 0);
+        rcc->lookahead_buffer_index = FFMIN(rcc->lookahead_buffer_index + s->bit_rate / fps,
+                                            s->bit_rate);
     }
     return 0;
 }
@@ -622,6 +638,88 @@ static void update_predictor(Predictor *p, double q, double var, double size)
     p->coeff += new_coeff;
 }
 
+/**
+ * Get the qscale of a picture type from the one of P-frames, or the inverse.
+ */
+static double type_qscale(AVCodecContext *a, double q, int pict_type, int inverse)
+{
+    double factor = 1.0, offset = 0.0;
+
+    if (pict_type == AV_PICTURE_TYPE_I) {
+        factor = FFABS(a->i_quant_factor);
+        offset = a->i_quant_offset;
+    } else if (pict_type == AV_PICTURE_TYPE_B) {
+        factor = FFABS(a->b_quant_factor);
+        offset = a->b_quant_offset;
+    }
+    return inverse ? (q - offset) / factor : q * factor + offset;
+}
+
+/**
+ * Raise q until the VBV buffer is predicted not to run dry while the
+ * analysed pictures are coded and to end at least half full, lower it while
+ * the buffer would get too full with a minimum rate, as x264 does.
+ * Without a VBV, a buffer of one second filled at the target bitrate is
+ * used instead, so that the bits of scene changes are spread over it.
+ */
+static double lookahead_vbv_qscale(MpegEncContext *s, double q,
+                                   int64_t *cur_cost)
+{
+    RateControlContext *rcc   = &s->rc_context;
+    AVCodecContext *a         = s->avctx;
+    const int has_vbv         = a->rc_buffer_size && a->rc_max_rate;
+    const double buffer_size  = has_vbv ? a->rc_buffer_size : s->bit_rate;
+    const double buffer_index = has_vbv ? rcc->buffer_index : rcc->lookahead_buffer_index;
+    const double fps          = get_fps(a);
+    const double min_rate     = has_vbv ? a->rc_min_rate / fps : 0;
+    const double max_rate     = has_vbv ? a->rc_max_rate / fps : s->bit_rate / fps;
+    int64_t cost[MAX_RC_LOOKAHEAD + 2 * MAX_B_FRAMES + 2];
+    int pict_type[FF_ARRAY_ELEMS(cost)];
+    int i, n, qmin, qmax, raised = 0, lowered = 0;
+    double q_p, fill, low_fill, high_fill;
+
+    n = ff_mpv_lookahead_plan(s, cost, pict_type, FF_ARRAY_ELEMS(cost));
+    if (!n)
+        return q;
+    *cur_cost = cost[0];
+
+    get_qminmax(&qmin, &qmax, s, s->pict_type);
+    low_fill  = FFMIN(buffer_index + n * max_rate / 2, buffer_size / 2);
+    high_fill = av_clipd(buffer_index - n * max_rate / 2,
+                         buffer_size * 0.8, buffer_size);
+
+    for (;;) {
+        int underflow = 0;
+
+        q_p  = type_qscale(a, q, s->pict_type, 1);
+        fill = buffer_index;
+        for (i = 0; i < n; i++) {
+            double pq = i ? type_qscale(a, q_p, pict_type[i], 0) : q;
+
+            fill -= predict_size(&rcc->lookahead_pred[pict_type[i]],
+                                 FFMAX(pq, 1), cost[i]);
+            if (fill < 0)
+                underflow = 1;
+            fill += av_clipd(buffer_size - fill - 1, min_rate, max_rate);
+        }
+
+        if ((underflow || fill < low_fill) && q < qmax && !lowered) {
+            q = FFMIN(q * 1.01, qmax);
+            raised = 1;
+        } else if (min_rate && fill > high_fill && q > qmin && !raised) {
+            q = FFMAX(q / 1.01, qmin);
+            lowered = 1;
+        } else
+            break;
+    }
+
+    if (s->avctx->debug & FF_DEBUG_RC)
+        av_log(s->avctx, AV_LOG_DEBUG,
+               "lookahead: %d pictures, qscale %f, buffer %f -> %f\n",
+               n, q, buffer_index, fill);
+    return q;
+}
+
 static void adaptive_quantization(MpegEncContext *s, double q)
 {
     int i;
@@ -640,6 +738,9 @@ static void adaptive_quantization(MpegEncContext *s, double q)
     Picture *const pic               = &s->current_picture;
     const int mb_width               = s->mb_width;
     const int mb_height              = s->mb_height;
+    /* lower the qscale of the MBs the following pictures refer to */
+    const float *lookahead_factor    = s->rc_lookahead ?
+        ff_mpv_lookahead_mb_factors(s, 5.0 * (1.0 - s->avctx->qcompress) / 6.0) : NULL;
 
     for (i = 0; i < s->mb_num; i++) {
         const int mb_xy = s->mb_index2xy[i];
@@ -689,6 +790,9 @@ static void adaptive_quantization(MpegEncContext *s, double q)
 
         factor *= 1.0 - border_masking * mb_factor;
 
+        if (lookahead_factor)
+            factor *= lookahead_factor[mb_xy];
+
         if (factor < 0.00001)
             factor = 0.00001;
 
@@ -765,7 +869,7 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
     RateControlEntry local_rce, *rce;
     double bits;
     double rate_factor;
-    int64_t var;
+    int64_t var, lookahead_cost = 0;
     const int pict_type = s->pict_type;
     Picture * const pic = &s->current_picture;
     emms_c();
@@ -788,6 +892,11 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
                          rcc->last_qscale,
                          sqrt(last_var),
                          s->frame_bits - s->stuffing_bits);
+        if (rcc->last_lookahead_cost)
+            update_predictor(&rcc->lookahead_pred[s->last_pict_type],
+                             rcc->last_qscale,
+                             rcc->last_lookahead_cost,
+                             s->frame_bits - s->stuffing_bits);
     }
 
     if (s->avctx->flags & AV_CODEC_FLAG_PASS2) {
@@ -882,6 +991,10 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
 
         q = modify_qscale(s, rce, q, picture_number);
 
+        if (s->rc_lookahead &&
+            (a->rc_buffer_size ? a->rc_max_rate : s->bit_rate))
+            q = lookahead_vbv_qscale(s, q, &lookahead_cost);
+
         rcc->pass1_wanted_bits += s->bit_rate / fps;
 
         av_assert0(q > 0.0);
@@ -910,9 +1023,10 @@ float ff_rate_estimate_qscale(MpegEncContext *s, int dry_run)
         q = (int)(q + 0.5);
 
     if (!dry_run) {
-        rcc->last_qscale        = q;
-        rcc->last_mc_mb_var_sum = pic->mc_mb_var_sum;
-        rcc->last_mb_var_sum    = pic->mb_var_sum;
+        rcc->last_qscale         = q;
+        rcc->last_mc_mb_var_sum  = pic->mc_mb_var_sum;
+        rcc->last_mb_var_sum     = pic->mb_var_sum;
+        rcc->last_lookahead_cost = lookahead_cost;
     }
     return q;
 }
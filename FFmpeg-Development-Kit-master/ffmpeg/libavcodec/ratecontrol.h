@@ -65,6 +65,9 @@ typedef struct RateControlContext{
     RateControlEntry *entry;
     double buffer_index;          ///< amount of bits in the video/audio buffer
     Predictor pred[5];
+    Predictor lookahead_pred[5];  ///< frame size from the rc_lookahead cost
+    int64_t last_lookahead_cost;
+    double lookahead_buffer_index;///< fill of the virtual buffer rc_lookahead plans with when there is no VBV
     double short_term_qsum;       ///< sum of recent qscales
     double short_term_qcount;     ///< count of recent qscales
     double pass1_rc_eq_output_sum;///< sum of the output of the rc equation, this is used for normalization
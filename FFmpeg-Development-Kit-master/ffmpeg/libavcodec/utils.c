@@ -557,8 +557,8 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
             if (size[i]) {
                 pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
                                                      CONFIG_MEMORY_POISONING ?
-                                                        NULL :
-                                                        av_buffer_allocz);
+                                                        av_buffer_alloc_large :
+                                                        av_buffer_allocz_large);
                 if (!pool->pools[i]) {
                     ret = AVERROR(ENOMEM);
                     goto fail;
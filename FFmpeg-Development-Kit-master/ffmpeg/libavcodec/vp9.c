@@ -33,6 +33,7 @@
 #include "vp9dsp.h"
 #include "libavutil/avassert.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 
 #define VP9_SYNCCODE 0x498342
 
@@ -61,7 +62,7 @@ typedef struct VP9Context {
     VP56RangeCoder c;
     VP56RangeCoder *c_b;
     unsigned c_b_size;
-    VP9Block *b_base, *b;
+    VP9Block *b;
     int pass;
     int row, row7, col, col7;
     uint8_t *dst[3];
@@ -155,6 +156,7 @@ typedef struct VP9Context {
 
     // block reconstruction intermediates
     int block_alloc_using_2pass;
+    VP9Block *b_base;
     int16_t *block_base, *block, *uvblock_base[2], *uvblock[2];
     uint8_t *eob_base, *uveob_base[2], *eob, *uveob[2];
     struct { int x, y; } min_mv, max_mv;
@@ -162,6 +164,17 @@ typedef struct VP9Context {
     DECLARE_ALIGNED(32, uint8_t, tmp_uv)[2][64 * 64 * 2];
     uint16_t mvscale[3][2];
     uint8_t mvstep[3][2];
+
+    // slice threading: tile columns are decoded in parallel, each by its own
+    // copy of this context, while the loopfilter follows one sb64 row behind
+    struct VP9Context **tile_ctx;
+    int nb_tile_ctx;
+    int *tile_progress; // number of tile columns done with each sb64 row
+    unsigned tile_progress_size;
+#if HAVE_THREADS
+    pthread_mutex_t progress_mutex;
+    pthread_cond_t progress_cond;
+#endif
 } VP9Context;
 
 static const uint8_t bwh_tab[2][N_BS_SIZES][2] = {
@@ -250,7 +263,7 @@ static int update_size(AVCodecContext *ctx, int w, int h)
     enum AVPixelFormat pix_fmts[HWACCEL_MAX + 2], *fmtp = pix_fmts;
     VP9Context *s = ctx->priv_data;
     uint8_t *p;
-    int bytesperpixel = s->bytesperpixel, res, cols, rows;
+    int bytesperpixel = s->bytesperpixel, res, cols, rows, lflvl_rows, i;
 
     av_assert0(w > 0 && h > 0);
 
@@ -295,12 +308,17 @@ static int update_size(AVCodecContext *ctx, int w, int h)
     s->cols      = (w + 7) >> 3;
     s->rows      = (h + 7) >> 3;
 
+    // with slice threads, the loopfilter runs behind the tile decoders, so
+    // the filter masks are kept for all sb64 rows instead of just one
+    lflvl_rows = ctx->active_thread_type == FF_THREAD_SLICE ? s->sb_rows : 1;
+
 #define assign(var, type, n) var = (type) p; p += s->sb_cols * (n) * sizeof(*var)
     av_freep(&s->intra_pred_data[0]);
     // FIXME we slightly over-allocate here for subsampled chroma, but a little
     // bit of padding shouldn't affect performance...
     p = av_malloc(s->sb_cols * (128 + 192 * bytesperpixel +
-                                sizeof(*s->lflvl) + 16 * sizeof(*s->above_mv_ctx)));
+                                lflvl_rows * sizeof(*s->lflvl) +
+                                16 * sizeof(*s->above_mv_ctx)));
     if (!p)
         return AVERROR(ENOMEM);
     assign(s->intra_pred_data[0],  uint8_t *,             64 * bytesperpixel);
@@ -319,12 +337,16 @@ static int update_size(AVCodecContext *ctx, int w, int h)
     assign(s->above_comp_ctx,      uint8_t *,              8);
     assign(s->above_ref_ctx,       uint8_t *,              8);
     assign(s->above_filter_ctx,    uint8_t *,              8);
-    assign(s->lflvl,               struct VP9Filter *,     1);
+    assign(s->lflvl,               struct VP9Filter *,     lflvl_rows);
 #undef assign
 
     // these will be re-allocated a little later
     av_freep(&s->b_base);
     av_freep(&s->block_base);
+    for (i = 0; i < s->nb_tile_ctx; i++) {
+        av_freep(&s->tile_ctx[i]->b_base);
+        av_freep(&s->tile_ctx[i]->block_base);
+    }
 
     if (s->bpp != s->last_bpp) {
         ff_vp9dsp_init(&s->dsp, s->bpp, ctx->flags & AV_CODEC_FLAG_BITEXACT);
@@ -335,43 +357,42 @@ static int update_size(AVCodecContext *ctx, int w, int h)
     return 0;
 }
 
-static int update_block_buffers(AVCodecContext *ctx)
+static int alloc_block_buffers(VP9Context *s, int nb_blocks, int sbs)
 {
-    VP9Context *s = ctx->priv_data;
     int chroma_blocks, chroma_eobs, bytesperpixel = s->bytesperpixel;
 
-    if (s->b_base && s->block_base && s->block_alloc_using_2pass == s->s.frames[CUR_FRAME].uses_2pass)
-        return 0;
-
     av_free(s->b_base);
     av_free(s->block_base);
     chroma_blocks = 64 * 64 >> (s->ss_h + s->ss_v);
     chroma_eobs   = 16 * 16 >> (s->ss_h + s->ss_v);
-    if (s->s.frames[CUR_FRAME].uses_2pass) {
-        int sbs = s->sb_cols * s->sb_rows;
+    s->b_base = av_malloc_array(nb_blocks, sizeof(VP9Block));
+    s->block_base = av_mallocz(((64 * 64 + 2 * chroma_blocks) * bytesperpixel * sizeof(int16_t) +
+                                16 * 16 + 2 * chroma_eobs) * sbs);
+    if (!s->b_base || !s->block_base)
+        return AVERROR(ENOMEM);
+    s->uvblock_base[0] = s->block_base + sbs * 64 * 64 * bytesperpixel;
+    s->uvblock_base[1] = s->uvblock_base[0] + sbs * chroma_blocks * bytesperpixel;
+    s->eob_base = (uint8_t *) (s->uvblock_base[1] + sbs * chroma_blocks * bytesperpixel);
+    s->uveob_base[0] = s->eob_base + 16 * 16 * sbs;
+    s->uveob_base[1] = s->uveob_base[0] + chroma_eobs * sbs;
 
-        s->b_base = av_malloc_array(s->cols * s->rows, sizeof(VP9Block));
-        s->block_base = av_mallocz(((64 * 64 + 2 * chroma_blocks) * bytesperpixel * sizeof(int16_t) +
-                                    16 * 16 + 2 * chroma_eobs) * sbs);
-        if (!s->b_base || !s->block_base)
-            return AVERROR(ENOMEM);
-        s->uvblock_base[0] = s->block_base + sbs * 64 * 64 * bytesperpixel;
-        s->uvblock_base[1] = s->uvblock_base[0] + sbs * chroma_blocks * bytesperpixel;
-        s->eob_base = (uint8_t *) (s->uvblock_base[1] + sbs * chroma_blocks * bytesperpixel);
-        s->uveob_base[0] = s->eob_base + 16 * 16 * sbs;
-        s->uveob_base[1] = s->uveob_base[0] + chroma_eobs * sbs;
-    } else {
-        s->b_base = av_malloc(sizeof(VP9Block));
-        s->block_base = av_mallocz((64 * 64 + 2 * chroma_blocks) * bytesperpixel * sizeof(int16_t) +
-                                   16 * 16 + 2 * chroma_eobs);
-        if (!s->b_base || !s->block_base)
-            return AVERROR(ENOMEM);
-        s->uvblock_base[0] = s->block_base + 64 * 64 * bytesperpixel;
-        s->uvblock_base[1] = s->uvblock_base[0] + chroma_blocks * bytesperpixel;
-        s->eob_base = (uint8_t *) (s->uvblock_base[1] + chroma_blocks * bytesperpixel);
-        s->uveob_base[0] = s->eob_base + 16 * 16;
-        s->uveob_base[1] = s->uveob_base[0] + chroma_eobs;
-    }
+    return 0;
+}
+
+static int update_block_buffers(AVCodecContext *ctx)
+{
+    VP9Context *s = ctx->priv_data;
+    int res;
+
+    if (s->b_base && s->block_base && s->block_alloc_using_2pass == s->s.frames[CUR_FRAME].uses_2pass)
+        return 0;
+
+    if (s->s.frames[CUR_FRAME].uses_2pass)
+        res = alloc_block_buffers(s, s->cols * s->rows, s->sb_cols * s->sb_rows);
+    else
+        res = alloc_block_buffers(s, 1, 1);
+    if (res < 0)
+        return res;
     s->block_alloc_using_2pass = s->s.frames[CUR_FRAME].uses_2pass;
 
     return 0;
@@ -659,9 +680,22 @@ static int decode_frame_header(AVCodecContext *ctx,
     s->s.h.filter.level = get_bits(&s->gb, 6);
     sharp = get_bits(&s->gb, 3);
     // if sharpness changed, reinit lim/mblim LUTs. if it didn't change, keep
-    // the old cache values since they are still valid
-    if (s->s.h.filter.sharpness != sharp)
-        memset(s->filter_lut.lim_lut, 0, sizeof(s->filter_lut.lim_lut));
+    // the old values since they are still valid. They are filled in here
+    // rather than on first use so that tile threads can share them
+    if (s->s.h.filter.sharpness != sharp) {
+        for (i = 1; i < 64; i++) {
+            int limit = i;
+
+            if (sharp > 0) {
+                limit >>= (sharp + 3) >> 2;
+                limit = FFMIN(limit, 9 - sharp);
+            }
+            limit = FFMAX(limit, 1);
+
+            s->filter_lut.lim_lut[i] = limit;
+            s->filter_lut.mblim_lut[i] = 2 * (i + 2) + limit;
+        }
+    }
     s->s.h.filter.sharpness = sharp;
     if ((s->s.h.lf_delta.enabled = get_bits1(&s->gb))) {
         if ((s->s.h.lf_delta.updated = get_bits1(&s->gb))) {
@@ -1423,7 +1457,7 @@ static av_always_inline void setctx_2d(uint8_t *ptr, int w, int h,
     }
 }
 
-static void decode_mode(AVCodecContext *ctx)
+static void decode_mode(VP9Context *s)
 {
     static const uint8_t left_ctx[N_BS_SIZES] = {
         0x0, 0x8, 0x0, 0x8, 0xc, 0x8, 0xc, 0xe, 0xc, 0xe, 0xf, 0xe, 0xf
@@ -1435,7 +1469,6 @@ static void decode_mode(AVCodecContext *ctx)
         TX_32X32, TX_32X32, TX_32X32, TX_32X32, TX_16X16, TX_16X16,
         TX_16X16, TX_8X8, TX_8X8, TX_8X8, TX_4X4, TX_4X4, TX_4X4
     };
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col, row7 = s->row7;
     enum TxfmMode max_tx = max_tx_for_bl_bp[b->bs];
@@ -2292,9 +2325,8 @@ static int decode_coeffs_b32_16bpp(VP9Context *s, int16_t *coef, int n_coeffs,
                                    nnz, scan, nb, band_counts, qmul);
 }
 
-static av_always_inline int decode_coeffs(AVCodecContext *ctx, int is8bitsperpixel)
+static av_always_inline int decode_coeffs(VP9Context *s, int is8bitsperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
     uint8_t (*p)[6][11] = s->prob.coef[b->tx][0 /* y */][!b->intra];
@@ -2459,14 +2491,14 @@ static av_always_inline int decode_coeffs(AVCodecContext *ctx, int is8bitsperpix
     return total_coeff;
 }
 
-static int decode_coeffs_8bpp(AVCodecContext *ctx)
+static int decode_coeffs_8bpp(VP9Context *s)
 {
-    return decode_coeffs(ctx, 1);
+    return decode_coeffs(s, 1);
 }
 
-static int decode_coeffs_16bpp(AVCodecContext *ctx)
+static int decode_coeffs_16bpp(VP9Context *s)
 {
-    return decode_coeffs(ctx, 0);
+    return decode_coeffs(s, 0);
 }
 
 static av_always_inline int check_intra_mode(VP9Context *s, int mode, uint8_t **a,
@@ -2650,10 +2682,9 @@ static av_always_inline int check_intra_mode(VP9Context *s, int mode, uint8_t **
     return mode;
 }
 
-static av_always_inline void intra_recon(AVCodecContext *ctx, ptrdiff_t y_off,
+static av_always_inline void intra_recon(VP9Context *s, ptrdiff_t y_off,
                                          ptrdiff_t uv_off, int bytesperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
     int w4 = bwh_tab[1][b->bs][0] << 1, step1d = 1 << b->tx, n;
@@ -2720,14 +2751,14 @@ static av_always_inline void intra_recon(AVCodecContext *ctx, ptrdiff_t y_off,
     }
 }
 
-static void intra_recon_8bpp(AVCodecContext *ctx, ptrdiff_t y_off, ptrdiff_t uv_off)
+static void intra_recon_8bpp(VP9Context *s, ptrdiff_t y_off, ptrdiff_t uv_off)
 {
-    intra_recon(ctx, y_off, uv_off, 1);
+    intra_recon(s, y_off, uv_off, 1);
 }
 
-static void intra_recon_16bpp(AVCodecContext *ctx, ptrdiff_t y_off, ptrdiff_t uv_off)
+static void intra_recon_16bpp(VP9Context *s, ptrdiff_t y_off, ptrdiff_t uv_off)
 {
-    intra_recon(ctx, y_off, uv_off, 2);
+    intra_recon(s, y_off, uv_off, 2);
 }
 
 static av_always_inline void mc_luma_unscaled(VP9Context *s, vp9_mc_func (*mc)[2],
@@ -2985,23 +3016,22 @@ static av_always_inline void mc_chroma_scaled(VP9Context *s, vp9_scaled_mc_func
 #undef BYTES_PER_PIXEL
 #undef SCALED
 
-static av_always_inline void inter_recon(AVCodecContext *ctx, int bytesperpixel)
+static av_always_inline void inter_recon(VP9Context *s, int bytesperpixel)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     int row = s->row, col = s->col;
 
     if (s->mvscale[b->ref[0]][0] || (b->comp && s->mvscale[b->ref[1]][0])) {
         if (bytesperpixel == 1) {
-            inter_pred_scaled_8bpp(ctx);
+            inter_pred_scaled_8bpp(s);
         } else {
-            inter_pred_scaled_16bpp(ctx);
+            inter_pred_scaled_16bpp(s);
         }
     } else {
         if (bytesperpixel == 1) {
-            inter_pred_8bpp(ctx);
+            inter_pred_8bpp(s);
         } else {
-            inter_pred_16bpp(ctx);
+            inter_pred_16bpp(s);
         }
     }
     if (!b->skip) {
@@ -3051,14 +3081,14 @@ static av_always_inline void inter_recon(AVCodecContext *ctx, int bytesperpixel)
     }
 }
 
-static void inter_recon_8bpp(AVCodecContext *ctx)
+static void inter_recon_8bpp(VP9Context *s)
 {
-    inter_recon(ctx, 1);
+    inter_recon(s, 1);
 }
 
-static void inter_recon_16bpp(AVCodecContext *ctx)
+static void inter_recon_16bpp(VP9Context *s)
 {
-    inter_recon(ctx, 2);
+    inter_recon(s, 2);
 }
 
 static av_always_inline void mask_edges(uint8_t (*mask)[8][4], int ss_h, int ss_v,
@@ -3183,11 +3213,10 @@ static av_always_inline void mask_edges(uint8_t (*mask)[8][4], int ss_h, int ss_
     }
 }
 
-static void decode_b(AVCodecContext *ctx, int row, int col,
+static void decode_b(VP9Context *s, int row, int col,
                      struct VP9Filter *lflvl, ptrdiff_t yoff, ptrdiff_t uvoff,
                      enum BlockLevel bl, enum BlockPartition bp)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     enum BlockSize bs = bl * 3 + bp;
     int bytesperpixel = s->bytesperpixel;
@@ -3207,7 +3236,7 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
         b->bs = bs;
         b->bl = bl;
         b->bp = bp;
-        decode_mode(ctx);
+        decode_mode(s);
         b->uvtx = b->tx - ((s->ss_h && w4 * 2 == (1 << b->tx)) ||
                            (s->ss_v && h4 * 2 == (1 << b->tx)));
 
@@ -3215,9 +3244,9 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
             int has_coeffs;
 
             if (bytesperpixel == 1) {
-                has_coeffs = decode_coeffs_8bpp(ctx);
+                has_coeffs = decode_coeffs_8bpp(s);
             } else {
-                has_coeffs = decode_coeffs_16bpp(ctx);
+                has_coeffs = decode_coeffs_16bpp(s);
             }
             if (!has_coeffs && b->bs <= BS_8x8 && !b->intra) {
                 b->skip = 1;
@@ -3299,15 +3328,15 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
     }
     if (b->intra) {
         if (s->bpp > 8) {
-            intra_recon_16bpp(ctx, yoff, uvoff);
+            intra_recon_16bpp(s, yoff, uvoff);
         } else {
-            intra_recon_8bpp(ctx, yoff, uvoff);
+            intra_recon_8bpp(s, yoff, uvoff);
         }
     } else {
         if (s->bpp > 8) {
-            inter_recon_16bpp(ctx);
+            inter_recon_16bpp(s);
         } else {
-            inter_recon_8bpp(ctx);
+            inter_recon_8bpp(s);
         }
     }
     if (emu[0]) {
@@ -3356,20 +3385,6 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
                        s->cols & 1 && col + w4 >= s->cols ? s->cols & 7 : 0,
                        s->rows & 1 && row + h4 >= s->rows ? s->rows & 7 : 0,
                        b->uvtx, skip_inter);
-
-        if (!s->filter_lut.lim_lut[lvl]) {
-            int sharp = s->s.h.filter.sharpness;
-            int limit = lvl;
-
-            if (sharp > 0) {
-                limit >>= (sharp + 3) >> 2;
-                limit = FFMIN(limit, 9 - sharp);
-            }
-            limit = FFMAX(limit, 1);
-
-            s->filter_lut.lim_lut[lvl] = limit;
-            s->filter_lut.mblim_lut[lvl] = 2 * (lvl + 2) + limit;
-        }
     }
 
     if (s->pass == 2) {
@@ -3383,10 +3398,9 @@ static void decode_b(AVCodecContext *ctx, int row, int col,
     }
 }
 
-static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *lflvl,
+static void decode_sb(VP9Context *s, int row, int col, struct VP9Filter *lflvl,
                       ptrdiff_t yoff, ptrdiff_t uvoff, enum BlockLevel bl)
 {
-    VP9Context *s = ctx->priv_data;
     int c = ((s->above_partition_ctx[col] >> (3 - bl)) & 1) |
             (((s->left_partition_ctx[row & 0x7] >> (3 - bl)) & 1) << 1);
     const uint8_t *p = s->s.h.keyframe || s->s.h.intraonly ? vp9_default_kf_partition_probs[bl][c] :
@@ -3399,35 +3413,35 @@ static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *l
 
     if (bl == BL_8X8) {
         bp = vp8_rac_get_tree(&s->c, vp9_partition_tree, p);
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
     } else if (col + hbs < s->cols) { // FIXME why not <=?
         if (row + hbs < s->rows) { // FIXME why not <=?
             bp = vp8_rac_get_tree(&s->c, vp9_partition_tree, p);
             switch (bp) {
             case PARTITION_NONE:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_H:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_b(ctx, row + hbs, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row + hbs, col, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_V:
-                decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
                 yoff  += hbs * 8 * bytesperpixel;
                 uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-                decode_b(ctx, row, col + hbs, lflvl, yoff, uvoff, bl, bp);
+                decode_b(s, row, col + hbs, lflvl, yoff, uvoff, bl, bp);
                 break;
             case PARTITION_SPLIT:
-                decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb(ctx, row, col + hbs, lflvl,
+                decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb(s, row, col + hbs, lflvl,
                           yoff + 8 * hbs * bytesperpixel,
                           uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_sb(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb(ctx, row + hbs, col + hbs, lflvl,
+                decode_sb(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb(s, row + hbs, col + hbs, lflvl,
                           yoff + 8 * hbs * bytesperpixel,
                           uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 break;
@@ -3436,36 +3450,35 @@ static void decode_sb(AVCodecContext *ctx, int row, int col, struct VP9Filter *l
             }
         } else if (vp56_rac_get_prob_branchy(&s->c, p[1])) {
             bp = PARTITION_SPLIT;
-            decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
-            decode_sb(ctx, row, col + hbs, lflvl,
+            decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row, col + hbs, lflvl,
                       yoff + 8 * hbs * bytesperpixel,
                       uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
         } else {
             bp = PARTITION_H;
-            decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+            decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
         }
     } else if (row + hbs < s->rows) { // FIXME why not <=?
         if (vp56_rac_get_prob_branchy(&s->c, p[2])) {
             bp = PARTITION_SPLIT;
-            decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_sb(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
         } else {
             bp = PARTITION_V;
-            decode_b(ctx, row, col, lflvl, yoff, uvoff, bl, bp);
+            decode_b(s, row, col, lflvl, yoff, uvoff, bl, bp);
         }
     } else {
         bp = PARTITION_SPLIT;
-        decode_sb(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+        decode_sb(s, row, col, lflvl, yoff, uvoff, bl + 1);
     }
     s->counts.partition[bl][c][bp]++;
 }
 
-static void decode_sb_mem(AVCodecContext *ctx, int row, int col, struct VP9Filter *lflvl,
+static void decode_sb_mem(VP9Context *s, int row, int col, struct VP9Filter *lflvl,
                           ptrdiff_t yoff, ptrdiff_t uvoff, enum BlockLevel bl)
 {
-    VP9Context *s = ctx->priv_data;
     VP9Block *b = s->b;
     ptrdiff_t hbs = 4 >> bl;
     AVFrame *f = s->s.frames[CUR_FRAME].tf.f;
@@ -3474,39 +3487,39 @@ static void decode_sb_mem(AVCodecContext *ctx, int row, int col, struct VP9Filte
 
     if (bl == BL_8X8) {
         av_assert2(b->bl == BL_8X8);
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
     } else if (s->b->bl == bl) {
-        decode_b(ctx, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
+        decode_b(s, row, col, lflvl, yoff, uvoff, b->bl, b->bp);
         if (b->bp == PARTITION_H && row + hbs < s->rows) {
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_b(ctx, row + hbs, col, lflvl, yoff, uvoff, b->bl, b->bp);
+            decode_b(s, row + hbs, col, lflvl, yoff, uvoff, b->bl, b->bp);
         } else if (b->bp == PARTITION_V && col + hbs < s->cols) {
             yoff  += hbs * 8 * bytesperpixel;
             uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-            decode_b(ctx, row, col + hbs, lflvl, yoff, uvoff, b->bl, b->bp);
+            decode_b(s, row, col + hbs, lflvl, yoff, uvoff, b->bl, b->bp);
         }
     } else {
-        decode_sb_mem(ctx, row, col, lflvl, yoff, uvoff, bl + 1);
+        decode_sb_mem(s, row, col, lflvl, yoff, uvoff, bl + 1);
         if (col + hbs < s->cols) { // FIXME why not <=?
             if (row + hbs < s->rows) {
-                decode_sb_mem(ctx, row, col + hbs, lflvl, yoff + 8 * hbs * bytesperpixel,
+                decode_sb_mem(s, row, col + hbs, lflvl, yoff + 8 * hbs * bytesperpixel,
                               uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
                 yoff  += hbs * 8 * y_stride;
                 uvoff += hbs * 8 * uv_stride >> s->ss_v;
-                decode_sb_mem(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
-                decode_sb_mem(ctx, row + hbs, col + hbs, lflvl,
+                decode_sb_mem(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+                decode_sb_mem(s, row + hbs, col + hbs, lflvl,
                               yoff + 8 * hbs * bytesperpixel,
                               uvoff + (8 * hbs * bytesperpixel >> s->ss_h), bl + 1);
             } else {
                 yoff  += hbs * 8 * bytesperpixel;
                 uvoff += hbs * 8 * bytesperpixel >> s->ss_h;
-                decode_sb_mem(ctx, row, col + hbs, lflvl, yoff, uvoff, bl + 1);
+                decode_sb_mem(s, row, col + hbs, lflvl, yoff, uvoff, bl + 1);
             }
         } else if (row + hbs < s->rows) {
             yoff  += hbs * 8 * y_stride;
             uvoff += hbs * 8 * uv_stride >> s->ss_v;
-            decode_sb_mem(ctx, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
+            decode_sb_mem(s, row + hbs, col, lflvl, yoff, uvoff, bl + 1);
         }
     }
 }
@@ -3663,10 +3676,9 @@ static av_always_inline void filter_plane_rows(VP9Context *s, int row, int ss_h,
     }
 }
 
-static void loopfilter_sb(AVCodecContext *ctx, struct VP9Filter *lflvl,
+static void loopfilter_sb(VP9Context *s, struct VP9Filter *lflvl,
                           int row, int col, ptrdiff_t yoff, ptrdiff_t uvoff)
 {
-    VP9Context *s = ctx->priv_data;
     AVFrame *f = s->s.frames[CUR_FRAME].tf.f;
     uint8_t *dst = f->data[0] + yoff;
     ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
@@ -3938,9 +3950,20 @@ static void adapt_probs(VP9Context *s)
 
 static void free_buffers(VP9Context *s)
 {
+    int i;
+
     av_freep(&s->intra_pred_data[0]);
     av_freep(&s->b_base);
     av_freep(&s->block_base);
+    for (i = 0; i < s->nb_tile_ctx; i++) {
+        av_freep(&s->tile_ctx[i]->b_base);
+        av_freep(&s->tile_ctx[i]->block_base);
+        av_freep(&s->tile_ctx[i]);
+    }
+    av_freep(&s->tile_ctx);
+    s->nb_tile_ctx = 0;
+    av_freep(&s->tile_progress);
+    s->tile_progress_size = 0;
 }
 
 static av_cold int vp9_decode_free(AVCodecContext *ctx)
@@ -3964,10 +3987,194 @@ static av_cold int vp9_decode_free(AVCodecContext *ctx)
     free_buffers(s);
     av_freep(&s->c_b);
     s->c_b_size = 0;
+#if HAVE_THREADS
+    pthread_mutex_destroy(&s->progress_mutex);
+    pthread_cond_destroy(&s->progress_cond);
+#endif
 
     return 0;
 }
 
+static void reset_left_ctx(VP9Context *s)
+{
+    memset(s->left_partition_ctx, 0, 8);
+    memset(s->left_skip_ctx, 0, 8);
+    if (s->s.h.keyframe || s->s.h.intraonly) {
+        memset(s->left_mode_ctx, DC_PRED, 16);
+    } else {
+        memset(s->left_mode_ctx, NEARESTMV, 8);
+    }
+    memset(s->left_y_nnz_ctx, 0, 16);
+    memset(s->left_uv_nnz_ctx, 0, 32);
+    memset(s->left_segpred_ctx, 0, 8);
+}
+
+// backup pre-loopfilter reconstruction data of columns [col_start, col_end)
+// for intra prediction of next row of sb64s
+static void backup_intra_pred_data(VP9Context *s, AVFrame *f, int col_start, int col_end,
+                                   ptrdiff_t yoff, ptrdiff_t uvoff)
+{
+    int bytesperpixel = s->bytesperpixel;
+    ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
+    ptrdiff_t x = col_start * 8 * bytesperpixel, uvx = x >> s->ss_h;
+    int w = (FFMIN(col_end, s->cols) - col_start) * 8 * bytesperpixel;
+
+    memcpy(s->intra_pred_data[0] + x,
+           f->data[0] + yoff + 63 * ls_y + x, w);
+    memcpy(s->intra_pred_data[1] + uvx,
+           f->data[1] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv + uvx, w >> s->ss_h);
+    memcpy(s->intra_pred_data[2] + uvx,
+           f->data[2] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv + uvx, w >> s->ss_h);
+}
+
+static void loopfilter_row(VP9Context *s, struct VP9Filter *lflvl_ptr, int row,
+                           ptrdiff_t yoff, ptrdiff_t uvoff)
+{
+    int col;
+
+    for (col = 0; col < s->cols;
+         col += 8, yoff += 64 * s->bytesperpixel,
+         uvoff += 64 * s->bytesperpixel >> s->ss_h, lflvl_ptr++) {
+        loopfilter_sb(s, lflvl_ptr, row, col, yoff, uvoff);
+    }
+}
+
+#if HAVE_THREADS
+#define copy_fields(to, from, start_field, end_field) \
+    memcpy(&(to)->start_field, &(from)->start_field, \
+           (char *)&(to)->end_field - (char *)&(to)->start_field)
+
+/**
+ * Set up one context per tile column for slice threading. The tile contexts
+ * share everything with the main context but the tile-local decoding state
+ * (range coder, left contexts, block buffers and symbol counts).
+ */
+static int update_tile_contexts(AVCodecContext *ctx)
+{
+    VP9Context *s = ctx->priv_data;
+    int i, res, tile_cols = s->s.h.tiling.tile_cols;
+
+    if (tile_cols > s->nb_tile_ctx) {
+        VP9Context **tile_ctx = av_realloc_array(s->tile_ctx, tile_cols, sizeof(*tile_ctx));
+
+        if (!tile_ctx)
+            return AVERROR(ENOMEM);
+        s->tile_ctx = tile_ctx;
+        for (; s->nb_tile_ctx < tile_cols; s->nb_tile_ctx++)
+            if (!(s->tile_ctx[s->nb_tile_ctx] = av_mallocz(sizeof(VP9Context))))
+                return AVERROR(ENOMEM);
+    }
+    av_fast_malloc(&s->tile_progress, &s->tile_progress_size,
+                   s->sb_rows * sizeof(*s->tile_progress));
+    if (!s->tile_progress)
+        return AVERROR(ENOMEM);
+    memset(s->tile_progress, 0, s->sb_rows * sizeof(*s->tile_progress));
+
+    for (i = 0; i < tile_cols; i++) {
+        VP9Context *td = s->tile_ctx[i];
+
+        copy_fields(td, s, s, block_alloc_using_2pass);
+        copy_fields(td, s, min_mv, tile_ctx);
+        if (!td->b_base || !td->block_base) {
+            if ((res = alloc_block_buffers(td, 1, 1)) < 0)
+                return res;
+        }
+        td->b = td->b_base;
+        td->block = td->block_base;
+        td->uvblock[0] = td->uvblock_base[0];
+        td->uvblock[1] = td->uvblock_base[1];
+        td->eob = td->eob_base;
+        td->uveob[0] = td->uveob_base[0];
+        td->uveob[1] = td->uveob_base[1];
+        memset(&td->counts, 0, sizeof(td->counts));
+        set_tile_offset(&td->tile_col_start, &td->tile_col_end,
+                        i, s->s.h.tiling.log2_tile_cols, s->sb_cols);
+    }
+
+    return 0;
+}
+
+static void merge_tile_counts(VP9Context *s)
+{
+    int i, j;
+
+    for (i = 0; i < s->s.h.tiling.tile_cols; i++) {
+        unsigned *dst = (unsigned *) &s->counts;
+        const unsigned *src = (const unsigned *) &s->tile_ctx[i]->counts;
+
+        for (j = 0; j < sizeof(s->counts) / sizeof(unsigned); j++)
+            dst[j] += src[j];
+    }
+}
+
+static void report_tile_progress(VP9Context *s, int sb_row)
+{
+    pthread_mutex_lock(&s->progress_mutex);
+    s->tile_progress[sb_row]++;
+    pthread_cond_broadcast(&s->progress_cond);
+    pthread_mutex_unlock(&s->progress_mutex);
+}
+
+static void await_tile_progress(VP9Context *s, int sb_row, int n)
+{
+    pthread_mutex_lock(&s->progress_mutex);
+    while (s->tile_progress[sb_row] < n)
+        pthread_cond_wait(&s->progress_cond, &s->progress_mutex);
+    pthread_mutex_unlock(&s->progress_mutex);
+}
+
+/**
+ * Decode one tile column of the current tile row, or, for the last job,
+ * loopfilter each sb64 row as soon as all tile columns are done with it.
+ */
+static int decode_tiles_mt(AVCodecContext *ctx, void *arg, int jobnr, int threadnr)
+{
+    VP9Context *s = ctx->priv_data;
+    AVFrame *f = s->s.frames[CUR_FRAME].tf.f;
+    ptrdiff_t ls_y = f->linesize[0], ls_uv = f->linesize[1];
+    int bytesperpixel = s->bytesperpixel, row, col;
+
+    if (jobnr == s->s.h.tiling.tile_cols) {
+        for (row = s->tile_row_start; row < s->tile_row_end; row += 8) {
+            await_tile_progress(s, row >> 3, s->s.h.tiling.tile_cols);
+            if (s->s.h.filter.level)
+                loopfilter_row(s, s->lflvl + (row >> 3) * s->sb_cols, row,
+                               (row >> 3) * ls_y * 64,
+                               (row >> 3) * ls_uv * 64 >> s->ss_v);
+            ff_thread_report_progress(&s->s.frames[CUR_FRAME].tf, row >> 3, 0);
+        }
+    } else {
+        VP9Context *td = s->tile_ctx[jobnr];
+
+        memcpy(&td->c, &s->c_b[jobnr], sizeof(td->c));
+        for (row = s->tile_row_start; row < s->tile_row_end; row += 8) {
+            ptrdiff_t yoff  = (row >> 3) * ls_y * 64;
+            ptrdiff_t uvoff = (row >> 3) * ls_uv * 64 >> s->ss_v;
+            ptrdiff_t yoff2 = yoff + td->tile_col_start * 8 * bytesperpixel;
+            ptrdiff_t uvoff2 = uvoff + (td->tile_col_start * 8 * bytesperpixel >> s->ss_h);
+            struct VP9Filter *lflvl_ptr = s->lflvl + (row >> 3) * s->sb_cols +
+                                          (td->tile_col_start >> 3);
+
+            reset_left_ctx(td);
+            for (col = td->tile_col_start;
+                 col < td->tile_col_end;
+                 col += 8, yoff2 += 64 * bytesperpixel,
+                 uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
+                memset(lflvl_ptr->mask, 0, sizeof(lflvl_ptr->mask));
+                decode_sb(td, row, col, lflvl_ptr, yoff2, uvoff2, BL_64X64);
+            }
+            // the loopfilter may only touch this row once the backup is done
+            if (row + 8 < s->rows)
+                backup_intra_pred_data(td, f, td->tile_col_start, td->tile_col_end,
+                                       yoff, uvoff);
+            report_tile_progress(s, row >> 3);
+        }
+    }
+
+    return 0;
+}
+#endif
+
 
 static int vp9_decode_frame(AVCodecContext *ctx, void *frame,
                             int *got_frame, AVPacket *pkt)
@@ -4104,6 +4311,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ff_thread_finish_setup(ctx);
     }
 
+#if HAVE_THREADS
+    if (ctx->active_thread_type == FF_THREAD_SLICE &&
+        (res = update_tile_contexts(ctx)) < 0) {
+        av_log(ctx, AV_LOG_ERROR,
+               "Failed to allocate tile contexts\n");
+        return res;
+    }
+#endif
+
     do {
         yoff = uvoff = 0;
         s->b = s->b_base;
@@ -4143,6 +4359,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 }
             }
 
+#if HAVE_THREADS
+            if (ctx->active_thread_type == FF_THREAD_SLICE) {
+                ctx->execute2(ctx, decode_tiles_mt, NULL, NULL,
+                              s->s.h.tiling.tile_cols + 1);
+                continue;
+            }
+#endif
+
             for (row = s->tile_row_start; row < s->tile_row_end;
                  row += 8, yoff += ls_y * 64, uvoff += ls_uv * 64 >> s->ss_v) {
                 struct VP9Filter *lflvl_ptr = s->lflvl;
@@ -4153,17 +4377,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
                                     tile_col, s->s.h.tiling.log2_tile_cols, s->sb_cols);
 
                     if (s->pass != 2) {
-                        memset(s->left_partition_ctx, 0, 8);
-                        memset(s->left_skip_ctx, 0, 8);
-                        if (s->s.h.keyframe || s->s.h.intraonly) {
-                            memset(s->left_mode_ctx, DC_PRED, 16);
-                        } else {
-                            memset(s->left_mode_ctx, NEARESTMV, 8);
-                        }
-                        memset(s->left_y_nnz_ctx, 0, 16);
-                        memset(s->left_uv_nnz_ctx, 0, 32);
-                        memset(s->left_segpred_ctx, 0, 8);
-
+                        reset_left_ctx(s);
                         memcpy(&s->c, &s->c_b[tile_col], sizeof(s->c));
                     }
 
@@ -4178,10 +4392,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
                         }
 
                         if (s->pass == 2) {
-                            decode_sb_mem(ctx, row, col, lflvl_ptr,
+                            decode_sb_mem(s, row, col, lflvl_ptr,
                                           yoff2, uvoff2, BL_64X64);
                         } else {
-                            decode_sb(ctx, row, col, lflvl_ptr,
+                            decode_sb(s, row, col, lflvl_ptr,
                                       yoff2, uvoff2, BL_64X64);
                         }
                     }
@@ -4194,31 +4408,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
                     continue;
                 }
 
-                // backup pre-loopfilter reconstruction data for intra
-                // prediction of next row of sb64s
-                if (row + 8 < s->rows) {
-                    memcpy(s->intra_pred_data[0],
-                           f->data[0] + yoff + 63 * ls_y,
-                           8 * s->cols * bytesperpixel);
-                    memcpy(s->intra_pred_data[1],
-                           f->data[1] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
-                           8 * s->cols * bytesperpixel >> s->ss_h);
-                    memcpy(s->intra_pred_data[2],
-                           f->data[2] + uvoff + ((64 >> s->ss_v) - 1) * ls_uv,
-                           8 * s->cols * bytesperpixel >> s->ss_h);
-                }
+                if (row + 8 < s->rows)
+                    backup_intra_pred_data(s, f, 0, s->cols, yoff, uvoff);
 
                 // loopfilter one row
-                if (s->s.h.filter.level) {
-                    yoff2 = yoff;
-                    uvoff2 = uvoff;
-                    lflvl_ptr = s->lflvl;
-                    for (col = 0; col < s->cols;
-                         col += 8, yoff2 += 64 * bytesperpixel,
-                         uvoff2 += 64 * bytesperpixel >> s->ss_h, lflvl_ptr++) {
-                        loopfilter_sb(ctx, lflvl_ptr, row, col, yoff2, uvoff2);
-                    }
-                }
+                if (s->s.h.filter.level)
+                    loopfilter_row(s, s->lflvl, row, yoff, uvoff);
 
                 // FIXME maybe we can make this more finegrained by running the
                 // loopfilter per-block instead of after each sbrow
@@ -4228,6 +4423,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         if (s->pass < 2 && s->s.h.refreshctx && !s->s.h.parallelmode) {
+#if HAVE_THREADS
+            if (ctx->active_thread_type == FF_THREAD_SLICE)
+                merge_tile_counts(s);
+#endif
             adapt_probs(s);
             ff_thread_finish_setup(ctx);
         }
@@ -4297,6 +4496,10 @@ static av_cold int vp9_decode_init(AVCodecContext *ctx)
     ctx->internal->allocate_progress = 1;
     s->last_bpp = 0;
     s->s.h.filter.sharpness = -1;
+#if HAVE_THREADS
+    pthread_mutex_init(&s->progress_mutex, NULL);
+    pthread_cond_init(&s->progress_cond, NULL);
+#endif
 
     return init_frames(ctx);
 }
@@ -4304,6 +4507,11 @@ static av_cold int vp9_decode_init(AVCodecContext *ctx)
 #if HAVE_THREADS
 static av_cold int vp9_decode_init_thread_copy(AVCodecContext *avctx)
 {
+    VP9Context *s = avctx->priv_data;
+
+    pthread_mutex_init(&s->progress_mutex, NULL);
+    pthread_cond_init(&s->progress_cond, NULL);
+
     return init_frames(avctx);
 }
 
@@ -4362,7 +4570,8 @@ AVCodec ff_vp9_decoder = {
     .init                  = vp9_decode_init,
     .close                 = vp9_decode_free,
     .decode                = vp9_decode_frame,
-    .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                             AV_CODEC_CAP_SLICE_THREADS,
     .flush                 = vp9_decode_flush,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vp9_decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp9_decode_update_thread_context),
@@ -25,6 +25,7 @@
 
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
+#include "libavutil/executor_internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -36,7 +37,7 @@ typedef struct ThreadContext {
     AVFilterGraph *graph;
 
     int nb_threads;
-    pthread_t *workers;
+    AVExecutorClient *client;
     avfilter_action_func *func;
 
     /* per-execute parameters */
@@ -44,73 +45,18 @@ typedef struct ThreadContext {
     void *arg;
     int   *rets;
     int nb_rets;
-    int nb_jobs;
-
-    pthread_cond_t last_job_cond;
-    pthread_cond_t current_job_cond;
-    pthread_mutex_t current_job_lock;
-    int current_job;
-    unsigned int current_execute;
-    int done;
 } ThreadContext;
 
-static void* attribute_align_arg worker(void *v)
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
-    ThreadContext *c = v;
-    int our_job      = c->nb_jobs;
-    int nb_threads   = c->nb_threads;
-    unsigned int last_execute = 0;
-    int self_id;
-
-    pthread_mutex_lock(&c->current_job_lock);
-    self_id = c->current_job++;
-    for (;;) {
-        while (our_job >= c->nb_jobs) {
-            if (c->current_job == nb_threads + c->nb_jobs)
-                pthread_cond_signal(&c->last_job_cond);
-
-            while (last_execute == c->current_execute && !c->done)
-                pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
-            last_execute = c->current_execute;
-            our_job = self_id;
-
-            if (c->done) {
-                pthread_mutex_unlock(&c->current_job_lock);
-                return NULL;
-            }
-        }
-        pthread_mutex_unlock(&c->current_job_lock);
-
-        c->rets[our_job % c->nb_rets] = c->func(c->ctx, c->arg, our_job, c->nb_jobs);
-
-        pthread_mutex_lock(&c->current_job_lock);
-        our_job = c->current_job++;
-    }
-}
-
-static void slice_thread_uninit(ThreadContext *c)
-{
-    int i;
-
-    pthread_mutex_lock(&c->current_job_lock);
-    c->done = 1;
-    pthread_cond_broadcast(&c->current_job_cond);
-    pthread_mutex_unlock(&c->current_job_lock);
+    ThreadContext *c = priv;
 
-    for (i = 0; i < c->nb_threads; i++)
-         pthread_join(c->workers[i], NULL);
-
-    pthread_mutex_destroy(&c->current_job_lock);
-    pthread_cond_destroy(&c->current_job_cond);
-    pthread_cond_destroy(&c->last_job_cond);
-    av_freep(&c->workers);
+    c->rets[jobnr % c->nb_rets] = c->func(c->ctx, c->arg, jobnr, nb_jobs);
 }
 
-static void slice_thread_park_workers(ThreadContext *c)
+static void slice_thread_uninit(ThreadContext *c)
 {
-    while (c->current_job != c->nb_threads + c->nb_jobs)
-        pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
-    pthread_mutex_unlock(&c->current_job_lock);
+    avpriv_executor_client_free(&c->client);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -122,10 +68,6 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     if (nb_jobs <= 0)
         return 0;
 
-    pthread_mutex_lock(&c->current_job_lock);
-
-    c->current_job = c->nb_threads;
-    c->nb_jobs     = nb_jobs;
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
@@ -136,18 +78,15 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
         c->rets    = &dummy_ret;
         c->nb_rets = 1;
     }
-    c->current_execute++;
-
-    pthread_cond_broadcast(&c->current_job_cond);
 
-    slice_thread_park_workers(c);
+    avpriv_executor_execute(c->client, nb_jobs);
 
     return 0;
 }
 
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
-    int i, ret;
+    int ret;
 
     if (!nb_threads) {
         int nb_cpus = av_cpu_count();
@@ -161,31 +100,13 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     if (nb_threads <= 1)
         return 1;
 
-    c->nb_threads = nb_threads;
-    c->workers = av_mallocz_array(sizeof(*c->workers), nb_threads);
-    if (!c->workers)
-        return AVERROR(ENOMEM);
-
-    c->current_job = 0;
-    c->nb_jobs     = 0;
-    c->done        = 0;
-
-    pthread_cond_init(&c->current_job_cond, NULL);
-    pthread_cond_init(&c->last_job_cond,    NULL);
-
-    pthread_mutex_init(&c->current_job_lock, NULL);
-    pthread_mutex_lock(&c->current_job_lock);
-    for (i = 0; i < nb_threads; i++) {
-        ret = pthread_create(&c->workers[i], NULL, worker, c);
-        if (ret) {
-           pthread_mutex_unlock(&c->current_job_lock);
-           c->nb_threads = i;
-           slice_thread_uninit(c);
-           return AVERROR(ret);
-        }
-    }
+    // the jobs run on the process-wide executor, no threads are started here
+    ret = avpriv_executor_client_create(&c->client, c, worker_func, nb_threads,
+                                        AV_EXECUTOR_PRIORITY_FILTER);
+    if (ret < 0)
+        return ret;
 
-    slice_thread_park_workers(c);
+    c->nb_threads = nb_threads;
 
     return c->nb_threads;
 }
@@ -53,6 +53,17 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext as a reference to the storage of the
+ * underlying protocol, without copying them.
+ * The returned buffer may be read-only and is followed by
+ * AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes.
+ * @param buf set to the new reference on success
+ * @return size on success, AVERROR(ENOSYS) if the context cannot return
+ *         references, or another AVERROR; nothing is read on failure
+ */
+int ffio_read_buffer(AVIOContext *s, int size, AVBufferRef **buf);
+
 /**
  * Read size bytes from AVIOContext into buf.
  * This reads at most 1 packet. If that is not enough fewer bytes will be
@@ -874,6 +874,39 @@ static int64_t io_read_seek(void *opaque, int stream_index, int64_t timestamp, i
     return internal->h->prot->url_read_seek(internal->h, stream_index, timestamp, flags);
 }
 
+int ffio_read_buffer(AVIOContext *s, int size, AVBufferRef **buf)
+{
+    AVIOInternal *internal = s->opaque;
+    int64_t pos, res;
+    int ret;
+
+    if (s->read_packet != io_read_packet || s->write_flag ||
+        s->update_checksum || !s->seek || size <= 0 ||
+        !internal->h->prot->url_get_buffer)
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(s);
+    ret = internal->h->prot->url_get_buffer(internal->h, pos, size, buf);
+    if (ret < 0)
+        return ret;
+
+    if (size <= s->buf_end - s->buf_ptr) {
+        s->buf_ptr += size;
+    } else {
+        /* move the protocol past the data instead of reading it */
+        if ((res = s->seek(s->opaque, pos + size, SEEK_SET)) < 0) {
+            av_buffer_unref(buf);
+            return res;
+        }
+        s->bytes_read += pos + size - s->pos;
+        s->buf_end =
+        s->buf_ptr = s->buffer;
+        s->pos     = pos + size;
+    }
+    s->eof_reached = 0;
+    return size;
+}
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     AVIOInternal *internal = NULL;
@@ -35,6 +35,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -73,6 +76,8 @@ typedef struct FileContext {
     int trunc;
     int blocksize;
     int follow;
+    int use_mmap;
+    int page_size;       ///< 0 when packets are not mapped
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -82,6 +87,7 @@ static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "return large packets mapped from the file instead of copied", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -197,6 +203,64 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+#endif
+
+/* smaller packets are cheaper to copy than to map */
+#define MAP_MIN_SIZE (1 << 16)
+
+/* Map the pages holding a packet privately and zero the padding after it,
+ * which copies only the last page or two. The file size is checked before
+ * each mapping, so a truncated file is read up to its end with read().
+ * Reading a packet of a file truncated after it was returned faults. */
+static int file_get_buffer(URLContext *h, int64_t pos, int size,
+                           AVBufferRef **buf)
+{
+#if HAVE_MMAP
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int64_t start, end;
+    uint8_t *map;
+
+    if (!c->page_size)
+        return AVERROR(ENOSYS);
+    if (pos < 0 || size < MAP_MIN_SIZE ||
+        size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE - c->page_size)
+        return AVERROR(ERANGE);
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+
+    start = pos & ~(int64_t)(c->page_size - 1);
+    end   = pos + size + AV_INPUT_BUFFER_PADDING_SIZE;
+    /* the padding may only extend into the zero filled rest of the last
+     * page, whole pages past the end of the file cannot be accessed */
+    if (pos + size > st.st_size || end > FFALIGN(st.st_size, c->page_size))
+        return AVERROR(ERANGE);
+
+    map = mmap(NULL, end - start, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+               c->fd, start);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+    memset(map + pos - start + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    *buf = av_buffer_create(map, end - start, file_unmap,
+                            (void *)(uintptr_t)(end - start), 0);
+    if (!*buf) {
+        munmap(map, end - start);
+        return AVERROR(ENOMEM);
+    }
+    (*buf)->data += pos - start;
+    (*buf)->size  = size;
+    return size;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -227,6 +291,12 @@ static int file_open(URLContext *h, const char *filename, int flags)
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_MMAP
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode))
+        c->page_size = FFMAX(sysconf(_SC_PAGESIZE), 0);
+#endif
+
     return 0;
 }
 
@@ -345,6 +415,7 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+    .url_get_buffer      = file_get_buffer,
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
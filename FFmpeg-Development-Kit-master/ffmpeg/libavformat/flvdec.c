@@ -1181,7 +1181,7 @@ retry_duration:
         goto leave;
     }
 
-    ret = av_get_packet(s->pb, pkt, size);
+    ret = ff_get_packet_ref(s->pb, pkt, size);
     if (ret < 0)
         return ret;
     pkt->dts          = dts;
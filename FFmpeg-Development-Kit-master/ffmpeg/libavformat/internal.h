@@ -284,6 +284,13 @@ void ff_put_v(AVIOContext *bc, uint64_t val);
  */
 int ff_get_line(AVIOContext *s, char *buf, int maxlen);
 
+/**
+ * Like av_get_packet(), but reference the data where the protocol keeps it
+ * when it can, e.g. a memory mapped file, instead of copying it.
+ * The packet data may then be read-only, it must not be modified in place.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 #define SPACE_CHARS " \t\r\n"
 
 /**
@@ -146,6 +146,9 @@ typedef struct MOVStreamContext {
     int time_scale;
     int64_t time_offset;  ///< time offset of the edit list entries
     int current_sample;
+    int64_t next_dts;     ///< dts of current_sample in AV_TIME_BASE, for the sample heaps
+    int64_t next_pos;     ///< position of current_sample, for the sample heaps
+    int heap_slot[2];     ///< index in MOVContext.sample_heap[], -1 if not queued
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -179,6 +182,22 @@ typedef struct MOVStreamContext {
     int32_t *display_matrix;
     uint32_t format;
 
+    /**
+     * With the lazy_index option, the samples are resolved from the sample
+     * tables when they are needed instead of being expanded into
+     * AVStream.index_entries, see mov_get_sample().
+     */
+    int lazy_index;
+    int nb_lazy_samples;
+    int lazy_key_off;         ///< offset of the stss and stps sample numbers
+    int *lazy_stts_start;     ///< first sample of each stts entry
+    int64_t *lazy_stts_dts;   ///< dts of that sample
+    int *lazy_stsc_start;     ///< first sample of each stsc entry
+    int lazy_stts_index;      ///< stts entry of the last resolved sample
+    int lazy_stsc_index;      ///< stsc entry of the last resolved sample
+    AVIndexEntry lazy_entry[2]; ///< last resolved samples, by parity of their number
+    int lazy_entry_sample[2];
+
     struct {
         int use_subsamples;
         uint8_t* auxiliary_info;
@@ -239,6 +258,18 @@ typedef struct MOVContext {
     uint8_t *decryption_key;
     int decryption_key_len;
     int enable_drefs;
+    int lazy_index;
+
+    /**
+     * Streams with samples left, as min-heaps on the position and on the dts
+     * of their current sample, to find the next sample to return without
+     * scanning all streams, see mov_find_next_sample().
+     */
+    int *sample_heap[2];
+    int nb_sample_heap;
+    int sample_heap_valid;  ///< cleared when samples of any stream changed
+    int sample_heap_scan;   ///< the heaps cannot be used, scan the streams
+    int sample_heap_last;   ///< stream whose current sample was last returned
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
@@ -3181,6 +3181,309 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     av_free(ctts_data_old);
 }
 
+/* index of the last entry of start[] not above n, trying hint and the
+ * entry after it first */
+static int mov_lazy_find_entry(const int *start, int count, int hint, int n)
+{
+    int a = 0, b = count;
+
+    if (start[hint] <= n && (hint + 1 == count || n < start[hint + 1]))
+        return hint;
+    if (hint + 1 < count && start[hint + 1] <= n &&
+        (hint + 2 == count || n < start[hint + 2]))
+        return hint + 1;
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (start[m] <= n)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/* index of the last sync sample number not above n, -1 if none */
+static int mov_lazy_find_key(const unsigned *keys, unsigned count, unsigned n)
+{
+    int a = -1, b = count;
+
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (keys[m] <= n)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int64_t mov_lazy_dts(MOVStreamContext *sc, int n)
+{
+    int i = sc->lazy_stts_index = mov_lazy_find_entry(sc->lazy_stts_start, sc->stts_count,
+                                                      sc->lazy_stts_index, n);
+
+    return sc->lazy_stts_dts[i] +
+           (int64_t)(n - sc->lazy_stts_start[i]) * sc->stts_data[i].duration;
+}
+
+static unsigned mov_lazy_size(MOVStreamContext *sc, int n)
+{
+    return sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[n];
+}
+
+/* return whether sample n is a keyframe and set *last to the last keyframe
+ * up to n, following the rules of mov_build_index() */
+static int mov_lazy_keyframe(AVStream *st, int n, int *last)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned v = n + sc->lazy_key_off;
+    int key = -1, i;
+
+    if (!sc->keyframe_absent) {
+        if (!sc->keyframe_count) {
+            key = n;
+        } else if ((i = mov_lazy_find_key((const unsigned *)sc->keyframes, sc->keyframe_count, v)) >= 0) {
+            key = sc->keyframes[i] - sc->lazy_key_off;
+        }
+    }
+    if (sc->stps_count &&
+        (i = mov_lazy_find_key(sc->stps_data, sc->stps_count, v)) >= 0)
+        key = FFMAX(key, (int)(sc->stps_data[i] - sc->lazy_key_off));
+    if (sc->keyframe_absent && !sc->stps_count)
+        key = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ? n : 0;
+
+    *last = FFMAX(key, 0);
+    return key == n;
+}
+
+static int mov_nb_samples(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    return sc->lazy_index ? sc->nb_lazy_samples : st->nb_index_entries;
+}
+
+/**
+ * Get the index entry of sample n of the stream.
+ * With a lazy index, the entry is valid until another sample with the same
+ * parity of this stream is requested.
+ */
+static AVIndexEntry *mov_get_sample(AVStream *st, int n)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *e, *prev;
+    int i, chunk, k, last;
+    int64_t pos;
+
+    if (!sc->lazy_index)
+        return &st->index_entries[n];
+
+    e = &sc->lazy_entry[n & 1];
+    if (sc->lazy_entry_sample[n & 1] == n)
+        return e;
+
+    i = sc->lazy_stsc_index = mov_lazy_find_entry(sc->lazy_stsc_start, sc->stsc_count,
+                                                  sc->lazy_stsc_index, n);
+    chunk = sc->stsc_data[i].first - 1 + (n - sc->lazy_stsc_start[i]) / sc->stsc_data[i].count;
+    k     = (n - sc->lazy_stsc_start[i]) % sc->stsc_data[i].count;
+
+    /* sequential reads continue from the previous sample */
+    prev = &sc->lazy_entry[(n - 1) & 1];
+    if (k && sc->lazy_entry_sample[(n - 1) & 1] == n - 1) {
+        pos = prev->pos + prev->size;
+    } else {
+        pos = sc->chunk_offsets[chunk];
+        for (i = n - k; i < n; i++)
+            pos += mov_lazy_size(sc, i);
+    }
+
+    e->pos          = pos;
+    e->timestamp    = mov_lazy_dts(sc, n);
+    e->size         = mov_lazy_size(sc, n);
+    e->flags        = mov_lazy_keyframe(st, n, &last) ? AVINDEX_KEYFRAME : 0;
+    e->min_distance = n - last;
+    sc->lazy_entry_sample[n & 1] = n;
+    return e;
+}
+
+/**
+ * Like av_index_search_timestamp(), also for streams with a lazy index.
+ */
+static int mov_search_sample(AVStream *st, int64_t wanted_timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int a = -1, b = sc->nb_lazy_samples, m;
+
+    if (!sc->lazy_index)
+        return av_index_search_timestamp(st, wanted_timestamp, flags);
+
+    if (b && mov_lazy_dts(sc, b - 1) < wanted_timestamp)
+        a = b - 1;
+    while (b - a > 1) {
+        int64_t timestamp;
+
+        m = (a + b) >> 1;
+        timestamp = mov_lazy_dts(sc, m);
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < sc->nb_lazy_samples &&
+               !(mov_get_sample(st, m)->flags & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == sc->nb_lazy_samples)
+        return -1;
+    return m;
+}
+
+static void mov_free_lazy_index(MOVStreamContext *sc)
+{
+    av_freep(&sc->lazy_stts_start);
+    av_freep(&sc->lazy_stts_dts);
+    av_freep(&sc->lazy_stsc_start);
+    sc->lazy_index = 0;
+}
+
+/**
+ * Expand a lazy index into st->index_entries, for fragments which append
+ * samples to it.
+ */
+static int mov_materialize_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *entries;
+    int i, ret;
+
+    if ((ret = av_reallocp_array(&st->index_entries, sc->nb_lazy_samples,
+                                 sizeof(*st->index_entries))) < 0)
+        return ret;
+    entries = st->index_entries;
+    for (i = 0; i < sc->nb_lazy_samples; i++)
+        entries[i] = *mov_get_sample(st, i);
+    st->nb_index_entries = sc->nb_lazy_samples;
+    st->index_entries_allocated_size = sc->nb_lazy_samples * sizeof(*st->index_entries);
+    mov_free_lazy_index(sc);
+    return 0;
+}
+
+/* check that the sync sample numbers are increasing and not below key_off,
+ * so that looking them up matches walking them in order */
+static int mov_lazy_keys_valid(const unsigned *keys, unsigned count, int key_off)
+{
+    unsigned i;
+
+    for (i = 0; i < count; i++)
+        if (keys[i] < (unsigned)key_off || (i && keys[i] <= keys[i - 1]))
+            return 0;
+    return 1;
+}
+
+/**
+ * Set up the lazy index of a track, if its sample tables can be resolved
+ * per sample in the same way mov_build_index() walks them.
+ * @return 1 if the track uses a lazy index, 0 if it needs a full index
+ */
+static int mov_build_lazy_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t dts = -sc->dts_shift, total = 0, stream_size = 0;
+    int i, j, nb;
+
+    if ((st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+         st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) ||
+        !sc->sample_count || sc->sample_count > INT_MAX || st->nb_index_entries ||
+        (sc->elst_data && sc->elst_count > 0) ||
+        (sc->rap_group_count && sc->rap_group) ||
+        !sc->stts_count || !sc->stsc_count || !sc->chunk_count ||
+        sc->stsc_data[0].first != 1 || sc->stsc_data[0].count <= 0 ||
+        (!sc->stsz_sample_size && !sc->sample_sizes) ||
+        (sc->stsz_sample_size > 0 && sc->sample_size > 0 &&
+         sc->stsz_sample_size != sc->sample_size))
+        return 0;
+
+    sc->lazy_key_off = (sc->keyframe_count && sc->keyframes[0] > 0) ||
+                       (sc->stps_count && sc->stps_data[0] > 0);
+    if (!mov_lazy_keys_valid((const unsigned *)sc->keyframes, sc->keyframe_count, sc->lazy_key_off) ||
+        !mov_lazy_keys_valid(sc->stps_data, sc->stps_count, sc->lazy_key_off))
+        return 0;
+    /* a sample in both tables stops the walk over stps */
+    if (!sc->keyframe_absent && sc->keyframe_count)
+        for (i = 0, j = 0; i < sc->keyframe_count && j < sc->stps_count;) {
+            if ((unsigned)sc->keyframes[i] == sc->stps_data[j])
+                return 0;
+            if ((unsigned)sc->keyframes[i] < sc->stps_data[j])
+                i++;
+            else
+                j++;
+        }
+
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].count <= 0 || sc->stts_data[i].duration < 0)
+            return 0;
+    for (i = 0; i < sc->stsc_count; i++)
+        if ((i && sc->stsc_data[i].first <= sc->stsc_data[i - 1].first) ||
+            sc->stsc_data[i].count < 0 ||
+            (sc->pseudo_stream_id != -1 &&
+             sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+
+    sc->lazy_stts_start = av_malloc_array(sc->stts_count, sizeof(*sc->lazy_stts_start));
+    sc->lazy_stts_dts   = av_malloc_array(sc->stts_count, sizeof(*sc->lazy_stts_dts));
+    sc->lazy_stsc_start = av_malloc_array(sc->stsc_count, sizeof(*sc->lazy_stsc_start));
+    if (!sc->lazy_stts_start || !sc->lazy_stts_dts || !sc->lazy_stsc_start)
+        goto fail;
+
+    for (i = 0; i < sc->stts_count; i++) {
+        sc->lazy_stts_start[i] = FFMIN(total, INT_MAX);
+        sc->lazy_stts_dts[i]   = dts;
+        total += sc->stts_data[i].count;
+        dts   += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+
+    total = 0;
+    for (i = 0; i < sc->stsc_count; i++) {
+        int64_t first  = FFMIN(sc->stsc_data[i].first, sc->chunk_count + 1LL);
+        int64_t end    = i + 1 < sc->stsc_count ?
+                         FFMIN(sc->stsc_data[i + 1].first, sc->chunk_count + 1LL) :
+                         sc->chunk_count + 1LL;
+
+        sc->lazy_stsc_start[i] = FFMIN(total, INT_MAX);
+        total += (end - first) * sc->stsc_data[i].count;
+    }
+    nb = FFMIN(total, sc->sample_count);
+
+    for (i = 0; i < nb; i++) {
+        unsigned size = mov_lazy_size(sc, i);
+        if (size > 0x3FFFFFFF)
+            goto fail;
+        stream_size += size;
+    }
+
+    sc->lazy_index           = 1;
+    sc->nb_lazy_samples      = nb;
+    sc->lazy_stts_index      = 0;
+    sc->lazy_stsc_index      = 0;
+    sc->lazy_entry_sample[0] =
+    sc->lazy_entry_sample[1] = -1;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (i = 0; i < FFMIN(nb, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, mov_lazy_dts(sc, i));
+
+    if (total > sc->sample_count)
+        av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+    else if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+    return 1;
+fail:
+    mov_free_lazy_index(sc);
+    return 0;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3235,6 +3538,9 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         current_dts -= sc->dts_shift;
         last_dts     = current_dts;
 
+        if (mov->lazy_index && mov_build_lazy_index(mov, st))
+            return;
+
         if (!sc->sample_count || st->nb_index_entries)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
@@ -3668,12 +3974,14 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the samples are resolved from them. */
+    if (!sc->lazy_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+    }
     av_freep(&sc->elst_data);
     av_freep(&sc->rap_group);
 
@@ -4092,6 +4400,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if (sc->lazy_index && (err = mov_materialize_index(st)) < 0)
+        return err;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -4122,6 +4432,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     }
     if (flags & MOV_TRUN_DATA_OFFSET)        data_offset        = avio_rb32(pb);
     if (flags & MOV_TRUN_FIRST_SAMPLE_FLAGS) first_sample_flags = avio_rb32(pb);
+    /* the new index entries may be inserted before the current samples */
+    c->sample_heap_valid = 0;
     dts    = sc->track_end - sc->time_offset;
     offset = frag->base_data_offset + data_offset;
     distance = 0;
@@ -5099,10 +5411,10 @@ static void mov_read_chapters(AVFormatContext *s)
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
-            if (st->nb_index_entries) {
+            if (mov_nb_samples(st)) {
                 // Retrieve the first frame, if possible
                 AVPacket pkt;
-                AVIndexEntry *sample = &st->index_entries[0];
+                AVIndexEntry *sample = mov_get_sample(st, 0);
                 if (avio_seek(sc->pb, sample->pos, SEEK_SET) != sample->pos) {
                     av_log(s, AV_LOG_ERROR, "Failed to retrieve first frame\n");
                     goto finish;
@@ -5274,6 +5586,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->elst_data);
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
+        mov_free_lazy_index(sc);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -5309,6 +5622,8 @@ static int mov_read_close(AVFormatContext *s)
     av_freep(&mov->fragment_index_data);
 
     av_freep(&mov->aes_decrypt);
+    av_freep(&mov->sample_heap[0]);
+    av_freep(&mov->sample_heap[1]);
 
     return 0;
 }
@@ -5619,7 +5934,7 @@ static int mov_read_header(AVFormatContext *s)
     return 0;
 }
 
-static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+static AVIndexEntry *mov_scan_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
@@ -5627,8 +5942,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_samples(avst)) {
+            AVIndexEntry *current_sample = mov_get_sample(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!s->pb->seekable && current_sample->pos < sample->pos) ||
@@ -5645,6 +5960,167 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     return sample;
 }
 
+enum { MOV_HEAP_POS, MOV_HEAP_DTS };
+
+static int mov_sample_heap_less(AVFormatContext *s, int heap, int a, int b)
+{
+    MOVStreamContext *sa = s->streams[a]->priv_data;
+    MOVStreamContext *sb = s->streams[b]->priv_data;
+    int64_t ka = heap == MOV_HEAP_POS ? sa->next_pos : sa->next_dts;
+    int64_t kb = heap == MOV_HEAP_POS ? sb->next_pos : sb->next_dts;
+
+    return ka < kb || (ka == kb && a < b);
+}
+
+static void mov_sample_heap_set(AVFormatContext *s, int heap, int slot, int i)
+{
+    MOVContext *mov = s->priv_data;
+    MOVStreamContext *sc = s->streams[i]->priv_data;
+
+    mov->sample_heap[heap][slot] = i;
+    sc->heap_slot[heap] = slot;
+}
+
+/* move the stream at slot up or down to restore the heap order */
+static void mov_sample_heap_sift(AVFormatContext *s, int heap, int slot)
+{
+    MOVContext *mov = s->priv_data;
+    int *h = mov->sample_heap[heap];
+    int i  = h[slot];
+
+    while (slot > 0 && mov_sample_heap_less(s, heap, i, h[(slot - 1) >> 1])) {
+        mov_sample_heap_set(s, heap, slot, h[(slot - 1) >> 1]);
+        slot = (slot - 1) >> 1;
+    }
+    while (2 * slot + 1 < mov->nb_sample_heap) {
+        int child = 2 * slot + 1;
+
+        if (child + 1 < mov->nb_sample_heap &&
+            mov_sample_heap_less(s, heap, h[child + 1], h[child]))
+            child++;
+        if (!mov_sample_heap_less(s, heap, h[child], i))
+            break;
+        mov_sample_heap_set(s, heap, slot, h[child]);
+        slot = child;
+    }
+    mov_sample_heap_set(s, heap, slot, i);
+}
+
+/* requeue stream i after its current sample changed */
+static void mov_update_sample_heap(AVFormatContext *s, int i)
+{
+    MOVContext *mov = s->priv_data;
+    AVStream *st = s->streams[i];
+    MOVStreamContext *sc = st->priv_data;
+    int heap;
+
+    if (sc->pb && sc->current_sample < mov_nb_samples(st)) {
+        AVIndexEntry *sample = mov_get_sample(st, sc->current_sample);
+
+        sc->next_dts = av_rescale(sample->timestamp, AV_TIME_BASE, sc->time_scale);
+        sc->next_pos = sample->pos;
+        if (sc->heap_slot[0] < 0) {
+            for (heap = 0; heap < 2; heap++)
+                mov_sample_heap_set(s, heap, mov->nb_sample_heap, i);
+            mov->nb_sample_heap++;
+        }
+        for (heap = 0; heap < 2; heap++)
+            mov_sample_heap_sift(s, heap, sc->heap_slot[heap]);
+    } else if (sc->heap_slot[0] >= 0) {
+        int last = --mov->nb_sample_heap;
+
+        for (heap = 0; heap < 2; heap++) {
+            int slot = sc->heap_slot[heap];
+
+            sc->heap_slot[heap] = -1;
+            if (slot != last) {
+                mov_sample_heap_set(s, heap, slot, mov->sample_heap[heap][last]);
+                mov_sample_heap_sift(s, heap, slot);
+            }
+        }
+    }
+}
+
+static int mov_build_sample_heap(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    int i, heap, ret;
+
+    mov->nb_sample_heap   = 0;
+    mov->sample_heap_scan = 0;
+    mov->sample_heap_last = -1;
+    for (heap = 0; heap < 2; heap++)
+        if ((ret = av_reallocp_array(&mov->sample_heap[heap], s->nb_streams,
+                                     sizeof(*mov->sample_heap[heap]))) < 0) {
+            mov->sample_heap_scan = 1;
+            return ret;
+        }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        MOVStreamContext *sc = s->streams[i]->priv_data;
+
+        sc->heap_slot[0] = sc->heap_slot[1] = -1;
+        /* positions in different files cannot be compared */
+        if (sc->pb && sc->pb != s->pb)
+            mov->sample_heap_scan = 1;
+    }
+    if (!mov->sample_heap_scan)
+        for (i = 0; i < s->nb_streams; i++)
+            mov_update_sample_heap(s, i);
+
+    mov->sample_heap_valid = 1;
+    return 0;
+}
+
+/**
+ * Find the next sample to return, in the order of mov_scan_next_sample(),
+ * in O(log(streams)) for files with all samples in the same file.
+ */
+static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+{
+    MOVContext *mov = s->priv_data;
+    MOVStreamContext *sc;
+    int *pos_heap;
+    int i, c, tie = 0;
+
+    if (!mov->sample_heap_valid)
+        mov_build_sample_heap(s);
+    else if (mov->sample_heap_last >= 0)
+        mov_update_sample_heap(s, mov->sample_heap_last);
+    mov->sample_heap_last = -1;
+
+    if (mov->sample_heap_scan)
+        return mov_scan_next_sample(s, st);
+    if (!mov->nb_sample_heap)
+        return NULL;
+
+    pos_heap = mov->sample_heap[MOV_HEAP_POS];
+    i  = pos_heap[0];
+    sc = s->streams[i]->priv_data;
+    if (s->pb->seekable) {
+        MOVStreamContext *first = s->streams[mov->sample_heap[MOV_HEAP_DTS][0]]->priv_data;
+
+        /* The scan picks the sample with the lowest position if it is within
+         * one second of the lowest dts and its position is unique, wherever
+         * the scan starts. Otherwise its result depends on the order of the
+         * streams, so run it. */
+        for (c = 1; c <= 2 && c < mov->nb_sample_heap; c++) {
+            MOVStreamContext *child = s->streams[pos_heap[c]]->priv_data;
+            tie |= child->next_pos == sc->next_pos;
+        }
+        if (tie || sc->next_dts - first->next_dts > AV_TIME_BASE) {
+            AVIndexEntry *sample = mov_scan_next_sample(s, st);
+            if (sample)
+                mov->sample_heap_last = (*st)->index;
+            return sample;
+        }
+    }
+
+    mov->sample_heap_last = i;
+    *st = s->streams[i];
+    return mov_get_sample(*st, sc->current_sample);
+}
+
 static int should_retry(AVIOContext *pb, int error_code) {
     if (error_code == AVERROR_EOF || avio_feof(pb))
         return 0;
@@ -5761,7 +6237,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             goto retry;
         }
 
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        /* AAX decryption and the DV demuxer modify the data in place */
+        if (mov->aax_mode || (mov->dv_demux && sc->dv_audio_container))
+            ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         if (ret < 0) {
             sc->current_sample -= should_retry(sc->pb, ret);
             return ret;
@@ -5808,8 +6288,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_samples(st)) ?
+            mov_get_sample(st, sc->current_sample)->timestamp : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -5885,9 +6365,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_search_sample(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && mov_nb_samples(st) && timestamp < mov_get_sample(st, 0)->timestamp)
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
@@ -5938,13 +6418,14 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         return AVERROR_INVALIDDATA;
 
     st = s->streams[stream_index];
+    mc->sample_heap_valid = 0;
     sample = mov_seek_stream(s, st, sample_time, flags);
     if (sample < 0)
         return sample;
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_get_sample(st, sample)->timestamp;
 
         for (i = 0; i < s->nb_streams; i++) {
             int64_t timestamp;
@@ -6018,6 +6499,8 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "lazy_index", "Read the samples of audio and video tracks from the sample tables instead of building an index",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
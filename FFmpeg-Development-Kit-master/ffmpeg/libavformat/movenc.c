@@ -56,6 +56,7 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "faststart_reserve", "With faststart, write the moov atom into space reserved before the mdat atom (moov_size, or estimated from the stream durations) and only shift the data if it does not fit", offsetof(MOVMuxContext, faststart_reserve), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "separate_moof", "Write separate moof/mdat atoms for each track", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_SEPARATE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -5505,6 +5506,8 @@ static int mov_init(AVFormatContext *s)
     }
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->faststart_reserve)
+            mov->reserved_moov_gap = mov->reserved_moov_size;
         mov->reserved_moov_size = -1;
     }
 
@@ -5761,6 +5764,55 @@ static int mov_init(AVFormatContext *s)
     return 0;
 }
 
+/*
+ * Estimate the size of the final moov atom for the faststart_reserve option:
+ * a fixed part per track, and the sample table entries of the number of
+ * samples expected from the stream or file duration. Interleaved tracks get
+ * about one chunk per sample, hence the chunk offset in every entry. Tracks
+ * that are not set up yet only get the fixed part.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t size = 1024;
+    int i;
+
+    for (i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVStream *st    = track->st;
+        int64_t duration = s->duration, nb_samples = 0;
+
+        size += 1024;
+        // chapter, hint and timecode tracks are only created after this
+        if (!st || !track->par)
+            continue;
+        size += track->par->extradata_size;
+        if (st->duration > 0)
+            duration = av_rescale_q(st->duration, st->time_base, AV_TIME_BASE_Q);
+        if (duration <= 0)
+            continue;
+
+        if (track->par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            AVRational rate = st->avg_frame_rate.num && st->avg_frame_rate.den ?
+                              st->avg_frame_rate : (AVRational){ 60, 1 };
+            nb_samples = av_rescale(duration, rate.num, (int64_t)rate.den * AV_TIME_BASE);
+            // stsz, stco and ctts entries
+            size += nb_samples * 16;
+        } else if (track->par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            int frame_size = track->par->frame_size > 0 ? track->par->frame_size : 1024;
+            nb_samples = av_rescale(duration, track->par->sample_rate,
+                                    (int64_t)frame_size * AV_TIME_BASE);
+            // stsz and stco entries
+            size += nb_samples * 8;
+        }
+        if (size > INT_MAX / 2)
+            break;
+    }
+
+    // leave some room for the guesses above being short
+    return FFMIN(size + size / 8, INT_MAX / 2);
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -5843,8 +5895,19 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
             mov->reserved_header_pos = avio_tell(pb);
+            if (mov->faststart_reserve) {
+                if (!mov->reserved_moov_gap)
+                    mov->reserved_moov_gap = estimate_moov_size(s);
+                mov->reserved_moov_gap = FFMAX(mov->reserved_moov_gap, 8);
+                av_log(s, AV_LOG_VERBOSE, "Reserving %d bytes for the moov atom\n",
+                       mov->reserved_moov_gap);
+                avio_wb32(pb, mov->reserved_moov_gap);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, mov->reserved_moov_gap - 8);
+            }
+        }
         mov_write_mdat_tag(pb, mov);
     }
 
@@ -5979,28 +6042,27 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/*
+ * Move everything written from start on forward by shift bytes. The data is
+ * copied in blocks of at least shift bytes, so that a block is always read
+ * before the previous one is written over it, and of at least 64 kB, so that
+ * small shifts do not copy the file in tiny pieces.
+ */
+static int shift_data_from(AVFormatContext *s, int64_t start, int shift)
 {
-    int ret = 0, moov_size;
-    MOVMuxContext *mov = s->priv_data;
-    int64_t pos, pos_end = avio_tell(s->pb);
+    int ret = 0;
+    int64_t pos, pos_end;
     uint8_t *buf, *read_buf[2];
     int read_buf_id = 0;
     int read_size[2];
+    int block_size = FFMAX(shift, 1 << 16);
     AVIOContext *read_pb;
 
-    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
-        moov_size = compute_sidx_size(s);
-    else
-        moov_size = compute_moov_size(s);
-    if (moov_size < 0)
-        return moov_size;
-
-    buf = av_malloc(moov_size * 2);
+    buf = av_malloc_array(block_size, 2);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6016,18 +6078,18 @@ static int shift_data(AVFormatContext *s)
     /* mark the end of the shift to up to the last data we wrote, and get ready
      * for writing */
     pos_end = avio_tell(s->pb);
-    avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
+    avio_seek(s->pb, start + shift, SEEK_SET);
 
     /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
+    avio_seek(read_pb, start, SEEK_SET);
     pos = avio_tell(read_pb);
 
-#define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
-    read_buf_id ^= 1;                                                               \
+#define READ_BLOCK do {                                                              \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size);  \
+    read_buf_id ^= 1;                                                                \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at most block_size */
     READ_BLOCK;
     do {
         int n;
@@ -6045,6 +6107,70 @@ end:
     return ret;
 }
 
+static int shift_data(AVFormatContext *s)
+{
+    int moov_size;
+    MOVMuxContext *mov = s->priv_data;
+
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+        moov_size = compute_sidx_size(s);
+    else
+        moov_size = compute_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    return shift_data_from(s, mov->reserved_header_pos, moov_size);
+}
+
+/*
+ * Write the moov atom into the free atom reserved in front of the mdat atom
+ * with faststart_reserve, and a free atom over what is left of it. If the
+ * moov does not fit, only the data behind the reserved space is shifted, by
+ * the missing size.
+ */
+static int write_reserved_moov(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t moov_pos = avio_tell(pb);
+    int i, ret, moov_size, free_size, shift = 0;
+
+    for (;;) {
+        moov_size = get_moov_size(s);
+        if (moov_size < 0)
+            return moov_size;
+        free_size = mov->reserved_moov_gap + shift - moov_size;
+        if (!free_size || free_size >= 8)
+            break;
+        /* grow the space until the moov fits exactly or leaves room for a
+         * free atom, the moov grows too if its chunk offsets switch to co64 */
+        free_size = free_size < 0 ? -free_size : 8 - free_size;
+        shift    += free_size;
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += free_size;
+    }
+
+    if (shift) {
+        av_log(s, AV_LOG_INFO, "Reserved moov space too small by %d bytes, "
+               "moving the data\n", shift);
+        if ((ret = shift_data_from(s, mov->reserved_header_pos +
+                                      mov->reserved_moov_gap, shift)) < 0)
+            return ret;
+        moov_pos = avio_tell(pb);
+    }
+
+    avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+    if ((ret = mov_write_moov_tag(pb, mov, s)) < 0)
+        return ret;
+    if (free_size) {
+        avio_wb32(pb, free_size);
+        ffio_wfourcc(pb, "free");
+        ffio_fill(pb, 0, free_size - 8);
+    }
+    avio_seek(pb, moov_pos, SEEK_SET);
+    return 0;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6109,7 +6235,10 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_gap) {
+            if ((res = write_reserved_moov(s)) < 0)
+                return res;
+        } else if (mov->flags & FF_MOV_FLAG_FASTSTART) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
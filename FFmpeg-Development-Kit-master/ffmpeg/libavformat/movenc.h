@@ -196,6 +196,8 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int faststart_reserve;
+    int reserved_moov_gap;  ///< size of the free atom reserved for the moov with faststart_reserve
 
     char *major_brand;
 
@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -85,6 +86,15 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_shutdown)(URLContext *h, int flags);
+    /**
+     * Return a reference to size bytes at the absolute position pos,
+     * followed by AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes, without copying
+     * them. The position of the protocol is not changed. On error the caller
+     * reads the data instead. Protocols which cannot return references
+     * leave this unset.
+     */
+    int (*url_get_buffer)(URLContext *h, int64_t pos, int size,
+                          AVBufferRef **buf);
     int priv_data_size;
     const AVClass *priv_data_class;
     int flags;
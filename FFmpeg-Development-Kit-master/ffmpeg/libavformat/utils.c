@@ -296,6 +296,22 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    AVBufferRef *buf;
+    int64_t pos = avio_tell(s);
+
+    if (ffio_read_buffer(s, size, &buf) < 0)
+        return av_get_packet(s, pkt, size);
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -1895,6 +1911,39 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     }
 }
 
+/**
+ * Find the position of timestamp in entries like ff_index_search_timestamp()
+ * with AVSEEK_FLAG_ANY does, but walk back from the end with doubling steps
+ * before bisecting. Demuxers add entries at or close to the end, which then
+ * costs O(log distance) instead of O(log nb_entries).
+ */
+static int index_search_from_end(const AVIndexEntry *entries, int nb_entries,
+                                 int64_t timestamp)
+{
+    int a = nb_entries - 1, b = nb_entries, step = 1, m;
+
+    while (a >= 0 && entries[a].timestamp >= timestamp) {
+        b     = a;
+        a     = b > step ? b - step : -1;
+        step *= 2;
+    }
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (entries[m].timestamp < timestamp)
+            a = m;
+        else
+            b = m;
+    }
+
+    if (b == nb_entries)
+        return -1;
+    // which of several equal timestamps is hit depends on the bisection
+    if (entries[b].timestamp == timestamp)
+        return ff_index_search_timestamp(entries, nb_entries, timestamp,
+                                         AVSEEK_FLAG_ANY);
+    return b;
+}
+
 int ff_add_index_entry(AVIndexEntry **index_entries,
                        int *nb_index_entries,
                        unsigned int *index_entries_allocated_size,
@@ -1902,6 +1951,7 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
                        int size, int distance, int flags)
 {
     AVIndexEntry *entries, *ie;
+    size_t requested_size;
     int index;
 
     if ((unsigned) *nb_index_entries + 1 >= UINT_MAX / sizeof(AVIndexEntry))
@@ -1916,17 +1966,22 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
     if (is_relative(timestamp)) //FIXME this maintains previous behavior but we should shift by the correct offset once known
         timestamp -= RELATIVE_TS_BASE;
 
+    // Double the allocation while it is well below the allocation limit, so
+    // that building a long index only copies it a few times.
+    requested_size = (*nb_index_entries + 1) * sizeof(AVIndexEntry);
+    if (requested_size > *index_entries_allocated_size &&
+        *index_entries_allocated_size < INT_MAX / 4)
+        requested_size = FFMAX(requested_size, 2 * *index_entries_allocated_size);
+
     entries = av_fast_realloc(*index_entries,
                               index_entries_allocated_size,
-                              (*nb_index_entries + 1) *
-                              sizeof(AVIndexEntry));
+                              requested_size);
     if (!entries)
         return -1;
 
     *index_entries = entries;
 
-    index = ff_index_search_timestamp(*index_entries, *nb_index_entries,
-                                      timestamp, AVSEEK_FLAG_ANY);
+    index = index_search_from_end(entries, *nb_index_entries, timestamp);
 
     if (index < 0) {
         index = (*nb_index_entries)++;
@@ -16,8 +16,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#define _DEFAULT_SOURCE
+#define _SVID_SOURCE // needed for MAP_ANONYMOUS
+#define _DARWIN_C_SOURCE // needed for MAP_ANON
 #include <stdint.h>
 #include <string.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#if defined(MAP_ANON) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 
 #include "atomic.h"
 #include "buffer_internal.h"
@@ -89,6 +100,189 @@ AVBufferRef *av_buffer_allocz(int size)
     return ret;
 }
 
+static int large_alloc_flags;
+
+void av_buffer_set_large_alloc(int flags)
+{
+    large_alloc_flags = flags;
+}
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define USE_LARGE_MAP 1
+#else
+#define USE_LARGE_MAP 0
+#endif
+
+#if USE_LARGE_MAP
+/* buffers smaller than this always come from av_malloc() */
+#define LARGE_BUFFER_MIN    (1 << 20)
+#define HUGE_PAGE_SIZE      (2 << 20)
+#define PAGE_SIZE_MIN       4096
+/* maximum amount of memory kept mapped for reuse by AV_BUFFER_LARGE_RECYCLE */
+#define LARGE_RECYCLE_MAX   (512 << 20)
+
+typedef struct LargeBuffer {
+    uint8_t *map;
+    size_t   map_size;
+    int      size;      /* size of the buffers the mapping is used for */
+    struct LargeBuffer *next;
+} LargeBuffer;
+
+static AVMutex      large_recycle_mutex;
+static AVOnce       large_recycle_once = AV_ONCE_INIT;
+static LargeBuffer *large_recycle_list;
+static size_t       large_recycle_size;
+
+static void large_recycle_init(void)
+{
+    ff_mutex_init(&large_recycle_mutex, NULL);
+}
+
+static void large_buffer_free(void *opaque, uint8_t *data)
+{
+    LargeBuffer *buf = opaque;
+
+    if (large_alloc_flags & AV_BUFFER_LARGE_RECYCLE) {
+        ff_mutex_lock(&large_recycle_mutex);
+        if (large_recycle_size + buf->map_size <= LARGE_RECYCLE_MAX) {
+            buf->next           = large_recycle_list;
+            large_recycle_list  = buf;
+            large_recycle_size += buf->map_size;
+            buf = NULL;
+        }
+        ff_mutex_unlock(&large_recycle_mutex);
+        if (!buf)
+            return;
+    }
+
+    munmap(buf->map, buf->map_size);
+    av_free(buf);
+}
+
+/* take a recycled mapping used for buffers of the same size, NULL if there
+ * is none */
+static LargeBuffer *large_buffer_reuse(int size)
+{
+    LargeBuffer **p, *buf = NULL;
+
+    ff_mutex_lock(&large_recycle_mutex);
+    for (p = &large_recycle_list; *p; p = &(*p)->next) {
+        if ((*p)->size == size) {
+            buf = *p;
+            *p  = buf->next;
+            large_recycle_size -= buf->map_size;
+            break;
+        }
+    }
+    ff_mutex_unlock(&large_recycle_mutex);
+
+    return buf;
+}
+
+/* map anonymous memory for a buffer of the given size, starting on a huge
+ * page boundary */
+static int large_buffer_map(LargeBuffer *buf, int size, int flags)
+{
+    uint8_t *map;
+    size_t head, tail;
+
+#ifdef MAP_HUGETLB
+    if (flags & AV_BUFFER_LARGE_HUGETLB) {
+        buf->map_size = FFALIGN((size_t)size, HUGE_PAGE_SIZE);
+        buf->map      = mmap(NULL, buf->map_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buf->map != MAP_FAILED)
+            return 0;
+        /* no huge pages reserved, fall back to normal pages */
+    }
+#endif
+
+    /* Transparent huge pages are only used for aligned 2 MB ranges, so map
+     * one huge page more than needed and trim the ends. Whatever is left
+     * past the last whole huge page uses normal pages. */
+    buf->map_size = FFALIGN((size_t)size, PAGE_SIZE_MIN);
+    map = mmap(NULL, buf->map_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(ENOMEM);
+
+    head = FFALIGN((uintptr_t)map, HUGE_PAGE_SIZE) - (uintptr_t)map;
+    tail = HUGE_PAGE_SIZE - head;
+    if (head)
+        munmap(map, head);
+    if (tail)
+        munmap(map + head + buf->map_size, tail);
+    buf->map = map + head;
+
+#ifdef MADV_HUGEPAGE
+    if (flags & AV_BUFFER_LARGE_THP)
+        madvise(buf->map, buf->map_size, MADV_HUGEPAGE);
+#endif
+
+    return 0;
+}
+
+static AVBufferRef *buffer_alloc_large(int size, int zero)
+{
+    int flags = large_alloc_flags;
+    LargeBuffer *buf = NULL;
+    AVBufferRef *ret;
+
+    if (!flags || size < LARGE_BUFFER_MIN)
+        return zero ? av_buffer_allocz(size) : av_buffer_alloc(size);
+
+    ff_thread_once(&large_recycle_once, large_recycle_init);
+
+    if (flags & AV_BUFFER_LARGE_RECYCLE)
+        buf = large_buffer_reuse(size);
+
+    if (buf) {
+        if (zero)
+            memset(buf->map, 0, size);
+    } else {
+        buf = av_malloc(sizeof(*buf));
+        if (!buf)
+            return NULL;
+
+        buf->size = size;
+        if (large_buffer_map(buf, size, flags) < 0) {
+            av_free(buf);
+            return zero ? av_buffer_allocz(size) : av_buffer_alloc(size);
+        }
+
+        /* Linux places a page on the NUMA node of the thread that first
+         * writes to it, so do that here rather than in whichever thread
+         * happens to use the buffer first. New mappings are zeroed already. */
+        if (flags & AV_BUFFER_LARGE_FIRST_TOUCH) {
+            size_t i;
+            for (i = 0; i < buf->map_size; i += PAGE_SIZE_MIN)
+                buf->map[i] = 0;
+        }
+    }
+
+    ret = av_buffer_create(buf->map, size, large_buffer_free, buf, 0);
+    if (!ret)
+        large_buffer_free(buf, buf->map);
+
+    return ret;
+}
+#else
+static AVBufferRef *buffer_alloc_large(int size, int zero)
+{
+    return zero ? av_buffer_allocz(size) : av_buffer_alloc(size);
+}
+#endif
+
+AVBufferRef *av_buffer_alloc_large(int size)
+{
+    return buffer_alloc_large(size, 0);
+}
+
+AVBufferRef *av_buffer_allocz_large(int size)
+{
+    return buffer_alloc_large(size, 1);
+}
+
 AVBufferRef *av_buffer_ref(AVBufferRef *buf)
 {
     AVBufferRef *ret = av_mallocz(sizeof(*ret));
@@ -116,8 +310,13 @@ static void buffer_replace(AVBufferRef **dst, AVBufferRef **src)
         av_freep(dst);
 
     if (!avpriv_atomic_int_add_and_fetch(&b->refcount, -1)) {
+        /* b->free() may hand the structure containing b to another thread,
+         * so the flag must be read before calling it */
+        int free_avbuffer = !(b->flags & BUFFER_FLAG_NO_FREE);
+
         b->free(b->opaque, b->data);
-        av_freep(&b);
+        if (free_avbuffer)
+            av_free(b);
     }
 }
 
@@ -214,6 +413,52 @@ int av_buffer_realloc(AVBufferRef **pbuf, int size)
     return 0;
 }
 
+#if USE_MAGAZINES
+static pthread_key_t magazine_key;
+static AVOnce        magazine_key_once = AV_ONCE_INIT;
+static volatile int  magazine_next_index;
+
+static void magazine_key_init(void)
+{
+    pthread_key_create(&magazine_key, NULL);
+}
+
+/* return the magazine of pool used by the calling thread */
+static BufferPoolMagazine *get_magazine(AVBufferPool *pool)
+{
+    intptr_t index;
+
+    ff_thread_once(&magazine_key_once, magazine_key_init);
+
+    index = (intptr_t)pthread_getspecific(magazine_key);
+    if (!index) {
+        index = avpriv_atomic_int_add_and_fetch(&magazine_next_index, 1);
+        pthread_setspecific(magazine_key, (void *)index);
+    }
+
+    return &pool->magazines[(uintptr_t)(index - 1) % BUFFER_POOL_MAGAZINES];
+}
+
+/* lock a mutex, counting in *contended whether another thread held it */
+static void lock_counted(AVMutex *mutex, int64_t *contended)
+{
+    if (pthread_mutex_trylock(mutex)) {
+        ff_mutex_lock(mutex);
+        (*contended)++;
+    }
+}
+#endif
+
+static void pool_init_magazines(AVBufferPool *pool)
+{
+#if USE_MAGAZINES
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_MAGAZINES; i++)
+        ff_mutex_init(&pool->magazines[i].mutex, NULL);
+#endif
+}
+
 AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque))
@@ -223,6 +468,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    pool_init_magazines(pool);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -241,6 +487,7 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    pool_init_magazines(pool);
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -256,6 +503,22 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+#if USE_MAGAZINES
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_MAGAZINES; i++) {
+        BufferPoolMagazine *mag = &pool->magazines[i];
+
+        while (mag->nb_entries) {
+            BufferPoolEntry *buf = mag->entries[--mag->nb_entries];
+
+            buf->free(buf->opaque, buf->data);
+            av_freep(&buf);
+        }
+        ff_mutex_destroy(&mag->mutex);
+    }
+#endif
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
@@ -284,6 +547,60 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+#if USE_MAGAZINES
+/* move the oldest half of a full magazine to the shared list */
+static void flush_magazine(AVBufferPool *pool, BufferPoolMagazine *mag)
+{
+    const int n = BUFFER_POOL_MAGAZINE_SIZE / 2;
+    int i;
+
+    for (i = 0; i < n - 1; i++)
+        mag->entries[i]->next = mag->entries[i + 1];
+
+    lock_counted(&pool->mutex, &mag->contended);
+    mag->entries[n - 1]->next = pool->pool;
+    pool->pool = mag->entries[0];
+    ff_mutex_unlock(&pool->mutex);
+
+    mag->nb_entries -= n;
+    memmove(mag->entries, mag->entries + n, mag->nb_entries * sizeof(*mag->entries));
+}
+
+/* fill an empty magazine with up to half a magazine of entries, from the
+ * shared list or else from the magazines of other threads */
+static void refill_magazine(AVBufferPool *pool, BufferPoolMagazine *mag)
+{
+    const int n = BUFFER_POOL_MAGAZINE_SIZE / 2;
+    int i;
+
+    lock_counted(&pool->mutex, &mag->contended);
+    while (pool->pool && mag->nb_entries < n) {
+        mag->entries[mag->nb_entries++] = pool->pool;
+        pool->pool = pool->pool->next;
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    /* Entries released by other threads may be sitting in their magazines,
+     * take some rather than allocating a new buffer. Only magazines that are
+     * free right now are looked at, so this never waits. */
+    for (i = 0; i < BUFFER_POOL_MAGAZINES && !mag->nb_entries; i++) {
+        BufferPoolMagazine *other = &pool->magazines[i];
+        int take;
+
+        if (other == mag || !other->nb_entries ||
+            pthread_mutex_trylock(&other->mutex))
+            continue;
+
+        take = FFMIN((other->nb_entries + 1) / 2, n);
+        other->nb_entries -= take;
+        memcpy(mag->entries, other->entries + other->nb_entries,
+               take * sizeof(*mag->entries));
+        mag->nb_entries = take;
+        ff_mutex_unlock(&other->mutex);
+    }
+}
+#endif
+
 #if USE_ATOMICS
 /* remove the whole buffer list from the pool and return it */
 static BufferPoolEntry *get_pool(AVBufferPool *pool)
@@ -330,7 +647,17 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-#if USE_ATOMICS
+#if USE_MAGAZINES
+    {
+        BufferPoolMagazine *mag = get_magazine(pool);
+
+        lock_counted(&mag->mutex, &mag->contended);
+        if (mag->nb_entries == BUFFER_POOL_MAGAZINE_SIZE)
+            flush_magazine(pool, mag);
+        mag->entries[mag->nb_entries++] = buf;
+        ff_mutex_unlock(&mag->mutex);
+    }
+#elif USE_ATOMICS
     add_to_pool(buf);
 #else
     ff_mutex_lock(&pool->mutex);
@@ -371,8 +698,31 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 #if USE_ATOMICS
     avpriv_atomic_int_add_and_fetch(&pool->refcount, 1);
-    avpriv_atomic_int_add_and_fetch(&pool->nb_allocated, 1);
 #endif
+    avpriv_atomic_int_add_and_fetch(&pool->nb_allocated, 1);
+
+    return ret;
+}
+
+/* wrap a free entry of the pool into a new reference, using the AVBuffer
+ * embedded in the entry */
+static AVBufferRef *pool_reuse_buffer(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    AVBufferRef *ret = av_mallocz(sizeof(*ret));
+
+    if (!ret)
+        return NULL;
+
+    buf->buffer.data     = buf->data;
+    buf->buffer.size     = pool->size;
+    buf->buffer.free     = pool_release_buffer;
+    buf->buffer.opaque   = buf;
+    buf->buffer.flags    = BUFFER_FLAG_NO_FREE;
+    buf->buffer.refcount = 1;
+
+    ret->buffer = &buf->buffer;
+    ret->data   = buf->data;
+    ret->size   = pool->size;
 
     return ret;
 }
@@ -382,7 +732,32 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-#if USE_ATOMICS
+#if USE_MAGAZINES
+    BufferPoolMagazine *mag = get_magazine(pool);
+
+    lock_counted(&mag->mutex, &mag->contended);
+    if (!mag->nb_entries)
+        refill_magazine(pool, mag);
+
+    buf = mag->nb_entries ? mag->entries[--mag->nb_entries] : NULL;
+    if (buf)
+        mag->hits++;
+    else
+        mag->misses++;
+    ff_mutex_unlock(&mag->mutex);
+
+    if (buf) {
+        ret = pool_reuse_buffer(pool, buf);
+        if (!ret) {
+            /* give the entry back, keeping the refcount balanced */
+            avpriv_atomic_int_add_and_fetch(&pool->refcount, 1);
+            pool_release_buffer(buf, buf->data);
+            return NULL;
+        }
+    } else {
+        ret = pool_alloc_buffer(pool);
+    }
+#elif USE_ATOMICS
     /* check whether the pool is empty */
     buf = get_pool(pool);
     if (!buf && pool->refcount <= pool->nb_allocated) {
@@ -391,8 +766,11 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
             buf = get_pool(pool);
     }
 
-    if (!buf)
+    if (!buf) {
+        pool->misses++;
         return pool_alloc_buffer(pool);
+    }
+    pool->hits++;
 
     /* keep the first entry, return the rest of the list to the pool */
     add_to_pool(buf->next);
@@ -413,9 +791,11 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
         if (ret) {
             pool->pool = buf->next;
             buf->next = NULL;
+            pool->hits++;
         }
     } else {
         ret = pool_alloc_buffer(pool);
+        pool->misses++;
     }
     ff_mutex_unlock(&pool->mutex);
 #endif
@@ -425,3 +805,38 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 
     return ret;
 }
+
+int av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats)
+{
+#if USE_MAGAZINES
+    int i;
+#endif
+
+    if (!pool || !stats)
+        return AVERROR(EINVAL);
+
+    memset(stats, 0, sizeof(*stats));
+
+    ff_mutex_lock(&pool->mutex);
+    stats->hits      = pool->hits;
+    stats->misses    = pool->misses;
+    stats->contended = pool->contended;
+    ff_mutex_unlock(&pool->mutex);
+
+#if USE_MAGAZINES
+    for (i = 0; i < BUFFER_POOL_MAGAZINES; i++) {
+        BufferPoolMagazine *mag = &pool->magazines[i];
+
+        ff_mutex_lock(&mag->mutex);
+        stats->hits      += mag->hits;
+        stats->misses    += mag->misses;
+        stats->contended += mag->contended;
+        ff_mutex_unlock(&mag->mutex);
+    }
+#endif
+
+    stats->high_water_bytes = (int64_t)avpriv_atomic_int_get(&pool->nb_allocated) *
+                              pool->size;
+
+    return 0;
+}
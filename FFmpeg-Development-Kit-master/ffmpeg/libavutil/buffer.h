@@ -106,6 +106,61 @@ AVBufferRef *av_buffer_alloc(int size);
  */
 AVBufferRef *av_buffer_allocz(int size);
 
+/**
+ * @defgroup lavu_buffer_large Large buffer allocation
+ * Flags for av_buffer_set_large_alloc().
+ * @{
+ */
+/**
+ * Ask the kernel to back large buffers with transparent huge pages.
+ */
+#define AV_BUFFER_LARGE_THP         (1 << 0)
+/**
+ * Back large buffers with explicitly reserved huge pages (MAP_HUGETLB) when
+ * there are any left, falling back to normal pages otherwise.
+ */
+#define AV_BUFFER_LARGE_HUGETLB     (1 << 1)
+/**
+ * Fault in the pages of new large buffers in the allocating thread, so they
+ * are placed on its NUMA node.
+ */
+#define AV_BUFFER_LARGE_FIRST_TOUCH (1 << 2)
+/**
+ * Keep the memory of freed large buffers mapped and reuse it for new ones
+ * of the same size instead of returning it to the OS.
+ */
+#define AV_BUFFER_LARGE_RECYCLE     (1 << 3)
+/**
+ * @}
+ */
+
+/**
+ * Select how av_buffer_alloc_large() and av_buffer_allocz_large() allocate
+ * memory. This is a global setting, used among others for video frame
+ * buffers allocated by libavutil and libavcodec. It should be called before
+ * any such buffer is allocated.
+ *
+ * @param flags a combination of AV_BUFFER_LARGE_*, 0 (the default) to
+ *              allocate all buffers with av_malloc()
+ */
+void av_buffer_set_large_alloc(int flags);
+
+/**
+ * Allocate an AVBuffer of the given size, intended for large buffers such as
+ * video frame planes. With the default settings this is the same as
+ * av_buffer_alloc(), otherwise buffers of 1 MB and more are mapped directly
+ * as selected with av_buffer_set_large_alloc().
+ *
+ * @return an AVBufferRef of given size or NULL when out of memory
+ */
+AVBufferRef *av_buffer_alloc_large(int size);
+
+/**
+ * Same as av_buffer_alloc_large(), except the returned buffer will be
+ * initialized to zero.
+ */
+AVBufferRef *av_buffer_allocz_large(int size);
+
 /**
  * Always treat the buffer as read-only, even when it has only one
  * reference.
@@ -283,6 +338,42 @@ void av_buffer_pool_uninit(AVBufferPool **pool);
  */
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
 
+/**
+ * Usage statistics of a buffer pool, see av_buffer_pool_get_stats().
+ */
+typedef struct AVBufferPoolStats {
+    /**
+     * Number of av_buffer_pool_get() calls served with a buffer already
+     * allocated by the pool.
+     */
+    int64_t hits;
+    /**
+     * Number of av_buffer_pool_get() calls that had to allocate a new buffer.
+     */
+    int64_t misses;
+    /**
+     * Number of times a get or release had to wait for a lock held by
+     * another thread.
+     */
+    int64_t contended;
+    /**
+     * Bytes allocated by the pool. Buffers are only freed with the pool, so
+     * this is also the highest amount of memory the pool has used.
+     */
+    int64_t high_water_bytes;
+} AVBufferPoolStats;
+
+/**
+ * Get usage statistics of a buffer pool.
+ * This function may be called simultaneously with other pool functions from
+ * other threads, the counters are then a snapshot that may be slightly off.
+ *
+ * @param pool  the pool to query
+ * @param stats filled with the statistics of the pool
+ * @return 0 on success, a negative AVERROR on error
+ */
+int av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats);
+
 /**
  * @}
  */
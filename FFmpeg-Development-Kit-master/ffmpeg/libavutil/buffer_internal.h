@@ -32,6 +32,11 @@
  * The buffer was av_realloc()ed, so it is reallocatable.
  */
 #define BUFFER_FLAG_REALLOCATABLE (1 << 1)
+/**
+ * The AVBuffer structure itself is not to be freed, it is embedded in a
+ * pool entry and reused with it.
+ */
+#define BUFFER_FLAG_NO_FREE       (1 << 2)
 
 struct AVBuffer {
     uint8_t *data; /**< data described by this buffer */
@@ -61,6 +66,12 @@ struct AVBuffer {
 typedef struct BufferPoolEntry {
     uint8_t *data;
 
+    /*
+     * AVBuffer handed out when the entry is reused, so getting a buffer from
+     * the pool does not have to allocate one.
+     */
+    AVBuffer buffer;
+
     /*
      * Backups of the original opaque/free of the AVBuffer corresponding to
      * data. They will be used to free the buffer when the pool is freed.
@@ -72,10 +83,52 @@ typedef struct BufferPoolEntry {
     struct BufferPoolEntry *next;
 } BufferPoolEntry;
 
+#define USE_MAGAZINES HAVE_PTHREADS
+
+/*
+ * Number of magazines in front of the shared list of each pool. Threads are
+ * spread over them by a per-thread index, so as long as no more threads than
+ * that use a pool, none of them share a magazine.
+ */
+#define BUFFER_POOL_MAGAZINES     16
+/*
+ * Maximum number of entries in a magazine. Entries move between a magazine
+ * and the shared list half a magazine at a time.
+ */
+#define BUFFER_POOL_MAGAZINE_SIZE 8
+
+/*
+ * Small LIFO of free entries used by one thread (or a few, if there are more
+ * threads than magazines), so that most gets and releases only take a lock
+ * nobody else is holding.
+ */
+typedef struct BufferPoolMagazine {
+    AVMutex mutex;
+    BufferPoolEntry *entries[BUFFER_POOL_MAGAZINE_SIZE];
+    int nb_entries;
+
+    /* statistics, updated with the magazine locked */
+    int64_t hits;
+    int64_t misses;
+    int64_t contended;
+
+    /* keep magazines of different threads on different cache lines */
+    uint8_t padding[64];
+} BufferPoolMagazine;
+
 struct AVBufferPool {
     AVMutex mutex;
     BufferPoolEntry *pool;
 
+#if USE_MAGAZINES
+    BufferPoolMagazine magazines[BUFFER_POOL_MAGAZINES];
+#endif
+
+    /* statistics of the shared list, updated with mutex locked */
+    int64_t hits;
+    int64_t misses;
+    int64_t contended;
+
     /*
      * This is used to track when the pool is to be freed.
      * The pointer to the pool itself held by the caller is considered to
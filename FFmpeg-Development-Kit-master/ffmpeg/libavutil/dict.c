@@ -27,11 +27,123 @@
 #include "time_internal.h"
 #include "bprint.h"
 
+/* number of entries above which a dictionary gets a hash index */
+#ifndef DICT_HASH_THRESHOLD
+#define DICT_HASH_THRESHOLD 32
+#endif
+
+typedef struct DictHashEntry {
+    unsigned hash;
+    int next;
+} DictHashEntry;
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+    unsigned elems_size;
+
+    /* Optional hash index over the keys: each bucket holds a chain of the
+     * elements whose case-insensitive key hash falls into it. The elements
+     * keep their order, so only exact key lookups go through the index. */
+    int nb_buckets;
+    int *buckets;
+    DictHashEntry *hashes;
+    unsigned hashes_size;
 };
 
+static unsigned dict_hash(const char *key)
+{
+    unsigned h = 2166136261U;
+    while (*key)
+        h = (h ^ av_toupper(*key++)) * 16777619U;
+    return h;
+}
+
+static void dict_index_free(AVDictionary *m)
+{
+    av_freep(&m->buckets);
+    av_freep(&m->hashes);
+    m->hashes_size = 0;
+    m->nb_buckets  = 0;
+}
+
+static void dict_index_link(AVDictionary *m, int i)
+{
+    int *bucket = &m->buckets[m->hashes[i].hash & (m->nb_buckets - 1)];
+    m->hashes[i].next = *bucket;
+    *bucket = i;
+}
+
+static void dict_index_unlink(AVDictionary *m, int i)
+{
+    int *p = &m->buckets[m->hashes[i].hash & (m->nb_buckets - 1)];
+    while (*p != i)
+        p = &m->hashes[*p].next;
+    *p = m->hashes[i].next;
+}
+
+/**
+ * Make room in the index for nb_elems elements. The index is dropped if it
+ * cannot be grown, lookups then fall back to scanning the elements.
+ */
+static void dict_index_reserve(AVDictionary *m, int nb_elems)
+{
+    DictHashEntry *tmp;
+
+    if (!m->nb_buckets)
+        return;
+    tmp = av_fast_realloc(m->hashes, &m->hashes_size,
+                          nb_elems * sizeof(*m->hashes));
+    if (!tmp) {
+        dict_index_free(m);
+        return;
+    }
+    m->hashes = tmp;
+}
+
+/**
+ * (Re)build the index with at least as many buckets as elements.
+ */
+static void dict_index_build(AVDictionary *m)
+{
+    int i, nb_buckets = 16;
+
+    while (nb_buckets < m->count)
+        nb_buckets <<= 1;
+    av_freep(&m->buckets);
+    if (!(m->buckets = av_malloc_array(nb_buckets, sizeof(*m->buckets)))) {
+        dict_index_free(m);
+        return;
+    }
+    memset(m->buckets, -1, nb_buckets * sizeof(*m->buckets));
+    m->nb_buckets = nb_buckets;
+    dict_index_reserve(m, nb_buckets);
+    if (!m->nb_buckets)
+        return;
+    for (i = 0; i < m->count; i++) {
+        m->hashes[i].hash = dict_hash(m->elems[i].key);
+        dict_index_link(m, i);
+    }
+}
+
+static AVDictionaryEntry *dict_index_get(const AVDictionary *m, const char *key,
+                                         int start, int flags)
+{
+    unsigned hash = dict_hash(key);
+    int i, found = -1;
+
+    /* equal keys may be chained in any order, return the first one */
+    for (i = m->buckets[hash & (m->nb_buckets - 1)]; i >= 0; i = m->hashes[i].next) {
+        const char *s = m->elems[i].key;
+        if (i < start || (found >= 0 && i > found) || m->hashes[i].hash != hash)
+            continue;
+        if (flags & AV_DICT_MATCH_CASE ? strcmp(s, key) : av_strcasecmp(s, key))
+            continue;
+        found = i;
+    }
+    return found >= 0 ? &m->elems[found] : NULL;
+}
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -50,6 +162,9 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     else
         i = 0;
 
+    if (m->nb_buckets && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return dict_index_get(m, key, i, flags);
+
     for (; i < m->count; i++) {
         const char *s = m->elems[i].key;
         if (flags & AV_DICT_MATCH_CASE)
@@ -101,13 +216,23 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         else
             av_free(tag->value);
         av_free(tag->key);
+        if (m->nb_buckets) {
+            int i = tag - m->elems, last = m->count - 1;
+            dict_index_unlink(m, i);
+            if (i != last) {
+                dict_index_unlink(m, last);
+                m->hashes[i].hash = m->hashes[last].hash;
+                dict_index_link(m, i);
+            }
+        }
         *tag = m->elems[--m->count];
     } else if (copy_value) {
-        AVDictionaryEntry *tmp = av_realloc(m->elems,
-                                            (m->count + 1) * sizeof(*m->elems));
+        AVDictionaryEntry *tmp = av_fast_realloc(m->elems, &m->elems_size,
+                                                 (m->count + 1) * sizeof(*m->elems));
         if (!tmp)
             goto err_out;
         m->elems = tmp;
+        dict_index_reserve(m, m->count + 1);
     }
     if (copy_value) {
         m->elems[m->count].key = copy_key;
@@ -123,11 +248,19 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             m->elems[m->count].value = newval;
             av_freep(&copy_value);
         }
+        if (m->nb_buckets) {
+            m->hashes[m->count].hash = dict_hash(copy_key);
+            dict_index_link(m, m->count);
+        }
         m->count++;
+        if (m->nb_buckets ? m->count > m->nb_buckets :
+            m->count >= DICT_HASH_THRESHOLD || (flags & AV_DICT_HASH_INDEX))
+            dict_index_build(m);
     } else {
         av_freep(&copy_key);
     }
     if (!m->count) {
+        dict_index_free(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -136,6 +269,7 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
 
 err_out:
     if (m && !m->count) {
+        dict_index_free(m);
         av_freep(&m->elems);
         av_freep(pm);
     }
@@ -209,6 +343,7 @@ void av_dict_free(AVDictionary **pm)
             av_freep(&m->elems[m->count].key);
             av_freep(&m->elems[m->count].value);
         }
+        dict_index_free(m);
         av_freep(&m->elems);
     }
     av_freep(pm);
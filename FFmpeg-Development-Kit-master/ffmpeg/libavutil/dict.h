@@ -77,6 +77,9 @@
 #define AV_DICT_APPEND         32   /**< If the entry already exists, append to it.  Note that no
                                       delimiter is added, the strings are simply concatenated. */
 #define AV_DICT_MULTIKEY       64   /**< Allow to store several equal keys in the dictionary */
+#define AV_DICT_HASH_INDEX    128   /**< Index the keys by hash from now on, so that av_dict_get()
+                                         without AV_DICT_IGNORE_SUFFIX does not scan every entry.
+                                         Large dictionaries are indexed automatically. */
 
 typedef struct AVDictionaryEntry {
     char *key;
@@ -0,0 +1,257 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "atomic.h"
+#include "common.h"
+#include "cpu.h"
+#include "executor_internal.h"
+#include "internal.h"
+#include "mem.h"
+#include "thread.h"
+
+#define MAX_WORKERS 256
+
+static volatile int max_worker_threads;
+
+void av_set_max_worker_threads(int count)
+{
+    max_worker_threads = av_clip(count, 0, MAX_WORKERS);
+}
+
+#if HAVE_THREADS
+
+struct AVExecutorClient {
+    void *priv;
+    void (*job_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
+    int nb_threads;
+    int priority;
+
+    /* current batch; next_job is updated atomically, the rest with the
+     * executor mutex locked */
+    int nb_jobs;
+    volatile int next_job;
+    int next_threadnr;
+    int nb_running;             ///< threads still running jobs of the batch
+    int queued;
+    AVExecutorClient *next;     ///< next client in the executor queue
+    pthread_cond_t done_cond;
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  work_cond;
+    /* clients whose batch can take more threads, highest priority first */
+    AVExecutorClient *queue;
+    pthread_t workers[MAX_WORKERS];
+    int nb_workers;
+} executor;
+
+static AVOnce executor_once = AV_ONCE_INIT;
+
+static void executor_init(void)
+{
+    pthread_mutex_init(&executor.mutex, NULL);
+    pthread_cond_init(&executor.work_cond, NULL);
+}
+
+static void enqueue(AVExecutorClient *c)
+{
+    AVExecutorClient **p = &executor.queue;
+
+    while (*p && (*p)->priority >= c->priority)
+        p = &(*p)->next;
+    c->next   = *p;
+    *p        = c;
+    c->queued = 1;
+}
+
+static void dequeue(AVExecutorClient *c)
+{
+    AVExecutorClient **p = &executor.queue;
+
+    if (!c->queued)
+        return;
+    while (*p != c)
+        p = &(*p)->next;
+    *p        = c->next;
+    c->queued = 0;
+}
+
+/* run jobs of the batch of c until none are left, called with the mutex
+ * locked after joining the batch */
+static void run_jobs(AVExecutorClient *c, int threadnr)
+{
+    int jobnr;
+
+    pthread_mutex_unlock(&executor.mutex);
+    while ((jobnr = avpriv_atomic_int_add_and_fetch(&c->next_job, 1) - 1) < c->nb_jobs)
+        c->job_func(c->priv, jobnr, threadnr, c->nb_jobs, c->nb_threads);
+    pthread_mutex_lock(&executor.mutex);
+
+    /* no point in anyone else joining anymore */
+    dequeue(c);
+    if (!--c->nb_running)
+        pthread_cond_signal(&c->done_cond);
+}
+
+static void *attribute_align_arg worker(void *arg)
+{
+    pthread_mutex_lock(&executor.mutex);
+    for (;;) {
+        AVExecutorClient *c = executor.queue;
+        int threadnr;
+
+        if (!c) {
+            pthread_cond_wait(&executor.work_cond, &executor.mutex);
+            continue;
+        }
+        if (c->next_job >= c->nb_jobs) {
+            dequeue(c);
+            continue;
+        }
+
+        threadnr = c->next_threadnr++;
+        c->nb_running++;
+        if (c->next_threadnr == c->nb_threads)
+            dequeue(c);
+
+        run_jobs(c, threadnr);
+    }
+    return NULL;
+}
+
+/* start workers until there are enough to serve a batch of c, called with
+ * the mutex locked */
+static void start_workers(AVExecutorClient *c)
+{
+    int max = max_worker_threads ? max_worker_threads : av_cpu_count();
+
+    max = FFMIN(max, MAX_WORKERS);
+    while (executor.nb_workers < FFMIN(max, c->nb_threads - 1)) {
+        if (pthread_create(&executor.workers[executor.nb_workers], NULL, worker, NULL))
+            break;
+        executor.nb_workers++;
+    }
+}
+
+int avpriv_executor_client_create(AVExecutorClient **pclient, void *priv,
+                                  void (*job_func)(void *priv, int jobnr, int threadnr,
+                                                   int nb_jobs, int nb_threads),
+                                  int nb_threads, int priority)
+{
+    AVExecutorClient *c;
+    int ret;
+
+    ff_thread_once(&executor_once, executor_init);
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    if ((ret = pthread_cond_init(&c->done_cond, NULL))) {
+        av_free(c);
+        return AVERROR(ret);
+    }
+
+    c->priv       = priv;
+    c->job_func   = job_func;
+    c->nb_threads = FFMAX(nb_threads, 1);
+    c->priority   = priority;
+
+    *pclient = c;
+    return 0;
+}
+
+void avpriv_executor_execute(AVExecutorClient *c, int nb_jobs)
+{
+    int nb_helpers = FFMIN(nb_jobs, c->nb_threads) - 1;
+
+    if (nb_jobs <= 0)
+        return;
+
+    pthread_mutex_lock(&executor.mutex);
+
+    c->nb_jobs       = nb_jobs;
+    c->next_job      = 0;
+    c->next_threadnr = 1; /* 0 is for this thread */
+    c->nb_running    = 1;
+
+    if (nb_helpers > 0) {
+        start_workers(c);
+        enqueue(c);
+        while (nb_helpers--)
+            pthread_cond_signal(&executor.work_cond);
+    }
+
+    run_jobs(c, 0);
+
+    while (c->nb_running)
+        pthread_cond_wait(&c->done_cond, &executor.mutex);
+
+    pthread_mutex_unlock(&executor.mutex);
+}
+
+void avpriv_executor_client_free(AVExecutorClient **pclient)
+{
+    AVExecutorClient *c = *pclient;
+
+    if (!c)
+        return;
+
+    pthread_cond_destroy(&c->done_cond);
+    av_freep(pclient);
+}
+
+#else
+
+struct AVExecutorClient {
+    void *priv;
+    void (*job_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
+};
+
+int avpriv_executor_client_create(AVExecutorClient **pclient, void *priv,
+                                  void (*job_func)(void *priv, int jobnr, int threadnr,
+                                                   int nb_jobs, int nb_threads),
+                                  int nb_threads, int priority)
+{
+    AVExecutorClient *c = av_mallocz(sizeof(*c));
+
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    c->priv     = priv;
+    c->job_func = job_func;
+
+    *pclient = c;
+    return 0;
+}
+
+void avpriv_executor_execute(AVExecutorClient *c, int nb_jobs)
+{
+    int jobnr;
+
+    for (jobnr = 0; jobnr < nb_jobs; jobnr++)
+        c->job_func(c->priv, jobnr, 0, nb_jobs, 1);
+}
+
+void avpriv_executor_client_free(AVExecutorClient **pclient)
+{
+    av_freep(pclient);
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,42 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_EXECUTOR_H
+#define AVUTIL_EXECUTOR_H
+
+/**
+ * @file
+ * Process-wide pool of worker threads running the slice jobs of codec and
+ * filter contexts.
+ *
+ * Workers are started on demand up to a global limit and are shared by all
+ * contexts, so opening and closing a context does not start or stop threads.
+ */
+
+/**
+ * Set the maximum number of worker threads of the process-wide pool that
+ * runs the slice threading jobs of all codec and filter contexts. Threads
+ * submitting jobs run some of them too and are not counted. Lowering the
+ * limit does not stop workers that are already running.
+ *
+ * @param count maximum number of workers, 0 (the default) for
+ *              av_cpu_count()
+ */
+void av_set_max_worker_threads(int count);
+
+#endif /* AVUTIL_EXECUTOR_H */
@@ -0,0 +1,69 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_EXECUTOR_INTERNAL_H
+#define AVUTIL_EXECUTOR_INTERNAL_H
+
+/**
+ * @file
+ * Client API of the executor, see executor.h.
+ *
+ * Contexts register as clients and submit batches of jobs. An idle worker
+ * joins the running batch of the client with the highest priority that
+ * still has jobs left; the thread submitting a batch runs its jobs too.
+ */
+
+#include "executor.h"
+
+/* client priorities, batches of higher priority clients are served first */
+#define AV_EXECUTOR_PRIORITY_ENCODER 0
+#define AV_EXECUTOR_PRIORITY_FILTER  1
+#define AV_EXECUTOR_PRIORITY_DECODER 2
+
+typedef struct AVExecutorClient AVExecutorClient;
+
+/**
+ * Create a client of the executor.
+ *
+ * @param pclient    set to the new client
+ * @param priv       opaque pointer passed to job_func
+ * @param job_func   function running one job of a batch. threadnr is in
+ *                   [0, nb_threads) and unique among the jobs of the batch
+ *                   running at the same time.
+ * @param nb_threads maximum number of jobs of a batch running at the same
+ *                   time, including the submitting thread
+ * @param priority   one of AV_EXECUTOR_PRIORITY_*
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int avpriv_executor_client_create(AVExecutorClient **pclient, void *priv,
+                                  void (*job_func)(void *priv, int jobnr, int threadnr,
+                                                   int nb_jobs, int nb_threads),
+                                  int nb_threads, int priority);
+
+/**
+ * Run a batch of jobs, returning once all of them are done. Must not be
+ * called concurrently for the same client.
+ */
+void avpriv_executor_execute(AVExecutorClient *client, int nb_jobs);
+
+/**
+ * Destroy a client. No batch of it may be running.
+ */
+void avpriv_executor_client_free(AVExecutorClient **pclient);
+
+#endif /* AVUTIL_EXECUTOR_INTERNAL_H */
@@ -34,14 +34,17 @@
 #endif
 #include <stdarg.h>
 #include <stdlib.h>
+#include "avstring.h"
 #include "avutil.h"
 #include "bprint.h"
 #include "common.h"
 #include "internal.h"
 #include "log.h"
+#include "time.h"
 
 #if HAVE_PTHREADS
 #include <pthread.h>
+#include "atomic.h"
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
@@ -299,6 +302,361 @@ int av_log_format_line2(void *ptr, int level, const char *fmt, va_list vl,
     return ret;
 }
 
+static void write_line(int level, unsigned tint, int type[2], char *part[4])
+{
+    sanitize(part[0]);
+    colored_fputs(type[0], 0, part[0]);
+    sanitize(part[1]);
+    colored_fputs(type[1], 0, part[1]);
+    sanitize(part[2]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2]);
+    sanitize(part[3]);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3]);
+}
+
+#if HAVE_PTHREADS
+/*
+ * Asynchronous output: every logging thread formats its lines into a ring
+ * of its own, which only the writer thread reads. A thread whose ring is
+ * full drops the line instead of waiting. The writer merges the rings in
+ * logging order and does the deduplication and rate limiting per context.
+ */
+#define ASYNC_SLOTS    64
+#define ASYNC_CONTEXTS 64
+
+typedef struct AsyncLine {
+    int seq;
+    int level;
+    unsigned tint;
+    int type[2];
+    int len[4];
+    unsigned dropped;   ///< lines the thread dropped just before this one
+    void *avcl;
+    int64_t time;
+    char text[LINE_SZ];
+} AsyncLine;
+
+typedef struct AsyncRing {
+    struct AsyncRing *next;
+    void * volatile owner;  ///< the ring itself while a thread uses it
+    volatile int head;      ///< written by the writer
+    volatile int tail;      ///< written by the owning thread
+    int print_prefix;
+    unsigned dropped;
+    AsyncLine line[ASYNC_SLOTS];
+} AsyncRing;
+
+/* writer state for one logging context */
+typedef struct AsyncContext {
+    void *avcl;
+    int used;
+    int repeated;
+    int lines;
+    int suppressed;
+    int64_t window_start;
+    char prefix[256];
+    char last[LINE_SZ];
+} AsyncContext;
+
+static AsyncRing * volatile async_rings;
+static pthread_key_t async_key;
+static pthread_once_t async_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static int async_running;
+static int async_max_rate;
+static volatile int async_enabled;
+static volatile int async_active;
+static volatile int async_waiting;
+static volatile int async_quit;
+static volatile int async_seq;
+static AsyncContext async_ctx[ASYNC_CONTEXTS];
+
+static inline int async_next(int pos)
+{
+    return pos + 1 == 2 * ASYNC_SLOTS ? 0 : pos + 1;
+}
+
+static inline AsyncLine *async_slot(AsyncRing *r, int pos)
+{
+    return &r->line[pos & (ASYNC_SLOTS - 1)];
+}
+
+static void async_ring_release(void *r)
+{
+    avpriv_atomic_ptr_cas(&((AsyncRing *)r)->owner, r, NULL);
+}
+
+static void async_key_init(void)
+{
+    pthread_key_create(&async_key, async_ring_release);
+}
+
+/* get the calling thread's ring, reusing one left by an exited thread */
+static AsyncRing *async_get_ring(void)
+{
+    AsyncRing *r = pthread_getspecific(async_key), *next;
+
+    if (r)
+        return r;
+    for (r = async_rings; r; r = r->next)
+        if (!avpriv_atomic_ptr_cas(&r->owner, NULL, r))
+            break;
+    if (!r) {
+        if (!(r = av_mallocz(sizeof(*r))))
+            return NULL;
+        r->owner = r;
+        do {
+            next = r->next = async_rings;
+        } while (avpriv_atomic_ptr_cas((void * volatile *)&async_rings, next, r) != next);
+    }
+    r->print_prefix = 1;
+    if (pthread_setspecific(async_key, r)) {
+        async_ring_release(r);
+        return NULL;
+    }
+    return r;
+}
+
+/**
+ * Queue a line for the writer thread.
+ * @return 0 if the line was queued or dropped, <0 if it must be written
+ *         synchronously
+ */
+static int log_async(void *avcl, int level, unsigned tint, const char *fmt,
+                     va_list vl)
+{
+    AVBPrint part[4];
+    AsyncRing *r;
+    AsyncLine *l;
+    int i, len, pos = 0, tail, ret = 0;
+
+    avpriv_atomic_int_add_and_fetch(&async_active, 1);
+    if (!avpriv_atomic_int_get(&async_enabled) || !(r = async_get_ring())) {
+        ret = -1;
+        goto end;
+    }
+    tail = r->tail;
+    if (tail == (avpriv_atomic_int_get(&r->head) ^ ASYNC_SLOTS)) {
+        r->dropped++;
+        goto end;
+    }
+
+    l = async_slot(r, tail);
+    format_line(avcl, level, fmt, vl, part, &r->print_prefix, l->type);
+    for (i = 0; i < 4; i++) {
+        len = FFMIN(strlen(part[i].str), sizeof(l->text) - 1 - pos);
+        memcpy(l->text + pos, part[i].str, len);
+        l->len[i] = len;
+        pos += len;
+    }
+    l->text[pos] = 0;
+    av_bprint_finalize(part+3, NULL);
+    l->level   = level;
+    l->tint    = tint;
+    l->avcl    = avcl;
+    l->time    = av_gettime_relative();
+    l->dropped = r->dropped;
+    r->dropped = 0;
+    l->seq     = avpriv_atomic_int_add_and_fetch(&async_seq, 1);
+    avpriv_atomic_int_set(&r->tail, async_next(tail));
+
+    if (avpriv_atomic_int_get(&async_waiting)) {
+        pthread_mutex_lock(&async_lock);
+        pthread_cond_signal(&async_cond);
+        pthread_mutex_unlock(&async_lock);
+    }
+end:
+    avpriv_atomic_int_add_and_fetch(&async_active, -1);
+    return ret;
+}
+
+static void async_notice(int level, const char *prefix, const char *fmt, int n)
+{
+    char line[LINE_SZ];
+
+    av_strlcpy(line, prefix, sizeof(line));
+    av_strlcatf(line, sizeof(line), fmt, n);
+    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), 0, line);
+}
+
+static void async_ctx_flush(AsyncContext *c)
+{
+    if (c->repeated)
+        async_notice(AV_LOG_INFO, c->prefix, "    Last message repeated %d times\n", c->repeated);
+    if (c->suppressed)
+        async_notice(AV_LOG_WARNING, c->prefix, "    %d messages suppressed\n", c->suppressed);
+    c->repeated = c->suppressed = 0;
+}
+
+static void async_write(AsyncLine *l)
+{
+    AsyncContext *c = &async_ctx[((uintptr_t)l->avcl >> 4) % ASYNC_CONTEXTS];
+    int prefix_len = l->len[0] + l->len[1];
+    int len = prefix_len + l->len[2] + l->len[3];
+    int complete = len && l->text[len - 1] == '\n';
+    char buf[LINE_SZ + 4], *part[4];
+    int i, pos = 0;
+
+    if (l->dropped)
+        async_notice(AV_LOG_WARNING, "", "    %d log lines dropped\n", l->dropped);
+
+    if (!c->used || c->avcl != l->avcl) {
+        if (c->used)
+            async_ctx_flush(c);
+        memset(c, 0, sizeof(*c));
+        c->used         = 1;
+        c->avcl         = l->avcl;
+        c->window_start = l->time;
+    }
+
+    if (complete && (flags & AV_LOG_SKIP_REPEATED) && !strcmp(l->text, c->last)) {
+        c->repeated++;
+        return;
+    }
+    if (c->repeated)
+        async_notice(AV_LOG_INFO, c->prefix, "    Last message repeated %d times\n", c->repeated);
+    c->repeated = 0;
+    av_strlcpy(c->last, l->text, sizeof(c->last));
+
+    if (async_max_rate && l->level > AV_LOG_ERROR) {
+        if (l->time - c->window_start >= 1000000) {
+            if (c->suppressed)
+                async_notice(AV_LOG_WARNING, c->prefix, "    %d messages suppressed\n", c->suppressed);
+            c->suppressed   = 0;
+            c->lines        = 0;
+            c->window_start = l->time;
+        }
+        if (++c->lines > async_max_rate) {
+            c->suppressed++;
+            return;
+        }
+    }
+    if (prefix_len)
+        av_strlcpy(c->prefix, l->text, FFMIN(prefix_len + 1, sizeof(c->prefix)));
+
+    /* split the line back into its parts */
+    for (i = 0; i < 4; i++) {
+        part[i] = buf + pos + i;
+        memcpy(part[i], l->text + pos, l->len[i]);
+        part[i][l->len[i]] = 0;
+        pos += l->len[i];
+    }
+    write_line(l->level, l->tint, l->type, part);
+}
+
+/* write the queued lines in logging order, return how many there were */
+static int async_drain(void)
+{
+    AsyncRing *r, *first;
+    int n = 0;
+
+    pthread_mutex_lock(&mutex);
+    for (;;) {
+        first = NULL;
+        for (r = async_rings; r; r = r->next) {
+            if (avpriv_atomic_int_get(&r->tail) == r->head)
+                continue;
+            if (!first || async_slot(r, r->head)->seq - async_slot(first, first->head)->seq < 0)
+                first = r;
+        }
+        if (!first)
+            break;
+        async_write(async_slot(first, first->head));
+        avpriv_atomic_int_set(&first->head, async_next(first->head));
+        n++;
+    }
+    pthread_mutex_unlock(&mutex);
+    return n;
+}
+
+static int async_pending(void)
+{
+    AsyncRing *r;
+
+    for (r = async_rings; r; r = r->next)
+        if (avpriv_atomic_int_get(&r->tail) != r->head)
+            return 1;
+    return 0;
+}
+
+static void *async_writer(void *arg)
+{
+    int i;
+
+    for (;;) {
+        int quit = avpriv_atomic_int_get(&async_quit);
+        if (async_drain())
+            continue;
+        if (quit)
+            break;
+        pthread_mutex_lock(&async_lock);
+        avpriv_atomic_int_set(&async_waiting, 1);
+        if (!async_pending() && !async_quit)
+            pthread_cond_wait(&async_cond, &async_lock);
+        avpriv_atomic_int_set(&async_waiting, 0);
+        pthread_mutex_unlock(&async_lock);
+    }
+
+    pthread_mutex_lock(&mutex);
+    for (i = 0; i < ASYNC_CONTEXTS; i++) {
+        async_ctx_flush(&async_ctx[i]);
+        async_ctx[i].used = 0;
+    }
+    pthread_mutex_unlock(&mutex);
+    return NULL;
+}
+#endif /* HAVE_PTHREADS */
+
+int av_log_start_async(int max_rate)
+{
+#if HAVE_PTHREADS
+    int ret = 0;
+
+    pthread_once(&async_key_once, async_key_init);
+    pthread_mutex_lock(&async_lock);
+    async_max_rate = FFMAX(max_rate, 0);
+    if (!async_running) {
+        async_quit = 0;
+        if ((ret = pthread_create(&async_thread, NULL, async_writer, NULL))) {
+            ret = AVERROR(ret);
+        } else {
+            async_running = 1;
+            avpriv_atomic_int_set(&async_enabled, 1);
+        }
+    }
+    pthread_mutex_unlock(&async_lock);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+void av_log_stop_async(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&async_lock);
+    if (!async_running) {
+        pthread_mutex_unlock(&async_lock);
+        return;
+    }
+    avpriv_atomic_int_set(&async_enabled, 0);
+    pthread_mutex_unlock(&async_lock);
+
+    /* let the threads which saw it enabled queue their line */
+    while (avpriv_atomic_int_get(&async_active))
+        av_usleep(100);
+
+    pthread_mutex_lock(&async_lock);
+    avpriv_atomic_int_set(&async_quit, 1);
+    pthread_cond_signal(&async_cond);
+    pthread_mutex_unlock(&async_lock);
+    pthread_join(async_thread, NULL);
+    async_running = 0;
+#endif
+}
+
 void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
 {
     static int print_prefix = 1;
@@ -318,6 +676,8 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
     if (level > av_log_level)
         return;
 #if HAVE_PTHREADS
+    if (async_enabled && log_async(ptr, level, tint, fmt, vl) >= 0)
+        return;
     pthread_mutex_lock(&mutex);
 #endif
 
@@ -341,14 +701,7 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
         count = 0;
     }
     strcpy(prev, line);
-    sanitize(part[0].str);
-    colored_fputs(type[0], 0, part[0].str);
-    sanitize(part[1].str);
-    colored_fputs(type[1], 0, part[1].str);
-    sanitize(part[2].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[2].str);
-    sanitize(part[3].str);
-    colored_fputs(av_clip(level >> 3, 0, NB_LEVELS - 1), tint >> 8, part[3].str);
+    write_line(level, tint, type, (char *[4]){ part[0].str, part[1].str, part[2].str, part[3].str });
 
 #if CONFIG_VALGRIND_BACKTRACE
     if (level <= BACKTRACE_LOGLEVEL)
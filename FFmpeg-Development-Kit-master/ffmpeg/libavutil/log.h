@@ -369,6 +369,30 @@ int av_log_format_line2(void *ptr, int level, const char *fmt, va_list vl,
 void av_log_set_flags(int arg);
 int av_log_get_flags(void);
 
+/**
+ * Make av_log_default_callback() hand the lines to a background thread
+ * which writes them, so that the logging threads neither wait for the
+ * output nor for each other. Each thread queues its lines in a ring of its
+ * own; when it is full, further lines are dropped and their number is
+ * reported.
+ *
+ * With AV_LOG_SKIP_REPEATED, repeated lines are collapsed per logging
+ * context instead of across all of them.
+ *
+ * @param max_rate maximum number of lines per second written for one
+ *                 logging context, 0 for no limit. Errors and more severe
+ *                 messages are never suppressed; the number of suppressed
+ *                 lines is reported.
+ * @return 0 on success, a negative AVERROR code on failure, in particular
+ *         AVERROR(ENOSYS) without thread support
+ */
+int av_log_start_async(int max_rate);
+
+/**
+ * Write all queued lines and stop the thread started by av_log_start_async().
+ */
+void av_log_stop_async(void);
+
 /**
  * @}
  */
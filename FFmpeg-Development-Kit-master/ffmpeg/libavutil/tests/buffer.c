@@ -0,0 +1,164 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+
+#define SIZE     1024
+#define NB_BUFS  40
+#define THREADS  4
+
+static void print_stats(const char *name, AVBufferPool *pool)
+{
+    AVBufferPoolStats stats;
+
+    av_buffer_pool_get_stats(pool, &stats);
+    printf("%s: hits %"PRId64" misses %"PRId64" high water %"PRId64"\n",
+           name, stats.hits, stats.misses, stats.high_water_bytes);
+}
+
+static int get_bufs(AVBufferPool *pool, AVBufferRef **bufs, int n, int tag)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        bufs[i] = av_buffer_pool_get(pool);
+        if (!bufs[i])
+            return -1;
+        memset(bufs[i]->data, tag, SIZE);
+    }
+    return 0;
+}
+
+static int unref_bufs(AVBufferRef **bufs, int n, int tag)
+{
+    int i, j, ret = 0;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < SIZE; j++)
+            if (bufs[i]->data[j] != tag)
+                ret = -1;
+        av_buffer_unref(&bufs[i]);
+    }
+    return ret;
+}
+
+#if HAVE_PTHREADS
+typedef struct ThreadData {
+    AVBufferPool *pool;
+    AVBufferRef *bufs[NB_BUFS];
+    int tag;
+    int get;
+    int ret;
+} ThreadData;
+
+static void *worker(void *arg)
+{
+    ThreadData *td = arg;
+
+    td->ret = td->get ? get_bufs  (td->pool, td->bufs, NB_BUFS, td->tag)
+                      : unref_bufs(td->bufs, NB_BUFS, td->tag);
+    return NULL;
+}
+
+/* run one pass of all threads, getting or releasing buffers */
+static int run_threads(ThreadData *td, int get)
+{
+    pthread_t threads[THREADS];
+    int i, ret = 0;
+
+    for (i = 0; i < THREADS; i++) {
+        td[i].get = get;
+        if (pthread_create(&threads[i], NULL, worker, &td[i]))
+            return -1;
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        ret |= td[i].ret;
+    }
+    return ret;
+}
+#endif
+
+int main(void)
+{
+    AVBufferRef *bufs[NB_BUFS * THREADS];
+    AVBufferPool *pool = av_buffer_pool_init(SIZE, NULL);
+
+    if (!pool)
+        return 1;
+
+    /* buffers come back from the pool once released */
+    if (get_bufs(pool, bufs, 4, 1) < 0 || unref_bufs(bufs, 4, 1) < 0 ||
+        get_bufs(pool, bufs, 4, 2) < 0 || unref_bufs(bufs, 4, 2) < 0)
+        return 1;
+    print_stats("reuse", pool);
+
+    /* more buffers than fit in a thread's cache are still all reused */
+    if (get_bufs(pool, bufs, NB_BUFS, 3) < 0 || unref_bufs(bufs, NB_BUFS, 3) < 0 ||
+        get_bufs(pool, bufs, NB_BUFS, 4) < 0 || unref_bufs(bufs, NB_BUFS, 4) < 0)
+        return 1;
+    print_stats("overflow", pool);
+
+#if HAVE_PTHREADS
+    {
+        ThreadData td[THREADS];
+        AVBufferPoolStats before, after;
+        int i, j;
+
+        /* Get in some threads and release in others, then get everything
+         * from this one: nothing may be allocated again, wherever the
+         * released buffers ended up. */
+        for (i = 0; i < THREADS; i++) {
+            td[i].pool = pool;
+            td[i].tag  = 5 + i;
+        }
+        if (run_threads(td, 1) < 0)
+            return 1;
+        for (i = 0; i < THREADS / 2; i++) {
+            for (j = 0; j < NB_BUFS; j++) {
+                AVBufferRef *tmp = td[i].bufs[j];
+                td[i].bufs[j] = td[THREADS - 1 - i].bufs[j];
+                td[THREADS - 1 - i].bufs[j] = tmp;
+            }
+            FFSWAP(int, td[i].tag, td[THREADS - 1 - i].tag);
+        }
+        if (run_threads(td, 0) < 0)
+            return 1;
+
+        av_buffer_pool_get_stats(pool, &before);
+        if (get_bufs(pool, bufs, NB_BUFS * THREADS, 9) < 0 ||
+            unref_bufs(bufs, NB_BUFS * THREADS, 9) < 0)
+            return 1;
+        av_buffer_pool_get_stats(pool, &after);
+
+        /* how the threads raced decides how many buffers were allocated, so
+         * only print what does not depend on it */
+        printf("handoff: hits %"PRId64" misses %"PRId64"\n",
+               after.hits - before.hits, after.misses - before.misses);
+    }
+#endif
+
+    av_buffer_pool_uninit(&pool);
+    return 0;
+}
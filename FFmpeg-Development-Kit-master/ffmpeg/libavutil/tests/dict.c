@@ -18,7 +18,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <inttypes.h>
+#include <limits.h>
+
+/* lets the benchmark compare against unindexed lookups */
+static int dict_hash_threshold = 32;
+#define DICT_HASH_THRESHOLD dict_hash_threshold
+
 #include "libavutil/dict.c"
+#include "libavutil/time.h"
 
 static void print_dict(const AVDictionary *m)
 {
@@ -46,7 +54,84 @@ static void test_separators(const AVDictionary *m, const char pair, const char v
     av_dict_free(&dict);
 }
 
-int main(void)
+/* run the same operations on an indexed and on a plain dictionary */
+static void test_hash_index(int flags)
+{
+    AVDictionary *dict[2] = { NULL };
+    AVDictionaryEntry *e[2];
+    char key[16], val[16];
+    int i, j, mismatch = 0;
+
+    for (j = 0; j < 2; j++) {
+        dict_hash_threshold = j ? INT_MAX : 32;
+        for (i = 0; i < 200; i++) {
+            snprintf(key, sizeof(key), i & 1 ? "Tag%d" : "tag%d", i % 70);
+            snprintf(val, sizeof(val), "%d", i);
+            av_dict_set(&dict[j], key, val, flags | (j ? 0 : AV_DICT_HASH_INDEX));
+        }
+        for (i = 0; i < 70; i += 3) {
+            snprintf(key, sizeof(key), "TAG%d", i);
+            av_dict_set(&dict[j], key, NULL, flags);
+        }
+    }
+    printf("indexed: %d, plain: %d\n", dict[0]->nb_buckets > 0, dict[1]->nb_buckets > 0);
+    if (av_dict_count(dict[0]) != av_dict_count(dict[1]))
+        mismatch++;
+    for (i = 0; i < 80; i++) {
+        snprintf(key, sizeof(key), "tag%d", i);
+        e[0] = e[1] = NULL;
+        do {
+            for (j = 0; j < 2; j++)
+                e[j] = av_dict_get(dict[j], key, e[j], 0);
+            if ((e[0] ? e[0] - dict[0]->elems : -1) != (e[1] ? e[1] - dict[1]->elems : -1))
+                mismatch++;
+        } while (e[0] && e[1]);
+        for (j = 0; j < 2; j++)
+            e[j] = av_dict_get(dict[j], key, NULL, AV_DICT_MATCH_CASE);
+        if ((e[0] ? e[0] - dict[0]->elems : -1) != (e[1] ? e[1] - dict[1]->elems : -1))
+            mismatch++;
+    }
+    for (i = 0; i < av_dict_count(dict[0]); i++)
+        if (strcmp(dict[0]->elems[i].key,   dict[1]->elems[i].key) ||
+            strcmp(dict[0]->elems[i].value, dict[1]->elems[i].value))
+            mismatch++;
+    e[0] = av_dict_get(dict[0], "tag1", NULL, 0);
+    printf("%d entries, tag1 %s, %d mismatches\n",
+           av_dict_count(dict[0]), e[0] ? e[0]->value : "-", mismatch);
+    av_dict_free(&dict[0]);
+    av_dict_free(&dict[1]);
+    dict_hash_threshold = 32;
+}
+
+static void bench(int nb_tags)
+{
+    AVDictionary *dict = NULL;
+    char key[32];
+    int64_t t[3];
+    int i, j;
+
+    for (j = 0; j < 2; j++) {
+        dict_hash_threshold = j ? 32 : INT_MAX;
+        t[0] = av_gettime_relative();
+        for (i = 0; i < nb_tags; i++) {
+            snprintf(key, sizeof(key), "com.example.tag.%d", i);
+            av_dict_set(&dict, key, key, 0);
+        }
+        t[1] = av_gettime_relative();
+        for (i = 0; i < nb_tags; i++) {
+            snprintf(key, sizeof(key), "COM.EXAMPLE.TAG.%d", nb_tags - 1 - i);
+            if (!av_dict_get(dict, key, NULL, 0))
+                printf("missing %s\n", key);
+        }
+        t[2] = av_gettime_relative();
+        printf("%6d tags, %-7s set %8"PRId64" us, get %8"PRId64" us\n", nb_tags,
+               j ? "indexed" : "linear", t[1] - t[0], t[2] - t[1]);
+        av_dict_free(&dict);
+    }
+    dict_hash_threshold = 32;
+}
+
+int main(int argc, char **argv)
 {
     AVDictionary *dict = NULL;
     AVDictionaryEntry *e;
@@ -129,5 +214,17 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting hash index\n");
+    test_hash_index(0);
+    test_hash_index(AV_DICT_MULTIKEY);
+    test_hash_index(AV_DICT_APPEND);
+    test_hash_index(AV_DICT_DONT_OVERWRITE);
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        bench(100);
+        bench(1000);
+        bench(10000);
+    }
+
     return 0;
 }
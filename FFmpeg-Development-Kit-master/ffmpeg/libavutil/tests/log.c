@@ -21,8 +21,12 @@
 
 #include "libavutil/log.c"
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
+#define THREADS 4
+
 static int call_log_format_line2(const char *fmt, char *buffer, int buffer_size, ...)
 {
     va_list args;
@@ -34,6 +38,58 @@ static int call_log_format_line2(const char *fmt, char *buffer, int buffer_size,
     return ret;
 }
 
+#if HAVE_PTHREADS
+static const AVClass bench_class = {
+    .class_name = "bench",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+typedef struct BenchContext {
+    const AVClass *class;
+    int nb_lines;
+    int64_t time;
+    int64_t max_time;
+} BenchContext;
+
+static void *bench_thread(void *arg)
+{
+    BenchContext *ctx = arg;
+    int i;
+
+    for (i = 0; i < ctx->nb_lines; i++) {
+        int64_t t = av_gettime_relative();
+        av_log(ctx, AV_LOG_DEBUG, "decoding line %d of %d: some value %f\n",
+               i, ctx->nb_lines, i * 0.5);
+        t = av_gettime_relative() - t;
+        ctx->time    += t;
+        ctx->max_time = FFMAX(ctx->max_time, t);
+    }
+    return NULL;
+}
+
+/* time the logging threads spend in av_log(), lines go to stderr */
+static void bench(const char *name, int nb_lines)
+{
+    pthread_t threads[THREADS];
+    BenchContext ctx[THREADS];
+    int64_t time = 0, max_time = 0;
+    int i;
+
+    for (i = 0; i < THREADS; i++) {
+        ctx[i] = (BenchContext){ &bench_class, nb_lines };
+        pthread_create(&threads[i], NULL, bench_thread, &ctx[i]);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        time    += ctx[i].time;
+        max_time = FFMAX(max_time, ctx[i].max_time);
+    }
+    printf("%-6s %d threads: %6.2f us per line, longest call %"PRId64" us\n",
+           name, THREADS, (double)time / (THREADS * nb_lines), max_time);
+}
+#endif
+
 int main(int argc, char **argv)
 {
     int i;
@@ -67,5 +123,30 @@ int main(int argc, char **argv)
             return 1;
         }
     }
+
+#if HAVE_PTHREADS
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        int nb_lines = argc > 2 ? atoi(argv[2]) : 20000;
+        BenchContext ctx = { &bench_class };
+
+        bench("sync", nb_lines);
+        if (av_log_start_async(0) < 0)
+            return 1;
+        bench("async", nb_lines);
+
+        /* repeated and excess lines are collapsed per context */
+        av_log_set_flags(AV_LOG_SKIP_REPEATED);
+        av_log_stop_async();
+        av_log_start_async(10);
+        for (i = 0; i < 20; i++) {
+            av_log(&ctx, AV_LOG_INFO, "repeated\n");
+            av_log(NULL, AV_LOG_INFO, "interleaved %d\n", i);
+        }
+        for (i = 0; i < 20; i++)
+            av_log(&ctx, AV_LOG_INFO, "line %d\n", i);
+        av_log(&ctx, AV_LOG_ERROR, "errors are never suppressed\n");
+        av_log_stop_async();
+    }
+#endif
     return 0;
 }
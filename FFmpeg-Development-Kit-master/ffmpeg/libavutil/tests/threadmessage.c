@@ -0,0 +1,292 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Without arguments, check the queue semantics. With -b [messages], also
+ * compare the throughput and the number of thread wakeups of the queue
+ * against the mutex and condition variable FIFO it replaced.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_GETRUSAGE
+#include <sys/resource.h>
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/fifo.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+
+#define PRODUCERS 4
+#define BATCH     16
+
+typedef struct Message {
+    int producer;
+    int seq;
+} Message;
+
+#if HAVE_PTHREADS
+
+/* the previous implementation, for comparison */
+typedef struct LegacyQueue {
+    AVFifoBuffer *fifo;
+    pthread_mutex_t lock;
+    pthread_cond_t cond_recv;
+    pthread_cond_t cond_send;
+} LegacyQueue;
+
+static int legacy_alloc(LegacyQueue *q, unsigned nelem)
+{
+    if (!(q->fifo = av_fifo_alloc(nelem * sizeof(Message))))
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond_recv, NULL);
+    pthread_cond_init(&q->cond_send, NULL);
+    return 0;
+}
+
+static void legacy_free(LegacyQueue *q)
+{
+    av_fifo_freep(&q->fifo);
+    pthread_cond_destroy(&q->cond_send);
+    pthread_cond_destroy(&q->cond_recv);
+    pthread_mutex_destroy(&q->lock);
+}
+
+static void legacy_send(LegacyQueue *q, Message *msg)
+{
+    pthread_mutex_lock(&q->lock);
+    while (av_fifo_space(q->fifo) < sizeof(*msg))
+        pthread_cond_wait(&q->cond_send, &q->lock);
+    av_fifo_generic_write(q->fifo, msg, sizeof(*msg), NULL);
+    pthread_cond_signal(&q->cond_recv);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void legacy_recv(LegacyQueue *q, Message *msg)
+{
+    pthread_mutex_lock(&q->lock);
+    while (av_fifo_size(q->fifo) < sizeof(*msg))
+        pthread_cond_wait(&q->cond_recv, &q->lock);
+    av_fifo_generic_read(q->fifo, msg, sizeof(*msg), NULL);
+    pthread_cond_signal(&q->cond_send);
+    pthread_mutex_unlock(&q->lock);
+}
+
+typedef struct Producer {
+    AVThreadMessageQueue *mq;
+    LegacyQueue *legacy;
+    int id;
+    int nb_msgs;
+    int batch;
+    int ret;
+} Producer;
+
+static void *producer(void *arg)
+{
+    Producer *p = arg;
+    Message msgs[BATCH];
+    int i, j, n;
+
+    for (i = 0; i < p->nb_msgs; i += n) {
+        n = FFMIN(p->batch, p->nb_msgs - i);
+        for (j = 0; j < n; j++) {
+            msgs[j].producer = p->id;
+            msgs[j].seq      = i + j;
+        }
+        if (p->legacy) {
+            for (j = 0; j < n; j++)
+                legacy_send(p->legacy, &msgs[j]);
+        } else if (n == 1) {
+            if ((p->ret = av_thread_message_queue_send(p->mq, msgs, 0)) < 0)
+                return NULL;
+        } else {
+            /* a batch may be sent in several parts */
+            for (j = 0; j < n; j += p->ret)
+                if ((p->ret = av_thread_message_queue_send_batch(p->mq, msgs + j,
+                                                                 n - j, 0)) < 0)
+                    return NULL;
+        }
+    }
+    p->ret = 0;
+    return NULL;
+}
+
+/**
+ * Run nb_producers threads sending nb_msgs messages each and receive them
+ * all here, checking that each producer's messages arrive in order.
+ */
+static int run(AVThreadMessageQueue *mq, LegacyQueue *legacy,
+               int nb_producers, int nb_msgs, int batch)
+{
+    pthread_t threads[PRODUCERS];
+    Producer p[PRODUCERS];
+    int next[PRODUCERS] = { 0 };
+    Message msgs[BATCH];
+    int i, n, received = 0, ret = 0;
+
+    for (i = 0; i < nb_producers; i++) {
+        p[i] = (Producer){ mq, legacy, i, nb_msgs, batch };
+        if (pthread_create(&threads[i], NULL, producer, &p[i]))
+            return -1;
+    }
+    while (received < nb_producers * nb_msgs) {
+        if (legacy) {
+            legacy_recv(legacy, msgs);
+            n = 1;
+        } else if (batch == 1) {
+            if ((n = av_thread_message_queue_recv(mq, msgs, 0)) < 0)
+                break;
+            n = 1;
+        } else if ((n = av_thread_message_queue_recv_batch(mq, msgs, batch, 0)) < 0) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (msgs[i].seq != next[msgs[i].producer]++)
+                ret = -1;
+        }
+        received += n;
+    }
+    for (i = 0; i < nb_producers; i++) {
+        pthread_join(threads[i], NULL);
+        ret |= p[i].ret;
+    }
+    return received == nb_producers * nb_msgs ? ret : -1;
+}
+
+static int64_t wakeups(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+#else
+    return 0;
+#endif
+}
+
+static void bench(const char *name, int legacy, int nb_producers,
+                  int nb_msgs, int batch)
+{
+    AVThreadMessageQueue *mq = NULL;
+    LegacyQueue lq;
+    int64_t t, w;
+    int ret;
+
+    if (legacy ? legacy_alloc(&lq, 64) :
+                 av_thread_message_queue_alloc(&mq, 64, sizeof(Message)))
+        return;
+    w = wakeups();
+    t = av_gettime_relative();
+    ret = run(mq, legacy ? &lq : NULL, nb_producers, nb_msgs, batch);
+    t = av_gettime_relative() - t;
+    w = wakeups() - w;
+    printf("%-24s %10.0f msg/s %8"PRId64" wakeups%s\n", name,
+           (double)nb_producers * nb_msgs * 1000000 / FFMAX(t, 1), w,
+           ret < 0 ? " FAILED" : "");
+    if (legacy)
+        legacy_free(&lq);
+    else
+        av_thread_message_queue_free(&mq);
+}
+#endif /* HAVE_PTHREADS */
+
+static int nb_freed;
+
+static void free_message(void *msg)
+{
+    nb_freed++;
+}
+
+int main(int argc, char **argv)
+{
+    AVThreadMessageQueue *mq;
+    Message msg = { 0 }, msgs[BATCH];
+    int i, ret;
+
+    if (av_thread_message_queue_alloc(&mq, 4, sizeof(Message)) < 0)
+        return 0;
+
+    /* non-blocking operations on an empty and on a full queue */
+    ret = av_thread_message_queue_recv(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+    printf("recv on empty queue: %s\n", ret == AVERROR(EAGAIN) ? "EAGAIN" : "failed");
+    for (i = 0; i < BATCH; i++)
+        msgs[i].seq = i;
+    ret = av_thread_message_queue_send_batch(mq, msgs, BATCH, AV_THREAD_MESSAGE_NONBLOCK);
+    printf("batch sent on queue of 4: %d\n", ret);
+    ret = av_thread_message_queue_send(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+    printf("send on full queue: %s\n", ret == AVERROR(EAGAIN) ? "EAGAIN" : "failed");
+
+    /* pending messages are received before the error */
+    av_thread_message_queue_set_err_recv(mq, AVERROR_EOF);
+    ret = av_thread_message_queue_recv_batch(mq, msgs, 3, 0);
+    printf("batch received: %d, first %d\n", ret, msgs[0].seq);
+    ret = av_thread_message_queue_recv(mq, &msg, 0);
+    printf("then received: %d, seq %d\n", ret, msg.seq);
+    ret = av_thread_message_queue_recv(mq, &msg, 0);
+    printf("then received: %s\n", ret == AVERROR_EOF ? "EOF" : "failed");
+    av_thread_message_queue_set_err_recv(mq, 0);
+
+    /* flush frees the remaining messages and unblocks the senders */
+    av_thread_message_queue_set_free_func(mq, free_message);
+    av_thread_message_queue_send_batch(mq, msgs, 3, 0);
+    av_thread_message_flush(mq);
+    ret = av_thread_message_queue_send_batch(mq, msgs, BATCH, AV_THREAD_MESSAGE_NONBLOCK);
+    printf("flushed %d, then sent %d\n", nb_freed, ret);
+
+    av_thread_message_queue_set_err_send(mq, AVERROR_EOF);
+    ret = av_thread_message_queue_send(mq, &msg, 0);
+    printf("send after error: %s\n", ret == AVERROR_EOF ? "EOF" : "failed");
+    av_thread_message_queue_free(&mq);
+    printf("freed %d\n", nb_freed);
+
+#if HAVE_PTHREADS
+    {
+        static const int batches[] = { 1, BATCH };
+        int j, nb_msgs = 100000;
+
+        for (i = 0; i < FF_ARRAY_ELEMS(batches); i++) {
+            for (j = 1; j <= PRODUCERS; j *= PRODUCERS) {
+                av_thread_message_queue_alloc(&mq, 8, sizeof(Message));
+                ret = run(mq, NULL, j, nb_msgs, batches[i]);
+                printf("%d producer(s), batch %d: %s\n", j, batches[i],
+                       ret < 0 ? "failed" : "ok");
+                av_thread_message_queue_free(&mq);
+            }
+        }
+
+        if (argc > 1 && !strcmp(argv[1], "-b")) {
+            if (argc > 2)
+                nb_msgs = atoi(argv[2]);
+            bench("mutex fifo, 1 producer", 1, 1,         nb_msgs, 1);
+            bench("ring, 1 producer",       0, 1,         nb_msgs, 1);
+            bench("ring batched",           0, 1,         nb_msgs, BATCH);
+            bench("mutex fifo, 4 producers", 1, PRODUCERS, nb_msgs, 1);
+            bench("ring, 4 producers",      0, PRODUCERS, nb_msgs, 1);
+        }
+    }
+#endif
+
+    return 0;
+}
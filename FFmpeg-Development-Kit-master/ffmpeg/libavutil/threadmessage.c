@@ -18,20 +18,57 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#include "fifo.h"
+#include <string.h>
+
+#include "atomic.h"
+#include "common.h"
+#include "mem.h"
 #include "threadmessage.h"
 #include "thread.h"
 
+/* keeps the fields written by the senders and by the receivers apart */
+#define CACHE_LINE 64
+
+/*
+ * The messages live in a ring written by the senders and read by the
+ * receivers. Positions run over twice the number of slots so that a full
+ * ring can be told apart from an empty one. The senders and the receivers
+ * only ever exchange the tail and head positions, so in the common case of
+ * one thread on each side a message goes through without any lock shared
+ * between them. Several senders (or receivers) are serialized among
+ * themselves by their side lock.
+ *
+ * A thread only sleeps when the ring is full (or empty): it registers as a
+ * waiter and rechecks the ring under the parking lock, and the other side
+ * only takes that lock to wake it when it sees a registered waiter.
+ */
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
-    AVFifoBuffer *fifo;
+    uint8_t *buf;
+    unsigned elsize;
+    int nelem;
+    void (*free_func)(void *msg);
+
+    /* senders */
+    pthread_mutex_t send_lock;
+    volatile int tail;
+    int head_cache;
+    char pad0[CACHE_LINE];
+
+    /* receivers */
+    pthread_mutex_t recv_lock;
+    volatile int head;
+    int tail_cache;
+    char pad1[CACHE_LINE];
+
+    /* parking */
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
-    unsigned elsize;
-    void (*free_func)(void *msg);
+    volatile int recv_waiters;
+    volatile int send_waiters;
+    volatile int err_send;
+    volatile int err_recv;
 #else
     int dummy;
 #endif
@@ -45,35 +82,41 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
     AVThreadMessageQueue *rmq;
     int ret = 0;
 
-    if (nelem > INT_MAX / elsize)
+    if (!nelem || nelem > INT_MAX / 2 || nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
-    if ((ret = pthread_mutex_init(&rmq->lock, NULL))) {
-        av_free(rmq);
-        return AVERROR(ret);
-    }
-    if ((ret = pthread_cond_init(&rmq->cond_recv, NULL))) {
-        pthread_mutex_destroy(&rmq->lock);
-        av_free(rmq);
-        return AVERROR(ret);
-    }
-    if ((ret = pthread_cond_init(&rmq->cond_send, NULL))) {
-        pthread_cond_destroy(&rmq->cond_recv);
-        pthread_mutex_destroy(&rmq->lock);
+    if (!(rmq->buf = av_malloc_array(nelem, elsize))) {
         av_free(rmq);
-        return AVERROR(ret);
-    }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
-        pthread_cond_destroy(&rmq->cond_send);
-        pthread_cond_destroy(&rmq->cond_recv);
-        pthread_mutex_destroy(&rmq->lock);
-        av_free(rmq);
-        return AVERROR(ret);
+        return AVERROR(ENOMEM);
     }
+    if ((ret = pthread_mutex_init(&rmq->lock, NULL)))
+        goto fail_buf;
+    if ((ret = pthread_mutex_init(&rmq->send_lock, NULL)))
+        goto fail_lock;
+    if ((ret = pthread_mutex_init(&rmq->recv_lock, NULL)))
+        goto fail_send_lock;
+    if ((ret = pthread_cond_init(&rmq->cond_recv, NULL)))
+        goto fail_recv_lock;
+    if ((ret = pthread_cond_init(&rmq->cond_send, NULL)))
+        goto fail_cond_recv;
     rmq->elsize = elsize;
+    rmq->nelem  = nelem;
     *mq = rmq;
     return 0;
+
+fail_cond_recv:
+    pthread_cond_destroy(&rmq->cond_recv);
+fail_recv_lock:
+    pthread_mutex_destroy(&rmq->recv_lock);
+fail_send_lock:
+    pthread_mutex_destroy(&rmq->send_lock);
+fail_lock:
+    pthread_mutex_destroy(&rmq->lock);
+fail_buf:
+    av_free(rmq->buf);
+    av_free(rmq);
+    return AVERROR(ret);
 #else
     *mq = NULL;
     return AVERROR(ENOSYS);
@@ -93,9 +136,11 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
 #if HAVE_THREADS
     if (*mq) {
         av_thread_message_flush(*mq);
-        av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->buf);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
+        pthread_mutex_destroy(&(*mq)->recv_lock);
+        pthread_mutex_destroy(&(*mq)->send_lock);
         pthread_mutex_destroy(&(*mq)->lock);
         av_freep(mq);
     }
@@ -104,38 +149,146 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
 
 #if HAVE_THREADS
 
+static inline int ring_used(AVThreadMessageQueue *mq, int head, int tail)
+{
+    int used = tail - head;
+    return used < 0 ? used + 2 * mq->nelem : used;
+}
+
+static inline int ring_advance(AVThreadMessageQueue *mq, int pos, int n)
+{
+    pos += n;
+    return pos >= 2 * mq->nelem ? pos - 2 * mq->nelem : pos;
+}
+
+static inline uint8_t *ring_slot(AVThreadMessageQueue *mq, int pos)
+{
+    return mq->buf + (size_t)(pos >= mq->nelem ? pos - mq->nelem : pos) * mq->elsize;
+}
+
+static int send_ready(AVThreadMessageQueue *mq)
+{
+    return avpriv_atomic_int_get(&mq->err_send) ||
+           ring_used(mq, avpriv_atomic_int_get(&mq->head),
+                         avpriv_atomic_int_get(&mq->tail)) < mq->nelem;
+}
+
+static int recv_ready(AVThreadMessageQueue *mq)
+{
+    return avpriv_atomic_int_get(&mq->err_recv) ||
+           avpriv_atomic_int_get(&mq->tail) != avpriv_atomic_int_get(&mq->head);
+}
+
+/**
+ * Sleep until ready() holds. The caller's side lock is released meanwhile
+ * so that flushing or setting an error never waits for a parked thread.
+ *
+ * waiters counts the parked threads which were not signaled yet, so that
+ * the other side stops taking the parking lock as soon as they were.
+ */
+static void park(AVThreadMessageQueue *mq, pthread_mutex_t *side_lock,
+                 volatile int *waiters, pthread_cond_t *cond,
+                 int (*ready)(AVThreadMessageQueue *mq))
+{
+    pthread_mutex_unlock(side_lock);
+    pthread_mutex_lock(&mq->lock);
+    for (;;) {
+        avpriv_atomic_int_add_and_fetch(waiters, 1);
+        if (ready(mq)) {
+            avpriv_atomic_int_add_and_fetch(waiters, -1);
+            break;
+        }
+        /* a spurious wakeup leaves the count too high, which only costs
+         * an unneeded signal later */
+        pthread_cond_wait(cond, &mq->lock);
+    }
+    pthread_mutex_unlock(&mq->lock);
+    pthread_mutex_lock(side_lock);
+}
+
+static void wake(AVThreadMessageQueue *mq, volatile int *waiters,
+                 pthread_cond_t *cond, int all)
+{
+    if (!avpriv_atomic_int_get(waiters))
+        return;
+    pthread_mutex_lock(&mq->lock);
+    if (*waiters > 0) {
+        if (all) {
+            avpriv_atomic_int_set(waiters, 0);
+            pthread_cond_broadcast(cond);
+        } else {
+            avpriv_atomic_int_add_and_fetch(waiters, -1);
+            pthread_cond_signal(cond);
+        }
+    }
+    pthread_mutex_unlock(&mq->lock);
+}
+
 static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
-                                               void *msg,
+                                               const uint8_t *msgs,
+                                               int nb_msgs,
                                                unsigned flags)
 {
-    while (!mq->err_send && av_fifo_space(mq->fifo) < mq->elsize) {
+    int i, n, space, tail, err;
+
+    for (;;) {
+        if ((err = avpriv_atomic_int_get(&mq->err_send)))
+            return err;
+        tail  = mq->tail;
+        space = mq->nelem - ring_used(mq, mq->head_cache, tail);
+        if (space < nb_msgs) {
+            mq->head_cache = avpriv_atomic_int_get(&mq->head);
+            space = mq->nelem - ring_used(mq, mq->head_cache, tail);
+        }
+        if (space)
+            break;
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
-        pthread_cond_wait(&mq->cond_send, &mq->lock);
+        park(mq, &mq->send_lock, &mq->send_waiters, &mq->cond_send, send_ready);
     }
-    if (mq->err_send)
-        return mq->err_send;
-    av_fifo_generic_write(mq->fifo, msg, mq->elsize, NULL);
-    /* one message is sent, signal one receiver */
-    pthread_cond_signal(&mq->cond_recv);
-    return 0;
+
+    n = FFMIN(space, nb_msgs);
+    for (i = 0; i < n; i++)
+        memcpy(ring_slot(mq, ring_advance(mq, tail, i)),
+               msgs + (size_t)i * mq->elsize, mq->elsize);
+    avpriv_atomic_int_set(&mq->tail, ring_advance(mq, tail, n));
+    wake(mq, &mq->recv_waiters, &mq->cond_recv, n > 1);
+    return n;
 }
 
 static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
-                                               void *msg,
+                                               uint8_t *msgs,
+                                               int nb_msgs,
                                                unsigned flags)
 {
-    while (!mq->err_recv && av_fifo_size(mq->fifo) < mq->elsize) {
+    int i, n, avail, head, err;
+
+    for (;;) {
+        /* read the error first: a message sent before it was set must
+         * still be received */
+        err   = avpriv_atomic_int_get(&mq->err_recv);
+        head  = mq->head;
+        avail = ring_used(mq, head, mq->tail_cache);
+        if (avail < nb_msgs) {
+            mq->tail_cache = avpriv_atomic_int_get(&mq->tail);
+            avail = ring_used(mq, head, mq->tail_cache);
+        }
+        if (avail)
+            break;
+        if (err)
+            return err;
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
-        pthread_cond_wait(&mq->cond_recv, &mq->lock);
+        park(mq, &mq->recv_lock, &mq->recv_waiters, &mq->cond_recv, recv_ready);
     }
-    if (av_fifo_size(mq->fifo) < mq->elsize)
-        return mq->err_recv;
-    av_fifo_generic_read(mq->fifo, msg, mq->elsize, NULL);
-    /* one message space appeared, signal one sender */
-    pthread_cond_signal(&mq->cond_send);
-    return 0;
+
+    n = FFMIN(avail, nb_msgs);
+    for (i = 0; i < n; i++)
+        memcpy(msgs + (size_t)i * mq->elsize,
+               ring_slot(mq, ring_advance(mq, head, i)), mq->elsize);
+    avpriv_atomic_int_set(&mq->head, ring_advance(mq, head, n));
+    wake(mq, &mq->send_waiters, &mq->cond_send, n > 1);
+    return n;
 }
 
 #endif /* HAVE_THREADS */
@@ -143,29 +296,53 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags)
+{
+    int ret = av_thread_message_queue_send_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
+int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
+                                 void *msg,
+                                 unsigned flags)
+{
+    int ret = av_thread_message_queue_recv_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
 {
 #if HAVE_THREADS
     int ret;
 
-    pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_send_locked(mq, msg, flags);
-    pthread_mutex_unlock(&mq->lock);
+    if (!nb_msgs)
+        return 0;
+    pthread_mutex_lock(&mq->send_lock);
+    ret = av_thread_message_queue_send_locked(mq, msgs,
+                                              FFMIN(nb_msgs, mq->nelem), flags);
+    pthread_mutex_unlock(&mq->send_lock);
     return ret;
 #else
     return AVERROR(ENOSYS);
 #endif /* HAVE_THREADS */
 }
 
-int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
-                                 void *msg,
-                                 unsigned flags)
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
 {
 #if HAVE_THREADS
     int ret;
 
-    pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_recv_locked(mq, msg, flags);
-    pthread_mutex_unlock(&mq->lock);
+    if (!nb_msgs)
+        return 0;
+    pthread_mutex_lock(&mq->recv_lock);
+    ret = av_thread_message_queue_recv_locked(mq, msgs,
+                                              FFMIN(nb_msgs, mq->nelem), flags);
+    pthread_mutex_unlock(&mq->recv_lock);
     return ret;
 #else
     return AVERROR(ENOSYS);
@@ -176,10 +353,8 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
                                           int err)
 {
 #if HAVE_THREADS
-    pthread_mutex_lock(&mq->lock);
-    mq->err_send = err;
-    pthread_cond_broadcast(&mq->cond_send);
-    pthread_mutex_unlock(&mq->lock);
+    avpriv_atomic_int_set(&mq->err_send, err);
+    wake(mq, &mq->send_waiters, &mq->cond_send, 1);
 #endif /* HAVE_THREADS */
 }
 
@@ -187,36 +362,26 @@ void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
                                           int err)
 {
 #if HAVE_THREADS
-    pthread_mutex_lock(&mq->lock);
-    mq->err_recv = err;
-    pthread_cond_broadcast(&mq->cond_recv);
-    pthread_mutex_unlock(&mq->lock);
+    avpriv_atomic_int_set(&mq->err_recv, err);
+    wake(mq, &mq->recv_waiters, &mq->cond_recv, 1);
 #endif /* HAVE_THREADS */
 }
 
-#if HAVE_THREADS
-static void free_func_wrap(void *arg, void *msg, int size)
-{
-    AVThreadMessageQueue *mq = arg;
-    mq->free_func(msg);
-}
-#endif
-
 void av_thread_message_flush(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
-    int used, off;
-    void *free_func = mq->free_func;
+    int head, tail;
 
-    pthread_mutex_lock(&mq->lock);
-    used = av_fifo_size(mq->fifo);
-    if (free_func)
-        for (off = 0; off < used; off += mq->elsize)
-            av_fifo_generic_peek_at(mq->fifo, mq, off, mq->elsize, free_func_wrap);
-    av_fifo_drain(mq->fifo, used);
+    pthread_mutex_lock(&mq->recv_lock);
+    tail = avpriv_atomic_int_get(&mq->tail);
+    if (mq->free_func)
+        for (head = mq->head; head != tail; head = ring_advance(mq, head, 1))
+            mq->free_func(ring_slot(mq, head));
+    avpriv_atomic_int_set(&mq->head, tail);
+    mq->tail_cache = tail;
+    pthread_mutex_unlock(&mq->recv_lock);
     /* only the senders need to be notified since the queue is empty and there
      * is nothing to read */
-    pthread_cond_broadcast(&mq->cond_send);
-    pthread_mutex_unlock(&mq->lock);
+    wake(mq, &mq->send_waiters, &mq->cond_send, 1);
 #endif /* HAVE_THREADS */
 }
@@ -66,6 +66,33 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags);
 
+/**
+ * Send several messages on the queue.
+ *
+ * The messages are stored contiguously in msgs and sent in order. Without
+ * AV_THREAD_MESSAGE_NONBLOCK, this blocks until at least one of them can be
+ * sent, and then sends as many as fit in the queue.
+ *
+ * @return the number of messages sent, or a negative error code
+ */
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
+/**
+ * Receive several messages from the queue.
+ *
+ * Without AV_THREAD_MESSAGE_NONBLOCK, this blocks until at least one
+ * message is available, and then receives up to nb_msgs of them into msgs.
+ *
+ * @return the number of messages received, or a negative error code
+ */
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
 /**
  * Set the sending error code.
  *
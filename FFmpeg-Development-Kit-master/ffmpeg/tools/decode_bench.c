@@ -0,0 +1,142 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare video decoding speed with the default frame buffer allocator and
+ * with the large buffer backends selected by av_buffer_set_large_alloc().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/buffer.h"
+#include "libavutil/time.h"
+
+static const struct {
+    const char *name;
+    int flags;
+} modes[] = {
+    { "default",         0 },
+    { "thp",             AV_BUFFER_LARGE_THP | AV_BUFFER_LARGE_FIRST_TOUCH |
+                         AV_BUFFER_LARGE_RECYCLE },
+    { "hugetlb",         AV_BUFFER_LARGE_HUGETLB | AV_BUFFER_LARGE_THP |
+                         AV_BUFFER_LARGE_FIRST_TOUCH | AV_BUFFER_LARGE_RECYCLE },
+};
+
+static int receive_frames(AVCodecContext *dec, AVFrame *frame, int *nb_frames)
+{
+    int ret;
+
+    while ((ret = avcodec_receive_frame(dec, frame)) >= 0) {
+        (*nb_frames)++;
+        av_frame_unref(frame);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/* decode the first video stream of filename, return the number of frames
+ * decoded or a negative error code */
+static int decode_file(const char *filename, int threads)
+{
+    AVFormatContext *fmt = NULL;
+    AVCodecContext  *dec = NULL;
+    AVCodec *codec;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket pkt;
+    int ret, idx, nb_frames = 0;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    if ((ret = avformat_open_input(&fmt, filename, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(fmt, NULL)) < 0)
+        goto end;
+
+    idx = ret = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (ret < 0)
+        goto end;
+
+    dec = avcodec_alloc_context3(codec);
+    if (!dec) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(dec, fmt->streams[idx]->codecpar)) < 0)
+        goto end;
+    dec->thread_count = threads;
+    if ((ret = avcodec_open2(dec, codec, NULL)) < 0)
+        goto end;
+
+    while (av_read_frame(fmt, &pkt) >= 0) {
+        if (pkt.stream_index == idx)
+            ret = avcodec_send_packet(dec, &pkt);
+        av_packet_unref(&pkt);
+        if (ret < 0 || (ret = receive_frames(dec, frame, &nb_frames)) < 0)
+            goto end;
+    }
+    if ((ret = avcodec_send_packet(dec, NULL)) < 0 ||
+        (ret = receive_frames(dec, frame, &nb_frames)) < 0)
+        goto end;
+
+    ret = nb_frames;
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&dec);
+    avformat_close_input(&fmt);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int threads, runs, i, j;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input> [threads [runs]]\n", argv[0]);
+        return 1;
+    }
+    threads = argc > 2 ? atoi(argv[2]) : 0;
+    runs    = argc > 3 ? atoi(argv[3]) : 3;
+
+    av_register_all();
+
+    for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+        double best = 0;
+        int frames = 0;
+
+        av_buffer_set_large_alloc(modes[i].flags);
+
+        /* keep the fastest run, the first one also warms up the file cache */
+        for (j = 0; j < runs; j++) {
+            int64_t t = av_gettime_relative();
+
+            frames = decode_file(argv[1], threads);
+            if (frames < 0) {
+                fprintf(stderr, "Decoding %s failed: %s\n", argv[1], av_err2str(frames));
+                return 1;
+            }
+            t = av_gettime_relative() - t;
+            best = FFMAX(best, frames * 1000000.0 / FFMAX(t, 1));
+        }
+        printf("%-8s %d frames, %.1f fps\n", modes[i].name, frames, best);
+    }
+
+    av_buffer_set_large_alloc(0);
+    return 0;
+}
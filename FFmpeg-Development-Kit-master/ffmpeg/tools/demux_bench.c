@@ -0,0 +1,104 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare demuxing throughput of local files read with read() and with the
+ * memory mapped mode of the file protocol.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavformat/avformat.h"
+#include "libavutil/time.h"
+
+static const struct {
+    const char *name;
+    const char *mmap;
+} modes[] = {
+    { "read", "0" },
+    { "mmap", "1" },
+};
+
+/* demux all packets of filename, touching each payload once like a
+ * consumer would, return 0 or a negative error code */
+static int demux_file(const char *filename, const char *mmap,
+                      int64_t *nb_packets, int64_t *nb_bytes)
+{
+    AVFormatContext *fmt = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    unsigned sum = 0;
+    int ret;
+
+    *nb_packets = *nb_bytes = 0;
+
+    av_dict_set(&opts, "mmap", mmap, 0);
+    ret = avformat_open_input(&fmt, filename, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    while ((ret = av_read_frame(fmt, &pkt)) >= 0) {
+        if (pkt.size)
+            sum += pkt.data[0] + pkt.data[pkt.size - 1];
+        (*nb_packets)++;
+        *nb_bytes += pkt.size;
+        av_packet_unref(&pkt);
+    }
+    avformat_close_input(&fmt);
+
+    /* keep the compiler from dropping the payload accesses */
+    if (sum == 1)
+        fprintf(stderr, " ");
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+int main(int argc, char **argv)
+{
+    int runs, i, j;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input> [runs]\n", argv[0]);
+        return 1;
+    }
+    runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    av_register_all();
+
+    for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+        int64_t best = INT64_MAX, packets = 0, bytes = 0;
+
+        /* keep the fastest run, the first one also warms up the file cache */
+        for (j = 0; j < runs; j++) {
+            int64_t t = av_gettime_relative();
+            int ret   = demux_file(argv[1], modes[i].mmap, &packets, &bytes);
+
+            if (ret < 0) {
+                fprintf(stderr, "Demuxing %s failed: %s\n", argv[1], av_err2str(ret));
+                return 1;
+            }
+            best = FFMIN(best, FFMAX(av_gettime_relative() - t, 1));
+        }
+        printf("%-8s %"PRId64" packets, %.0f packets/s, %.2f GB/s\n",
+               modes[i].name, packets, packets * 1000000.0 / best,
+               bytes / 1000.0 / best);
+    }
+
+    return 0;
+}
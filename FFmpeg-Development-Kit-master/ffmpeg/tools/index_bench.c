@@ -0,0 +1,105 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure building a stream index with av_add_index_entry() and looking it
+ * up with av_index_search_timestamp().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavformat/avformat.h"
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+
+/* timestamp of the i-th added entry: in order, or with every 16th block
+ * of 8 entries added in reverse like a demuxer meeting reordered packets */
+static int64_t entry_timestamp(int i, int reorder)
+{
+    if (reorder && !(i >> 3 & 15))
+        i = (i & ~7) | (7 - (i & 7));
+    return 40LL * i;
+}
+
+static int build_index(AVStream *st, int nb_entries, int reorder)
+{
+    int i;
+
+    for (i = 0; i < nb_entries; i++) {
+        int64_t ts = entry_timestamp(i, reorder);
+        if (av_add_index_entry(st, ts * 4, ts, 1000, 0,
+                               i % 12 ? 0 : AVINDEX_KEYFRAME) < 0)
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *fmt;
+    AVStream *st;
+    AVLFG lfg;
+    int nb_entries, nb_lookups = 1000000, reorder, i;
+    unsigned sum = 0;
+
+    nb_entries = argc > 1 ? atoi(argv[1]) : 10000000;
+    if (nb_entries <= 0) {
+        fprintf(stderr, "Usage: %s [entries]\n", argv[0]);
+        return 1;
+    }
+
+    av_lfg_init(&lfg, 1);
+
+    for (reorder = 0; reorder < 2; reorder++) {
+        int64_t t;
+
+        if (!(fmt = avformat_alloc_context()) ||
+            !(st = avformat_new_stream(fmt, NULL))) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+
+        t = av_gettime_relative();
+        if (build_index(st, nb_entries, reorder) < 0) {
+            fprintf(stderr, "Adding %d index entries failed\n", nb_entries);
+            return 1;
+        }
+        t = FFMAX(av_gettime_relative() - t, 1);
+        printf("%-8s %d entries, %.1f ns/entry\n", reorder ? "reorder" : "append",
+               st->nb_index_entries, t * 1000.0 / nb_entries);
+
+        if (reorder) {
+            t = av_gettime_relative();
+            for (i = 0; i < nb_lookups; i++) {
+                int64_t ts = 40LL * (av_lfg_get(&lfg) % nb_entries);
+                sum += av_index_search_timestamp(st, ts, AVSEEK_FLAG_BACKWARD);
+            }
+            t = FFMAX(av_gettime_relative() - t, 1);
+            printf("%-8s %d lookups, %.1f ns/lookup\n", "search",
+                   nb_lookups, t * 1000.0 / nb_lookups);
+        }
+
+        avformat_free_context(fmt);
+    }
+
+    /* keep the compiler from dropping the lookups */
+    if (sum == 1)
+        fprintf(stderr, " ");
+    return 0;
+}
@@ -4,6 +4,13 @@
   #include <io.h>
 #endif
 
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+
 #define INT64_C(c) (c ## LL)
 #define UINT64_C(c) (c ## ULL)
 
@@ -59,8 +66,275 @@ namespace
     metadata.setData(DDIkey, dictEntry->value);
   }
 
+  // Memory budget for the decoded frame cache of each stream, in MB. Can be overridden with FFMPEG_READER_CACHE_MB,
+  // 0 disables the cache (and with it prefetching).
+  size_t GetFrameCacheBudget()
+  {
+    const char* env = getenv("FFMPEG_READER_CACHE_MB");
+    int megabytes = env ? atoi(env) : 256;
+    return megabytes > 0 ? size_t(megabytes) * 1024 * 1024 : 0;
+  }
+
+  // Number of frames decoded ahead of the last requested frame by the prefetch thread. Can be overridden with
+  // FFMPEG_READER_PREFETCH, 0 disables prefetching.
+  int GetPrefetchFrames()
+  {
+    const char* env = getenv("FFMPEG_READER_PREFETCH");
+    int frames = env ? atoi(env) : 8;
+    return frames > 0 ? frames : 0;
+  }
+
+  // 8-bit planar YUV formats the reader converts to float itself, with their chroma subsampling and range.
+  struct PlanarYuvFormat
+  {
+    PixelFormat _format;
+    int _chromaShiftX;
+    int _chromaShiftY;
+    bool _fullRange;
+  };
+
+  const PlanarYuvFormat kPlanarYuvFormats[] = {
+    { PIX_FMT_YUV420P,  1, 1, false },
+    { PIX_FMT_YUVJ420P, 1, 1, true  },
+    { PIX_FMT_YUV422P,  1, 0, false },
+    { PIX_FMT_YUVJ422P, 1, 0, true  },
+    { PIX_FMT_YUV444P,  0, 0, false },
+    { PIX_FMT_YUVJ444P, 0, 0, true  },
+    { PIX_FMT_YUV411P,  2, 0, false },
+    { PIX_FMT_YUV440P,  0, 1, false },
+    { PIX_FMT_YUVJ440P, 0, 1, true  },
+  };
+
+  // Layout of a decoded frame in the buffer handed to the reader and in the frame cache. Frames in one of the planar YUV
+  // formats above are stored as decoded, planes one after the other, and converted to float by the reader only for the rows
+  // and columns it is asked for. Anything else is converted to RGB24 up front.
+  struct FrameLayout
+  {
+    PixelFormat _format;
+    bool _yuv;
+    int _width;
+    int _height;
+    int _chromaShiftX;
+    int _chromaShiftY;
+    size_t _offset[3];  // start of each plane in the buffer
+    int _linesize[3];
+    size_t _size;       // bytes per frame
+
+    // BT.601 YUV to RGB terms for each 8-bit code value, in the 0-1 range. Those are the coefficients swscale uses by
+    // default, so the result matches what the RGB24 conversion gave.
+    float _y[256];
+    float _crR[256];
+    float _cbG[256];
+    float _crG[256];
+    float _cbB[256];
+
+    FrameLayout()
+      : _format(PIX_FMT_RGB24)
+      , _yuv(false)
+      , _width(0)
+      , _height(0)
+      , _chromaShiftX(0)
+      , _chromaShiftY(0)
+      , _size(0)
+    {
+      _offset[0] = _offset[1] = _offset[2] = 0;
+      _linesize[0] = _linesize[1] = _linesize[2] = 0;
+    }
+
+    void setup(PixelFormat format, int width, int height)
+    {
+      _width = width;
+      _height = height;
+
+      const PlanarYuvFormat* yuv = NULL;
+      for (size_t i = 0; i < sizeof(kPlanarYuvFormats) / sizeof(kPlanarYuvFormats[0]); ++i) {
+        if (kPlanarYuvFormats[i]._format == format)
+          yuv = &kPlanarYuvFormats[i];
+      }
+
+      if (!yuv) {
+        _format = PIX_FMT_RGB24;
+        _yuv = false;
+        _linesize[0] = width * 3;
+        _size = size_t(_linesize[0]) * height;
+        return;
+      }
+
+      _format = format;
+      _yuv = true;
+      _chromaShiftX = yuv->_chromaShiftX;
+      _chromaShiftY = yuv->_chromaShiftY;
+      _linesize[0] = width;
+      _linesize[1] = _linesize[2] = -((-width) >> _chromaShiftX);
+      _offset[0] = 0;
+      _offset[1] = size_t(width) * height;
+      _offset[2] = _offset[1] + size_t(_linesize[1]) * chromaHeight();
+      _size = _offset[2] + size_t(_linesize[2]) * chromaHeight();
+
+      for (int i = 0; i < 256; ++i) {
+        float y = yuv->_fullRange ? i / 255.0f : (i - 16) / 219.0f;
+        float c = yuv->_fullRange ? (i - 128) / 255.0f : (i - 128) / 224.0f;
+        _y[i] = y;
+        _crR[i] = 1.402f * c;
+        _cbG[i] = -0.344136f * c;
+        _crG[i] = -0.714136f * c;
+        _cbB[i] = 1.772f * c;
+      }
+    }
+
+    int chromaHeight() const
+    {
+      return -((-_height) >> _chromaShiftY);
+    }
+
+    static float clamp(float v)
+    {
+      return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    }
+
+    // convert count pixels of a line (0 is the top one) starting at column x of a YUV frame to RGB
+    void convertRow(const unsigned char* buffer, int line, int x, int count, float* r, float* g, float* b) const
+    {
+      const unsigned char* Y = buffer + _offset[0] + size_t(line) * _linesize[0];
+      const unsigned char* U = buffer + _offset[1] + size_t(line >> _chromaShiftY) * _linesize[1];
+      const unsigned char* V = buffer + _offset[2] + size_t(line >> _chromaShiftY) * _linesize[2];
+
+      for (int i = 0; i < count; ++i) {
+        int X = x + i;
+        int cb = U[X >> _chromaShiftX];
+        int cr = V[X >> _chromaShiftX];
+        float y = _y[Y[X]];
+        r[i] = clamp(y + _crR[cr]);
+        g[i] = clamp(y + _cbG[cb] + _crG[cr]);
+        b[i] = clamp(y + _cbB[cb]);
+      }
+    }
+  };
+
+  // Bounded LRU of decoded frames, already in the FrameLayout handed to the reader, keyed by 0-based frame
+  // index. Storage of evicted frames is recycled for new ones, so once the cache is full no more allocation happens.
+  class FrameCache
+  {
+    typedef std::list< std::pair< int, std::vector<unsigned char> > > FrameList;
+    typedef std::map<int, FrameList::iterator> FrameMap;
+
+    FrameList _frames;  // most recently used first
+    FrameMap _index;
+    size_t _frameSize;  // bytes per frame
+    size_t _maxFrames;  // number of frames fitting in the memory budget
+
+  public:
+    FrameCache()
+      : _frameSize(0)
+      , _maxFrames(0)
+    {}
+
+    void setup(size_t frameSize, size_t budget)
+    {
+      _frames.clear();
+      _index.clear();
+      _frameSize = frameSize;
+      _maxFrames = frameSize ? budget / frameSize : 0;
+    }
+
+    bool enabled() const
+    {
+      return _maxFrames > 0;
+    }
+
+    bool contains(int frame) const
+    {
+      return _index.find(frame) != _index.end();
+    }
+
+    // copy a cached frame into buffer, returns false on a cache miss
+    bool fetch(int frame, unsigned char* buffer)
+    {
+      FrameMap::iterator it = _index.find(frame);
+      if (it == _index.end())
+        return false;
+
+      _frames.splice(_frames.begin(), _frames, it->second);
+      memcpy(buffer, &it->second->second[0], _frameSize);
+      return true;
+    }
+
+    // return the storage to fill with a frame, evicting the least recently used frame if the budget is used up;
+    // NULL if the cache is disabled
+    unsigned char* insert(int frame)
+    {
+      if (!enabled())
+        return NULL;
+
+      FrameMap::iterator it = _index.find(frame);
+      if (it != _index.end()) {
+        _frames.splice(_frames.begin(), _frames, it->second);
+        return &it->second->second[0];
+      }
+
+      if (_index.size() >= _maxFrames) {
+        _frames.splice(_frames.begin(), _frames, --_frames.end());
+        _index.erase(_frames.front().first);
+        _frames.front().first = frame;
+      }
+      else
+        _frames.push_front(std::make_pair(frame, std::vector<unsigned char>(_frameSize)));
+
+      _index[frame] = _frames.begin();
+      return &_frames.front().second[0];
+    }
+  };
+
+  // Build a packet index for every file opened, so seeks are planned from it instead of searched for. Can be disabled
+  // with FFMPEG_READER_INDEX=0.
+  bool IsIndexEnabled()
+  {
+    const char* env = getenv("FFMPEG_READER_INDEX");
+    return !env || atoi(env) != 0;
+  }
+
+  // Keep the packet index in a sidecar file next to the media (<filename>.ffindex), so it is built only once per file.
+  // Enabled with FFMPEG_READER_INDEX_SIDECAR=1.
+  bool IsIndexSidecarEnabled()
+  {
+    const char* env = getenv("FFMPEG_READER_INDEX_SIDECAR");
+    return env && atoi(env) != 0;
+  }
+
+  // Maximum number of independent demux/decode contexts opened for one file, i.e. the number of render threads that can
+  // decode frames of the same file at the same time. Can be overridden with FFMPEG_READER_CONTEXTS.
+  int GetMaxDecodeContexts()
+  {
+    const char* env = getenv("FFMPEG_READER_CONTEXTS");
+    int contexts = env ? atoi(env) : 4;
+    return contexts > 0 ? contexts : 1;
+  }
+
+  // One video packet as recorded by the index pass, in decode order.
+  struct IndexPacket
+  {
+    int64_t _pts;
+    int64_t _dts;
+    int64_t _pos;   // byte position in the file, -1 if unknown
+    int64_t _key;   // non-zero for key-frames, 64 bits to keep the sidecar layout free of padding
+  };
+
   class FFmpegFile: public RefCountedObject
   {
+    // A key-frame decode can start from.
+    struct KeyFrame
+    {
+      int64_t _ts;    // timestamp, in the stream's _timestampField
+      int64_t _seekTs; // timestamp to seek to in order to land at or before this packet
+      int64_t _pos;   // byte position, -1 if unknown
+      int _frame;     // 0-based index of the frame in presentation order
+
+      bool operator<(const KeyFrame& other) const
+      {
+        return _frame < other._frame;
+      }
+    };
+
     struct Stream  
     {
       int _idx;                      // stream index
@@ -69,6 +343,7 @@ namespace
       AVCodec* _videoCodec;
       AVFrame* _avFrame;             // decoding frame
       SwsContext* _convertCtx;
+      FrameLayout _layout;           // layout of the frames handed out
 
       int _fpsNum;
       int _fpsDen;
@@ -97,6 +372,15 @@ namespace
                                // since the last seek. This is part of a guard mechanism to detect when decode appears to have
                                // stalled and ensure that FFmpegFile::decode() does not loop indefinitely.
 
+      FrameCache _cache;       // Recently decoded frames. Every frame decoded on the way from a seek's landing key-frame to the
+                               // desired frame ends up here, so scrubbing backwards through a GOP only decodes it once.
+
+      // Packet index, empty if the index pass failed or was disabled. With it frame numbers are presentation order ranks
+      // of the packets rather than derived from timestamps and frame rate, which also holds for VFR streams.
+      std::vector<int64_t> _frameTs;    // timestamp of each frame in presentation order
+      std::vector<KeyFrame> _keyFrames; // key-frames decode can cleanly start from, in presentation order
+      std::vector<int> _frameKey;       // for each frame, the entry of _keyFrames to start decoding from to reach it
+
       Stream() 
         : _idx(0)
         , _avstream(NULL)
@@ -136,24 +420,142 @@ namespace
         delete(s);
       }
 
+      bool indexed() const
+      {
+        return !_frameTs.empty();
+      }
+
       int64_t frameToPts(int frame) const
       {
+        if (indexed() && frame >= 0 && frame < int(_frameTs.size()))
+          return _frameTs[frame];
+
         return _startPTS + (int64_t(frame) * _fpsDen *  _avstream->time_base.den) / 
                                     (int64_t(_fpsNum) * _avstream->time_base.num);
       }
 
       int ptsToFrame(int64_t pts) const 
       {
+        if (indexed() && pts >= _frameTs.front() && pts <= _frameTs.back())
+          return int(std::upper_bound(_frameTs.begin(), _frameTs.end(), pts) - _frameTs.begin()) - 1;
+
         return (int64_t(pts - _startPTS) * _avstream->time_base.num *  _fpsNum) / 
                                   (int64_t(_avstream->time_base.den) * _fpsDen);
       }
 
-      SwsContext* getConvertCtx()
+      // Take the properties and index worked out by another context of the same file for this stream.
+      void shareInfo(const Stream& other)
       {
-        if (!_convertCtx)
-          _convertCtx = sws_getContext(_width, _height, _codecContext->pix_fmt, _width, _height, PIX_FMT_RGB24, SWS_BICUBIC, NULL, NULL, NULL);
+        _startPTS = other._startPTS;
+        _frames = other._frames;
+        _ptsSeen = other._ptsSeen;
+        _timestampField = other._timestampField;
+        _frameTs = other._frameTs;
+        _keyFrames = other._keyFrames;
+        _frameKey = other._frameKey;
+      }
 
-        return _convertCtx;
+      // Derive the seek tables from the packets of this stream in decode order. Leaves the stream unindexed if the
+      // packets can't be ordered (missing or duplicate timestamps) or if decode can't start at the first frame.
+      void setIndex(const std::vector<IndexPacket>& packets)
+      {
+        _frameTs.clear();
+        _keyFrames.clear();
+        _frameKey.clear();
+
+        if (packets.empty())
+          return;
+
+        // Use PTSs if every packet has one, DTSs otherwise.
+        bool usePts = true, useDts = true;
+        for (size_t i = 0; i < packets.size(); ++i) {
+          usePts = usePts && packets[i]._pts != int64_t(AV_NOPTS_VALUE);
+          useDts = useDts && packets[i]._dts != int64_t(AV_NOPTS_VALUE);
+        }
+        if (!usePts && !useDts)
+          return;
+
+        std::vector<int64_t> ts(packets.size());
+        for (size_t i = 0; i < packets.size(); ++i)
+          ts[i] = usePts ? packets[i]._pts : packets[i]._dts;
+
+        std::vector<int64_t> frameTs(ts);
+        std::sort(frameTs.begin(), frameTs.end());
+        if (std::adjacent_find(frameTs.begin(), frameTs.end()) != frameTs.end())
+          return;
+
+        // A key-frame is a clean start only if no packet between it and the next key-frame in decode order is presented
+        // before it (open GOP leading pictures), as those would come out of the decoder ahead of it or not at all.
+        std::vector<KeyFrame> keyFrames;
+        for (size_t i = 0; i < packets.size(); ++i) {
+          if (!packets[i]._key)
+            continue;
+
+          int64_t minTs = ts[i];
+          size_t j = i + 1;
+          for (; j < packets.size() && !packets[j]._key; ++j)
+            minTs = std::min(minTs, ts[j]);
+          if (minTs < ts[i])
+            continue;
+
+          KeyFrame key;
+          key._ts = ts[i];
+          key._seekTs = packets[i]._dts != int64_t(AV_NOPTS_VALUE) ? std::min(ts[i], packets[i]._dts) : ts[i];
+          key._pos = packets[i]._pos;
+          key._frame = int(std::lower_bound(frameTs.begin(), frameTs.end(), ts[i]) - frameTs.begin());
+          keyFrames.push_back(key);
+        }
+        std::sort(keyFrames.begin(), keyFrames.end());
+        if (keyFrames.empty() || keyFrames.front()._frame != 0)
+          return;
+
+        // Precompute the key-frame for every frame, so seek planning is a lookup.
+        std::vector<int> frameKey(frameTs.size());
+        size_t k = 0;
+        for (size_t frame = 0; frame < frameTs.size(); ++frame) {
+          while (k + 1 < keyFrames.size() && keyFrames[k + 1]._frame <= int(frame))
+            ++k;
+          frameKey[frame] = int(k);
+        }
+
+        _frameTs.swap(frameTs);
+        _keyFrames.swap(keyFrames);
+        _frameKey.swap(frameKey);
+        _timestampField = usePts ? &AVPacket::pts : &AVPacket::dts;
+        _startPTS = _frameTs.front();
+        _frames = _frameTs.size();
+      }
+
+      size_t frameSize() const
+      {
+        return _layout._size;
+      }
+
+      // store the last decoded frame into a buffer, in the stream's frame layout
+      void convertFrame(unsigned char* buffer)
+      {
+        uint8_t* planes[3];
+        int linesizes[3];
+        for (int p = 0; p < 3; ++p) {
+          planes[p] = buffer + _layout._offset[p];
+          linesizes[p] = _layout._linesize[p];
+        }
+
+        // the frame is already in the layout's format, copy the planes as they are
+        if (_layout._yuv && _avFrame->format == _layout._format) {
+          for (int p = 0; p < 3; ++p) {
+            int rows = p ? _layout.chromaHeight() : _height;
+            for (int row = 0; row < rows; ++row)
+              memcpy(planes[p] + size_t(row) * linesizes[p], _avFrame->data[p] + size_t(row) * _avFrame->linesize[p], linesizes[p]);
+          }
+          return;
+        }
+
+        // Source and destination sizes are the same, only the pixel format changes, so there's no point in a filtering scaler.
+        _convertCtx = sws_getCachedContext(_convertCtx, _width, _height, PixelFormat(_avFrame->format),
+                                           _width, _height, _layout._format, SWS_POINT, NULL, NULL, NULL);
+        if (_convertCtx)
+          sws_scale(_convertCtx, _avFrame->data, _avFrame->linesize, 0, _height, planes, linesizes);
       }
 
       // Return the number of input frames needed by this stream's codec before it can produce output. We expect to have to
@@ -177,8 +579,16 @@ namespace
 
     AVPacket _avPacket;
     
-    // internal lock for multithread access
-    Lock _lock;
+    // internal lock for multithread access, signalled to wake up the prefetch thread
+    SignalLock _lock;
+
+    // prefetch state, protected by _lock
+    bool _prefetchRunning;     // true if the prefetch thread has been started
+    bool _prefetchQuit;        // set to stop the prefetch thread
+    int _prefetchFrames;       // number of frames to decode ahead of the last requested one
+    unsigned _prefetchStream;  // stream being prefetched
+    int _prefetchFrom;         // next 0-based frame to prefetch
+    int _prefetchTo;           // end of the prefetch range, nothing to do while _prefetchFrom >= _prefetchTo
 
     // set reader error
     void setError(const char* msg, const char* prefix = 0)
@@ -394,15 +804,158 @@ namespace
       return frames;
     }
 
+    // Sidecar layout: magic, size and modification time of the media file (to detect stale indices), number of streams,
+    // then for each stream its index, packet count and packets.
+    static const char* indexMagic()
+    {
+      return "FFRIDX01";
+    }
+
+    static bool mediaFileStamp(const char* filename, int64_t& size, int64_t& mtime)
+    {
+      struct stat st;
+      if (stat(filename, &st) != 0)
+        return false;
+      size = st.st_size;
+      mtime = st.st_mtime;
+      return true;
+    }
+
+    bool readIndexSidecar(const std::string& filename, std::vector< std::vector<IndexPacket> >& packets)
+    {
+      int64_t size, mtime;
+      if (!mediaFileStamp(filename.c_str(), size, mtime))
+        return false;
+
+      FILE* file = fopen((filename + ".ffindex").c_str(), "rb");
+      if (!file)
+        return false;
+
+      char magic[8];
+      int64_t fileSize = -1, fileTime = -1;
+      uint32_t nbStreams = 0;
+      bool ok = fread(magic, sizeof(magic), 1, file) == 1 && !memcmp(magic, indexMagic(), sizeof(magic)) &&
+                fread(&fileSize, sizeof(fileSize), 1, file) == 1 && fileSize == size &&
+                fread(&fileTime, sizeof(fileTime), 1, file) == 1 && fileTime == mtime &&
+                fread(&nbStreams, sizeof(nbStreams), 1, file) == 1 && nbStreams == _streams.size();
+
+      for (uint32_t i = 0; ok && i < nbStreams; ++i) {
+        int32_t idx = -1;
+        uint32_t count = 0;
+        ok = fread(&idx, sizeof(idx), 1, file) == 1 && idx == _streams[i]->_idx &&
+             fread(&count, sizeof(count), 1, file) == 1;
+        if (ok) {
+          packets[i].resize(count);
+          ok = !count || fread(&packets[i][0], sizeof(IndexPacket), count, file) == count;
+        }
+      }
+
+      fclose(file);
+      return ok;
+    }
+
+    void writeIndexSidecar(const std::string& filename, const std::vector< std::vector<IndexPacket> >& packets)
+    {
+      int64_t size, mtime;
+      if (!mediaFileStamp(filename.c_str(), size, mtime))
+        return;
+
+      // Write to a temporary and rename, so a reader never sees a partial sidecar.
+      std::string sidecar = filename + ".ffindex";
+      std::string temp = sidecar + ".tmp";
+      FILE* file = fopen(temp.c_str(), "wb");
+      if (!file)
+        return;
+
+      uint32_t nbStreams = _streams.size();
+      bool ok = fwrite(indexMagic(), 8, 1, file) == 1 &&
+                fwrite(&size, sizeof(size), 1, file) == 1 &&
+                fwrite(&mtime, sizeof(mtime), 1, file) == 1 &&
+                fwrite(&nbStreams, sizeof(nbStreams), 1, file) == 1;
+
+      for (uint32_t i = 0; ok && i < nbStreams; ++i) {
+        int32_t idx = _streams[i]->_idx;
+        uint32_t count = packets[i].size();
+        ok = fwrite(&idx, sizeof(idx), 1, file) == 1 &&
+             fwrite(&count, sizeof(count), 1, file) == 1 &&
+             (!count || fwrite(&packets[i][0], sizeof(IndexPacket), count, file) == count);
+      }
+
+      if (fclose(file) != 0)
+        ok = false;
+      if (!ok || rename(temp.c_str(), sidecar.c_str()) != 0)
+        remove(temp.c_str());
+    }
+
+    // Read every packet of the file once, recording timestamps, key-frame flags and positions of the video streams'
+    // packets, and derive each stream's seek tables from them.
+    void buildIndex(const std::string& filename)
+    {
+      std::vector< std::vector<IndexPacket> > packets(_streams.size());
+
+      bool sidecar = IsIndexSidecarEnabled();
+      bool fromSidecar = sidecar && readIndexSidecar(filename, packets);
+
+      if (!fromSidecar) {
+#if TRACE_FILE_OPEN
+        std::cout << "  Building packet index..." << std::endl;
+#endif
+        std::map<int, size_t> streamMap;
+        for (size_t i = 0; i < _streams.size(); ++i)
+          streamMap[_streams[i]->_idx] = i;
+
+        if (av_seek_frame(_context, -1, _context->start_time != int64_t(AV_NOPTS_VALUE) ? _context->start_time : 0,
+                          AVSEEK_FLAG_BACKWARD) < 0)
+          return;
+
+        av_init_packet(&_avPacket);
+        int error;
+        while ((error = av_read_frame(_context, &_avPacket)) >= 0) {
+          std::map<int, size_t>::iterator it = streamMap.find(_avPacket.stream_index);
+          if (it != streamMap.end()) {
+            IndexPacket packet;
+            packet._pts = _avPacket.pts;
+            packet._dts = _avPacket.dts;
+            packet._pos = _avPacket.pos;
+            packet._key = (_avPacket.flags & AV_PKT_FLAG_KEY) ? 1 : 0;
+            packets[it->second].push_back(packet);
+          }
+          av_free_packet(&_avPacket);
+        }
+
+        // Only a complete pass gives a usable index.
+        if (error != AVERROR_EOF)
+          return;
+
+        if (sidecar)
+          writeIndexSidecar(filename, packets);
+      }
+
+      for (size_t i = 0; i < _streams.size(); ++i) {
+        _streams[i]->setIndex(packets[i]);
+#if TRACE_FILE_OPEN
+        std::cout << "    Stream " << _streams[i]->_idx << ": " << packets[i].size() << " packets, " <<
+                     _streams[i]->_keyFrames.size() << " usable key-frames" << (fromSidecar ? " (from sidecar)" : "") << std::endl;
+#endif
+      }
+    }
+
   public:
 
     typedef RefCountedPtr<FFmpegFile> Ptr;
 
-    // constructor
-    FFmpegFile(const char* filename)
+    // constructor. Contexts opened after the first one of a file pass that one as primary, they then take the stream
+    // properties and index from it instead of working them out again.
+    FFmpegFile(const char* filename, size_t cacheBudget = GetFrameCacheBudget(), const FFmpegFile* primary = NULL)
       : _context(NULL)
       , _format(NULL)
       , _invalidState(false)      
+      , _prefetchRunning(false)
+      , _prefetchQuit(false)
+      , _prefetchFrames(GetPrefetchFrames())
+      , _prefetchStream(0)
+      , _prefetchFrom(0)
+      , _prefetchTo(0)
     {
       // FIXME_GC: shouldn't the plugin be passed the filename without the prefix?
       int offset = 0;
@@ -507,6 +1060,7 @@ namespace
 
         stream->_width  = avstream->codec->width;
         stream->_height = avstream->codec->height;
+        stream->_layout.setup(avstream->codec->pix_fmt, stream->_width, stream->_height);
 #if TRACE_FILE_OPEN
         std::cout << "      Image size=" << stream->_width << "x" << stream->_height << std::endl;
 #endif
@@ -530,20 +1084,47 @@ namespace
 #endif
 
         // set stream start time and numbers of frames
-        stream->_startPTS = getStreamStartTime(*stream);
-        stream->_frames   = getStreamFrames(*stream);
+        const Stream* shared = primary ? primary->findStream(i) : NULL;
+        if (shared)
+          stream->shareInfo(*shared);
+        else {
+          stream->_startPTS = getStreamStartTime(*stream);
+          stream->_frames   = getStreamFrames(*stream);
+        }
+
+        stream->_cache.setup(stream->frameSize(), cacheBudget);
           
         // save the stream
         _streams.push_back(stream);
       }
 
-      if (_streams.empty())
+      if (_streams.empty()) {
         setError( unsuported_codec ? "unsupported codec..." : "unable to find video stream" );
+        return;
+      }
+
+      if (!primary && IsIndexEnabled())
+        buildIndex(filename + offset);
+
+      // Prefetched frames go to the cache only, there's no point in decoding ahead without one.
+      if (_prefetchFrames > 0 && _streams[0]->_cache.enabled()) {
+        _prefetchRunning = true;
+        Thread::spawn(prefetchThread, 1, this);
+      }
     }
 
     // destructor
     ~FFmpegFile()
     {
+      if (_prefetchRunning) {
+        {
+          Guard guard(_lock);
+          _prefetchQuit = true;
+          _lock.signal();
+        }
+        Thread::wait(this);
+      }
+
       // force to close all resources needed for all streams
       std::for_each(_streams.begin(), _streams.end(), Stream::destroy);
 
@@ -569,6 +1150,27 @@ namespace
       return _streams.size();
     }
 
+    // return the stream for FFmpeg stream index idx, NULL if it's not a supported video stream
+    const Stream* findStream(int idx) const
+    {
+      for (size_t i = 0; i < _streams.size(); ++i) {
+        if (_streams[i]->_idx == idx)
+          return _streams[i];
+      }
+      return NULL;
+    }
+
+    // return true if frame (1-based) of a stream is in the cache, without waiting for a decode in progress
+    bool cached(unsigned frame, unsigned streamIdx = 0)
+    {
+      if (streamIdx >= _streams.size() || !_lock.trylock())
+        return false;
+
+      bool found = _streams[streamIdx]->_cache.contains(frame - 1);
+      _lock.unlock();
+      return found;
+    }
+
     // decode a single frame into the buffer thread safe
     bool decode(unsigned char* buffer, unsigned frame, unsigned streamIdx = 0)
     {
@@ -587,8 +1189,87 @@ namespace
       if (desiredFrame < 0 || desiredFrame >= stream->_frames)
         return false;
 
+      bool hasPicture = stream->_cache.fetch(desiredFrame, buffer);
 #if TRACE_DECODE_PROCESS
-      std::cout << "ffmpegReader=" << this << "::decode(): desiredFrame=" << desiredFrame << ", videoStream=" << streamIdx << ", streamIdx=" << stream->_idx << std::endl;
+      if (hasPicture)
+        std::cout << "ffmpegReader=" << this << "::decode(): desiredFrame=" << desiredFrame << " found in cache" << std::endl;
+#endif
+      if (!hasPicture)
+        hasPicture = decodeFrame(stream, desiredFrame, buffer);
+
+      // Keep the prefetch thread ahead of the play head.
+      if (hasPicture && _prefetchRunning) {
+        _prefetchStream = streamIdx;
+        _prefetchFrom = desiredFrame + 1;
+        _prefetchTo = std::min<int64_t>(desiredFrame + 1 + _prefetchFrames, stream->_frames);
+        _lock.signal();
+      }
+
+      return hasPicture;
+    }
+
+  private:
+
+    // Seek stream so that decode reaches targetFrame. For indexed streams decode is planned to start at the key-frame
+    // targetFrame needs, returned in seekKey. Otherwise lastSeekedFrame is set, so that the landing frame is searched for
+    // using the timestamps of the packets read after the seek.
+    int seekStream(Stream* stream, int targetFrame, int& lastSeekedFrame, const KeyFrame*& seekKey)
+    {
+      stream->_decodeNextFrameIn  = -1;
+      stream->_decodeNextFrameOut = -1;
+      stream->_accumDecodeLatency = 0;
+
+      int64_t seekTs;
+      if (stream->indexed()) {
+        seekKey = &stream->_keyFrames[stream->_frameKey[targetFrame]];
+        lastSeekedFrame = -1;
+        seekTs = seekKey->_seekTs;
+      }
+      else {
+        seekKey = NULL;
+        lastSeekedFrame = targetFrame;
+        seekTs = stream->frameToPts(targetFrame);
+      }
+
+      avcodec_flush_buffers(stream->_codecContext);
+      return av_seek_frame(_context, stream->_idx, seekTs, AVSEEK_FLAG_BACKWARD);
+    }
+
+    static void prefetchThread(unsigned index, unsigned nThreads, void* userdata)
+    {
+      static_cast<FFmpegFile*>(userdata)->prefetch();
+    }
+
+    // Decode the frames following the last requested one into the cache, one frame per lock hold so that a render
+    // thread asking for a frame never waits for more than one decode.
+    void prefetch()
+    {
+      _lock.lock();
+      while (!_prefetchQuit) {
+        if (_prefetchFrom >= _prefetchTo) {
+          _lock.wait();
+          continue;
+        }
+
+        Stream* stream = _streams[_prefetchStream];
+        int frame = _prefetchFrom++;
+        if (!stream->_cache.contains(frame)) {
+          // Give up on this range on failure, the next request will seek and try again.
+          if (!decodeFrame(stream, frame, NULL))
+            _prefetchTo = _prefetchFrom;
+        }
+
+        _lock.unlock();
+        _lock.lock();
+      }
+      _lock.unlock();
+    }
+
+    // Decode frame desiredFrame of stream into buffer (if not NULL) and the stream's cache. Must be called with _lock held.
+    bool decodeFrame(Stream* stream, int desiredFrame, unsigned char* buffer)
+    {
+#if TRACE_DECODE_PROCESS
+      std::cout << "ffmpegReader=" << this << "::decode(): desiredFrame=" << desiredFrame << ", streamIdx=" << stream->_idx << std::endl;
 #endif
 
       // Number of read retries remaining when decode stall is detected before we give up (in the case of post-seek stalls,
@@ -625,19 +1306,19 @@ namespace
       int lastSeekedFrame = -1; // 0-based index of the last frame to which we seeked when seek in progress / negative when no
                                 // seek in progress,
 
+      // For indexed streams, the key-frame a seek was planned to start decoding at, while packets before it are skipped.
+      // Once it's read, frame indices are known without searching and exactly desiredFrame - _frame frames are decoded
+      // before the desired one.
+      const KeyFrame* seekKey = NULL;
+
       if (desiredFrame != stream->_decodeNextFrameOut) {
 #if TRACE_DECODE_PROCESS
         std::cout << "  Next frame expected out=" << stream->_decodeNextFrameOut << ", Seeking to desired frame" << std::endl;
 #endif
 
-        lastSeekedFrame = desiredFrame;
-        stream->_decodeNextFrameIn  = -1;
-        stream->_decodeNextFrameOut = -1;
-        stream->_accumDecodeLatency = 0;
         awaitingFirstDecodeAfterSeek = true;
 
-        avcodec_flush_buffers(stream->_codecContext);
-        int error = av_seek_frame(_context, stream->_idx, stream->frameToPts(desiredFrame), AVSEEK_FLAG_BACKWARD);
+        int error = seekStream(stream, desiredFrame, lastSeekedFrame, seekKey);
         if (error < 0) {
           // Seek error. Abort attempt to read and decode frames.
           setInternalError(error, "FFmpeg Reader failed to seek frame: ");
@@ -700,6 +1381,25 @@ namespace
             if (_avPacket.pts != int64_t(AV_NOPTS_VALUE))
               stream->_ptsSeen = true;
 
+            // If an index planned seek is in progress, skip packets until the planned key-frame is reached. Should the
+            // file not match the index, go on as for an unindexed seek.
+            if (seekKey) {
+              if (_avPacket.*stream->_timestampField == seekKey->_ts && (seekKey->_pos < 0 || _avPacket.pos == seekKey->_pos)) {
+#if TRACE_DECODE_PROCESS
+                std::cout << "    Reached planned key-frame " << seekKey->_frame << std::endl;
+#endif
+                stream->_decodeNextFrameOut = stream->_decodeNextFrameIn = seekKey->_frame;
+                seekKey = NULL;
+              }
+              else if (seekKey->_pos >= 0 && _avPacket.pos > seekKey->_pos) {
+#if TRACE_DECODE_PROCESS
+                std::cout << "    Passed planned key-frame, file doesn't match its index" << std::endl;
+#endif
+                seekKey = NULL;
+                lastSeekedFrame = desiredFrame;
+              }
+            }
+
             // If a seek is in progress, we need to synchronise frame indices if we can...
             if (lastSeekedFrame >= 0) {
 #if TRACE_DECODE_PROCESS
@@ -779,7 +1479,7 @@ namespace
             }
 
             // If there's no seek in progress, feed this frame into the decoder.
-            if (lastSeekedFrame < 0) {
+            if (lastSeekedFrame < 0 && !seekKey) {
 #if TRACE_DECODE_BITSTREAM              
               std::cout << "  Decoding input frame " << stream->_decodeNextFrameIn << " bitstream:" << std::endl;
               uint8_t *data = _avPacket.data;
@@ -872,17 +1572,27 @@ namespace
 #if TRACE_DECODE_PROCESS
             std::cout << ", is desired frame" << std::endl;
 #endif
-            AVPicture output;
-            avpicture_fill(&output, buffer, PIX_FMT_RGB24, stream->_width, stream->_height);
-
-            sws_scale(stream->getConvertCtx(), stream->_avFrame->data, stream->_avFrame->linesize, 0,  stream->_height, output.data, output.linesize);
+            unsigned char* cached = stream->_cache.insert(desiredFrame);
+            if (buffer) {
+              stream->convertFrame(buffer);
+              if (cached)
+                memcpy(cached, buffer, stream->frameSize());
+            }
+            else if (cached)
+              stream->convertFrame(cached);
 
             hasPicture = true;
           }
+          // Otherwise keep the frame anyway, it's one of the frames between the key-frame a seek landed at and the desired
+          // frame, which are the next ones requested when scrubbing backwards.
+          else {
 #if TRACE_DECODE_PROCESS
-          else
             std::cout << ", is not desired frame (" << desiredFrame << ")" << std::endl;
 #endif
+            unsigned char* cached = stream->_cache.insert(stream->_decodeNextFrameOut);
+            if (cached)
+              stream->convertFrame(cached);
+          }
 
           // Advance next output frame expected from decode.
           ++stream->_decodeNextFrameOut;
@@ -950,15 +1660,11 @@ namespace
               }
             }
 
-            // If we reach here, seek to the target frame chosen above in an attempt to recover from the decode stall.
-            lastSeekedFrame = seekTargetFrame;
-            stream->_decodeNextFrameIn  = -1;
-            stream->_decodeNextFrameOut = -1;
-            stream->_accumDecodeLatency = 0;
+            // If we reach here, seek to the target frame chosen above in an attempt to recover from the decode stall. For
+            // indexed streams, a target before the landing frame resolves to the previous key-frame.
             awaitingFirstDecodeAfterSeek = true;
 
-            avcodec_flush_buffers(stream->_codecContext);
-            int error = av_seek_frame(_context, stream->_idx, stream->frameToPts(seekTargetFrame), AVSEEK_FLAG_BACKWARD);
+            int error = seekStream(stream, seekTargetFrame, lastSeekedFrame, seekKey);
             if (error < 0) {
               // Seek error. Abort attempt to read and decode frames.
               setInternalError(error, "FFmpeg Reader failed to seek frame: ");
@@ -986,6 +1692,8 @@ namespace
       return hasPicture;
     }
 
+  public:
+
     // fill the metada information of a particular stream
     bool metadata(DD::Image::MetaData::Bundle& metadata, unsigned streamIdx = 0)
     {
@@ -1019,6 +1727,17 @@ namespace
       return true;
     }
 
+    // get the layout of the frames decode() fills the buffer with
+    bool layout(FrameLayout& layout, unsigned streamIdx = 0) const
+    {
+      // fixed once the file is open, no need to lock
+      if (streamIdx >= _streams.size())
+        return false;
+
+      layout = _streams[streamIdx]->_layout;
+      return true;
+    }
+
     // get stream information
     bool info( int& width, 
                int& height, 
@@ -1026,8 +1745,7 @@ namespace
                int& frames, 
                unsigned streamIdx = 0)
     {
-      Guard guard(_lock);
-
+      // stream properties don't change once the file is open, no need to lock
       if (streamIdx >= _streams.size())
         return false;
 
@@ -1044,10 +1762,177 @@ namespace
     
   };
 
-  // Keeps track of all FFmpegFile mapped against file name.
+  // A set of independent FFmpegFile contexts opened on the same file, so that several threads can decode frames from it at
+  // the same time instead of queueing on a single context. The first context works out the stream properties and index,
+  // the others copy them when opened and never modify them, so they're read without locking. Frame requests go to the idle
+  // context that has the frame cached or whose last decoded frame is closest, a new context is opened when all of them are
+  // too far away to decode forward from.
+  class FFmpegFilePool: public RefCountedObject
+  {
+    // decoding further than this past the last frame of a context is assumed to be more expensive than a new context
+    enum { kMaxForwardDistance = 25 };
+
+    struct Context
+    {
+      FFmpegFile* _file;
+      bool _busy;
+      int _lastFrame;       // last frame decoded by the context, -1 if none
+      unsigned _lastStream;
+
+      Context(FFmpegFile* file)
+        : _file(file)
+        , _busy(false)
+        , _lastFrame(-1)
+        , _lastStream(0)
+      {
+      }
+    };
+
+    std::string _filename;
+    std::string _errorMsg;
+    std::vector<Context> _contexts;  // the first one is the primary context
+    size_t _maxContexts;
+    size_t _opening;                 // number of contexts being opened outside of the lock
+    SignalLock _lock;
+
+    // distance to decode forward from the last frame of a context, -1 if it would have to seek backward
+    static int distance(const Context& context, int frame, unsigned streamIdx)
+    {
+      if (context._lastFrame < 0 || context._lastStream != streamIdx || frame < context._lastFrame)
+        return -1;
+      return frame - context._lastFrame;
+    }
+
+  public:
+
+    typedef RefCountedPtr<FFmpegFilePool> Ptr;
+
+    // constructor
+    FFmpegFilePool(const char* filename)
+      : _filename(filename)
+      , _maxContexts(GetMaxDecodeContexts())
+      , _opening(0)
+    {
+      _contexts.reserve(_maxContexts);
+      _contexts.push_back(Context(new FFmpegFile(filename, GetFrameCacheBudget() / _maxContexts)));
+    }
+
+    // destructor
+    ~FFmpegFilePool()
+    {
+      for (size_t i = 0; i < _contexts.size(); ++i)
+        delete _contexts[i]._file;
+    }
+
+    // get the internal error string
+    const char* error() const
+    {
+      return _errorMsg.empty() ? _contexts[0]._file->error() : _errorMsg.c_str();
+    }
+
+    // return true if the reader can't decode the frame
+    bool invalid() const
+    {
+      return _contexts[0]._file->invalid();
+    }
+
+    // fill the metada information of a particular stream
+    bool metadata(DD::Image::MetaData::Bundle& metadata, unsigned streamIdx = 0)
+    {
+      return _contexts[0]._file->metadata(metadata, streamIdx);
+    }
+
+    // get stream information
+    bool info(int& width, int& height, double& aspect, int& frames, unsigned streamIdx = 0)
+    {
+      return _contexts[0]._file->info(width, height, aspect, frames, streamIdx);
+    }
+
+    // get the layout of the frames decode() fills the buffer with
+    bool layout(FrameLayout& layout, unsigned streamIdx = 0) const
+    {
+      return _contexts[0]._file->layout(layout, streamIdx);
+    }
+
+    // decode a single frame into the buffer, using the context best placed to do so
+    bool decode(unsigned char* buffer, unsigned frame, unsigned streamIdx = 0)
+    {
+      int desiredFrame = frame - 1;
+      size_t slot = 0;
+
+      {
+        Guard guard(_lock);
+
+        for (;;) {
+          int best = -1;
+          int bestDistance = -1;
+
+          for (size_t i = 0; i < _contexts.size(); ++i) {
+            if (_contexts[i]._busy)
+              continue;
+            if (_contexts[i]._file->cached(frame, streamIdx)) {
+              best = i;
+              bestDistance = 0;
+              break;
+            }
+            int d = distance(_contexts[i], desiredFrame, streamIdx);
+            if (best < 0 || (d >= 0 && (bestDistance < 0 || d < bestDistance))) {
+              best = i;
+              bestDistance = d;
+            }
+          }
+
+          // open another context if none of the idle ones can decode forward to the frame
+          if ((best < 0 || bestDistance < 0 || bestDistance > kMaxForwardDistance) &&
+              _contexts.size() + _opening < _maxContexts) {
+            ++_opening;
+            _lock.unlock();
+            FFmpegFile* file = new FFmpegFile(_filename.c_str(), GetFrameCacheBudget() / _maxContexts, _contexts[0]._file);
+            _lock.lock();
+            --_opening;
+
+            if (file->invalid()) {
+              delete file;
+            }
+            else {
+              _contexts.push_back(Context(file));
+              best = _contexts.size() - 1;
+            }
+          }
+
+          if (best >= 0 && !_contexts[best]._busy) {
+            slot = best;
+            break;
+          }
+
+          // every context is busy, wait for one to be released
+          _lock.wait();
+        }
+
+        _contexts[slot]._busy = true;
+      }
+
+      // _contexts never reallocates past its reserved size, so the pointer stays valid while the lock is released
+      FFmpegFile* file = _contexts[slot]._file;
+      bool hasPicture = file->decode(buffer, frame, streamIdx);
+
+      Guard guard(_lock);
+      Context& context = _contexts[slot];
+      context._busy = false;
+      context._lastFrame = hasPicture ? desiredFrame : -1;
+      context._lastStream = streamIdx;
+      if (!hasPicture)
+        _errorMsg = file->error();
+      _lock.signal();
+
+      return hasPicture;
+    }
+  };
+
+  // Keeps track of all FFmpegFilePool mapped against file name.
   class FFmpegFileManager
   {
-    typedef std::map<std::string, FFmpegFile::Ptr> ReaderMap;
+    typedef std::map<std::string, FFmpegFilePool::Ptr> ReaderMap;
 
 #if !defined(FN_HIERO)
     ReaderMap _readers;
@@ -1114,18 +1999,18 @@ namespace
     }
 
     // get a specific reader 
-    FFmpegFile::Ptr get(const char* filename)
+    FFmpegFilePool::Ptr get(const char* filename)
     {
       // For performance reason and for different use cases Hero prefer to decode multiple time the same file.
       // That means allocating more resources by gurantee best performance when the application needs
       // to seek in consecutive way from different position in the same video sequence.
 #if defined(FN_HIERO)
-      FFmpegFile::Ptr retVal;
+      FFmpegFilePool::Ptr retVal;
       retVal.allocate(filename);
       return retVal;
 #else
       Guard guad(_lock);
-      FFmpegFile::Ptr retVal;
+      FFmpegFilePool::Ptr retVal;
 
       ReaderMap::iterator it = _readers.find(filename);
       if (it == _readers.end()) {
@@ -1197,8 +2082,9 @@ private:
    
 private:
 
-  FFmpegFile::Ptr _reader;
+  FFmpegFilePool::Ptr _reader;
   DD::Image::MemoryBuffer _data;    // decoding buffer
+  FrameLayout _layout;              // layout of the decoded frame in _data
   size_t _memNeeded;                // memory needed for decoding a single frame
   
   int  _numFrames;                  // number of frames in the selected stream
@@ -1233,9 +2119,11 @@ ffmpegReader::ffmpegReader(Read* iop)
     info_.last_frame(frames);
     
     _numFrames = frames;
-    _memNeeded = width * height * 3;   
   }
 
+  if (_reader->layout(_layout))
+    _memNeeded = _layout._size;
+
   // get stream 0 metadata
   _reader->metadata(meta);
     
@@ -1276,12 +2164,30 @@ void ffmpegReader::engine(int y, int x, int rx, ChannelMask channels, Row& out)
     return;
   }
 
-  foreach ( z, channels ) {
-    float* TO = out.writable(z) + x;
-    unsigned char* FROM = static_cast<unsigned char*>(guard.buffer());
-    FROM += (height() - y - 1) * width() * 3;
-    FROM += x * 3;
-    from_byte(z, TO, FROM + z - 1, NULL, rx - x, 3);
+  const unsigned char* buffer = static_cast<const unsigned char*>(guard.buffer());
+  int line = height() - y - 1;
+
+  if (!_layout._yuv) {
+    foreach ( z, channels ) {
+      float* TO = out.writable(z) + x;
+      const unsigned char* FROM = buffer + size_t(line) * _layout._linesize[0];
+      FROM += x * 3;
+      from_byte(z, TO, FROM + z - 1, NULL, rx - x, 3);
+    }
+    return;
+  }
+
+  // Convert the requested span straight from the decoded YUV planes, a chunk at a time so the RGB values are still in
+  // cache when the colorspace LUT is applied to them.
+  const int kChunk = 256;
+  float rgb[3][kChunk];
+
+  for (int X = x; X < rx; X += kChunk) {
+    int count = std::min(rx - X, kChunk);
+    _layout.convertRow(buffer, line, X, count, rgb[0], rgb[1], rgb[2]);
+
+    foreach ( z, channels )
+      from_float(z, out.writable(z) + X, rgb[z - 1], NULL, count, 1);
   }
 }
 